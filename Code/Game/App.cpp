@@ -1,21 +1,29 @@
+#include <stdio.h>
+#include <fstream>
 #include "Engine/Renderer/Renderer.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Input/InputSystem.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
-#include "Engine/Renderer/Window.hpp"
 #include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Core/DevConsole.hpp"
 #include "Engine/Core/EventSystem.hpp"
 #include "Engine/Core/Clock.hpp"
 #include "Engine/Core/JobSystem.hpp"
+#include "Game/EngineBuildPreferences.hpp"
+#include "Game/App.hpp"
+#include "Game/MemoryTracker.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/Game.hpp"
+#include "Game/RenderResourceTable.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
+#include "Engine/Renderer/Window.hpp"
 #include "Engine/Renderer/TextureView.hpp"
-#include "Engine/Renderer/ParticlesManager.hpp"
 #include "ThirdParty/ImGUI/imgui.h"
 #include "ThirdParty/ImGUI/imgui_impl_dx11.h"
 #include "ThirdParty/ImGUI/imgui_impl_win32.h"
-#include "Game/App.hpp"
-#include "Game/Game.hpp"
+#endif
 
 Renderer* g_theRenderer = nullptr;
 App* g_theApp = nullptr;
@@ -23,17 +31,52 @@ InputSystem* g_theInput = nullptr;
 AudioSystem* g_theAudio = nullptr;
 Window* g_theWindow = nullptr;
 JobSystem* g_theJobSystem = nullptr;
-ParticlesManager* g_theParticlesManager = nullptr;
+RenderResourceTable* g_theRenderResources = nullptr;
+extern MemoryTracker* g_theMemoryTracker;
 
 bool App::s_isQuitting = false;
 
 void App::Startup()
 {
 	LoadGameConfigBlackboard();
+	m_isHeadless = m_isHeadless || g_gameConfigBlackboard.GetValue("headless", false);
 
 	EventSystemConfig eventSystemConfig;
 	g_theEventSystem = new EventSystem(eventSystemConfig);
 
+	bool enableJobSystem = g_gameConfigBlackboard.GetValue("enableJobSystem", false);
+	if (enableJobSystem)
+	{
+		JobSystemConfig jobSystemConfig;
+		jobSystemConfig.m_numWorkerThreads = std::thread::hardware_concurrency() - 1;
+		g_theJobSystem = new JobSystem(jobSystemConfig);
+	}
+
+	MemoryTrackerConfig memoryConfig;
+	memoryConfig.m_frameAllocationBudget = g_gameConfigBlackboard.GetValue("memFrameAllocationBudget", memoryConfig.m_frameAllocationBudget);
+	memoryConfig.m_frameByteBudget = g_gameConfigBlackboard.GetValue("memFrameByteBudget", memoryConfig.m_frameByteBudget);
+	memoryConfig.m_dieOnBudgetExceeded = g_gameConfigBlackboard.GetValue("memDieOnBudgetExceeded", memoryConfig.m_dieOnBudgetExceeded);
+	g_theMemoryTracker = new MemoryTracker(memoryConfig);
+
+	g_theEventSystem->Startup();
+	//a headless run has no window, renderer, input, audio or console, the game draws into a render backend that only counts
+	if (!m_isHeadless)
+		StartupPresentation();
+	if(g_theJobSystem)
+		g_theJobSystem->Startup();
+	g_theMemoryTracker->Startup();
+	GameTestRegistry::Startup();
+	g_theRenderResources = new RenderResourceTable();
+
+	m_theGame = new Game();
+	m_theGame->Startup();
+
+	SubscribeEventCallbackFunction("quit", Command_Quit);
+}
+
+#if !defined(GAME_HEADLESS_ONLY)
+void App::StartupPresentation()
+{
 	InputSystemConfig inputConfig;
 	g_theInput = new InputSystem(inputConfig);
 
@@ -61,55 +104,26 @@ void App::Startup()
 	AudioSystemConfig audioConfig;
 	g_theAudio = new AudioSystem(audioConfig);
 
-	bool enableJobSystem = g_gameConfigBlackboard.GetValue("enableJobSystem", false);
-	if (enableJobSystem)
-	{
-		JobSystemConfig jobSystemConfig;
-		jobSystemConfig.m_numWorkerThreads = std::thread::hardware_concurrency() - 1;
-		g_theJobSystem = new JobSystem(jobSystemConfig);
-	}
-
-	ParticlesManagerConfig particleConfig;
-	particleConfig.m_maxParticles = g_gameConfigBlackboard.GetValue("maxCPUParticles", 0);
-	particleConfig.m_numPools = g_gameConfigBlackboard.GetValue("cpuParticlePools", 1);
-	particleConfig.m_renderer = g_theRenderer;
-	particleConfig.m_jobSystem = g_theJobSystem;
-	g_theParticlesManager = new ParticlesManager(particleConfig);
-
-	g_theEventSystem->Startup();
 	g_theInput->Startup();
 	g_theWindow->Startup();
 	g_theRenderer->Startup();
 	g_theConsole->Startup();
 	g_theAudio->Startup();
-	if(g_theJobSystem)
-		g_theJobSystem->Startup();
-	g_theParticlesManager->Startup();
 
 	//initialize ImGUI
 	ImGui::CreateContext();
 	ImGui::StyleColorsDark();
 	ImGui_ImplWin32_Init(g_theWindow->GetOSWindowHandle());
 	ImGui_ImplDX11_Init(g_theRenderer->GetDevice(), g_theRenderer->GetDeviceContext());
-
-	m_theGame = new Game();
-	m_theGame->Startup();
-
-	SubscribeEventCallbackFunction("quit", Command_Quit);
 }
 
-void App::BeginFrame()
-{	
-	Clock::SystemBeginFrame();
-
-	g_theEventSystem->BeginFrame();
+void App::BeginPresentationFrame()
+{
 	g_theInput->BeginFrame();
 	g_theWindow->BeginFrame();
 	g_theRenderer->BeginFrame();
 	g_theConsole->BeginFrame();
 	g_theAudio->BeginFrame();
-	if(g_theJobSystem)
-		g_theJobSystem->BeginFrame();
 
 	//imgui begin frame functions
 	ImGui_ImplDX11_NewFrame();
@@ -117,20 +131,8 @@ void App::BeginFrame()
 	ImGui::NewFrame();
 }
 
-void App::Update()
-{
-	HandleKeyboardInput();
-
-	float deltaSeconds = static_cast<float>(m_gameClock.GetDeltaTime());
-	if(m_theGame)
-		m_theGame->Update(deltaSeconds);
-}
-
-void App::Render() const
+void App::RenderPresentation() const
 {
-	if (m_theGame)
-		m_theGame->Render();
-
 	//imgui render function
 	Texture* texture = g_theRenderer->GetCurrentColorTarget();
 	TextureView* rtv = texture->GetRenderTargetView();
@@ -139,43 +141,25 @@ void App::Render() const
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
-void App::EndFrame()
+void App::EndPresentationFrame()
 {
-	g_theEventSystem->EndFrame();
 	g_theInput->EndFrame();
 	g_theWindow->EndFrame();
 	g_theRenderer->EndFrame();
 	g_theConsole->EndFrame();
 	g_theAudio->EndFrame();
-	if (g_theJobSystem)
-		g_theJobSystem->EndFrame();
 
 	//ImGui::Render();
 	//ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
-void App::Shutdown()
+void App::ShutdownPresentation()
 {
-	m_theGame->ShutDown();
-	delete m_theGame;
-	m_theGame = nullptr;
-
 	//imgui shutdown
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
 
-	g_theParticlesManager->Shutdown();
-	delete g_theParticlesManager;
-	g_theParticlesManager = nullptr;
-
-	if (g_theJobSystem)
-	{
-		g_theJobSystem->Shutdown();
-		delete g_theJobSystem;
-		g_theJobSystem = nullptr;
-	}
-
 	g_theAudio->Shutdown();
 	delete g_theAudio;
 	g_theAudio = nullptr;
@@ -195,6 +179,97 @@ void App::Shutdown()
 	g_theInput->Shutdown();
 	delete g_theInput;
 	g_theInput = nullptr;
+}
+#else
+//headless only builds have no window, renderer or imgui to present with, so they always run headless
+void App::StartupPresentation()
+{
+}
+
+void App::BeginPresentationFrame()
+{
+}
+
+void App::RenderPresentation() const
+{
+}
+
+void App::EndPresentationFrame()
+{
+}
+
+void App::ShutdownPresentation()
+{
+}
+#endif
+
+void App::BeginFrame()
+{	
+	Clock::SystemBeginFrame();
+	g_theMemoryTracker->BeginFrame();
+
+	g_theEventSystem->BeginFrame();
+	if(g_theJobSystem)
+		g_theJobSystem->BeginFrame();
+
+	if (!m_isHeadless)
+		BeginPresentationFrame();
+}
+
+void App::Update()
+{
+	if (!m_isHeadless)
+		HandleKeyboardInput();
+
+	float deltaSeconds = static_cast<float>(m_gameClock.GetDeltaTime());
+	if(m_theGame)
+		m_theGame->Update(deltaSeconds);
+}
+
+void App::Render() const
+{
+	if (m_theGame)
+		m_theGame->Render();
+	if (!m_isHeadless)
+		RenderPresentation();
+}
+
+void App::EndFrame()
+{
+	if (m_theGame)
+		m_theGame->EndFrame();
+
+	g_theEventSystem->EndFrame();
+	if (!m_isHeadless)
+		EndPresentationFrame();
+	if (g_theJobSystem)
+		g_theJobSystem->EndFrame();
+	g_theMemoryTracker->EndFrame();
+}
+
+void App::Shutdown()
+{
+	m_theGame->ShutDown();
+	delete m_theGame;
+	m_theGame = nullptr;
+
+	GameTestRegistry::Shutdown();
+	g_theMemoryTracker->Shutdown();
+	delete g_theMemoryTracker;
+	g_theMemoryTracker = nullptr;
+
+	if (g_theJobSystem)
+	{
+		g_theJobSystem->Shutdown();
+		delete g_theJobSystem;
+		g_theJobSystem = nullptr;
+	}
+
+	delete g_theRenderResources;
+	g_theRenderResources = nullptr;
+
+	if (!m_isHeadless)
+		ShutdownPresentation();
 
 	g_theEventSystem->Shutdown();
 	delete g_theEventSystem;
@@ -209,12 +284,104 @@ void App::RunFrame()
 	EndFrame();
 }
 
-void App::Run()
+int App::Run()
 {
+	if (m_isHeadless)
+		return RunHeadless();
+
 	while (!IsQuitting())
 	{
 		RunFrame();
 	}
+	return 0;
+}
+
+//runs the game tests when runTests is set, then every mode the cpu can run for a fixed number of frames, and prints what it
+//measured and writes it to headlessResultsFile. Returns the exit code of the process, nonzero when a test failed, a mode
+//stopped early or the results could not be written.
+int App::RunHeadless()
+{
+	std::string results;
+	bool hasFailed = false;
+	if (g_gameConfigBlackboard.GetValue("runTests", false))
+		hasFailed = !RunHeadlessTests(results);
+
+	int framesPerMode = g_gameConfigBlackboard.GetValue("headlessFramesPerMode", 300);
+	for (int modeIndex = int(GameMode::EDITOR); modeIndex <= int(GameMode::GPU_PERF_ZOO) && framesPerMode > 0; modeIndex++)
+	{
+		GameMode mode = static_cast<GameMode>(modeIndex);
+		if (mode == GameMode::GPU_PERF_ZOO)
+		{
+			results.append(Stringf("%s: skipped, its particles only run on a gpu\n", Game::GetGameModeName(mode)));
+			continue;
+		}
+
+		m_theGame->SetGameMode(mode);
+		double frameSeconds = 0.0;
+		long long numDraws = 0;
+		long long numStateChanges = 0;
+		long long numParticles = 0;
+		int numFrames = 0;
+		for (; numFrames < framesPerMode && !IsQuitting(); numFrames++)
+		{
+			double startTime = GetCurrentTimeSeconds();
+			RunFrame();
+			frameSeconds += GetCurrentTimeSeconds() - startTime;
+
+			const RenderBackendCounts& counts = m_theGame->GetHeadlessRenderCounts();
+			numDraws += counts.m_numDraws;
+			numStateChanges += counts.GetNumStateChanges();
+			if (m_theGame->GetParticleCapture())
+				numParticles += m_theGame->GetParticleCapture()->GetNumInstances();
+		}
+		if (numFrames < framesPerMode || m_theGame->GetGameMode() != mode)
+		{
+			results.append(Stringf("%s: FAILED, stopped after %d of %d frames\n", Game::GetGameModeName(mode), numFrames, framesPerMode));
+			hasFailed = true;
+			break;
+		}
+
+		float invNumFrames = 1.f / float(numFrames);
+		results.append(Stringf("%s: %.3f ms/frame, %.1f draws, %.1f state changes, %.1f captured particles\n", Game::GetGameModeName(mode),
+			frameSeconds * 1000.0 / double(numFrames), float(numDraws) * invNumFrames, float(numStateChanges) * invNumFrames, float(numParticles) * invNumFrames));
+	}
+
+	std::string resultsPath = g_gameConfigBlackboard.GetValue("headlessResultsFile", "HeadlessResults.txt");
+	if (!resultsPath.empty())
+	{
+		std::ofstream file(resultsPath.c_str());
+		file << results;
+		if (!file.good())
+		{
+			results.append(Stringf("FAILED to write the results to %s\n", resultsPath.c_str()));
+			hasFailed = true;
+		}
+	}
+	printf("%s", results.c_str());
+	fflush(stdout);
+	DebuggerPrintf("%s", results.c_str());
+	return hasFailed ? 1 : 0;
+}
+
+//a line per failed check and a summary, true when every test passed
+bool App::RunHeadlessTests(std::string& out_results)
+{
+	std::vector<GameTestResult> testResults;
+	int numFailed = GameTestRegistry::RunAll("", testResults);
+	for (int resultIndex = 0; resultIndex < int(testResults.size()); resultIndex++)
+	{
+		const GameTestResult& result = testResults[resultIndex];
+		if (result.m_failures.empty())
+			continue;
+
+		out_results.append(Stringf("FAIL %s\n", result.m_name.c_str()));
+		for (int i = 0; i < int(result.m_failures.size()); i++)
+		{
+			out_results.append(Stringf("    %s\n", result.m_failures[i].c_str()));
+		}
+	}
+	out_results.append(Stringf("%d of %d tests failed\n", numFailed, int(testResults.size())));
+	return numFailed == 0;
 }
 
 void App::HandleKeyboardInput()
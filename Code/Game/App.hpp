@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include "Engine/Math/Vec2.hpp"
 #include "Engine/Renderer/Camera.hpp"
 #include "Engine/Core/Clock.hpp"
@@ -12,12 +13,15 @@ public:
 	App() {}
 	~App() {}
 	void Startup();
-	void Run();
+	int Run();		//returns the exit code of the process
+	int RunHeadless();
 	void Shutdown();
 	void HandleQuitRequest();
 	void RemakeGame();
 
 	bool IsQuitting() const { return s_isQuitting; }
+	bool IsHeadless() const { return m_isHeadless; }
+	void SetHeadless(bool isHeadless) { m_isHeadless = isHeadless; }		//before Startup(), a headless config turns it on too
 	Clock& GetGameClock() { return m_gameClock; }
 
 	static bool Command_Quit(EventArgs& args);
@@ -25,11 +29,18 @@ public:
 private:
 	static bool s_isQuitting;
 	Game* m_theGame = nullptr;
+	bool m_isHeadless = false;		//no window, renderer, input, audio, console or imgui, Run() tests and benchmarks every mode and quits
 	Clock m_gameClock;
 
 private:
 	void BeginFrame();
 	void RunFrame();
+	void StartupPresentation();
+	void BeginPresentationFrame();
+	void RenderPresentation() const;
+	void EndPresentationFrame();
+	void ShutdownPresentation();
+	bool RunHeadlessTests(std::string& out_results);
 	void Update();
 	void Render() const;
 	void EndFrame();
@@ -0,0 +1,2387 @@
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/EulerAngles.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Engine/Renderer/ParticlesManager.hpp"
+#include "Engine/Renderer/ParticleSystem.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/XmlUtils.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/ParticleBoundsTree.hpp"
+#include "Game/ParticleLoopClip.hpp"
+#include "Game/ParticleAtlas.hpp"
+#include "Game/RenderResourceTable.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern RenderResourceTable* g_theRenderResources;
+
+const Vec3 PARTICLE_GRAVITY = Vec3(0.f, 0.f, -9.8f);
+constexpr float MIN_ATTRACTOR_DISTANCE_SQUARED = 0.00001f;
+constexpr int PARTICLE_CATCH_UP_STEPS = 8;
+
+template<typename T>
+static bool IsKeyEarlier(const AnimatedValueKey<T>& a, const AnimatedValueKey<T>& b)
+{
+	return a.GetTime() < b.GetTime();
+}
+
+static void BakeKeysIntoSamples(std::vector<AnimatedValueKey<float>> keys, float modifier, float valueWithoutKeys, float* out_samples)
+{
+	std::sort(keys.begin(), keys.end(), IsKeyEarlier<float>);
+	for (int i = 0; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		float time = float(i) / float(PARTICLE_CURVE_LUT_SIZE - 1);
+		float value = valueWithoutKeys;
+		if (!keys.empty())
+		{
+			value = keys.back().GetValue();
+			if (time <= keys[0].GetTime())
+			{
+				value = keys[0].GetValue();
+			}
+			else
+			{
+				for (int k = 1; k < int(keys.size()); k++)
+				{
+					if (time < keys[k].GetTime())
+					{
+						float fraction = RangeMap(time, keys[k - 1].GetTime(), keys[k].GetTime(), 0.f, 1.f);
+						value = Interpolate(keys[k - 1].GetValue(), keys[k].GetValue(), fraction);
+						break;
+					}
+				}
+			}
+		}
+		out_samples[i] = value * modifier;
+	}
+}
+
+static void BakeColorKeys(std::vector<AnimatedValueKey<Rgba8>> keys, const Rgba8& colorWithoutKeys, Rgba8* out_samples)
+{
+	std::sort(keys.begin(), keys.end(), IsKeyEarlier<Rgba8>);
+	for (int i = 0; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		float time = float(i) / float(PARTICLE_CURVE_LUT_SIZE - 1);
+		if (keys.empty())
+		{
+			out_samples[i] = colorWithoutKeys;
+			continue;
+		}
+
+		int nextKey = int(keys.size());
+		for (int k = 0; k < int(keys.size()); k++)
+		{
+			if (time < keys[k].GetTime())
+			{
+				nextKey = k;
+				break;
+			}
+		}
+		if (nextKey == 0 || nextKey == int(keys.size()))
+		{
+			out_samples[i] = nextKey == 0 ? keys[0].GetValue() : keys.back().GetValue();
+			continue;
+		}
+
+		Rgba8 from = keys[nextKey - 1].GetValue();
+		Rgba8 to = keys[nextKey].GetValue();
+		float fraction = RangeMap(time, keys[nextKey - 1].GetTime(), keys[nextKey].GetTime(), 0.f, 1.f);
+		out_samples[i].r = static_cast<unsigned char>(Interpolate(from.r, to.r, fraction));
+		out_samples[i].g = static_cast<unsigned char>(Interpolate(from.g, to.g, fraction));
+		out_samples[i].b = static_cast<unsigned char>(Interpolate(from.b, to.b, fraction));
+		out_samples[i].a = static_cast<unsigned char>(Interpolate(from.a, to.a, fraction));
+	}
+}
+
+static int GetSampleIndexForNormalizedAge(float normalizedAge, float& out_fraction)
+{
+	float samplePosition = ClampZeroToOne(normalizedAge) * float(PARTICLE_CURVE_LUT_SIZE - 1);
+	int sampleIndex = int(samplePosition);
+	if (sampleIndex > PARTICLE_CURVE_LUT_SIZE - 2)
+		sampleIndex = PARTICLE_CURVE_LUT_SIZE - 2;
+	out_fraction = samplePosition - float(sampleIndex);
+	return sampleIndex;
+}
+
+static void GrowBounds(AABB3& bounds, bool& hasBounds, const Vec3& center, float halfExtent)
+{
+	Vec3 extent = Vec3(halfExtent, halfExtent, halfExtent);
+	if (!hasBounds)
+	{
+		bounds = AABB3(center - extent, center + extent);
+		hasBounds = true;
+		return;
+	}
+
+	bounds.m_mins = Vec3(std::min(bounds.m_mins.x, center.x - halfExtent), std::min(bounds.m_mins.y, center.y - halfExtent), std::min(bounds.m_mins.z, center.z - halfExtent));
+	bounds.m_maxs = Vec3(std::max(bounds.m_maxs.x, center.x + halfExtent), std::max(bounds.m_maxs.y, center.y + halfExtent), std::max(bounds.m_maxs.z, center.z + halfExtent));
+}
+
+static bool IsHigherParticleIndex(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+	return a.second > b.second;
+}
+
+static int GetNumSpriteFrames(const BakedParticleEmitter& emitter)
+{
+	return emitter.m_isSpriteSheet ? emitter.m_spriteSheetLayout.x * emitter.m_spriteSheetLayout.y : 1;
+}
+
+static unsigned int PackRgba8(const Rgba8& color)
+{
+	return (unsigned int)color.r | ((unsigned int)color.g << 8) | ((unsigned int)color.b << 16) | ((unsigned int)color.a << 24);
+}
+
+static int GetSpriteSheetFrame(const BakedParticleEmitter& emitter, float normalizedAge)
+{
+	if (!emitter.m_isSpriteSheet)
+		return 0;
+
+	int numFrames = emitter.m_spriteSheetLayout.x * emitter.m_spriteSheetLayout.y;
+	return std::min(int(ClampZeroToOne(normalizedAge) * numFrames), numFrames - 1);
+}
+
+static void GetSpriteSheetUVs(const BakedParticleEmitter& emitter, int frame, Vec2& out_uvMins, Vec2& out_uvMaxs)
+{
+	if (!emitter.m_frameUVs.empty())
+	{
+		out_uvMins = emitter.m_frameUVs[frame].m_mins;
+		out_uvMaxs = emitter.m_frameUVs[frame].m_maxs;
+		return;
+	}
+
+	out_uvMins = Vec2(0.f, 0.f);
+	out_uvMaxs = Vec2(1.f, 1.f);
+	if (!emitter.m_isSpriteSheet)
+		return;
+
+	Vec2 cellSize = Vec2(1.f / emitter.m_spriteSheetLayout.x, 1.f / emitter.m_spriteSheetLayout.y);
+	int cellX = frame % emitter.m_spriteSheetLayout.x;
+	int cellY = (emitter.m_spriteSheetLayout.y - 1) - (frame / emitter.m_spriteSheetLayout.x);		//sprite sheets are laid out from the top left
+	out_uvMins = Vec2(cellX * cellSize.x, cellY * cellSize.y);
+	out_uvMaxs = out_uvMins + cellSize;
+}
+
+static bool IsLaterExpiry(const BatchedStaticParticle& a, const BatchedStaticParticle& b)
+{
+	return a.m_expirySeconds > b.m_expirySeconds;
+}
+
+static bool IsBakedCurveConstant(const BakedParticleCurve& curve)
+{
+	for (int i = 1; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		if (curve.m_curveOne[i] != curve.m_curveOne[0] || (curve.m_randomBetweenCurves && curve.m_curveTwo[i] != curve.m_curveTwo[0]))
+			return false;
+	}
+	return true;
+}
+
+static Vec3 GetInstanceSpaceVector(const Mat44& transform, const Vec3& worldVector)
+{
+	//instance bases are orthogonal but may be scaled, so each component is a projection divided by its basis length squared
+	Vec3 iBasis = transform.GetIBasis3D();
+	Vec3 jBasis = transform.GetJBasis3D();
+	Vec3 kBasis = transform.GetKBasis3D();
+	return Vec3(DotProduct3D(worldVector, iBasis) / std::max(iBasis.GetLengthSquared(), 0.000001f),
+		DotProduct3D(worldVector, jBasis) / std::max(jBasis.GetLengthSquared(), 0.000001f),
+		DotProduct3D(worldVector, kBasis) / std::max(kBasis.GetLengthSquared(), 0.000001f));
+}
+
+static void GetPerpendicularAxes(const Vec3& forward, Vec3& out_left, Vec3& out_up)
+{
+	Vec3 helper = fabsf(forward.z) < 0.99f ? Vec3(0.f, 0.f, 1.f) : Vec3(1.f, 0.f, 0.f);
+	out_left = CrossProduct3D(helper, forward).GetNormalized();
+	out_up = CrossProduct3D(forward, out_left);
+}
+
+void BakedParticleCurve::Bake(const AnimatedCurve<float>& curve, float modifier, float valueWithoutKeys)
+{
+	m_randomBetweenCurves = curve.IsToRandomBetweenCurves();
+	BakeKeysIntoSamples(curve.m_curveOneKeys, modifier, valueWithoutKeys, m_curveOne);
+	if (m_randomBetweenCurves)
+	{
+		BakeKeysIntoSamples(curve.m_curveTwoKeys, modifier, valueWithoutKeys, m_curveTwo);
+	}
+
+	m_isZero = true;
+	for (int i = 0; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		if (m_curveOne[i] != 0.f || (m_randomBetweenCurves && m_curveTwo[i] != 0.f))
+		{
+			m_isZero = false;
+			break;
+		}
+	}
+}
+
+float BakedParticleCurve::Evaluate(float normalizedAge, float curveBlend) const
+{
+	float fraction = 0.f;
+	int sampleIndex = GetSampleIndexForNormalizedAge(normalizedAge, fraction);
+	float value = Interpolate(m_curveOne[sampleIndex], m_curveOne[sampleIndex + 1], fraction);
+	if (m_randomBetweenCurves)
+	{
+		float valueTwo = Interpolate(m_curveTwo[sampleIndex], m_curveTwo[sampleIndex + 1], fraction);
+		value = Interpolate(value, valueTwo, curveBlend);
+	}
+	return value;
+}
+
+BatchedParticleEffect::BatchedParticleEffect(const std::vector<ParticleEmitterData>& emitterData, int maxInstances, ParticleWorld* world)
+	:m_world(world), m_lodPolicy(ParticleLODPolicy::GetDefault()), m_sorter(world ? world->GetJobSystem() : nullptr), m_instanceBuilder(world ? world->GetJobSystem() : nullptr)
+{
+	int maxParticlesPerInstance = 0;
+	for (int i = 0; i < int(emitterData.size()); i++)
+	{
+		BakeEmitter(emitterData[i]);
+		maxParticlesPerInstance += m_emitters.back().m_maxParticlesPerInstance;
+	}
+
+	std::vector<BlendMode> blendModes;
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		emitter.m_blendSlot = int(std::find(blendModes.begin(), blendModes.end(), emitter.m_blendMode) - blendModes.begin());
+		if (emitter.m_blendSlot == int(blendModes.size()))
+			blendModes.push_back(emitter.m_blendMode);
+	}
+	m_numBlendSlots = int(blendModes.size());
+
+	//the compact stream looks frames up by their index into one table for the whole effect
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		emitter.m_firstFrameUV = int(m_frameUVs.size());
+		int numFrames = emitter.m_isSpriteSheet ? emitter.m_spriteSheetLayout.x * emitter.m_spriteSheetLayout.y : 1;
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			Vec2 uvMins;
+			Vec2 uvMaxs;
+			GetSpriteSheetUVs(emitter, frame, uvMins, uvMaxs);
+			m_frameUVs.push_back(AABB2(uvMins, uvMaxs));
+		}
+	}
+
+	m_maxParticles = maxParticlesPerInstance * maxInstances;
+	m_particles.reserve(m_maxParticles);
+	m_particleSortRanks.reserve(m_maxParticles);
+	m_instances.reserve(maxInstances);
+	m_emitterStates.reserve(maxInstances * m_emitters.size());
+	m_instanceAttractorPositions.reserve(maxInstances * m_attractors.size());
+	m_vertsPerEmitter.resize(m_emitters.size());
+	m_quadParticlesPerEmitter.resize(m_emitters.size());
+	m_sortedDepthsPerEmitter.resize(m_emitters.size());
+	m_compactParticlesPerEmitter.resize(m_emitters.size());
+	BuildDrawOrder();
+	m_numRankedQuadsPerEmitter.resize(m_emitters.size(), 0);
+	if (m_world)
+		m_world->RegisterBatchedEffect(this);
+}
+
+BatchedParticleEffect::~BatchedParticleEffect()
+{
+	delete m_loopClip;
+	m_loopClip = nullptr;
+	delete m_loopClipBuffer;
+	m_loopClipBuffer = nullptr;
+	for (int i = 0; i < int(m_staticBatches.size()); i++)
+	{
+		delete m_staticBatches[i].m_gpuBuffer;
+	}
+	if (!m_world)
+		return;
+
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		if (m_instances[instanceIndex].m_proxyId != -1)
+			m_world->GetBoundsTree()->DestroyProxy(m_instances[instanceIndex].m_proxyId);
+	}
+	m_world->UnregisterBatchedEffect(this);
+}
+
+BatchedParticleEffect* BatchedParticleEffect::CreateFromEffectFile(const char* effectPath, int maxInstances, ParticleWorld* world)
+{
+	std::vector<ParticleEmitterData> emitterData = LoadEmitterData(effectPath, world);
+	if (emitterData.empty())
+		return nullptr;
+
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, maxInstances, world);
+	ParticleLODPolicy lodPolicy = ParticleLODPolicy::LoadFromEffectFile(effectPath);
+	effect->SetLODPolicy(lodPolicy);
+	effect->SetScreenCullSettings(ParticleScreenCullSettings::LoadFromEffectFile(effectPath));
+	effect->SetBudgetSettings(ParticleBudgetSettings::LoadFromEffectFile(effectPath));
+	if (!lodPolicy.m_impostorPath.empty())
+		effect->SetImpostor(ParticleImpostorDescriptor::LoadFromFile(lodPolicy.m_impostorPath.c_str()));
+	effect->SetLoopClip(ParticleLoopClip::LoadFromEffectFile(effectPath));
+	return effect;
+}
+
+std::vector<ParticleEmitterData> BatchedParticleEffect::LoadEmitterData(const char* effectPath, ParticleWorld* world)
+{
+	//the particles manager owns the xml parsing, so load through a throwaway system and retire it once its data is copied out.
+	//A missing or broken file is caught here first, so the engine loader only ever sees a document it can read
+	std::vector<ParticleEmitterData> emitterData;
+	XmlDocument effectDocument;
+	if (!world || !world->GetParticlesManager() || effectDocument.LoadFile(effectPath) != tinyxml2::XML_SUCCESS || !effectDocument.RootElement())
+		return emitterData;
+
+	ParticleSystem* loaderSystem = world->GetParticlesManager()->CreateParticleSystem(effectPath, Vec3::ZERO, false);
+	if (!loaderSystem)
+		return emitterData;
+
+	emitterData = loaderSystem->GetEmitterDataForAllEmitters();
+	std::vector<ParticleEmitterData> stoppedData = emitterData;
+	for (int i = 0; i < int(stoppedData.size()); i++)
+	{
+		stoppedData[i].m_particlesEmittedPerSecond = 0.f;
+		stoppedData[i].m_numBurstParticles = 0.f;
+	}
+	loaderSystem->UpdateEmitterData(stoppedData);
+	world->GetReclaimer()->Retire(loaderSystem);
+	return emitterData;
+}
+
+void BatchedParticleEffect::Update(float deltaSeconds)
+{
+	double startTime = GetCurrentTimeSeconds();
+	//attractors of world space emitters follow their instance
+	int numAttractors = int(m_attractors.size());
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()) && numAttractors > 0; instanceIndex++)
+	{
+		const BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive)
+			continue;
+
+		for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+		{
+			const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+			for (int i = emitter.m_firstAttractor; i < emitter.m_firstAttractor + emitter.m_numAttractors; i++)
+			{
+				Vec3 localPosition = emitter.m_offset + m_attractors[i].m_offsetFromEmitter;
+				m_instanceAttractorPositions[instanceIndex * numAttractors + i] = emitter.m_worldSpace ? instance.m_transform.TransformPosition3D(localPosition) : localPosition;
+			}
+		}
+	}
+
+	m_clockSeconds += double(deltaSeconds);
+	if (deltaSeconds > 0.f)
+	{
+		m_hasMovedSinceSort = true;
+		m_isRenderDataStale = true;
+	}
+	if (m_loopClip)
+	{
+		UpdateLoopClipInstances();
+		FreeRemovedInstances();
+		if (m_world)
+			m_world->AddParticleWorkSeconds(GetCurrentTimeSeconds() - startTime);
+		return;
+	}
+
+	m_impostorSeconds += deltaSeconds;
+	if (m_impostor.IsValid())
+		m_impostorSeconds = fmodf(m_impostorSeconds, m_impostor.m_loopSeconds);
+	UpdateInstanceLODs(deltaSeconds);
+	m_requestedSpawnsThisFrame = 0;
+	EmitParticles();
+	m_requestedSpawnsPeak = std::max(m_requestedSpawnsThisFrame, int(float(m_requestedSpawnsPeak) * 0.9f));
+	SimulateParticles();
+	ExpireStaticParticles();
+	UpdateInstanceBounds();
+	FreeRemovedInstances();
+	if (m_world)
+		m_world->AddParticleWorkSeconds(GetCurrentTimeSeconds() - startTime);
+}
+
+void BatchedParticleEffect::UpdateRenderData(const Camera& camera) const
+{
+	double startTime = GetCurrentTimeSeconds();
+	Vec3 cameraForward, cameraLeft, cameraUp;
+	camera.GetOrientation().GetAsVectors_XFwd_YLeft_ZUp(cameraForward, cameraLeft, cameraUp);
+
+	BatchedRenderDataKey key;
+	key.m_cameraPosition = camera.GetPosition();
+	key.m_cameraLeft = cameraLeft;
+	key.m_cameraUp = cameraUp;
+	key.m_useCompactStream = m_world && m_world->IsCompactInstanceStreamEnabled();
+	key.m_useScreenCull = m_screenCullSettings.m_isEnabled && m_world && m_world->HasViewFrustum();
+	key.m_isSortingEnabled = GetQualityKnobs().m_isSortingEnabled;
+	key.m_isGlobalOrderEnabled = key.m_isSortingEnabled && GetSortSettings().m_isGlobalOrderEnabled;
+
+	//a paused effect seen from the same place and with the same instances visible draws last frame's render data again
+	if (!IsRenderDataCurrent(key))
+	{
+		BuildRenderData(camera, cameraForward, key);
+		m_renderDataKey = key;
+		m_renderDataVersion++;
+		m_isRenderDataStale = false;
+		m_renderDataVisibility.resize(m_instances.size());
+		for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+		{
+			m_renderDataVisibility[instanceIndex] = GetRenderVisibility(m_instances[instanceIndex]);
+		}
+	}
+
+	if (m_world)
+		m_world->AddParticleWorkSeconds(GetCurrentTimeSeconds() - startTime);
+}
+
+unsigned char BatchedParticleEffect::GetRenderVisibility(const BatchedEffectInstance& instance)
+{
+	return (unsigned char)((instance.m_isAlive ? 1 : 0) | (instance.m_isVisible ? 2 : 0) | (instance.m_isImpostor ? 4 : 0));
+}
+
+bool BatchedParticleEffect::IsRenderDataCurrent(const BatchedRenderDataKey& key) const
+{
+	//billboards follow the camera axes, while the culls and the sort also follow its position.
+	//Both are measured against where the render data was built, so a slow drift still rebuilds once it adds up
+	if (m_isRenderDataStale || m_renderDataVisibility.size() != m_instances.size())
+		return false;
+	float tolerance = GetSortSettings().m_cameraTolerance;
+	if ((key.m_cameraPosition - m_renderDataKey.m_cameraPosition).GetLengthSquared() > tolerance * tolerance)
+		return false;
+	if (DotProduct3D(key.m_cameraLeft, m_renderDataKey.m_cameraLeft) < 1.f - tolerance || DotProduct3D(key.m_cameraUp, m_renderDataKey.m_cameraUp) < 1.f - tolerance)
+		return false;
+	if (key.m_useCompactStream != m_renderDataKey.m_useCompactStream || key.m_useScreenCull != m_renderDataKey.m_useScreenCull
+		|| key.m_isSortingEnabled != m_renderDataKey.m_isSortingEnabled || key.m_isGlobalOrderEnabled != m_renderDataKey.m_isGlobalOrderEnabled)
+		return false;
+
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		if (m_renderDataVisibility[instanceIndex] != GetRenderVisibility(m_instances[instanceIndex]))
+			return false;
+	}
+	return true;
+}
+
+void BatchedParticleEffect::BuildRenderData(const Camera& camera, const Vec3& cameraForward, const BatchedRenderDataKey& key) const
+{
+	const Vec3& cameraLeft = key.m_cameraLeft;
+	const Vec3& cameraUp = key.m_cameraUp;
+	bool useCompactStream = key.m_useCompactStream;
+	bool useScreenCull = key.m_useScreenCull;
+	//clearing keeps the capacity, so the arrays grow to what is actually alive once and are reused every rebuild after that
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		m_vertsPerEmitter[emitterIndex].clear();
+		m_quadParticlesPerEmitter[emitterIndex].clear();
+		m_compactParticlesPerEmitter[emitterIndex].clear();
+	}
+
+	m_screenCullStats = ParticleScreenCullStats();
+	if (useScreenCull)
+		BuildScreenCullSlots();
+
+	//impostors and clips draw whole instances from baked data, so the cull drops whole instances too
+	m_impostorVerts.clear();
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()) && m_numImpostorInstances > 0; instanceIndex++)
+	{
+		const BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive || !instance.m_isImpostor || !instance.m_isVisible)
+			continue;
+		if (useScreenCull && IsSubPixel(instance.m_transform.TransformPosition3D(m_impostor.m_centerOffset), m_impostor.m_worldSize * 0.5f))
+		{
+			m_screenCullStats.m_numSubPixelCulled++;
+			continue;
+		}
+		AddImpostorVerts(instanceIndex, camera.GetPosition(), cameraLeft, cameraUp);
+	}
+
+	//unsorted clip emitters are drawn straight from the decoded clip on the gpu, only sorted ones still need their quads here
+	m_visibleClipInstances.clear();
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()) && m_loopClip; instanceIndex++)
+	{
+		const BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive || !instance.m_isVisible)
+			continue;
+		if (useScreenCull && IsInstanceSubPixel(instance))
+		{
+			m_screenCullStats.m_numSubPixelCulled++;
+			continue;
+		}
+		m_visibleClipInstances.push_back(instanceIndex);
+		AddLoopClipVerts(instanceIndex, cameraLeft, cameraUp);
+	}
+	if (m_loopClip)
+	{
+		BuildLoopClipSegments();
+		m_areLoopClipSegmentsStale = true;
+	}
+
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); particleIndex++)
+	{
+		const BatchedParticle& particle = m_particles[particleIndex];
+		const BatchedEffectInstance& instance = m_instances[particle.m_instanceIndex];
+		if (!instance.m_isVisible || instance.m_isImpostor)
+			continue;
+		if (useScreenCull && !IsParticleKeptByScreenCull(particleIndex))
+			continue;
+
+		//unsorted emitters leave building their quads to the vertex shader
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		if (useCompactStream && !emitter.m_sortParticles)
+		{
+			m_compactParticlesPerEmitter[particle.m_emitterIndex].push_back(particleIndex);
+			continue;
+		}
+
+		float normalizedAge = particle.m_age * particle.m_inverseLifetime;
+		Vec3 position = GetParticleRenderPosition(particle);
+
+		Vec3 right = -cameraLeft;
+		Vec3 up = cameraUp;
+		if (emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD)
+		{
+			right = Vec3(1.f, 0.f, 0.f);
+			up = Vec3(0.f, 1.f, 0.f);
+		}
+		if (particle.m_rotationDegrees != 0.f)
+		{
+			float rotationCos = CosDegrees(particle.m_rotationDegrees);
+			float rotationSin = SinDegrees(particle.m_rotationDegrees);
+			Vec3 rotatedRight = right * rotationCos + up * rotationSin;
+			up = up * rotationCos - right * rotationSin;
+			right = rotatedRight;
+		}
+
+		float halfSizeX = particle.m_size * emitter.m_sizeX.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f;
+		float halfSizeY = particle.m_size * emitter.m_sizeY.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f;
+		Vec3 halfRight = right * halfSizeX;
+		Vec3 halfUp = up * halfSizeY;
+
+		float fraction = 0.f;
+		int sampleIndex = GetSampleIndexForNormalizedAge(normalizedAge, fraction);
+		Rgba8 color = fraction < 0.5f ? emitter.m_color[sampleIndex] : emitter.m_color[sampleIndex + 1];
+
+		Vec2 uvMins;
+		Vec2 uvMaxs;
+		GetSpriteSheetUVs(emitter, GetSpriteSheetFrame(emitter, normalizedAge), uvMins, uvMaxs);
+
+		Vec3 bottomLeft = position - halfRight - halfUp;
+		Vec3 bottomRight = position + halfRight - halfUp;
+		Vec3 topRight = position + halfRight + halfUp;
+		Vec3 topLeft = position - halfRight + halfUp;
+		std::vector<Vertex_PCU>& verts = m_vertsPerEmitter[particle.m_emitterIndex];
+		verts.emplace_back(bottomLeft, color, uvMins);
+		verts.emplace_back(bottomRight, color, Vec2(uvMaxs.x, uvMins.y));
+		verts.emplace_back(topRight, color, uvMaxs);
+		verts.emplace_back(bottomLeft, color, uvMins);
+		verts.emplace_back(topRight, color, uvMaxs);
+		verts.emplace_back(topLeft, color, Vec2(uvMins.x, uvMaxs.y));
+		if (emitter.m_sortParticles)
+			m_quadParticlesPerEmitter[particle.m_emitterIndex].push_back(particleIndex);
+	}
+
+	//a still effect seen from where it was last sorted is drawn in last frame's order without looking at depths
+	const ParticleSortSettings& sortSettings = GetSortSettings();
+	bool isSortingEnabled = key.m_isSortingEnabled;
+	float tolerance = sortSettings.m_cameraTolerance;
+	bool canKeepLastOrder = sortSettings.m_mode == ParticleSortMode::COHERENT && !m_hasMovedSinceSort
+		&& (camera.GetPosition() - m_sortCameraPosition).GetLengthSquared() <= tolerance * tolerance && DotProduct3D(cameraForward, m_sortCameraForward) >= 1.f - tolerance;
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()) && isSortingEnabled; emitterIndex++)
+	{
+		if (m_emitters[emitterIndex].m_sortParticles)
+			SortQuadsBackToFront(emitterIndex, camera.GetPosition(), cameraForward, canKeepLastOrder);
+	}
+	if (isSortingEnabled)
+	{
+		m_hasMovedSinceSort = false;
+		m_sortCameraPosition = camera.GetPosition();
+		m_sortCameraForward = cameraForward;
+	}
+	for (int streamIndex = 0; streamIndex < int(m_mergedStreams.size()) && key.m_isGlobalOrderEnabled; streamIndex++)
+	{
+		MergeSortedStream(m_mergedStreams[streamIndex]);
+	}
+	if (useCompactStream)
+		BuildCompactInstanceStream();
+}
+
+void BatchedParticleEffect::GetDrawItems(std::vector<BatchedDrawItem>& out_items) const
+{
+	//emitters in draw order, each with what it draws itself ahead of the particles it is still simulating
+	for (int drawIndex = 0; drawIndex < int(m_emitterDrawOrder.size()); drawIndex++)
+	{
+		int emitterIndex = m_emitterDrawOrder[drawIndex];
+		const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		BatchedDrawItem item;
+		item.m_emitterIndex = emitterIndex;
+		bool hasClipSegments = m_loopClip && m_loopClipSegmentStarts[emitterIndex + 1] > m_loopClipSegmentStarts[emitterIndex];
+		bool hasStaticParticles = emitter.m_isStatic && m_numStaticParticles > 0;
+		bool isMerged = m_renderDataKey.m_isGlobalOrderEnabled && emitter.m_mergedStream >= 0;
+		bool drawsMergedStream = isMerged && m_mergedStreams[emitter.m_mergedStream].m_emitterIndices[0] == emitterIndex;
+		if (hasClipSegments || hasStaticParticles || drawsMergedStream)
+		{
+			item.m_kind = BatchedDrawKind::EMITTER_PASSES;
+			out_items.push_back(item);
+		}
+		if (isMerged)
+			continue;
+
+		if (m_renderDataKey.m_useCompactStream && !m_compactParticlesPerEmitter[emitterIndex].empty())
+		{
+			item.m_kind = BatchedDrawKind::COMPACT;
+			out_items.push_back(item);
+		}
+		if (!m_vertsPerEmitter[emitterIndex].empty())
+		{
+			item.m_kind = BatchedDrawKind::VERTS;
+			out_items.push_back(item);
+		}
+	}
+	if (!m_impostorVerts.empty())
+	{
+		BatchedDrawItem item;
+		item.m_kind = BatchedDrawKind::IMPOSTORS;
+		out_items.push_back(item);
+	}
+}
+
+Texture* BatchedParticleEffect::GetEmitterTexture(int emitterIndex) const
+{
+	//interned on first use, so effects baked by tools never load their textures
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	if (!emitter.m_texture.IsValid() && emitter.m_textureHash != 0)
+		emitter.m_texture = g_theRenderResources->InternTexture(emitter.m_texturePath.c_str());
+	return g_theRenderResources->GetTexture(emitter.m_texture);
+}
+
+void BatchedParticleEffect::DrawEmitterPasses(RenderBackend& backend, int emitterIndex, const Vec3& cameraLeft, const Vec3& cameraUp) const
+{
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	int numClipSegments = m_loopClip ? m_loopClipSegmentStarts[emitterIndex + 1] - m_loopClipSegmentStarts[emitterIndex] : 0;
+	if (numClipSegments > 0)
+	{
+		//the decoded clip goes up with the first draw, after that only rebuilt render data sends its segments
+		if (m_areLoopClipSegmentsStale)
+		{
+			int maxSegments = std::max(int(m_loopClipSegments.size()), int(m_instances.capacity() * m_emitters.size()));
+			if (m_loopClipBuffer && m_loopClipBuffer->GetMaxSegments() < int(m_loopClipSegments.size()))
+			{
+				delete m_loopClipBuffer;
+				m_loopClipBuffer = nullptr;
+			}
+			if (!m_loopClipBuffer)
+				m_loopClipBuffer = new ParticleLoopClipBuffer(m_loopClipParticles, maxSegments);
+			m_loopClipBuffer->SetSegments(m_loopClipSegments);
+			m_areLoopClipSegmentsStale = false;
+		}
+		backend.SetBlendMode(emitter.m_blendMode);
+		backend.BindTexture(GetEmitterTexture(emitterIndex));
+		m_loopClipBuffer->Draw(backend, m_loopClipSegmentStarts[emitterIndex], numClipSegments, m_loopClipQuadsPerSegment[emitterIndex], cameraLeft, cameraUp, emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD);
+		backend.BindShader(nullptr);
+	}
+
+	//resident static particles are drawn in their emitter's place in the order, ahead of the ones it is still simulating
+	if (emitter.m_isStatic && m_numStaticParticles > 0)
+		RenderStaticBatches(backend, emitterIndex, cameraLeft, cameraUp, m_renderDataKey.m_useScreenCull);
+
+	//the merged stream is drawn where its first emitter would be
+	if (!m_renderDataKey.m_isGlobalOrderEnabled || emitter.m_mergedStream < 0)
+		return;
+	const BatchedMergedStream& stream = m_mergedStreams[emitter.m_mergedStream];
+	for (int runIndex = 0; runIndex < int(stream.m_runs.size()) && stream.m_emitterIndices[0] == emitterIndex; runIndex++)
+	{
+		const BatchedDrawRun& run = stream.m_runs[runIndex];
+		const BakedParticleEmitter& runEmitter = m_emitters[run.m_emitterIndex];
+		backend.SetBlendMode(runEmitter.m_blendMode);
+		backend.BindTexture(GetEmitterTexture(run.m_emitterIndex));
+		backend.DrawVertexArray(run.m_numVerts, &stream.m_verts[run.m_firstVertex]);
+	}
+}
+
+void BatchedParticleEffect::DrawImpostors(RenderBackend& backend) const
+{
+	backend.SetBlendMode(m_impostor.m_blendMode);
+	backend.BindTexture(g_theRenderResources->GetTexture(m_impostorTexture));
+	backend.DrawVertexArray(int(m_impostorVerts.size()), m_impostorVerts.data());
+}
+
+void BatchedParticleEffect::SortQuadsBackToFront(int emitterIndex, const Vec3& cameraPosition, const Vec3& cameraForward, bool canKeepLastOrder) const
+{
+	std::vector<Vertex_PCU>& verts = m_vertsPerEmitter[emitterIndex];
+	const std::vector<int>& quadParticles = m_quadParticlesPerEmitter[emitterIndex];
+	std::vector<float>& sortedDepths = m_sortedDepthsPerEmitter[emitterIndex];
+	int& numRankedQuads = m_numRankedQuadsPerEmitter[emitterIndex];
+	int numQuads = int(verts.size()) / 6;
+	int numClipQuads = numQuads - int(quadParticles.size());
+	if (numQuads == 0)
+	{
+		sortedDepths.clear();
+		numRankedQuads = 0;
+		return;
+	}
+
+	//quads of particles drawn last frame go back to last frame's order, the rest are new to it
+	bool isCoherent = GetSortSettings().m_mode == ParticleSortMode::COHERENT;
+	m_quadAtRank.assign(isCoherent ? numRankedQuads : 0, -1);
+	m_unrankedQuads.clear();
+	for (int quadIndex = 0; quadIndex < numQuads; quadIndex++)
+	{
+		int particleIndex = quadIndex < numClipQuads ? -1 : quadParticles[quadIndex - numClipQuads];
+		unsigned int rank = particleIndex >= 0 ? m_particleSortRanks[particleIndex] : UINT_MAX;
+		if (rank < (unsigned int)m_quadAtRank.size() && m_quadAtRank[rank] < 0)
+		{
+			m_quadAtRank[rank] = quadIndex;
+		}
+		else
+		{
+			m_unrankedQuads.push_back(quadIndex);
+		}
+	}
+
+	m_sortPairs.clear();
+	if (canKeepLastOrder && m_unrankedQuads.empty())
+	{
+		m_rankDepths.clear();
+		for (int rank = 0; rank < int(m_quadAtRank.size()); rank++)
+		{
+			if (m_quadAtRank[rank] >= 0)
+			{
+				m_sortPairs.push_back(ParticleSortPair{ 0, (unsigned int)m_quadAtRank[rank] });
+				m_rankDepths.push_back(sortedDepths[rank]);
+			}
+		}
+		sortedDepths.swap(m_rankDepths);
+	}
+	else
+	{
+		//view depth of each quad's center, taken from the verts so clip and simulated particles sort the same way
+		m_sortDepths.resize(numQuads);
+		for (int quadIndex = 0; quadIndex < numQuads; quadIndex++)
+		{
+			Vec3 center = (verts[quadIndex * 6].m_position + verts[quadIndex * 6 + 2].m_position) * 0.5f;
+			m_sortDepths[quadIndex] = DotProduct3D(center - cameraPosition, cameraForward);
+		}
+		float minDepth = *std::min_element(m_sortDepths.begin(), m_sortDepths.end());
+		float maxDepth = *std::max_element(m_sortDepths.begin(), m_sortDepths.end());
+
+		//16 bit keys over the depth range of this frame, inverted so an ascending sort puts the farthest quad first
+		float keyScale = maxDepth > minDepth ? 65535.f / (maxDepth - minDepth) : 0.f;
+		for (int rank = 0; rank < int(m_quadAtRank.size()); rank++)
+		{
+			int quadIndex = m_quadAtRank[rank];
+			if (quadIndex >= 0)
+				m_sortPairs.push_back(ParticleSortPair{ 65535u - (unsigned int)((m_sortDepths[quadIndex] - minDepth) * keyScale), (unsigned int)quadIndex });
+		}
+		m_unrankedSortPairs.resize(m_unrankedQuads.size());
+		for (int i = 0; i < int(m_unrankedQuads.size()); i++)
+		{
+			int quadIndex = m_unrankedQuads[i];
+			m_unrankedSortPairs[i] = ParticleSortPair{ 65535u - (unsigned int)((m_sortDepths[quadIndex] - minDepth) * keyScale), (unsigned int)quadIndex };
+		}
+
+		//last frame's order only needs repairing unless the view jumped, new quads are sorted on their own and merged in
+		int maxRepairMoves = int(GetSortSettings().m_maxRepairMovesPerQuad * float(numQuads));
+		if (!ParticleRadixSorter::RepairNearlySorted(m_sortPairs, maxRepairMoves))
+			m_sorter.Sort(m_sortPairs, 16);
+		m_sorter.Sort(m_unrankedSortPairs, 16);
+		ParticleRadixSorter::MergeSortedRuns(m_sortPairs, m_unrankedSortPairs, m_mergedSortPairs);
+		m_sortPairs.swap(m_mergedSortPairs);
+		sortedDepths.resize(m_sortPairs.size());
+		for (int rank = 0; rank < int(m_sortPairs.size()); rank++)
+		{
+			sortedDepths[rank] = m_sortDepths[m_sortPairs[rank].m_index];
+		}
+	}
+
+	m_sortedVerts.resize(size_t(m_sortPairs.size()) * 6);
+	for (int rank = 0; rank < int(m_sortPairs.size()); rank++)
+	{
+		int quadIndex = int(m_sortPairs[rank].m_index);
+		memcpy(&m_sortedVerts[rank * 6], &verts[quadIndex * 6], sizeof(Vertex_PCU) * 6);
+		if (quadIndex >= numClipQuads)
+			m_particleSortRanks[quadParticles[quadIndex - numClipQuads]] = (unsigned int)rank;
+	}
+	verts.swap(m_sortedVerts);
+	numRankedQuads = numQuads;
+}
+
+void BatchedParticleEffect::BuildDrawOrder()
+{
+	std::vector<std::pair<int, int>> drawOrder;
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		drawOrder.emplace_back(m_emitters[emitterIndex].m_drawOrder, emitterIndex);
+	}
+	std::sort(drawOrder.begin(), drawOrder.end());
+
+	//additive blending does not depend on order, so only the other blend modes get a merged stream
+	m_emitterDrawOrder.clear();
+	m_mergedStreams.clear();
+	for (int drawIndex = 0; drawIndex < int(drawOrder.size()); drawIndex++)
+	{
+		int emitterIndex = drawOrder[drawIndex].second;
+		m_emitterDrawOrder.push_back(emitterIndex);
+		BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		if (!emitter.m_sortParticles || emitter.m_blendMode == BlendMode::ADDITIVE)
+			continue;
+
+		for (int streamIndex = 0; streamIndex < int(m_mergedStreams.size()) && emitter.m_mergedStream < 0; streamIndex++)
+		{
+			if (m_emitters[m_mergedStreams[streamIndex].m_emitterIndices[0]].m_blendMode == emitter.m_blendMode)
+				emitter.m_mergedStream = streamIndex;
+		}
+		if (emitter.m_mergedStream < 0)
+		{
+			emitter.m_mergedStream = int(m_mergedStreams.size());
+			m_mergedStreams.emplace_back();
+		}
+
+		BatchedMergedStream& stream = m_mergedStreams[emitter.m_mergedStream];
+		int textureSlot = int(stream.m_emitterIndices.size());
+		for (int i = 0; i < int(stream.m_emitterIndices.size()); i++)
+		{
+			if (m_emitters[stream.m_emitterIndices[i]].m_textureHash == emitter.m_textureHash)
+			{
+				textureSlot = stream.m_textureSlots[i];
+				break;
+			}
+		}
+		stream.m_emitterIndices.push_back(emitterIndex);
+		stream.m_textureSlots.push_back(textureSlot);
+	}
+
+	//a stream of one emitter is just that emitter
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		if (emitter.m_mergedStream >= 0 && m_mergedStreams[emitter.m_mergedStream].m_emitterIndices.size() < 2)
+			emitter.m_mergedStream = -1;
+	}
+}
+
+void BatchedParticleEffect::MergeSortedStream(BatchedMergedStream& stream) const
+{
+	//k way merge of streams that are already back to front, one pass over the quads with a scan over the few stream heads
+	int numStreams = int(stream.m_emitterIndices.size());
+	stream.m_heads.assign(numStreams, 0);
+	stream.m_verts.clear();
+	stream.m_runs.clear();
+	int runTextureSlot = -1;
+	for (;;)
+	{
+		int nextStream = -1;
+		float nextDepth = 0.f;
+		for (int i = 0; i < numStreams; i++)
+		{
+			const std::vector<float>& depths = m_sortedDepthsPerEmitter[stream.m_emitterIndices[i]];
+			int head = stream.m_heads[i];
+			if (head < int(depths.size()) && (nextStream < 0 || depths[head] > nextDepth))
+			{
+				nextStream = i;
+				nextDepth = depths[head];
+			}
+		}
+		if (nextStream < 0)
+			break;
+
+		int emitterIndex = stream.m_emitterIndices[nextStream];
+		if (stream.m_textureSlots[nextStream] != runTextureSlot)
+		{
+			BatchedDrawRun run;
+			run.m_firstVertex = int(stream.m_verts.size());
+			run.m_emitterIndex = emitterIndex;
+			stream.m_runs.push_back(run);
+			runTextureSlot = stream.m_textureSlots[nextStream];
+		}
+		const Vertex_PCU* quadVerts = &m_vertsPerEmitter[emitterIndex][stream.m_heads[nextStream] * 6];
+		stream.m_verts.insert(stream.m_verts.end(), quadVerts, quadVerts + 6);
+		stream.m_runs.back().m_numVerts += 6;
+		stream.m_heads[nextStream]++;
+	}
+}
+
+void BatchedParticleEffect::BuildCompactInstanceStream() const
+{
+	m_compactParticleIndices.clear();
+	m_compactEmitterStarts.resize(m_emitters.size() + 1);
+	for (int drawIndex = 0; drawIndex < int(m_emitterDrawOrder.size()); drawIndex++)
+	{
+		int emitterIndex = m_emitterDrawOrder[drawIndex];
+		const std::vector<int>& particles = m_compactParticlesPerEmitter[emitterIndex];
+		m_compactEmitterStarts[emitterIndex] = int(m_compactParticleIndices.size());
+		m_compactParticleIndices.insert(m_compactParticleIndices.end(), particles.begin(), particles.end());
+	}
+	m_compactEmitterStarts.back() = int(m_compactParticleIndices.size());
+	if (m_compactParticleIndices.empty())
+		return;
+
+	//positions are stored relative to their instance, so half floats only have to cover the size of one effect
+	m_instanceOrigins.resize(m_instances.size());
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		m_instanceOrigins[instanceIndex] = m_instances[instanceIndex].m_transform.GetTranslation3D();
+	}
+}
+
+void BatchedParticleEffect::WriteEmitterInstances(int emitterIndex, CompactParticleInstance* out_instances, int originBase, int frameBase) const
+{
+	m_compactOriginBase = originBase;
+	m_compactFrameBase = frameBase;
+	m_instanceBuilder.BuildRange(*this, m_compactEmitterStarts[emitterIndex], int(m_compactParticlesPerEmitter[emitterIndex].size()), out_instances);
+}
+
+void BatchedParticleEffect::WriteInstances(int firstInstance, int numInstances, CompactParticleInstance* out_instances) const
+{
+	//runs on workers, so it only reads the effect
+	for (int i = 0; i < numInstances; i++)
+	{
+		const BatchedParticle& particle = m_particles[m_compactParticleIndices[firstInstance + i]];
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		float normalizedAge = particle.m_age * particle.m_inverseLifetime;
+		Vec3 position = GetParticleRenderPosition(particle) - m_instanceOrigins[particle.m_instanceIndex];
+		float fraction = 0.f;
+		int sampleIndex = GetSampleIndexForNormalizedAge(normalizedAge, fraction);
+
+		CompactParticleInstance& instance = out_instances[i];
+		instance.m_position[0] = FloatToHalf(position.x);
+		instance.m_position[1] = FloatToHalf(position.y);
+		instance.m_position[2] = FloatToHalf(position.z);
+		instance.m_halfSize[0] = FloatToHalf(particle.m_size * emitter.m_sizeX.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f);
+		instance.m_halfSize[1] = FloatToHalf(particle.m_size * emitter.m_sizeY.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f);
+		instance.m_rotationDegrees = FloatToHalf(particle.m_rotationDegrees);
+		instance.m_color = fraction < 0.5f ? emitter.m_color[sampleIndex] : emitter.m_color[sampleIndex + 1];
+		instance.m_spriteFrame = (unsigned short)(m_compactFrameBase + emitter.m_firstFrameUV + GetSpriteSheetFrame(emitter, normalizedAge));
+		instance.m_originIndex = (unsigned short)(m_compactOriginBase + particle.m_instanceIndex);
+	}
+}
+
+const ParticleSortSettings& BatchedParticleEffect::GetSortSettings() const
+{
+	static const ParticleSortSettings defaultSettings;
+	return m_world ? m_world->GetSortSettings() : defaultSettings;
+}
+
+void BatchedParticleEffect::UpdateLoopClipInstances()
+{
+	//the clip never changes, so its bounds stand in for the particles every frame
+	AABB3 clipBounds = m_loopClip->GetBounds();
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive)
+			continue;
+
+		instance.m_localSpaceBounds = clipBounds;
+		instance.m_hasLocalSpaceBounds = true;
+		instance.m_hasWorldSpaceBounds = false;
+	}
+	UpdateInstanceBounds();
+}
+
+void BatchedParticleEffect::DecodeLoopClip()
+{
+	//decoded into the shader's layout up front, so playback never touches a sample again
+	int numEmitters = int(m_emitters.size());
+	int numFrames = m_loopClip->GetNumFrames();
+	m_loopClipParticles.clear();
+	m_loopClipParticles.reserve(m_loopClip->GetNumSamples());
+	m_loopClipRanges.assign(numFrames * numEmitters, IntVec2(0, 0));
+	m_loopClipQuadsPerSegment.assign(numEmitters, 0);
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		int numSamples = 0;
+		const ParticleClipSample* samples = m_loopClip->GetFrameSamples(frame, numSamples);
+		for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+		{
+			const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+			IntVec2& range = m_loopClipRanges[frame * numEmitters + emitterIndex];
+			range.x = int(m_loopClipParticles.size());
+			for (int i = 0; i < numSamples; i++)
+			{
+				const ParticleClipSample& sample = samples[i];
+				if (sample.m_emitterIndex != emitterIndex)
+					continue;
+
+				Vec3 position = m_loopClip->DecodePosition(sample, 0.f);
+				Vec3 frameDelta = m_loopClip->DecodePosition(sample, 1.f) - position;
+				Vec2 uvMins;
+				Vec2 uvMaxs;
+				GetSpriteSheetUVs(emitter, sample.m_spriteFrame, uvMins, uvMaxs);
+
+				LoopClipParticleInstance particle;
+				particle.m_position[0] = position.x;
+				particle.m_position[1] = position.y;
+				particle.m_position[2] = position.z;
+				particle.m_halfWidth = m_loopClip->DecodeHalfSize(sample.m_halfWidth);
+				particle.m_halfHeight = m_loopClip->DecodeHalfSize(sample.m_halfHeight);
+				particle.m_rotationDegrees = m_loopClip->DecodeRotationDegrees(sample.m_rotation);
+				particle.m_color = PackRgba8(sample.m_color);
+				particle.m_uvMinsMaxs[0] = uvMins.x;
+				particle.m_uvMinsMaxs[1] = uvMins.y;
+				particle.m_uvMinsMaxs[2] = uvMaxs.x;
+				particle.m_uvMinsMaxs[3] = uvMaxs.y;
+				particle.m_frameDelta[0] = frameDelta.x;
+				particle.m_frameDelta[1] = frameDelta.y;
+				particle.m_frameDelta[2] = frameDelta.z;
+				m_loopClipParticles.push_back(particle);
+			}
+			range.y = int(m_loopClipParticles.size()) - range.x;
+			m_loopClipQuadsPerSegment[emitterIndex] = std::max(m_loopClipQuadsPerSegment[emitterIndex], range.y);
+		}
+	}
+}
+
+int BatchedParticleEffect::GetLoopClipFrame(const BatchedEffectInstance& instance, float& out_frameFraction) const
+{
+	float clipSeconds = fmodf(float(m_clockSeconds) + instance.m_loopPhaseSeconds, m_loopClip->GetPeriodSeconds());
+	float framePosition = clipSeconds / m_loopClip->GetFrameSeconds();
+	int frame = std::min(int(framePosition), m_loopClip->GetNumFrames() - 1);
+	out_frameFraction = ClampZeroToOne(framePosition - float(frame));
+	return frame;
+}
+
+void BatchedParticleEffect::BuildLoopClipSegments() const
+{
+	int numEmitters = int(m_emitters.size());
+	m_loopClipSegments.clear();
+	m_loopClipSegmentStarts.assign(numEmitters + 1, 0);
+	for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+	{
+		m_loopClipSegmentStarts[emitterIndex] = int(m_loopClipSegments.size());
+		if (m_emitters[emitterIndex].m_sortParticles)
+			continue;
+
+		for (int i = 0; i < int(m_visibleClipInstances.size()); i++)
+		{
+			const BatchedEffectInstance& instance = m_instances[m_visibleClipInstances[i]];
+			float frameFraction = 0.f;
+			int frame = GetLoopClipFrame(instance, frameFraction);
+			const IntVec2& range = m_loopClipRanges[frame * numEmitters + emitterIndex];
+			if (range.y == 0)
+				continue;
+
+			Vec3 iBasis = instance.m_transform.GetIBasis3D();
+			Vec3 jBasis = instance.m_transform.GetJBasis3D();
+			Vec3 kBasis = instance.m_transform.GetKBasis3D();
+			Vec3 translation = instance.m_transform.GetTranslation3D();
+			LoopClipSegment segment;
+			segment.m_iBasis[0] = iBasis.x;
+			segment.m_iBasis[1] = iBasis.y;
+			segment.m_iBasis[2] = iBasis.z;
+			segment.m_iBasis[3] = 0.f;
+			segment.m_jBasis[0] = jBasis.x;
+			segment.m_jBasis[1] = jBasis.y;
+			segment.m_jBasis[2] = jBasis.z;
+			segment.m_jBasis[3] = 0.f;
+			segment.m_kBasis[0] = kBasis.x;
+			segment.m_kBasis[1] = kBasis.y;
+			segment.m_kBasis[2] = kBasis.z;
+			segment.m_kBasis[3] = 0.f;
+			segment.m_translation[0] = translation.x;
+			segment.m_translation[1] = translation.y;
+			segment.m_translation[2] = translation.z;
+			segment.m_translation[3] = 1.f;
+			segment.m_firstParticle = (unsigned int)range.x;
+			segment.m_numParticles = (unsigned int)range.y;
+			segment.m_frameFraction = frameFraction;
+			m_loopClipSegments.push_back(segment);
+		}
+	}
+	m_loopClipSegmentStarts[numEmitters] = int(m_loopClipSegments.size());
+}
+
+void BatchedParticleEffect::AddLoopClipVerts(int instanceIndex, const Vec3& cameraLeft, const Vec3& cameraUp) const
+{
+	const BatchedEffectInstance& instance = m_instances[instanceIndex];
+	float frameFraction = 0.f;
+	int frame = GetLoopClipFrame(instance, frameFraction);
+
+	int numSamples = 0;
+	const ParticleClipSample* samples = m_loopClip->GetFrameSamples(frame, numSamples);
+	for (int i = 0; i < numSamples; i++)
+	{
+		const ParticleClipSample& sample = samples[i];
+		const BakedParticleEmitter& emitter = m_emitters[sample.m_emitterIndex];
+		if (!emitter.m_sortParticles)
+			continue;
+
+		Vec3 position = instance.m_transform.TransformPosition3D(m_loopClip->DecodePosition(sample, frameFraction));
+
+		Vec3 right = -cameraLeft;
+		Vec3 up = cameraUp;
+		if (emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD)
+		{
+			right = Vec3(1.f, 0.f, 0.f);
+			up = Vec3(0.f, 1.f, 0.f);
+		}
+		if (sample.m_rotation != 0)
+		{
+			float rotationDegrees = m_loopClip->DecodeRotationDegrees(sample.m_rotation);
+			float rotationCos = CosDegrees(rotationDegrees);
+			float rotationSin = SinDegrees(rotationDegrees);
+			Vec3 rotatedRight = right * rotationCos + up * rotationSin;
+			up = up * rotationCos - right * rotationSin;
+			right = rotatedRight;
+		}
+
+		Vec3 halfRight = right * m_loopClip->DecodeHalfSize(sample.m_halfWidth);
+		Vec3 halfUp = up * m_loopClip->DecodeHalfSize(sample.m_halfHeight);
+		Vec2 uvMins;
+		Vec2 uvMaxs;
+		GetSpriteSheetUVs(emitter, sample.m_spriteFrame, uvMins, uvMaxs);
+
+		Vec3 bottomLeft = position - halfRight - halfUp;
+		Vec3 bottomRight = position + halfRight - halfUp;
+		Vec3 topRight = position + halfRight + halfUp;
+		Vec3 topLeft = position - halfRight + halfUp;
+		std::vector<Vertex_PCU>& verts = m_vertsPerEmitter[sample.m_emitterIndex];
+		verts.emplace_back(bottomLeft, sample.m_color, uvMins);
+		verts.emplace_back(bottomRight, sample.m_color, Vec2(uvMaxs.x, uvMins.y));
+		verts.emplace_back(topRight, sample.m_color, uvMaxs);
+		verts.emplace_back(bottomLeft, sample.m_color, uvMins);
+		verts.emplace_back(topRight, sample.m_color, uvMaxs);
+		verts.emplace_back(topLeft, sample.m_color, Vec2(uvMins.x, uvMaxs.y));
+	}
+}
+
+void BatchedParticleEffect::AddImpostorVerts(int instanceIndex, const Vec3& cameraPosition, const Vec3& cameraLeft, const Vec3& cameraUp) const
+{
+	const BatchedEffectInstance& instance = m_instances[instanceIndex];
+	Vec3 center = instance.m_transform.TransformPosition3D(m_impostor.m_centerOffset);
+
+	//the row baked closest to the direction the instance is seen from, measured around its own z axis
+	Vec3 toCamera = cameraPosition - center;
+	float viewDegrees = Atan2Degrees(DotProduct3D(toCamera, instance.m_transform.GetJBasis3D()), DotProduct3D(toCamera, instance.m_transform.GetIBasis3D()));
+	int view = int(floorf(viewDegrees * float(m_impostor.m_numViews) / 360.f + 0.5f)) % m_impostor.m_numViews;
+	if (view < 0)
+		view += m_impostor.m_numViews;
+
+	//instances are spread over the loop so neighbouring impostors do not animate in lockstep
+	float loopFraction = fmodf(m_impostorSeconds / m_impostor.m_loopSeconds + float(instanceIndex) * 0.618034f, 1.f);
+	int frame = std::min(int(loopFraction * float(m_impostor.m_numFrames)), m_impostor.m_numFrames - 1);
+
+	Vec2 cellSize = Vec2(1.f / float(m_impostor.m_numFrames), 1.f / float(m_impostor.m_numViews));
+	Vec2 uvMins = Vec2(float(frame) * cellSize.x, float(m_impostor.m_numViews - 1 - view) * cellSize.y);		//first view is the top row
+	Vec2 uvMaxs = uvMins + cellSize;
+
+	Vec3 halfRight = -cameraLeft * (m_impostor.m_worldSize * 0.5f);
+	Vec3 halfUp = cameraUp * (m_impostor.m_worldSize * 0.5f);
+	Vec3 bottomLeft = center - halfRight - halfUp;
+	Vec3 bottomRight = center + halfRight - halfUp;
+	Vec3 topRight = center + halfRight + halfUp;
+	Vec3 topLeft = center - halfRight + halfUp;
+	m_impostorVerts.emplace_back(bottomLeft, Rgba8::WHITE, uvMins);
+	m_impostorVerts.emplace_back(bottomRight, Rgba8::WHITE, Vec2(uvMaxs.x, uvMins.y));
+	m_impostorVerts.emplace_back(topRight, Rgba8::WHITE, uvMaxs);
+	m_impostorVerts.emplace_back(bottomLeft, Rgba8::WHITE, uvMins);
+	m_impostorVerts.emplace_back(topRight, Rgba8::WHITE, uvMaxs);
+	m_impostorVerts.emplace_back(topLeft, Rgba8::WHITE, Vec2(uvMins.x, uvMaxs.y));
+}
+
+Vec3 BatchedParticleEffect::GetParticleRenderPosition(const BatchedParticle& particle) const
+{
+	const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+	Vec3 position = particle.m_position;
+	if (particle.m_orbitalRadius != 0.f)
+	{
+		Vec3 radialAxis, tangentAxis;
+		GetPerpendicularAxes(emitter.m_orbitalAxis, radialAxis, tangentAxis);
+		float orbitCos = CosDegrees(particle.m_orbitalAngleDegrees);
+		float orbitSin = SinDegrees(particle.m_orbitalAngleDegrees);
+		position += (radialAxis * orbitCos + tangentAxis * orbitSin) * particle.m_orbitalRadius;
+	}
+	if (!emitter.m_worldSpace)
+	{
+		position = m_instances[particle.m_instanceIndex].m_transform.TransformPosition3D(position);
+	}
+	return position;
+}
+
+void BatchedParticleEffect::BuildScreenCullSlots() const
+{
+	const ParticleFrustum& view = m_world->GetViewFrustum();
+	IntVec2 screenSize = m_world->GetScreenSize();
+	int tileSize = m_screenCullSettings.m_tileSizePixels;
+	int numTilesX = (screenSize.x + tileSize - 1) / tileSize;
+	int numTilesY = (screenSize.y + tileSize - 1) / tileSize;
+	m_screenSlotCounts.assign(numTilesX * numTilesY * m_numBlendSlots, 0);
+	m_particleScreenSlots.resize(m_particles.size());
+
+	float pixelsPerUnitAtUnitDepth = float(screenSize.y) * 0.5f / view.m_tanHalfFovY;
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); particleIndex++)
+	{
+		const BatchedParticle& particle = m_particles[particleIndex];
+		m_particleScreenSlots[particleIndex] = -1;
+		if (!m_instances[particle.m_instanceIndex].m_isVisible)
+			continue;
+
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		Vec3 relative = GetParticleRenderPosition(particle) - view.m_position;
+		float depth = DotProduct3D(relative, view.m_forward);
+		if (depth <= view.m_nearZ)
+			continue;		//behind the near plane, the rasterizer would clip it anyway
+
+		float normalizedAge = particle.m_age * particle.m_inverseLifetime;
+		float sizeX = fabsf(emitter.m_sizeX.Evaluate(normalizedAge, particle.m_curveBlend));
+		float sizeY = fabsf(emitter.m_sizeY.Evaluate(normalizedAge, particle.m_curveBlend));
+		float pixelSize = particle.m_size * std::max(sizeX, sizeY) * pixelsPerUnitAtUnitDepth / depth;
+		if (pixelSize < m_screenCullSettings.m_minPixelSize)
+		{
+			m_screenCullStats.m_numSubPixelCulled++;
+			continue;
+		}
+
+		//particles centered off screen can still reach into it, so they land in the nearest edge tile
+		float pixelX = (-DotProduct3D(relative, view.m_left) / (depth * view.m_tanHalfFovX) * 0.5f + 0.5f) * float(screenSize.x);
+		float pixelY = (DotProduct3D(relative, view.m_up) / (depth * view.m_tanHalfFovY) * 0.5f + 0.5f) * float(screenSize.y);
+		int tileX = Clamp(int(pixelX) / tileSize, 0, numTilesX - 1);
+		int tileY = Clamp(int(pixelY) / tileSize, 0, numTilesY - 1);
+		int slot = (tileY * numTilesX + tileX) * m_numBlendSlots + emitter.m_blendSlot;
+		m_particleScreenSlots[particleIndex] = slot;
+		m_screenSlotCounts[slot]++;
+	}
+}
+
+bool BatchedParticleEffect::IsSubPixel(const Vec3& center, float radius) const
+{
+	//a sphere the camera is inside or close to is never dropped
+	const ParticleFrustum& view = m_world->GetViewFrustum();
+	float depth = DotProduct3D(center - view.m_position, view.m_forward);
+	if (depth <= view.m_nearZ + radius)
+		return false;
+
+	float pixelsPerUnitAtUnitDepth = float(m_world->GetScreenSize().y) * 0.5f / view.m_tanHalfFovY;
+	return radius * 2.f * pixelsPerUnitAtUnitDepth / depth < m_screenCullSettings.m_minPixelSize;
+}
+
+bool BatchedParticleEffect::IsInstanceSubPixel(const BatchedEffectInstance& instance) const
+{
+	Vec3 center = (instance.m_bounds.m_mins + instance.m_bounds.m_maxs) * 0.5f;
+	return IsSubPixel(center, (instance.m_bounds.m_maxs - instance.m_bounds.m_mins).GetLength() * 0.5f);
+}
+
+bool BatchedParticleEffect::IsParticleKeptByScreenCull(int particleIndex) const
+{
+	int slot = m_particleScreenSlots[particleIndex];
+	if (slot < 0)
+		return false;
+
+	//over the cap, every particle in the tile survives with the same probability so the tile thins out evenly
+	int maxPerTile = m_screenCullSettings.m_maxParticlesPerTile;
+	int count = m_screenSlotCounts[slot];
+	if (maxPerTile <= 0 || count <= maxPerTile)
+		return true;
+	if (m_particles[particleIndex].m_screenCullRank * float(count) < float(maxPerTile))
+		return true;
+
+	m_screenCullStats.m_numTileCapCulled++;
+	return false;
+}
+
+int BatchedParticleEffect::AddInstance(const Mat44& transform)
+{
+	int instanceIndex = -1;
+	if (m_freeInstances.empty())
+	{
+		instanceIndex = int(m_instances.size());
+		m_instances.emplace_back();
+		m_emitterStates.resize(m_emitterStates.size() + m_emitters.size());
+		m_staticBatches.resize(m_staticBatches.size() + m_emitters.size());
+		m_instanceAttractorPositions.resize(m_instanceAttractorPositions.size() + m_attractors.size());
+	}
+	else
+	{
+		instanceIndex = m_freeInstances.back();
+		m_freeInstances.pop_back();
+	}
+
+	BatchedEffectInstance& instance = m_instances[instanceIndex];
+	instance.m_transform = transform;
+	instance.m_localGravity = GetInstanceSpaceVector(transform, PARTICLE_GRAVITY);
+	instance.m_isAlive = true;
+	instance.m_isEmitting = true;
+	instance.m_isRemoved = false;
+	instance.m_isVisible = true;
+	instance.m_numAliveParticles = 0;
+	instance.m_lodBand = 0;
+	instance.m_pendingDeltaSeconds = 0.f;
+	instance.m_tickDeltaSeconds = 0.f;
+	instance.m_secondsCulled = 0.f;
+	instance.m_dormantSeconds = 0.f;
+	instance.m_isDormant = false;
+	instance.m_isImpostor = false;
+	instance.m_loopPhaseSeconds = m_loopClip ? m_rng.GetRandomFloatInRange(0.f, m_loopClip->GetPeriodSeconds()) : 0.f;
+	instance.m_bounds = AABB3(transform.GetTranslation3D(), transform.GetTranslation3D());
+	if (m_world)
+		instance.m_proxyId = m_world->GetBoundsTree()->CreateProxy(instance.m_bounds, this, instanceIndex);
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		m_emitterStates[instanceIndex * m_emitters.size() + emitterIndex] = BatchedEmitterState();
+	}
+	m_numLiveInstances++;
+	m_isRenderDataStale = true;
+	return instanceIndex;
+}
+
+void BatchedParticleEffect::RemoveInstance(int instanceIndex)
+{
+	//the slot is only recycled once every particle it emitted has died, since particles refer back to it
+	BatchedEffectInstance& instance = m_instances[instanceIndex];
+	instance.m_isEmitting = false;
+	instance.m_isRemoved = true;
+}
+
+void BatchedParticleEffect::SetInstanceTransform(int instanceIndex, const Mat44& transform)
+{
+	BatchedEffectInstance& instance = m_instances[instanceIndex];
+	if (memcmp(instance.m_transform.m_values, transform.m_values, sizeof(transform.m_values)) == 0)
+		return;
+
+	//static particles of local emitters move with the instance, so their verts are rebuilt
+	instance.m_transform = transform;
+	instance.m_localGravity = GetInstanceSpaceVector(transform, PARTICLE_GRAVITY);
+	m_hasMovedSinceSort = true;
+	m_isRenderDataStale = true;
+	for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+	{
+		if (m_emitters[emitterIndex].m_isStatic && !m_emitters[emitterIndex].m_worldSpace)
+			m_staticBatches[instanceIndex * m_emitters.size() + emitterIndex].m_isDirty = true;
+	}
+}
+
+const Mat44& BatchedParticleEffect::GetInstanceTransform(int instanceIndex) const
+{
+	return m_instances[instanceIndex].m_transform;
+}
+
+const AABB3& BatchedParticleEffect::GetInstanceBounds(int instanceIndex) const
+{
+	return m_instances[instanceIndex].m_bounds;
+}
+
+void BatchedParticleEffect::SetAllInstancesCulled()
+{
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		m_instances[instanceIndex].m_isVisible = false;
+	}
+}
+
+void BatchedParticleEffect::SetInstanceVisible(int instanceIndex)
+{
+	m_instances[instanceIndex].m_isVisible = true;
+}
+
+void BatchedParticleEffect::SetScreenCullSettings(const ParticleScreenCullSettings& settings)
+{
+	m_screenCullSettings = settings;
+}
+
+const ParticleQualityKnobs& BatchedParticleEffect::GetQualityKnobs() const
+{
+	static const ParticleQualityKnobs fullQuality;
+	return m_world ? m_world->GetQualityKnobs() : fullQuality;
+}
+
+void BatchedParticleEffect::SetBudgetSettings(const ParticleBudgetSettings& settings)
+{
+	m_budgetSettings = settings;
+}
+
+void BatchedParticleEffect::SetBudgetCap(int maxAliveParticles)
+{
+	m_budgetCap = maxAliveParticles;
+}
+
+//the pool size, or less while the world's budget holds the effect to fewer
+int BatchedParticleEffect::GetMaxAliveParticles() const
+{
+	return m_budgetCap >= 0 ? std::min(m_budgetCap, m_maxParticles) : m_maxParticles;
+}
+
+//returns how many were evicted, which is fewer than asked when the rest of the alive count is static particles
+int BatchedParticleEffect::EvictOldestParticles(int numParticles)
+{
+	numParticles = std::min(numParticles, int(m_particles.size()));
+	if (numParticles <= 0)
+		return 0;
+
+	//oldest means closest to the end of its lifetime, which is the least noticeable particle to lose
+	m_evictionCandidates.clear();
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); particleIndex++)
+	{
+		const BatchedParticle& particle = m_particles[particleIndex];
+		m_evictionCandidates.emplace_back(-particle.m_age * particle.m_inverseLifetime, particleIndex);
+	}
+	std::nth_element(m_evictionCandidates.begin(), m_evictionCandidates.begin() + (numParticles - 1), m_evictionCandidates.end());
+	m_evictionCandidates.resize(numParticles);
+
+	//removal swaps the last particle in, so go from the highest index down
+	std::sort(m_evictionCandidates.begin(), m_evictionCandidates.end(), IsHigherParticleIndex);
+	for (int i = 0; i < int(m_evictionCandidates.size()); i++)
+	{
+		RemoveParticle(m_evictionCandidates[i].second);
+	}
+	return numParticles;
+}
+
+void BatchedParticleEffect::SetImpostor(const ParticleImpostorDescriptor& impostor)
+{
+	//instances already drawn as impostors catch up through the lod pass, which stops using the impostor once it is invalid
+	m_impostor = impostor;
+	m_impostorTexture = impostor.IsValid() ? g_theRenderResources->InternTexture(impostor.m_texturePath.c_str()) : TextureHandle();
+	m_impostorSeconds = 0.f;
+	m_isRenderDataStale = true;
+}
+
+void BatchedParticleEffect::SetLoopClip(ParticleLoopClip* clip)
+{
+	//a clip baked before emitters or sprite sheets changed no longer matches, so keep simulating
+	if (clip)
+	{
+		std::vector<int> numSpriteFramesPerEmitter;
+		for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+		{
+			numSpriteFramesPerEmitter.push_back(GetNumSpriteFrames(m_emitters[emitterIndex]));
+		}
+		if (!clip->FitsEmitters(numSpriteFramesPerEmitter))
+		{
+			DebuggerPrintf("Loop clip does not match the emitters of its effect, simulating the effect instead\n");
+			delete clip;
+			clip = nullptr;
+		}
+	}
+
+	delete m_loopClip;
+	m_loopClip = clip;
+	delete m_loopClipBuffer;
+	m_loopClipBuffer = nullptr;
+	m_loopClipParticles.clear();
+	m_loopClipRanges.clear();
+	m_loopClipQuadsPerSegment.clear();
+	m_loopClipSegments.clear();
+	m_isRenderDataStale = true;
+	if (m_loopClip)
+		DecodeLoopClip();
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		m_instances[instanceIndex].m_loopPhaseSeconds = m_loopClip ? m_rng.GetRandomFloatInRange(0.f, m_loopClip->GetPeriodSeconds()) : 0.f;
+	}
+}
+
+void BatchedParticleEffect::GetParticleSprites(std::vector<BatchedParticleSprite>& out_sprites) const
+{
+	//billboard sizes, colors and frames exactly as Render builds them
+	out_sprites.clear();
+	out_sprites.reserve(m_particles.size());
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); particleIndex++)
+	{
+		const BatchedParticle& particle = m_particles[particleIndex];
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		float normalizedAge = particle.m_age * particle.m_inverseLifetime;
+		float fraction = 0.f;
+		int sampleIndex = GetSampleIndexForNormalizedAge(normalizedAge, fraction);
+
+		BatchedParticleSprite sprite;
+		sprite.m_position = GetParticleRenderPosition(particle);
+		sprite.m_velocity = particle.m_velocity;
+		sprite.m_halfWidth = fabsf(particle.m_size * emitter.m_sizeX.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f);
+		sprite.m_halfHeight = fabsf(particle.m_size * emitter.m_sizeY.Evaluate(normalizedAge, particle.m_curveBlend) * 0.5f);
+		sprite.m_rotationDegrees = particle.m_rotationDegrees;
+		sprite.m_ageSeconds = particle.m_age;
+		sprite.m_color = fraction < 0.5f ? emitter.m_color[sampleIndex] : emitter.m_color[sampleIndex + 1];
+		sprite.m_blendMode = emitter.m_blendMode;
+		sprite.m_emitterIndex = particle.m_emitterIndex;
+		sprite.m_spriteFrame = GetSpriteSheetFrame(emitter, normalizedAge);
+		out_sprites.push_back(sprite);
+	}
+
+	for (int batchIndex = 0; batchIndex < int(m_staticBatches.size()); batchIndex++)
+	{
+		const BatchedStaticBatch& batch = m_staticBatches[batchIndex];
+		const BakedParticleEmitter& emitter = m_emitters[batchIndex % m_emitters.size()];
+		const Mat44& transform = m_instances[batchIndex / m_emitters.size()].m_transform;
+		for (int i = 0; i < int(batch.m_particles.size()); i++)
+		{
+			const BatchedStaticParticle& particle = batch.m_particles[i];
+			BatchedParticleSprite sprite;
+			sprite.m_position = emitter.m_worldSpace ? particle.m_position : transform.TransformPosition3D(particle.m_position);
+			sprite.m_halfWidth = fabsf(particle.m_halfWidth);
+			sprite.m_halfHeight = fabsf(particle.m_halfHeight);
+			sprite.m_rotationDegrees = particle.m_rotationDegrees;
+			sprite.m_ageSeconds = particle.m_lifetime - float(particle.m_expirySeconds - m_clockSeconds);
+			sprite.m_color = particle.m_color;
+			sprite.m_blendMode = emitter.m_blendMode;
+			sprite.m_emitterIndex = batchIndex % int(m_emitters.size());
+			out_sprites.push_back(sprite);
+		}
+	}
+}
+
+//every particle as one captured compact stream in draw order, sorted and static emitters included, for tools that draw an effect
+//without a gpu. Sorted emitters are ordered back to front from the given camera like Render orders them.
+void BatchedParticleEffect::CaptureParticles(const Vec3& cameraPosition, const Vec3& cameraForward, const Vec3& cameraLeft, const Vec3& cameraUp, ParticleInstanceCapture& capture) const
+{
+	std::vector<BatchedParticleSprite> sprites;
+	GetParticleSprites(sprites);
+	if (sprites.empty())
+		return;
+
+	//one origin in the middle of the particles keeps their half float positions precise
+	Vec3 origin;
+	for (int i = 0; i < int(sprites.size()); i++)
+	{
+		origin += sprites[i].m_position;
+	}
+	origin *= 1.f / float(sprites.size());
+	CapturedParticleEffect& effect = capture.BeginEffect(std::vector<Vec3>(1, origin), m_frameUVs);
+
+	std::vector<std::pair<float, int>> emitterSprites;
+	for (int drawIndex = 0; drawIndex < int(m_emitterDrawOrder.size()); drawIndex++)
+	{
+		int emitterIndex = m_emitterDrawOrder[drawIndex];
+		const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		emitterSprites.clear();
+		for (int i = 0; i < int(sprites.size()); i++)
+		{
+			if (sprites[i].m_emitterIndex == emitterIndex)
+				emitterSprites.emplace_back(emitter.m_sortParticles ? -DotProduct3D(sprites[i].m_position - cameraPosition, cameraForward) : 0.f, i);
+		}
+		if (emitterSprites.empty())
+			continue;
+		if (emitter.m_sortParticles)
+			std::sort(emitterSprites.begin(), emitterSprites.end());
+
+		CapturedParticleDraw draw;
+		draw.m_firstInstance = int(effect.m_instances.size());
+		draw.m_numInstances = int(emitterSprites.size());
+		draw.m_blendMode = emitter.m_blendMode;
+		draw.m_texturePath = emitter.m_texturePath;
+		draw.m_isHorizontal = emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD;
+		draw.m_cameraLeft = cameraLeft;
+		draw.m_cameraUp = cameraUp;
+		for (int i = 0; i < int(emitterSprites.size()); i++)
+		{
+			const BatchedParticleSprite& sprite = sprites[emitterSprites[i].second];
+			Vec3 position = sprite.m_position - origin;
+			CompactParticleInstance instance;
+			instance.m_position[0] = FloatToHalf(position.x);
+			instance.m_position[1] = FloatToHalf(position.y);
+			instance.m_position[2] = FloatToHalf(position.z);
+			instance.m_halfSize[0] = FloatToHalf(sprite.m_halfWidth);
+			instance.m_halfSize[1] = FloatToHalf(sprite.m_halfHeight);
+			instance.m_rotationDegrees = FloatToHalf(sprite.m_rotationDegrees);
+			instance.m_color = sprite.m_color;
+			instance.m_spriteFrame = (unsigned short)(emitter.m_firstFrameUV + sprite.m_spriteFrame);
+			instance.m_originIndex = 0;
+			effect.m_instances.push_back(instance);
+		}
+		capture.AddDraw(draw);
+	}
+}
+
+void BatchedParticleEffect::SetLODPolicy(const ParticleLODPolicy& policy)
+{
+	m_lodPolicy = policy;
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		m_instances[instanceIndex].m_lodBand = 0;
+	}
+}
+
+int BatchedParticleEffect::GetInstanceLODBand(int instanceIndex) const
+{
+	return m_instances[instanceIndex].m_lodBand;
+}
+
+void BatchedParticleEffect::BakeEmitter(const ParticleEmitterData& emitterData)
+{
+	BakedParticleEmitter emitter;
+	emitter.m_maxParticlesPerInstance = emitterData.m_maxParticles;
+	emitter.m_lifetime = emitterData.m_particleLifetime;
+	emitter.m_startSpeed = emitterData.m_startSpeed;
+	emitter.m_startSize = emitterData.m_startSize;
+	emitter.m_startRotationDegrees = emitterData.m_startRotationDegrees;
+	emitter.m_offset = emitterData.m_offsetFromWorldPos;
+	emitter.m_worldSpace = emitterData.m_simulationSpace == SimulationSpace::WORLD;
+	emitter.m_emissionMode = emitterData.m_emissionMode;
+	emitter.m_particlesPerSecond = emitterData.m_particlesEmittedPerSecond;
+	emitter.m_numBurstParticles = int(emitterData.m_numBurstParticles);
+	emitter.m_burstInterval = emitterData.m_burstInterval;
+
+	if (ConeEmitter* coneEmitter = dynamic_cast<ConeEmitter*>(emitterData.m_shape))
+	{
+		emitter.m_shape = BatchedEmitterShape::CONE;
+		emitter.m_coneHalfAngle = coneEmitter->m_coneHalfAngle;
+		emitter.m_shapeForward = coneEmitter->m_coneForward.GetNormalized();
+	}
+	else if (SphereEmitter* sphereEmitter = dynamic_cast<SphereEmitter*>(emitterData.m_shape))
+	{
+		emitter.m_shape = BatchedEmitterShape::SPHERE;
+		emitter.m_sphereRadius = sphereEmitter->m_sphereRadius;
+		emitter.m_fromSphereSurface = sphereEmitter->m_fromSurface;
+	}
+	else if (BoxEmitter* boxEmitter = dynamic_cast<BoxEmitter*>(emitterData.m_shape))
+	{
+		emitter.m_shape = BatchedEmitterShape::BOX;
+		emitter.m_boxDimensions = boxEmitter->m_dimensions;
+		emitter.m_shapeForward = boxEmitter->m_forward.GetNormalized();
+	}
+
+	emitter.m_gravityScale = float(emitterData.m_gravityScale);
+	emitter.m_velocityX.Bake(emitterData.m_velocityOverLifetime_X, emitterData.m_volSpeedModifier, 0.f);
+	emitter.m_velocityY.Bake(emitterData.m_velocityOverLifetime_Y, emitterData.m_volSpeedModifier, 0.f);
+	emitter.m_velocityZ.Bake(emitterData.m_velocityOverLifetime_Z, emitterData.m_volSpeedModifier, 0.f);
+	emitter.m_drag.Bake(emitterData.m_dragOverLifetime, emitterData.m_dragModifier, 0.f);
+	emitter.m_angularVelocity.Bake(emitterData.m_rotationOverLifetime, emitterData.m_rotationModifier, 0.f);
+	emitter.m_orbitalVelocity.Bake(emitterData.m_orbitalVelOverLifetime, emitterData.m_orbitalVelocityModifier, 0.f);
+	emitter.m_orbitalRadius.Bake(emitterData.m_orbitalRadiusOverLifetime, emitterData.m_orbitalRadiusModifier, 0.f);
+	if (emitterData.m_orbitalVelocityAxis.GetLengthSquared() > 0.f)
+		emitter.m_orbitalAxis = emitterData.m_orbitalVelocityAxis.GetNormalized();
+	emitter.m_firstAttractor = int(m_attractors.size());
+	emitter.m_numAttractors = int(emitterData.m_pointAttractors.size());
+	m_attractors.insert(m_attractors.end(), emitterData.m_pointAttractors.begin(), emitterData.m_pointAttractors.end());
+	emitter.m_isAnalytic = emitter.m_drag.m_isZero && emitter.m_velocityX.m_isZero && emitter.m_velocityY.m_isZero && emitter.m_velocityZ.m_isZero
+		&& emitter.m_orbitalVelocity.m_isZero && emitter.m_orbitalRadius.m_isZero && emitter.m_numAttractors == 0;
+	m_maxParticleLifetime = std::max(m_maxParticleLifetime, emitter.m_lifetime.m_max);
+
+	emitter.m_sizeX.Bake(emitterData.m_sizeOverLifetimeX, emitterData.m_sizeOverLifeXModifier, 1.f);
+	emitter.m_sizeY.Bake(emitterData.m_sizeOverLifetimeY, emitterData.m_sizeOverLifeYModifier, 1.f);
+	float maxSizeScale = 0.f;
+	for (int i = 0; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		maxSizeScale = std::max(maxSizeScale, std::max(fabsf(emitter.m_sizeX.m_curveOne[i]), fabsf(emitter.m_sizeY.m_curveOne[i])));
+		if (emitter.m_sizeX.m_randomBetweenCurves)
+			maxSizeScale = std::max(maxSizeScale, fabsf(emitter.m_sizeX.m_curveTwo[i]));
+		if (emitter.m_sizeY.m_randomBetweenCurves)
+			maxSizeScale = std::max(maxSizeScale, fabsf(emitter.m_sizeY.m_curveTwo[i]));
+	}
+	emitter.m_maxHalfExtentScale = maxSizeScale * 0.5f * 1.4142136f;		//quads can be rotated, so use the half diagonal
+	BakeColorKeys(emitterData.m_colorOverLifetime, emitterData.m_startColor, emitter.m_color);
+	emitter.m_texturePath = emitterData.m_textureFilepath;
+	if (emitter.m_texturePath == "Default")
+		emitter.m_texturePath.clear();		//the editor's name for the renderer's default texture, which binding no texture selects
+	emitter.m_blendMode = emitterData.m_blendMode;
+	emitter.m_renderMode = emitterData.m_renderMode;
+	emitter.m_isSpriteSheet = emitterData.m_isSpriteSheetTexture && emitterData.m_spriteSheetGridLayout.x > 0 && emitterData.m_spriteSheetGridLayout.y > 0;
+	if (emitter.m_isSpriteSheet)
+		emitter.m_spriteSheetLayout = emitterData.m_spriteSheetGridLayout;
+	emitter.m_sortParticles = emitterData.m_sortParticles;
+	emitter.m_drawOrder = emitterData.m_drawOrder;
+
+	//emitters whose textures were packed into the same atlas page end up with the same texture, so they can share a draw
+	const ParticleAtlas* atlas = m_world ? m_world->GetAtlas() : nullptr;
+	const ParticleAtlasRegion* atlasRegion = atlas ? atlas->FindRegion(emitter.m_texturePath, emitter.m_spriteSheetLayout) : nullptr;
+	if (atlasRegion)
+	{
+		emitter.m_texturePath = atlas->GetPageTexturePath(atlasRegion->m_page);
+		for (int frame = 0; frame < int(atlasRegion->m_framePositions.size()); frame++)
+		{
+			emitter.m_frameUVs.push_back(atlas->GetFrameUVs(*atlasRegion, frame));
+		}
+	}
+	if (!emitter.m_texturePath.empty())
+		emitter.m_textureHash = HashResourcePath(emitter.m_texturePath.c_str());
+
+	//nothing moves a particle that starts still with no gravity, and nothing over its lifetime changes how it looks
+	//cached verts keep their spawn order, so sorted emitters stay out
+	bool hasConstantColor = true;
+	for (int i = 1; i < PARTICLE_CURVE_LUT_SIZE; i++)
+	{
+		const Rgba8& color = emitter.m_color[i];
+		if (color.r != emitter.m_color[0].r || color.g != emitter.m_color[0].g || color.b != emitter.m_color[0].b || color.a != emitter.m_color[0].a)
+			hasConstantColor = false;
+	}
+	bool hasSingleFrame = !emitter.m_isSpriteSheet || emitter.m_spriteSheetLayout.x * emitter.m_spriteSheetLayout.y == 1;
+	emitter.m_isStatic = emitter.m_isAnalytic && emitter.m_gravityScale == 0.f && emitter.m_startSpeed.m_min == 0.f && emitter.m_startSpeed.m_max == 0.f
+		&& emitter.m_angularVelocity.m_isZero && IsBakedCurveConstant(emitter.m_sizeX) && IsBakedCurveConstant(emitter.m_sizeY) && hasConstantColor && hasSingleFrame && !emitter.m_sortParticles;
+	m_emitters.push_back(emitter);
+}
+
+void BatchedParticleEffect::UpdateInstanceLODs(float deltaSeconds)
+{
+	m_frameNumber++;
+	bool hasView = m_world && m_world->HasViewFrustum();
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive)
+			continue;
+
+		//instances culled for long enough stop simulating and only track the time they missed
+		bool canSleep = hasView && !instance.m_isRemoved && m_lodPolicy.m_dormantDelaySeconds >= 0.f;
+		if (canSleep && !instance.m_isVisible)
+		{
+			instance.m_secondsCulled += deltaSeconds;
+			if (instance.m_isDormant || instance.m_secondsCulled >= m_lodPolicy.m_dormantDelaySeconds)
+			{
+				if (!instance.m_isDormant)
+				{
+					//impostors are already tracking missed time since their particles were dropped
+					instance.m_isDormant = true;
+					if (!instance.m_isImpostor)
+						instance.m_dormantSeconds = instance.m_pendingDeltaSeconds;
+					instance.m_pendingDeltaSeconds = 0.f;
+					m_numDormantInstances++;
+				}
+				instance.m_dormantSeconds += deltaSeconds;
+				instance.m_tickDeltaSeconds = 0.f;
+				continue;
+			}
+		}
+		else
+		{
+			instance.m_secondsCulled = 0.f;
+		}
+
+		bool isWaking = instance.m_isDormant;
+		if (isWaking)
+		{
+			if (!instance.m_isImpostor)
+			{
+				CatchUpInstance(instanceIndex, instance.m_dormantSeconds);
+				instance.m_dormantSeconds = 0.f;
+			}
+			instance.m_isDormant = false;
+			m_numDormantInstances--;
+		}
+
+		if (hasView)
+		{
+			const ParticleFrustum& view = m_world->GetViewFrustum();
+			Vec3 center = (instance.m_bounds.m_mins + instance.m_bounds.m_maxs) * 0.5f;
+			float radius = (instance.m_bounds.m_maxs - instance.m_bounds.m_mins).GetLength() * 0.5f;
+			float distance = (center - view.m_position).GetLength() * GetQualityKnobs().m_lodDistanceScale;
+			float screenSize = radius / std::max(distance * view.m_tanHalfFovY, 0.0001f);
+			instance.m_lodBand = m_lodPolicy.SelectBand(instance.m_lodBand, distance, screenSize);
+		}
+		if (UpdateInstanceImpostor(instanceIndex, deltaSeconds))
+			continue;
+
+		//instances in the same band tick on different frames so the cost of a coarse band is spread evenly
+		//a waking instance always ticks so its bounds are rebuilt from the caught up particles
+		const ParticleLODBand& band = m_lodPolicy.m_bands[instance.m_lodBand];
+		instance.m_pendingDeltaSeconds += deltaSeconds;
+		instance.m_tickDeltaSeconds = 0.f;
+		if (isWaking || (m_frameNumber + instanceIndex) % band.m_tickInterval == 0)
+		{
+			instance.m_tickDeltaSeconds = instance.m_pendingDeltaSeconds;
+			instance.m_pendingDeltaSeconds = 0.f;
+		}
+	}
+}
+
+bool BatchedParticleEffect::UpdateInstanceImpostor(int instanceIndex, float deltaSeconds)
+{
+	BatchedEffectInstance& instance = m_instances[instanceIndex];
+	bool useImpostor = m_impostor.IsValid() && !instance.m_isRemoved && instance.m_lodBand == int(m_lodPolicy.m_bands.size()) - 1;
+	if (useImpostor)
+	{
+		//the flipbook replaces the whole system, so its particles go back to the pool right away
+		//and leaving the band rebuilds a full lifetime of them, the same way a dormant instance wakes
+		if (!instance.m_isImpostor)
+		{
+			for (int particleIndex = 0; particleIndex < int(m_particles.size()); )
+			{
+				if (m_particles[particleIndex].m_instanceIndex == instanceIndex)
+				{
+					RemoveParticle(particleIndex);
+					continue;
+				}
+				particleIndex++;
+			}
+			ClearStaticParticles(instanceIndex);
+			instance.m_isImpostor = true;
+			instance.m_dormantSeconds = m_maxParticleLifetime;
+			instance.m_pendingDeltaSeconds = 0.f;
+			m_numImpostorInstances++;
+		}
+		instance.m_dormantSeconds += deltaSeconds;
+		instance.m_tickDeltaSeconds = 0.f;
+		return true;
+	}
+
+	if (instance.m_isImpostor)
+	{
+		CatchUpInstance(instanceIndex, instance.m_dormantSeconds);
+		instance.m_isImpostor = false;
+		instance.m_dormantSeconds = 0.f;
+		instance.m_pendingDeltaSeconds = 0.f;
+		instance.m_tickDeltaSeconds = deltaSeconds;
+		m_numImpostorInstances--;
+		return true;
+	}
+	return false;
+}
+
+void BatchedParticleEffect::CatchUpInstance(int instanceIndex, float dormantSeconds)
+{
+	//nothing emitted before the last full particle lifetime can still be alive, so that is all there is to replay
+	float window = std::min(dormantSeconds, m_maxParticleLifetime);
+	int numEmitters = int(m_emitters.size());
+	float skippedSeconds = dormantSeconds - window;
+	for (int emitterIndex = 0; emitterIndex < numEmitters && skippedSeconds > 0.f; emitterIndex++)
+	{
+		const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+		BatchedEmitterState& state = m_emitterStates[instanceIndex * numEmitters + emitterIndex];
+		if (emitter.m_emissionMode == EmissionMode::BURST && emitter.m_burstInterval > 0.f)
+			state.m_timeUntilBurst = fmodf(state.m_timeUntilBurst - skippedSeconds, emitter.m_burstInterval);
+	}
+
+	bool hasSteppedEmitters = false;
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); )
+	{
+		BatchedParticle& particle = m_particles[particleIndex];
+		if (particle.m_instanceIndex != instanceIndex)
+		{
+			particleIndex++;
+			continue;
+		}
+
+		if (dormantSeconds >= m_maxParticleLifetime)
+		{
+			RemoveParticle(particleIndex);
+			continue;
+		}
+
+		//analytic particles jump straight to the current time, the rest are stepped below
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		if (emitter.m_isAnalytic && !IntegrateParticle(particle, dormantSeconds))
+		{
+			RemoveParticle(particleIndex);
+			continue;
+		}
+		particleIndex++;
+	}
+
+	for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+	{
+		if (m_emitters[emitterIndex].m_isAnalytic)
+			CatchUpAnalyticEmitter(instanceIndex, emitterIndex, window);
+		else
+			hasSteppedEmitters = true;
+	}
+	if (!hasSteppedEmitters || window <= 0.f)
+		return;
+
+	//everything else is resimulated in a few large steps, which only has to look plausible on the first visible frame
+	float stepSeconds = window / float(PARTICLE_CATCH_UP_STEPS);
+	for (int step = 0; step < PARTICLE_CATCH_UP_STEPS; step++)
+	{
+		for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+		{
+			if (!m_emitters[emitterIndex].m_isAnalytic)
+				EmitEmitterParticles(instanceIndex, emitterIndex, stepSeconds);
+		}
+
+		for (int particleIndex = 0; particleIndex < int(m_particles.size()); )
+		{
+			BatchedParticle& particle = m_particles[particleIndex];
+			if (particle.m_instanceIndex == instanceIndex && !m_emitters[particle.m_emitterIndex].m_isAnalytic && !IntegrateParticle(particle, stepSeconds))
+			{
+				RemoveParticle(particleIndex);
+				continue;
+			}
+			particleIndex++;
+		}
+	}
+}
+
+void BatchedParticleEffect::CatchUpAnalyticEmitter(int instanceIndex, int emitterIndex, float window)
+{
+	const BatchedEffectInstance& instance = m_instances[instanceIndex];
+	if (!instance.m_isEmitting || window <= 0.f)
+		return;
+
+	//the same band and quality scaling as regular emission, so waking up under reduced quality does not spawn at full rate
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	const ParticleLODBand& band = m_lodPolicy.m_bands[instance.m_lodBand];
+	const ParticleQualityKnobs& knobs = GetQualityKnobs();
+	float emissionScale = band.m_emissionScale * knobs.m_emissionScale;
+	BatchedEmitterState& state = m_emitterStates[instanceIndex * m_emitters.size() + emitterIndex];
+	int maxAlive = int(float(emitter.m_maxParticlesPerInstance) * band.m_maxAliveFraction * knobs.m_maxAliveScale);
+
+	//spawn the particles the window would have emitted, youngest first, already aged to where they would be now
+	std::vector<float>& spawnAges = m_catchUpSpawnAges;
+	spawnAges.clear();
+	if (emitter.m_emissionMode == EmissionMode::BURST)
+	{
+		int numBurstParticles = int(float(emitter.m_numBurstParticles) * emissionScale + 0.5f);
+		state.m_timeUntilBurst -= window;
+		float burstInterval = emitter.m_burstInterval > 0.f ? emitter.m_burstInterval : window;
+		while (state.m_timeUntilBurst <= 0.f)
+		{
+			for (int i = 0; i < numBurstParticles; i++)
+			{
+				spawnAges.push_back(-state.m_timeUntilBurst);
+			}
+			state.m_timeUntilBurst += burstInterval;
+		}
+		std::sort(spawnAges.begin(), spawnAges.end());
+	}
+	else
+	{
+		float particlesPerSecond = emitter.m_particlesPerSecond * emissionScale;
+		float numToSpawn = state.m_emitAccumulator + particlesPerSecond * window;
+		int numSpawned = int(numToSpawn);
+		state.m_emitAccumulator = numToSpawn - float(numSpawned);
+		for (int i = 0; i < numSpawned; i++)
+		{
+			spawnAges.push_back((float(i) + 0.5f) / particlesPerSecond);
+		}
+	}
+
+	for (int i = 0; i < int(spawnAges.size()); i++)
+	{
+		if (state.m_numAliveParticles >= maxAlive || GetNumAliveParticles() >= GetMaxAliveParticles())
+			break;
+		if (emitter.m_isStatic)
+		{
+			SpawnStaticParticle(instanceIndex, emitterIndex, spawnAges[i]);
+			continue;
+		}
+
+		SpawnParticle(instanceIndex, emitterIndex);
+		int particleIndex = int(m_particles.size()) - 1;
+		if (!IntegrateParticle(m_particles[particleIndex], spawnAges[i]))
+			RemoveParticle(particleIndex);
+	}
+}
+
+void BatchedParticleEffect::EmitParticles()
+{
+	int numEmitters = int(m_emitters.size());
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		const BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (instance.m_tickDeltaSeconds <= 0.f)
+			continue;
+
+		for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+		{
+			EmitEmitterParticles(instanceIndex, emitterIndex, instance.m_tickDeltaSeconds);
+		}
+	}
+}
+
+void BatchedParticleEffect::EmitEmitterParticles(int instanceIndex, int emitterIndex, float deltaSeconds)
+{
+	const BatchedEffectInstance& instance = m_instances[instanceIndex];
+	if (!instance.m_isEmitting)
+		return;
+
+	const ParticleLODBand& band = m_lodPolicy.m_bands[instance.m_lodBand];
+	const ParticleQualityKnobs& knobs = GetQualityKnobs();
+	float emissionScale = band.m_emissionScale * knobs.m_emissionScale;
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	BatchedEmitterState& state = m_emitterStates[instanceIndex * m_emitters.size() + emitterIndex];
+	int numToSpawn = 0;
+	if (emitter.m_emissionMode == EmissionMode::BURST)
+	{
+		state.m_timeUntilBurst -= deltaSeconds;
+		if (state.m_timeUntilBurst <= 0.f)
+		{
+			numToSpawn = int(float(emitter.m_numBurstParticles) * emissionScale + 0.5f);
+			state.m_timeUntilBurst += emitter.m_burstInterval > 0.f ? emitter.m_burstInterval : deltaSeconds;
+		}
+	}
+	else
+	{
+		state.m_emitAccumulator += emitter.m_particlesPerSecond * emissionScale * deltaSeconds;
+		numToSpawn = int(state.m_emitAccumulator);
+		state.m_emitAccumulator -= float(numToSpawn);
+	}
+
+	//the full request counts as demand, before the effect's own caps or the budget throttle what is actually emitted
+	m_requestedSpawnsThisFrame += std::max(numToSpawn, 0);
+	int maxAlive = int(float(emitter.m_maxParticlesPerInstance) * band.m_maxAliveFraction * knobs.m_maxAliveScale);
+	int roomInInstance = maxAlive - state.m_numAliveParticles;
+	int roomInPool = GetMaxAliveParticles() - GetNumAliveParticles();
+	numToSpawn = std::min(numToSpawn, std::min(roomInInstance, roomInPool));
+	if (numToSpawn <= 0)
+		return;
+
+	for (int i = 0; i < numToSpawn; i++)
+	{
+		if (emitter.m_isStatic)
+			SpawnStaticParticle(instanceIndex, emitterIndex, 0.f);
+		else
+			SpawnParticle(instanceIndex, emitterIndex);
+	}
+}
+
+void BatchedParticleEffect::SpawnParticle(int instanceIndex, int emitterIndex)
+{
+	m_isRenderDataStale = true;
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	BatchedEffectInstance& instance = m_instances[instanceIndex];
+
+	Vec3 shapePosition;
+	Vec3 direction = GetRandomShapeDirection(emitter, shapePosition);
+	BatchedParticle particle;
+	particle.m_position = emitter.m_offset + shapePosition;
+	particle.m_velocity = direction * m_rng.GetRandomFloatInRange(emitter.m_startSpeed.m_min, emitter.m_startSpeed.m_max);
+	if (emitter.m_worldSpace)
+	{
+		particle.m_position = instance.m_transform.TransformPosition3D(particle.m_position);
+		particle.m_velocity = instance.m_transform.TransformVectorQuantity3D(particle.m_velocity);
+	}
+	float lifetime = m_rng.GetRandomFloatInRange(emitter.m_lifetime.m_min, emitter.m_lifetime.m_max);
+	particle.m_inverseLifetime = lifetime > 0.f ? 1.f / lifetime : 0.f;
+	particle.m_size = m_rng.GetRandomFloatInRange(emitter.m_startSize.m_min, emitter.m_startSize.m_max);
+	particle.m_rotationDegrees = m_rng.GetRandomFloatInRange(emitter.m_startRotationDegrees.m_min, emitter.m_startRotationDegrees.m_max);
+	particle.m_curveBlend = m_rng.RollRandomFloatZeroToOne();
+	particle.m_screenCullRank = m_rng.RollRandomFloatZeroToOne();
+	particle.m_instanceIndex = instanceIndex;
+	particle.m_emitterIndex = emitterIndex;
+	m_particles.push_back(particle);
+	m_particleSortRanks.push_back(UINT_MAX);
+
+	m_emitterStates[instanceIndex * m_emitters.size() + emitterIndex].m_numAliveParticles++;
+	instance.m_numAliveParticles++;
+}
+
+void BatchedParticleEffect::SpawnStaticParticle(int instanceIndex, int emitterIndex, float ageSeconds)
+{
+	//spawn through the regular path for the shape, start values and alive counts, then move the particle out of the sim
+	SpawnParticle(instanceIndex, emitterIndex);
+	BatchedParticle particle = m_particles.back();
+	m_particles.pop_back();
+	m_particleSortRanks.pop_back();
+
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	float lifetime = particle.m_inverseLifetime > 0.f ? 1.f / particle.m_inverseLifetime : 0.f;
+	if (ageSeconds >= lifetime)
+	{
+		m_emitterStates[instanceIndex * m_emitters.size() + emitterIndex].m_numAliveParticles--;
+		m_instances[instanceIndex].m_numAliveParticles--;
+		return;
+	}
+
+	BatchedStaticParticle staticParticle;
+	staticParticle.m_position = particle.m_position;
+	staticParticle.m_halfWidth = particle.m_size * emitter.m_sizeX.Evaluate(0.f, particle.m_curveBlend) * 0.5f;
+	staticParticle.m_halfHeight = particle.m_size * emitter.m_sizeY.Evaluate(0.f, particle.m_curveBlend) * 0.5f;
+	staticParticle.m_rotationDegrees = particle.m_rotationDegrees;
+	staticParticle.m_halfExtent = particle.m_size * emitter.m_maxHalfExtentScale;
+	staticParticle.m_lifetime = lifetime;
+	staticParticle.m_color = emitter.m_color[0];
+	staticParticle.m_expirySeconds = m_clockSeconds + double(lifetime - ageSeconds);
+
+	BatchedStaticBatch& batch = m_staticBatches[instanceIndex * m_emitters.size() + emitterIndex];
+	batch.m_particles.push_back(staticParticle);
+	std::push_heap(batch.m_particles.begin(), batch.m_particles.end(), IsLaterExpiry);
+	GrowBounds(batch.m_bounds, batch.m_hasBounds, staticParticle.m_position, staticParticle.m_halfExtent);
+	batch.m_isDirty = true;
+	m_numStaticParticles++;
+}
+
+void BatchedParticleEffect::ExpireStaticParticles()
+{
+	int numEmitters = int(m_emitters.size());
+	for (int batchIndex = 0; batchIndex < int(m_staticBatches.size()); batchIndex++)
+	{
+		BatchedStaticBatch& batch = m_staticBatches[batchIndex];
+		while (!batch.m_particles.empty() && batch.m_particles.front().m_expirySeconds <= m_clockSeconds)
+		{
+			std::pop_heap(batch.m_particles.begin(), batch.m_particles.end(), IsLaterExpiry);
+			batch.m_particles.pop_back();
+			batch.m_isDirty = true;
+			batch.m_isBoundsDirty = true;
+			m_emitterStates[batchIndex].m_numAliveParticles--;
+			m_instances[batchIndex / numEmitters].m_numAliveParticles--;
+			m_numStaticParticles--;
+		}
+	}
+}
+
+void BatchedParticleEffect::ClearStaticParticles(int instanceIndex)
+{
+	int numEmitters = int(m_emitters.size());
+	for (int emitterIndex = 0; emitterIndex < numEmitters; emitterIndex++)
+	{
+		BatchedStaticBatch& batch = m_staticBatches[instanceIndex * numEmitters + emitterIndex];
+		int numCleared = int(batch.m_particles.size());
+		batch.m_particles.clear();
+		batch.m_hasBounds = false;
+		batch.m_isDirty = true;
+		m_emitterStates[instanceIndex * numEmitters + emitterIndex].m_numAliveParticles -= numCleared;
+		m_instances[instanceIndex].m_numAliveParticles -= numCleared;
+		m_numStaticParticles -= numCleared;
+	}
+}
+
+void BatchedParticleEffect::RenderStaticBatches(RenderBackend& backend, int emitterIndex, const Vec3& cameraLeft, const Vec3& cameraUp, bool useScreenCull) const
+{
+	const BakedParticleEmitter& emitter = m_emitters[emitterIndex];
+	int numEmitters = int(m_emitters.size());
+	bool hasBoundState = false;
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		BatchedStaticBatch& batch = m_staticBatches[instanceIndex * numEmitters + emitterIndex];
+		const BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (batch.m_particles.empty() || !instance.m_isVisible || instance.m_isImpostor)
+			continue;
+
+		//the batch stays uploaded as a whole, so it is only dropped once the whole instance shrinks below a pixel
+		if (useScreenCull && IsInstanceSubPixel(instance))
+		{
+			m_screenCullStats.m_numSubPixelCulled += int(batch.m_particles.size());
+			continue;
+		}
+
+		//the shader billboards from the camera axes, so only spawns, expiries and moves need the particles sent again
+		if (batch.m_isDirty)
+		{
+			m_staticUploadScratch.resize(batch.m_particles.size());
+			for (int i = 0; i < int(batch.m_particles.size()); i++)
+			{
+				const BatchedStaticParticle& particle = batch.m_particles[i];
+				StaticParticleInstance& upload = m_staticUploadScratch[i];
+				Vec3 position = emitter.m_worldSpace ? particle.m_position : instance.m_transform.TransformPosition3D(particle.m_position);
+				upload.m_position[0] = position.x;
+				upload.m_position[1] = position.y;
+				upload.m_position[2] = position.z;
+				upload.m_halfWidth = particle.m_halfWidth;
+				upload.m_halfHeight = particle.m_halfHeight;
+				upload.m_rotationDegrees = particle.m_rotationDegrees;
+				upload.m_color = PackRgba8(particle.m_color);
+			}
+
+			//sized once for the most particles the emitter can have alive in one instance
+			if (!batch.m_gpuBuffer)
+				batch.m_gpuBuffer = new ParticleStaticBuffer(emitter.m_maxParticlesPerInstance);
+			batch.m_gpuBuffer->Upload(m_staticUploadScratch);
+			batch.m_isDirty = false;
+			m_numStaticUploads++;
+		}
+
+		if (!hasBoundState)
+		{
+			backend.SetBlendMode(emitter.m_blendMode);
+			backend.BindTexture(GetEmitterTexture(emitterIndex));
+			hasBoundState = true;
+		}
+
+		//static emitters only ever show their first frame
+		Vec2 uvMins;
+		Vec2 uvMaxs;
+		GetSpriteSheetUVs(emitter, 0, uvMins, uvMaxs);
+		batch.m_gpuBuffer->Draw(backend, cameraLeft, cameraUp, emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD, uvMins, uvMaxs);
+	}
+	if (hasBoundState)
+		backend.BindShader(nullptr);
+}
+
+void BatchedParticleEffect::SimulateParticles()
+{
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		//instances that skip this frame keep last tick's bounds
+		BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (instance.m_tickDeltaSeconds > 0.f)
+		{
+			instance.m_hasLocalSpaceBounds = false;
+			instance.m_hasWorldSpaceBounds = false;
+		}
+	}
+
+	for (int particleIndex = 0; particleIndex < int(m_particles.size()); )
+	{
+		BatchedParticle& particle = m_particles[particleIndex];
+		BatchedEffectInstance& instance = m_instances[particle.m_instanceIndex];
+		if (instance.m_tickDeltaSeconds <= 0.f)
+		{
+			particleIndex++;
+			continue;
+		}
+
+		if (!IntegrateParticle(particle, instance.m_tickDeltaSeconds))
+		{
+			RemoveParticle(particleIndex);
+			continue;
+		}
+
+		const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+		float halfExtent = particle.m_size * emitter.m_maxHalfExtentScale + fabsf(particle.m_orbitalRadius);
+		if (emitter.m_worldSpace)
+			GrowBounds(instance.m_worldSpaceBounds, instance.m_hasWorldSpaceBounds, particle.m_position, halfExtent);
+		else
+			GrowBounds(instance.m_localSpaceBounds, instance.m_hasLocalSpaceBounds, particle.m_position, halfExtent);
+		particleIndex++;
+	}
+}
+
+bool BatchedParticleEffect::IntegrateParticle(BatchedParticle& particle, float deltaSeconds)
+{
+	particle.m_age += deltaSeconds;
+	float normalizedAge = particle.m_age * particle.m_inverseLifetime;
+	if (normalizedAge >= 1.f)
+		return false;
+
+	//particles of local space emitters move in instance space, so gravity has to be brought into it to keep pulling down
+	const BakedParticleEmitter& emitter = m_emitters[particle.m_emitterIndex];
+	const Vec3& gravity = emitter.m_worldSpace ? PARTICLE_GRAVITY : m_instances[particle.m_instanceIndex].m_localGravity;
+	Vec3 acceleration = gravity * emitter.m_gravityScale;
+	if (emitter.m_isAnalytic)
+	{
+		//constant acceleration, exact for any step size
+		particle.m_position += particle.m_velocity * deltaSeconds + acceleration * (0.5f * deltaSeconds * deltaSeconds);
+		particle.m_velocity += acceleration * deltaSeconds;
+		if (!emitter.m_angularVelocity.m_isZero)
+			particle.m_rotationDegrees += emitter.m_angularVelocity.Evaluate(normalizedAge, particle.m_curveBlend) * deltaSeconds;
+		return true;
+	}
+
+	int numAttractors = int(m_attractors.size());
+	if (!emitter.m_drag.m_isZero)
+		acceleration -= particle.m_velocity * emitter.m_drag.Evaluate(normalizedAge, particle.m_curveBlend);
+	if (!emitter.m_velocityX.m_isZero)
+		acceleration.x += emitter.m_velocityX.Evaluate(normalizedAge, particle.m_curveBlend);
+	if (!emitter.m_velocityY.m_isZero)
+		acceleration.y += emitter.m_velocityY.Evaluate(normalizedAge, particle.m_curveBlend);
+	if (!emitter.m_velocityZ.m_isZero)
+		acceleration.z += emitter.m_velocityZ.Evaluate(normalizedAge, particle.m_curveBlend);
+	for (int i = emitter.m_firstAttractor; i < emitter.m_firstAttractor + emitter.m_numAttractors; i++)
+	{
+		Vec3 toAttractor = m_instanceAttractorPositions[particle.m_instanceIndex * numAttractors + i] - particle.m_position;
+		float distanceSquared = std::max(toAttractor.GetLengthSquared(), MIN_ATTRACTOR_DISTANCE_SQUARED);
+		acceleration += toAttractor * (m_attractors[i].m_strength / distanceSquared);
+	}
+
+	particle.m_velocity += acceleration * deltaSeconds;
+	particle.m_position += particle.m_velocity * deltaSeconds;
+	if (!emitter.m_angularVelocity.m_isZero)
+		particle.m_rotationDegrees += emitter.m_angularVelocity.Evaluate(normalizedAge, particle.m_curveBlend) * deltaSeconds;
+	if (!emitter.m_orbitalVelocity.m_isZero)
+		particle.m_orbitalAngleDegrees += emitter.m_orbitalVelocity.Evaluate(normalizedAge, particle.m_curveBlend) * deltaSeconds;
+	if (!emitter.m_orbitalRadius.m_isZero)
+		particle.m_orbitalRadius += emitter.m_orbitalRadius.Evaluate(normalizedAge, particle.m_curveBlend) * deltaSeconds;
+	return true;
+}
+
+void BatchedParticleEffect::RemoveParticle(int particleIndex)
+{
+	BatchedParticle& particle = m_particles[particleIndex];
+	m_emitterStates[particle.m_instanceIndex * m_emitters.size() + particle.m_emitterIndex].m_numAliveParticles--;
+	m_instances[particle.m_instanceIndex].m_numAliveParticles--;
+	particle = m_particles.back();
+	m_particles.pop_back();
+	m_particleSortRanks[particleIndex] = m_particleSortRanks.back();
+	m_particleSortRanks.pop_back();
+	m_isRenderDataStale = true;
+}
+
+void BatchedParticleEffect::UpdateInstanceBounds()
+{
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (!instance.m_isAlive)
+			continue;
+
+		//the emitter origin is always included so an instance that has not emitted yet is still found by the cull
+		bool hasBounds = true;
+		AABB3 bounds = AABB3(instance.m_transform.GetTranslation3D(), instance.m_transform.GetTranslation3D());
+		if (instance.m_hasWorldSpaceBounds)
+		{
+			GrowBounds(bounds, hasBounds, instance.m_worldSpaceBounds.m_mins, 0.f);
+			GrowBounds(bounds, hasBounds, instance.m_worldSpaceBounds.m_maxs, 0.f);
+		}
+		//an impostor instance has released its particles, so the billboard is all there is to bound
+		if (instance.m_isImpostor && m_impostor.IsValid())
+			GrowBounds(bounds, hasBounds, instance.m_transform.TransformPosition3D(m_impostor.m_centerOffset), m_impostor.m_worldSize * 0.5f);
+		if (instance.m_hasLocalSpaceBounds)
+		{
+			const AABB3& local = instance.m_localSpaceBounds;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				Vec3 localCorner = Vec3((corner & 1) ? local.m_maxs.x : local.m_mins.x, (corner & 2) ? local.m_maxs.y : local.m_mins.y, (corner & 4) ? local.m_maxs.z : local.m_mins.z);
+				GrowBounds(bounds, hasBounds, instance.m_transform.TransformPosition3D(localCorner), 0.f);
+			}
+		}
+		for (int emitterIndex = 0; emitterIndex < int(m_emitters.size()); emitterIndex++)
+		{
+			BatchedStaticBatch& batch = m_staticBatches[instanceIndex * m_emitters.size() + emitterIndex];
+			if (batch.m_isBoundsDirty)
+			{
+				//expiry can only shrink the bounds, which is rare enough to simply regrow them here
+				batch.m_hasBounds = false;
+				for (int i = 0; i < int(batch.m_particles.size()); i++)
+				{
+					GrowBounds(batch.m_bounds, batch.m_hasBounds, batch.m_particles[i].m_position, batch.m_particles[i].m_halfExtent);
+				}
+				batch.m_isBoundsDirty = false;
+			}
+			if (!batch.m_hasBounds)
+				continue;
+
+			const AABB3& batchBounds = batch.m_bounds;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				Vec3 batchCorner = Vec3((corner & 1) ? batchBounds.m_maxs.x : batchBounds.m_mins.x, (corner & 2) ? batchBounds.m_maxs.y : batchBounds.m_mins.y, (corner & 4) ? batchBounds.m_maxs.z : batchBounds.m_mins.z);
+				GrowBounds(bounds, hasBounds, m_emitters[emitterIndex].m_worldSpace ? batchCorner : instance.m_transform.TransformPosition3D(batchCorner), 0.f);
+			}
+		}
+		instance.m_bounds = bounds;
+		if (instance.m_proxyId != -1)
+			m_world->GetBoundsTree()->MoveProxy(instance.m_proxyId, instance.m_bounds);
+	}
+}
+
+void BatchedParticleEffect::FreeRemovedInstances()
+{
+	for (int instanceIndex = 0; instanceIndex < int(m_instances.size()); instanceIndex++)
+	{
+		BatchedEffectInstance& instance = m_instances[instanceIndex];
+		if (instance.m_isAlive && instance.m_isRemoved && instance.m_numAliveParticles == 0)
+		{
+			instance.m_isAlive = false;
+			if (instance.m_proxyId != -1)
+			{
+				m_world->GetBoundsTree()->DestroyProxy(instance.m_proxyId);
+				instance.m_proxyId = -1;
+			}
+			m_freeInstances.push_back(instanceIndex);
+			m_numLiveInstances--;
+		}
+	}
+}
+
+Vec3 BatchedParticleEffect::GetRandomShapeDirection(const BakedParticleEmitter& emitter, Vec3& out_localPosition)
+{
+	out_localPosition = Vec3::ZERO;
+	switch (emitter.m_shape)
+	{
+	case BatchedEmitterShape::SPHERE:
+	{
+		Vec3 direction = m_rng.GetRandomDirectionInSphere().GetNormalized();
+		float radius = emitter.m_fromSphereSurface ? emitter.m_sphereRadius : emitter.m_sphereRadius * m_rng.RollRandomFloatZeroToOne();
+		out_localPosition = direction * radius;
+		return direction;
+	}
+	case BatchedEmitterShape::BOX:
+	{
+		out_localPosition.x = m_rng.GetRandomFloatInRange(-0.5f, 0.5f) * emitter.m_boxDimensions.x;
+		out_localPosition.y = m_rng.GetRandomFloatInRange(-0.5f, 0.5f) * emitter.m_boxDimensions.y;
+		out_localPosition.z = m_rng.GetRandomFloatInRange(-0.5f, 0.5f) * emitter.m_boxDimensions.z;
+		return emitter.m_shapeForward;
+	}
+	case BatchedEmitterShape::CONE:
+	default:
+	{
+		if (emitter.m_coneHalfAngle <= 0.f)
+			return emitter.m_shapeForward;
+
+		//uniform over the spherical cap around the cone forward
+		Vec3 left, up;
+		GetPerpendicularAxes(emitter.m_shapeForward, left, up);
+		float cosTheta = m_rng.GetRandomFloatInRange(CosDegrees(emitter.m_coneHalfAngle), 1.f);
+		float sinTheta = sqrtf(std::max(0.f, 1.f - cosTheta * cosTheta));
+		float phi = m_rng.GetRandomFloatInRange(0.f, 360.f);
+		return emitter.m_shapeForward * cosTheta + (left * CosDegrees(phi) + up * SinDegrees(phi)) * sinTheta;
+	}
+	}
+}
@@ -0,0 +1,428 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Math/Mat44.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include "Engine/Math/AABB3.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/FloatRange.hpp"
+#include "Engine/Math/RandomNumberGenerator.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Renderer/ParticleEmitterData.hpp"
+#include "Game/ParticleLOD.hpp"
+#include "Game/ParticleScreenCull.hpp"
+#include "Game/ParticleBudget.hpp"
+#include "Game/ParticleQualityController.hpp"
+#include "Game/ParticleImpostor.hpp"
+#include "Game/ParticleRadixSort.hpp"
+#include "Game/ParticleInstanceStream.hpp"
+#include "Game/ParticleStaticBuffer.hpp"
+#include "Game/ParticleLoopClipBuffer.hpp"
+#include "Game/RenderResourceTable.hpp"
+
+class Camera;
+class Texture;
+class ParticleWorld;
+class VertexBuffer;
+class ParticleLoopClip;
+class RenderBackend;
+class ParticleStaticBuffer;
+class ParticleLoopClipBuffer;
+class ParticleInstanceCapture;
+
+constexpr int PARTICLE_CURVE_LUT_SIZE = 64;
+
+//An over-lifetime curve sampled at fixed normalized ages, so evaluating it per particle is a single lerp.
+struct BakedParticleCurve
+{
+	float m_curveOne[PARTICLE_CURVE_LUT_SIZE] = {};
+	float m_curveTwo[PARTICLE_CURVE_LUT_SIZE] = {};
+	bool m_randomBetweenCurves = false;
+	bool m_isZero = true;
+
+	void Bake(const AnimatedCurve<float>& curve, float modifier, float valueWithoutKeys);
+	float Evaluate(float normalizedAge, float curveBlend) const;
+};
+
+enum class BatchedEmitterShape
+{
+	CONE,
+	SPHERE,
+	BOX,
+};
+
+struct BakedParticleEmitter
+{
+	//spawning
+	int m_maxParticlesPerInstance = 0;
+	FloatRange m_lifetime;
+	FloatRange m_startSpeed;
+	FloatRange m_startSize;
+	FloatRange m_startRotationDegrees;
+	Vec3 m_offset;
+	bool m_worldSpace = false;
+	EmissionMode m_emissionMode = EmissionMode::CONSTANT;
+	float m_particlesPerSecond = 0.f;
+	int m_numBurstParticles = 0;
+	float m_burstInterval = 0.f;
+	BatchedEmitterShape m_shape = BatchedEmitterShape::CONE;
+	Vec3 m_shapeForward = Vec3(1.f, 0.f, 0.f);
+	float m_coneHalfAngle = 0.f;
+	float m_sphereRadius = 1.f;
+	bool m_fromSphereSurface = false;
+	Vec3 m_boxDimensions;
+
+	//simulation
+	float m_gravityScale = 0.f;
+	BakedParticleCurve m_velocityX;
+	BakedParticleCurve m_velocityY;
+	BakedParticleCurve m_velocityZ;
+	BakedParticleCurve m_drag;
+	BakedParticleCurve m_angularVelocity;
+	BakedParticleCurve m_orbitalVelocity;
+	BakedParticleCurve m_orbitalRadius;
+	Vec3 m_orbitalAxis = Vec3(0.f, 0.f, 1.f);
+	int m_firstAttractor = 0;
+	int m_numAttractors = 0;
+	bool m_isAnalytic = false;		//only gravity acts on particles, so their state at any age has a closed form
+	bool m_isStatic = false;		//particles never move or change their look after spawn, so they skip the sim and keep their verts
+
+	//rendering
+	BakedParticleCurve m_sizeX;
+	BakedParticleCurve m_sizeY;
+	float m_maxHalfExtentScale = 0.f;		//largest half diagonal of a quad per unit of start size
+	Rgba8 m_color[PARTICLE_CURVE_LUT_SIZE];
+	std::string m_texturePath;
+	unsigned int m_textureHash = 0;		//of the path, what draws compare to tell if they share a texture, 0 when untextured
+	mutable TextureHandle m_texture;	//interned the first time the emitter draws, so baking needs no renderer
+	BlendMode m_blendMode = BlendMode::ALPHA;
+	RenderMode m_renderMode = RenderMode::BILLBOARD;
+	bool m_isSpriteSheet = false;
+	IntVec2 m_spriteSheetLayout = IntVec2(1, 1);
+	std::vector<AABB2> m_frameUVs;		//uvs of each frame in the particle atlas, empty when the texture is not in it
+	int m_firstFrameUV = 0;				//first frame of this emitter in the effect's frame table
+	bool m_sortParticles = false;		//quads are drawn back to front
+	int m_drawOrder = 0;
+	int m_mergedStream = -1;			//stream the global ordering merges this emitter into, -1 when it is always drawn on its own
+	int m_blendSlot = 0;		//index among the distinct blend modes of the effect, for per tile caps
+};
+
+struct BatchedParticle
+{
+	Vec3 m_position;		//world space, or instance space for local emitters
+	Vec3 m_velocity;
+	float m_age = 0.f;
+	float m_inverseLifetime = 0.f;
+	float m_size = 0.f;
+	float m_rotationDegrees = 0.f;
+	float m_orbitalAngleDegrees = 0.f;
+	float m_orbitalRadius = 0.f;
+	float m_curveBlend = 0.f;
+	float m_screenCullRank = 0.f;		//stable random key deciding which particles survive a tile cap
+	int m_instanceIndex = -1;
+	int m_emitterIndex = -1;
+};
+
+//A particle as it would be drawn, for tools that render or record the effect without the gpu.
+struct BatchedParticleSprite
+{
+	Vec3 m_position;		//world space
+	Vec3 m_velocity;
+	float m_halfWidth = 0.f;
+	float m_halfHeight = 0.f;
+	float m_rotationDegrees = 0.f;
+	float m_ageSeconds = 0.f;
+	Rgba8 m_color;
+	BlendMode m_blendMode = BlendMode::ALPHA;
+	int m_emitterIndex = -1;
+	int m_spriteFrame = 0;
+};
+
+//Render data of a particle from a static emitter, fixed from spawn until it expires.
+struct BatchedStaticParticle
+{
+	Vec3 m_position;		//world space, or instance space for local emitters
+	float m_halfWidth = 0.f;
+	float m_halfHeight = 0.f;
+	float m_rotationDegrees = 0.f;
+	float m_halfExtent = 0.f;
+	float m_lifetime = 0.f;
+	Rgba8 m_color;
+	double m_expirySeconds = 0.0;		//on the effect clock
+};
+
+//Static particles of one emitter in one instance. The particles form a min heap on expiry, so expiring them only looks at the front,
+//and the gpu copy is only uploaded again when a particle spawns or expires or the instance moves.
+struct BatchedStaticBatch
+{
+	std::vector<BatchedStaticParticle> m_particles;
+	ParticleStaticBuffer* m_gpuBuffer = nullptr;
+	bool m_isDirty = false;
+	AABB3 m_bounds;
+	bool m_hasBounds = false;
+	bool m_isBoundsDirty = false;
+};
+
+struct BatchedDrawRun
+{
+	int m_firstVertex = 0;
+	int m_numVerts = 0;
+	int m_emitterIndex = -1;		//texture and blend of the run
+};
+
+//Sorted emitters of one effect sharing a blend mode whose result depends on order. With global ordering on, their back to front
+//streams are merged into one, which only breaks into another draw where the texture changes.
+struct BatchedMergedStream
+{
+	std::vector<int> m_emitterIndices;		//in draw order, which also breaks depth ties
+	std::vector<int> m_textureSlots;		//per emitter, equal slots share a texture
+	std::vector<int> m_heads;
+	std::vector<Vertex_PCU> m_verts;
+	std::vector<BatchedDrawRun> m_runs;
+};
+
+enum class BatchedDrawKind
+{
+	COMPACT,			//an unsorted emitter's instances of the compact stream
+	VERTS,				//an emitter's quads built on the cpu
+	EMITTER_PASSES,		//an emitter's loop clip, static batches or merged sorted stream, which the effect draws itself
+	IMPOSTORS,
+};
+
+//One step of an effect's draw sequence. Compact and vert steps only carry an emitter, so the draw batcher can join them with
+//steps of the same texture, blend and billboard mode, while the other kinds are always drawn on their own.
+struct BatchedDrawItem
+{
+	BatchedDrawKind m_kind = BatchedDrawKind::COMPACT;
+	int m_emitterIndex = -1;
+};
+
+//What last frame's render data was built for. Seen again with the same key, an effect that has not changed since draws it unchanged.
+struct BatchedRenderDataKey
+{
+	Vec3 m_cameraPosition;
+	Vec3 m_cameraLeft;
+	Vec3 m_cameraUp;
+	bool m_useCompactStream = false;
+	bool m_useScreenCull = false;
+	bool m_isSortingEnabled = false;
+	bool m_isGlobalOrderEnabled = false;
+};
+
+struct BatchedEmitterState
+{
+	float m_emitAccumulator = 0.f;
+	float m_timeUntilBurst = 0.f;
+	int m_numAliveParticles = 0;
+};
+
+struct BatchedEffectInstance
+{
+	Mat44 m_transform;
+	Vec3 m_localGravity;		//gravity in instance space, for local space emitters
+	bool m_isAlive = false;
+	bool m_isEmitting = false;
+	bool m_isRemoved = false;
+	bool m_isVisible = true;
+	int m_numAliveParticles = 0;
+	int m_proxyId = -1;
+	AABB3 m_bounds;
+	AABB3 m_localSpaceBounds;		//grown during the sim pass by particles of local space emitters
+	AABB3 m_worldSpaceBounds;		//grown during the sim pass by particles of world space emitters
+	bool m_hasLocalSpaceBounds = false;
+	bool m_hasWorldSpaceBounds = false;
+	int m_lodBand = 0;
+	float m_pendingDeltaSeconds = 0.f;
+	float m_tickDeltaSeconds = 0.f;		//0 on frames this instance is not simulated
+	float m_secondsCulled = 0.f;
+	float m_dormantSeconds = 0.f;		//time missed while dormant, caught up when the instance is seen again
+	bool m_isDormant = false;
+	bool m_isImpostor = false;		//drawn as the baked flipbook, simulates nothing and is caught up when it leaves the far band
+	float m_loopPhaseSeconds = 0.f;		//random offset into the loop clip so instances do not play in sync
+};
+
+//Simulates every live instance of one effect definition in a single pass over one shared particle pool.
+//Curves are baked once per definition, each particle carries the index of the instance that emitted it,
+//and instances only contribute a transform and their emission state, so extra instances cost almost nothing.
+//Instance bounds fall out of the sim pass and feed the world's bounds tree, so culled instances build no render data.
+//Distant instances drop to coarser lod bands that tick less often, emit less and cap their alive count.
+//Instances culled for a while go dormant and cost nothing until they are seen again and catch up.
+//Before render data is built, effects that opt in drop sub-pixel particles and keep a capped random subset per screen tile.
+//Effects with a baked impostor swap instances in their farthest band for one animated billboard.
+//Particles of static emitters live in per instance vertex buffers that are only touched on spawn and expiry.
+//Effects with a baked loop clip skip emission and simulation entirely and only play the clip back, decoded on the gpu once.
+//Drawing goes through a ParticleDrawBatcher, which joins the draws of every effect the world renders together.
+class BatchedParticleEffect : public ParticleInstanceSource
+{
+public:
+	BatchedParticleEffect(const std::vector<ParticleEmitterData>& emitterData, int maxInstances, ParticleWorld* world = nullptr);
+	~BatchedParticleEffect();
+	//nullptr when the file is missing, cannot be parsed or there is no world to load it through
+	static BatchedParticleEffect* CreateFromEffectFile(const char* effectPath, int maxInstances, ParticleWorld* world);
+	static std::vector<ParticleEmitterData> LoadEmitterData(const char* effectPath, ParticleWorld* world);
+	void Update(float deltaSeconds);
+	void UpdateRenderData(const Camera& camera) const;
+	void GetDrawItems(std::vector<BatchedDrawItem>& out_items) const;
+	void DrawEmitterPasses(RenderBackend& backend, int emitterIndex, const Vec3& cameraLeft, const Vec3& cameraUp) const;
+	void DrawImpostors(RenderBackend& backend) const;
+	void WriteEmitterInstances(int emitterIndex, CompactParticleInstance* out_instances, int originBase, int frameBase) const;
+
+	int AddInstance(const Mat44& transform);
+	void RemoveInstance(int instanceIndex);
+	void SetInstanceTransform(int instanceIndex, const Mat44& transform);
+	const Mat44& GetInstanceTransform(int instanceIndex) const;
+	const AABB3& GetInstanceBounds(int instanceIndex) const;
+	void SetAllInstancesCulled();
+	void SetInstanceVisible(int instanceIndex);
+	void SetLODPolicy(const ParticleLODPolicy& policy);
+	int GetInstanceLODBand(int instanceIndex) const;
+	void SetScreenCullSettings(const ParticleScreenCullSettings& settings);
+	void SetBudgetSettings(const ParticleBudgetSettings& settings);
+	void SetBudgetCap(int maxAliveParticles);
+	int EvictOldestParticles(int numParticles);
+	void SetImpostor(const ParticleImpostorDescriptor& impostor);
+	void SetLoopClip(ParticleLoopClip* clip);
+	void GetParticleSprites(std::vector<BatchedParticleSprite>& out_sprites) const;
+	void CaptureParticles(const Vec3& cameraPosition, const Vec3& cameraForward, const Vec3& cameraLeft, const Vec3& cameraUp, ParticleInstanceCapture& capture) const;
+
+	int GetNumInstances() const { return m_numLiveInstances; }
+	int GetNumAliveParticles() const { return int(m_particles.size()) + m_numStaticParticles; }
+	int GetNumStaticParticles() const { return m_numStaticParticles; }
+	int GetNumStaticUploads() const { return m_numStaticUploads; }		//static batches sent to the gpu since the effect was made
+	int GetMaxParticles() const { return m_maxParticles; }
+	int GetNumDormantInstances() const { return m_numDormantInstances; }
+	const ParticleScreenCullStats& GetScreenCullStats() const { return m_screenCullStats; }
+	const ParticleBudgetSettings& GetBudgetSettings() const { return m_budgetSettings; }
+	int GetRequestedSpawnsPeak() const { return m_requestedSpawnsPeak; }
+	int GetNumImpostorInstances() const { return m_numImpostorInstances; }
+	bool IsPlayingLoopClip() const { return m_loopClip != nullptr; }
+	virtual void WriteInstances(int firstInstance, int numInstances, CompactParticleInstance* out_instances) const override;
+	const BakedParticleEmitter& GetEmitter(int emitterIndex) const { return m_emitters[emitterIndex]; }
+	const std::vector<Vertex_PCU>& GetEmitterVerts(int emitterIndex) const { return m_vertsPerEmitter[emitterIndex]; }
+	Texture* GetEmitterTexture(int emitterIndex) const;
+	int GetNumEmitterInstances(int emitterIndex) const { return int(m_compactParticlesPerEmitter[emitterIndex].size()); }
+	const std::vector<Vec3>& GetInstanceOrigins() const { return m_instanceOrigins; }
+	const std::vector<AABB2>& GetFrameUVs() const { return m_frameUVs; }
+	unsigned int GetRenderDataVersion() const { return m_renderDataVersion; }
+	float GetMaxParticleLifetime() const { return m_maxParticleLifetime; }
+
+private:
+	ParticleWorld* m_world = nullptr;
+	std::vector<BakedParticleEmitter> m_emitters;
+	std::vector<PointAttractor> m_attractors;
+	std::vector<BatchedEffectInstance> m_instances;
+	std::vector<BatchedEmitterState> m_emitterStates;		//m_emitters.size() entries per instance
+	std::vector<Vec3> m_instanceAttractorPositions;			//m_attractors.size() entries per instance, world space
+	std::vector<int> m_freeInstances;
+	std::vector<BatchedParticle> m_particles;
+	mutable std::vector<BatchedStaticBatch> m_staticBatches;		//m_emitters.size() entries per instance, only used by static emitters
+	int m_numStaticParticles = 0;
+	mutable int m_numStaticUploads = 0;
+	double m_clockSeconds = 0.0;
+	mutable std::vector<std::vector<Vertex_PCU>> m_vertsPerEmitter;
+	std::vector<int> m_emitterDrawOrder;
+	mutable std::vector<BatchedMergedStream> m_mergedStreams;
+	mutable std::vector<int> m_particleScreenSlots;		//tile and blend slot per particle from the screen cull, -1 to drop
+	mutable std::vector<int> m_screenSlotCounts;
+	mutable ParticleScreenCullStats m_screenCullStats;
+	ParticleScreenCullSettings m_screenCullSettings;
+	int m_numBlendSlots = 0;
+	ParticleBudgetSettings m_budgetSettings;
+	int m_budgetCap = -1;					//max alive particles granted by the world's budget, -1 when unbudgeted
+	int m_requestedSpawnsThisFrame = 0;
+	int m_requestedSpawnsPeak = 0;			//decaying peak, so effects that tick every few frames still show their demand
+	std::vector<std::pair<float, int>> m_evictionCandidates;
+	std::vector<float> m_catchUpSpawnAges;
+	RandomNumberGenerator m_rng;
+	ParticleLODPolicy m_lodPolicy;
+	unsigned int m_frameNumber = 0;
+	int m_maxParticles = 0;
+	int m_numLiveInstances = 0;
+	int m_numDormantInstances = 0;
+	float m_maxParticleLifetime = 0.f;
+	ParticleImpostorDescriptor m_impostor;
+	TextureHandle m_impostorTexture;
+	float m_impostorSeconds = 0.f;			//drives the flipbook of every impostor instance
+	int m_numImpostorInstances = 0;
+	mutable std::vector<Vertex_PCU> m_impostorVerts;
+	ParticleLoopClip* m_loopClip = nullptr;
+	std::vector<LoopClipParticleInstance> m_loopClipParticles;		//every frame of the clip decoded once, grouped by frame and then emitter
+	std::vector<IntVec2> m_loopClipRanges;		//first particle and count of each emitter in each frame
+	std::vector<int> m_loopClipQuadsPerSegment;	//most particles of each emitter in any frame
+	mutable ParticleLoopClipBuffer* m_loopClipBuffer = nullptr;
+	mutable std::vector<LoopClipSegment> m_loopClipSegments;		//one per visible instance of each unsorted emitter, grouped by emitter
+	mutable std::vector<int> m_loopClipSegmentStarts;				//first segment of each emitter, plus the end
+	mutable std::vector<int> m_visibleClipInstances;
+	mutable bool m_areLoopClipSegmentsStale = false;		//rebuilt since they were last sent to the clip buffer
+	mutable ParticleRadixSorter m_sorter;
+	mutable std::vector<unsigned int> m_particleSortRanks;		//position of each particle in last frame's order of its emitter, kept in step with m_particles
+	mutable std::vector<std::vector<int>> m_quadParticlesPerEmitter;	//particle behind each simulated quad, after the loop clip quads
+	mutable std::vector<std::vector<float>> m_sortedDepthsPerEmitter;	//view depth of each quad in sorted order, for the global ordering
+	mutable std::vector<int> m_numRankedQuadsPerEmitter;
+	mutable bool m_hasMovedSinceSort = true;
+	mutable Vec3 m_sortCameraPosition;
+	mutable Vec3 m_sortCameraForward;
+	mutable std::vector<int> m_quadAtRank;
+	mutable std::vector<int> m_unrankedQuads;
+	mutable std::vector<float> m_sortDepths;
+	mutable std::vector<float> m_rankDepths;
+	mutable std::vector<ParticleSortPair> m_sortPairs;
+	mutable std::vector<ParticleSortPair> m_unrankedSortPairs;
+	mutable std::vector<ParticleSortPair> m_mergedSortPairs;
+	mutable std::vector<Vertex_PCU> m_sortedVerts;
+	mutable ParticleInstanceStreamBuilder m_instanceBuilder;
+	mutable std::vector<std::vector<int>> m_compactParticlesPerEmitter;	//particles of unsorted emitters drawn from the compact instance stream
+	mutable std::vector<int> m_compactParticleIndices;		//particle behind each instance of the stream, grouped by emitter in draw order
+	mutable std::vector<int> m_compactEmitterStarts;		//first instance of each emitter in the stream, plus the end
+	mutable std::vector<Vec3> m_instanceOrigins;
+	std::vector<AABB2> m_frameUVs;		//uvs of every frame of every emitter, for the compact stream
+	mutable int m_compactOriginBase = 0;		//where this effect's origins and frames start in the tables of the stream being written
+	mutable int m_compactFrameBase = 0;
+	mutable std::vector<StaticParticleInstance> m_staticUploadScratch;
+	mutable bool m_isRenderDataStale = true;		//set by anything that changes particles, instances or clip playback
+	mutable BatchedRenderDataKey m_renderDataKey;
+	mutable unsigned int m_renderDataVersion = 0;		//counts rebuilds of the render data, so draw batchers know when to lay out their draws again
+	mutable std::vector<unsigned char> m_renderDataVisibility;	//alive, visible and impostor bits of each instance when the render data was built
+
+private:
+	void BakeEmitter(const ParticleEmitterData& emitterData);
+	static unsigned char GetRenderVisibility(const BatchedEffectInstance& instance);
+	bool IsRenderDataCurrent(const BatchedRenderDataKey& key) const;
+	void BuildRenderData(const Camera& camera, const Vec3& cameraForward, const BatchedRenderDataKey& key) const;
+	Vec3 GetParticleRenderPosition(const BatchedParticle& particle) const;
+	void BuildScreenCullSlots() const;
+	void UpdateLoopClipInstances();
+	void DecodeLoopClip();
+	int GetLoopClipFrame(const BatchedEffectInstance& instance, float& out_frameFraction) const;
+	void AddLoopClipVerts(int instanceIndex, const Vec3& cameraLeft, const Vec3& cameraUp) const;
+	void BuildLoopClipSegments() const;
+	void AddImpostorVerts(int instanceIndex, const Vec3& cameraPosition, const Vec3& cameraLeft, const Vec3& cameraUp) const;
+	bool IsParticleKeptByScreenCull(int particleIndex) const;
+	bool IsSubPixel(const Vec3& center, float radius) const;
+	bool IsInstanceSubPixel(const BatchedEffectInstance& instance) const;
+	const ParticleQualityKnobs& GetQualityKnobs() const;
+	void UpdateInstanceLODs(float deltaSeconds);
+	bool UpdateInstanceImpostor(int instanceIndex, float deltaSeconds);
+	void CatchUpInstance(int instanceIndex, float dormantSeconds);
+	void CatchUpAnalyticEmitter(int instanceIndex, int emitterIndex, float window);
+	void EmitParticles();
+	void EmitEmitterParticles(int instanceIndex, int emitterIndex, float deltaSeconds);
+	int GetMaxAliveParticles() const;
+	void SpawnParticle(int instanceIndex, int emitterIndex);
+	void SpawnStaticParticle(int instanceIndex, int emitterIndex, float ageSeconds);
+	void ExpireStaticParticles();
+	void ClearStaticParticles(int instanceIndex);
+	void RenderStaticBatches(RenderBackend& backend, int emitterIndex, const Vec3& cameraLeft, const Vec3& cameraUp, bool useScreenCull) const;
+	const ParticleSortSettings& GetSortSettings() const;
+	void SortQuadsBackToFront(int emitterIndex, const Vec3& cameraPosition, const Vec3& cameraForward, bool canKeepLastOrder) const;
+	void BuildDrawOrder();
+	void MergeSortedStream(BatchedMergedStream& stream) const;
+	void BuildCompactInstanceStream() const;
+	void SimulateParticles();
+	bool IntegrateParticle(BatchedParticle& particle, float deltaSeconds);
+	void RemoveParticle(int particleIndex);
+	void UpdateInstanceBounds();
+	void FreeRemovedInstances();
+	Vec3 GetRandomShapeDirection(const BakedParticleEmitter& emitter, Vec3& out_localPosition);
+};
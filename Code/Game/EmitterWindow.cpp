@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "ThirdParty/TinyXML2/tinyxml2.h"
 #include "ThirdParty/ImGUI/imgui.h"
 #include "Engine/Core/ErrorWarningAssert.hpp"
@@ -300,3 +302,4 @@ void EmitterWindow::SetAllModuleDataDirty(bool dirty)
 	}
 }
 
+#endif
@@ -14,3 +14,8 @@
 #endif
 //#define ENABLE_VSYNC
 #define ENABLE_OPTICK_PROFILER	// comment out to disable optick profiler
+//#define ENABLE_MEMORY_TRACKING	// (If uncommented) Hooks global new/delete to count per-frame allocations per category (see mem.frame)
+//#define GAME_HEADLESS_ONLY		// (If uncommented) Leaves out the window, imgui, the editor and WinMain, main() always runs headless
+#if !defined(_WIN32) && !defined(GAME_HEADLESS_ONLY)
+#define GAME_HEADLESS_ONLY
+#endif
@@ -12,20 +12,32 @@
 #include "Engine/Core/Job.hpp"
 #include "Engine/Core/XmlUtils.hpp"
 #include "Engine/Renderer/Renderer.hpp"
-#include "Engine/Renderer/Window.hpp"
 #include "Engine/Renderer/DebugRenderSystem.hpp"
 #include "Engine/Renderer/ParticleEmitter.hpp"
 #include "Engine/Renderer/BitmapFont.hpp"
 #include "Engine/Renderer/ParticlesManager.hpp"
 #include "Engine/Renderer/ParticleSystem.hpp"
-#include "ThirdParty/ImGUI/imgui.h"
+#include "Game/EngineBuildPreferences.hpp"
 #include "Game/Game.hpp"
 #include "Game/App.hpp"
 #include "Game/Player.hpp"
 #include "Game/Prop.hpp"
+#include "Game/Zoo.hpp"
+#include "Game/MemoryTracker.hpp"
+#include "Game/ParticleSystemPool.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/ParticleBudget.hpp"
+#include "Game/ParticleFrustum.hpp"
+#include "Game/RenderCommandQueue.hpp"
+#include "Game/RenderResourceTable.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
+#include "Engine/Renderer/Window.hpp"
+#include "ThirdParty/ImGUI/imgui.h"
 #include "Game/EmitterWindow.hpp"
 #include "Game/ParticleEditor.hpp"
-#include "Game/Zoo.hpp"
+#endif
 
 extern App* g_theApp;
 extern Renderer* g_theRenderer;
@@ -33,7 +45,7 @@ extern InputSystem* g_theInput;
 extern AudioSystem* g_theAudio;
 extern Window* g_theWindow;
 extern JobSystem* g_theJobSystem;
-extern ParticlesManager* g_theParticlesManager;
+extern RenderResourceTable* g_theRenderResources;
 
 static float animationTimer = 0.f;
 
@@ -54,7 +66,57 @@ void Game::Startup()
 	m_worldCamera.SetViewToRenderTransform(Vec3(0.f, 0.f, 1.f), Vec3(-1.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f));
 	m_stopwatch.Start(&g_theApp->GetGameClock(), 1.f);
 	SubscribeEventCallbackFunction("controls", ControlsCommand);
-	DebugAddWorldBasis(Mat44(), -1.f, Rgba8::WHITE, Rgba8::WHITE, DebugRenderMode::USEDEPTH);
+	m_renderQueue = new RenderCommandQueue();
+	m_isHeadless = g_theApp->IsHeadless();
+	if (m_isHeadless)
+	{
+		m_headlessClientDimensions.x = g_gameConfigBlackboard.GetValue("headlessClientWidth", m_headlessClientDimensions.x);
+		m_headlessClientDimensions.y = g_gameConfigBlackboard.GetValue("headlessClientHeight", m_headlessClientDimensions.y);
+		m_headlessBackend = new CountingRenderBackend();
+		m_renderBackend = m_headlessBackend;
+		if (g_gameConfigBlackboard.GetValue("headlessCaptureParticles", true))
+			m_particleCapture = new ParticleInstanceCapture();
+	}
+	else
+	{
+		m_renderBackend = new RendererRenderBackend();
+	}
+	m_debugFont = g_theRenderResources->InternFont("Data/Fonts/MyFixedFont");
+	m_skyboxShader = g_theRenderResources->InternShader("Data/Shaders/Skybox");
+	m_skyboxTexture = g_theRenderResources->InternSkyboxTexture(
+		"LightSkybox",
+		"Data/Images/frontlabeled.png",
+		"Data/Images/backlabeled.png",
+		"Data/Images/leftlabeled.png",
+		"Data/Images/rightlabeled.png",
+		"Data/Images/toplabeled.png",
+		"Data/Images/bottomlabeled.png"
+	);
+	std::vector<Vertex_PCU> cubeVerts;
+	AddVertsForAABB3D(cubeVerts, AABB3(Vec3(-1.f, -1.f, -1.f), Vec3(1.f, 1.f, 1.f)));
+	m_skyboxMesh = g_theRenderResources->InternStaticMesh("SkyboxCube", cubeVerts);
+
+	ParticleWorldConfig particleWorldConfig;
+	particleWorldConfig.m_maxParticles = g_gameConfigBlackboard.GetValue("maxCPUParticles", 0);
+	particleWorldConfig.m_numPools = g_gameConfigBlackboard.GetValue("cpuParticlePools", 1);
+	particleWorldConfig.m_renderer = g_theRenderer;
+	particleWorldConfig.m_sharedJobSystem = g_theJobSystem;
+	particleWorldConfig.m_numDedicatedWorkerThreads = g_gameConfigBlackboard.GetValue("particleWorkerThreads", 0);
+	particleWorldConfig.m_occlusionBufferSize.x = g_gameConfigBlackboard.GetValue("particleOcclusionWidth", 0);
+	particleWorldConfig.m_occlusionBufferSize.y = g_gameConfigBlackboard.GetValue("particleOcclusionHeight", 0);
+	particleWorldConfig.m_maxBatchedParticles = g_gameConfigBlackboard.GetValue("maxBatchedParticles", 0);
+	particleWorldConfig.m_qualityFrameBudgetMs = g_gameConfigBlackboard.GetValue("particleFrameBudgetMs", 0.f);
+	bool isSortCoherent = g_gameConfigBlackboard.GetValue("particleSortCoherent", true);
+	particleWorldConfig.m_sortSettings.m_mode = isSortCoherent ? ParticleSortMode::COHERENT : ParticleSortMode::FULL;
+	particleWorldConfig.m_sortSettings.m_maxRepairMovesPerQuad = g_gameConfigBlackboard.GetValue("particleSortMaxRepairMoves", particleWorldConfig.m_sortSettings.m_maxRepairMovesPerQuad);
+	particleWorldConfig.m_sortSettings.m_isGlobalOrderEnabled = g_gameConfigBlackboard.GetValue("particleSortGlobalOrder", true);
+	particleWorldConfig.m_isCompactInstanceStreamEnabled = g_gameConfigBlackboard.GetValue("particleCompactInstances", false);
+	particleWorldConfig.m_atlasPath = g_gameConfigBlackboard.GetValue("particleAtlas", "");
+	m_particleWorld = new ParticleWorld(particleWorldConfig);
+	m_particleWorld->Startup();
+	m_particleWorld->SetInstanceCapture(m_particleCapture);
+	if (!m_isHeadless)
+		DebugAddWorldBasis(Mat44(), -1.f, Rgba8::WHITE, Rgba8::WHITE, DebugRenderMode::USEDEPTH);
 
 	m_player = new Player(this, Vec3());
 	m_player->m_position = Vec3(-10.f, -10.f, 10.f);
@@ -65,14 +127,18 @@ void Game::Startup()
 
 	Mat44 transMat = (Mat44::CreateTranslation3D(Vec3(3.f, 0.f, 1.f)));
 	transMat.Append(m_worldCamera.GetViewToRenderMatrix());
-	DebugAddWorldBasis(transMat, -1, Rgba8::WHITE, Rgba8::WHITE, DebugRenderMode::USEDEPTH);
+	if (!m_isHeadless)
+		DebugAddWorldBasis(transMat, -1, Rgba8::WHITE, Rgba8::WHITE, DebugRenderMode::USEDEPTH);
 }
 
 void Game::ShutDown()
 {
-	//clean up any running jobs in the job system
-	CleanUpJobs();
+	delete m_zoo;
+	m_zoo = nullptr;
+	m_particleWorld->GetReclaimer()->Retire(m_particleSystemBeingEdited);
+	m_particleSystemBeingEdited = nullptr;
 
+	//entities unregister their occluders from the particle world, so they go before it
 	for (int i = 0; i < m_allEntities.size(); i++)
 	{
 		if (m_allEntities[i])
@@ -82,14 +148,20 @@ void Game::ShutDown()
 		}
 	}
 	m_allEntities.clear();
-
-	g_theParticlesManager->KillAllParticleSystems();
-	m_particleSystemBeingEdited = nullptr;
-	delete m_zoo;
-	m_zoo = nullptr;
-
 	m_cube = nullptr;
 	m_player = nullptr;
+
+	//clean up any running jobs in the job system
+	m_particleWorld->Shutdown();
+	delete m_particleWorld;
+	m_particleWorld = nullptr;
+	delete m_renderQueue;
+	m_renderQueue = nullptr;
+	delete m_renderBackend;
+	m_renderBackend = nullptr;
+	m_headlessBackend = nullptr;
+	delete m_particleCapture;
+	m_particleCapture = nullptr;
 }
 
 void Game::Update(float deltaSeconds)
@@ -101,23 +173,37 @@ void Game::Update(float deltaSeconds)
 		return;
 	}
 
+	m_particleWorld->BeginFrame();
 	m_anyInputFieldActive = false;
-	HandleMouseCursor();
+
+	//a headless game has no window or input, its mode is only ever set by whoever runs it
+	if (!m_isHeadless)
+		HandleMouseCursor();
 	ChangeMode();
 	if (m_currentGamemode == GameMode::ATTRACT)
 	{
 		m_screenCamera.SetOrthoView(Vec2(0.f, 0.f), Vec2(m_uiScreenSize.x, m_uiScreenSize.y));
-		HandleAttractModeInput();
+		if (!m_isHeadless)
+			HandleAttractModeInput();
 		UpdateAttractMode(deltaSeconds);
 	}
 	else
 	{
-		m_worldCamera.SetPerspectiveView(g_theWindow->GetConfig().m_clientAspect, worldCamFov, worldCamNearZ, worldCamFarZ);
-		HandleDebugInput();
-		HandleGameInput();
+		m_worldCamera.SetPerspectiveView(GetClientAspect(), worldCamFov, worldCamNearZ, worldCamFarZ);
+		if (!m_isHeadless)
+		{
+			HandleDebugInput();
+			HandleGameInput();
+		}
 		//UpdateSphere(deltaSeconds);
 		UpdateEntities(deltaSeconds);
+
+		//the player has placed the camera for this frame, particle lod and culling both work from it
+		ParticleFrustum frustum = ParticleFrustum::CreateFromCamera(m_worldCamera, worldCamFov, GetClientAspect(), worldCamNearZ, worldCamFarZ);
+		m_particleWorld->SetViewFrustum(frustum);
+		m_particleWorld->SetScreenSize(GetClientDimensions());		//pixels of the render target, not the ui's virtual screen
 		UpdateMode(deltaSeconds);
+		m_particleWorld->CullBatchedEffects();
 	}
 
 	DisablePlayerInputIfRequired();
@@ -125,16 +211,23 @@ void Game::Update(float deltaSeconds)
 
 void Game::Render() 
 {
+	ScopedMemoryCategory renderScope(MemoryCategory::RENDER);
+	if (m_isHeadless)
+	{
+		RenderHeadless();
+		return;
+	}
+
+	m_renderQueue->BeginFrame();
 	if (m_currentGamemode == GameMode::ATTRACT)
 	{
 		g_theRenderer->BeginCamera(m_screenCamera);
 		{
 			g_theRenderer->ClearScreen(Rgba8::GREY);
-			g_theRenderer->SetBlendMode(BlendMode::ALPHA);
 			g_theRenderer->SetSamplerMode(SamplerMode::POINTCLAMP);
-			g_theRenderer->SetRasterizerState(CullMode::NONE, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
-			g_theRenderer->SetDepthStencilState(DepthTest::ALWAYS, false);
+			m_renderQueue->BeginPass(Vec3());
 			RenderAttractScreen();
+			m_renderQueue->Submit(*m_renderBackend);
 		}
 		g_theRenderer->EndCamera(m_screenCamera);
 	}
@@ -143,11 +236,21 @@ void Game::Render()
 		g_theRenderer->BeginCamera(m_worldCamera);
 		{
 			g_theRenderer->ClearScreen(Rgba8::GREY);
-			RenderSkybox();
 			g_theRenderer->SetSamplerMode(SamplerMode::POINTCLAMP);
+			m_renderQueue->BeginPass(m_worldCamera.GetPosition());
+			RenderSkybox();
+			RenderEntities();
+			if (m_zoo)
+				m_zoo->RenderGeometry();
+			m_renderQueue->Submit(*m_renderBackend);
+
+			//the queue leaves the state of its last draw behind, the direct draws after it start from the world defaults
+			g_theRenderer->SetBlendMode(BlendMode::ALPHA);
+			g_theRenderer->BindShaderByName("Default");
+			g_theRenderer->SetModelMatrix(Mat44::IDENTITY);
+			g_theRenderer->SetModelColor(Rgba8::WHITE);
 			g_theRenderer->SetRasterizerState(CullMode::BACK, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
 			g_theRenderer->SetDepthStencilState(DepthTest::LESSEQUAL, true);
-			RenderEntities();
 			DebugRenderWorld(m_worldCamera);
 			RenderMode();
 		}
@@ -155,8 +258,10 @@ void Game::Render()
 
 		g_theRenderer->BeginCamera(m_screenCamera);
 		{
+			m_renderQueue->BeginPass(Vec3());
 			RenderDebugStats();
 			RenderControls();
+			m_renderQueue->Submit(*m_renderBackend);
 			DebugRenderScreen(m_screenCamera);
 		}
 		g_theRenderer->EndCamera(m_screenCamera);
@@ -164,6 +269,7 @@ void Game::Render()
 
 	g_theRenderer->BeginCamera(m_screenCamera);
 	{
+		ScopedMemoryCategory consoleScope(MemoryCategory::CONSOLE);
 		g_theRenderer->SetSamplerMode(SamplerMode::POINTCLAMP);
 		g_theRenderer->SetRasterizerState(CullMode::NONE, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
 		g_theRenderer->SetDepthStencilState(DepthTest::ALWAYS, false);
@@ -172,8 +278,46 @@ void Game::Render()
 	g_theRenderer->EndCamera(m_screenCamera);
 }
 
+//the queued passes and the batched particles are recorded and submitted as usual into a backend that only counts, while
+//the particles manager, the console and debug render, which draw straight to the gpu, are skipped
+void Game::RenderHeadless()
+{
+	m_headlessBackend->ResetCounts();
+	if (m_particleCapture)
+		m_particleCapture->Clear();
+
+	m_renderQueue->BeginFrame();
+	if (m_currentGamemode == GameMode::ATTRACT)
+	{
+		m_renderQueue->BeginPass(Vec3());
+		RenderAttractScreen();
+		m_renderQueue->Submit(*m_renderBackend);
+		return;
+	}
+
+	m_renderQueue->BeginPass(m_worldCamera.GetPosition());
+	RenderSkybox();
+	RenderEntities();
+	if (m_zoo)
+		m_zoo->RenderGeometry();
+	m_renderQueue->Submit(*m_renderBackend);
+	RenderMode();
+
+	m_renderQueue->BeginPass(Vec3());
+	RenderDebugStats();
+	RenderControls();
+	m_renderQueue->Submit(*m_renderBackend);
+}
+
+void Game::EndFrame()
+{
+	m_particleWorld->EndFrame();
+}
+
+#if !defined(GAME_HEADLESS_ONLY)
 void Game::UpdateImGUIWindows()
 {
+	ScopedMemoryCategory editorScope(MemoryCategory::EDITOR);
 	if (m_showImguiDemoWindow)
 		ImGui::ShowDemoWindow(&m_showImguiDemoWindow);
 
@@ -182,28 +326,59 @@ void Game::UpdateImGUIWindows()
 		if (m_editorWindow)
 		{
 			m_editorWindow->UpdateWindow();
+			UpdateSystemFromEditor();
 		}
 
 		CreateOrLoadParticleEffectWindow();
 	}
 }
 
+void Game::UpdateSystemFromEditor()
+{
+	if (m_editorWindow->RespawnSystem())
+	{
+		m_particleWorld->GetReclaimer()->Retire(m_particleSystemBeingEdited);
+		m_particleSystemBeingEdited = SpawnParticleSystem(m_effectPath.c_str(), Vec3(5.f, 5.f, 0.f), true, m_gpuParticles);
+	}
+
+	//update particle system with new data from the editor
+	if (m_editorWindow->IsEditorDataDirty())
+	{
+		if (m_particleSystemBeingEdited)
+		{
+			m_particleSystemBeingEdited->UpdateEmitterData(m_editorWindow->GetLatestEmitterData());
+			m_particleSystemBeingEdited->SetPosition(m_editorWindow->m_particleSystemPos);
+		}
+		m_editorWindow->SetEditorDataDirty(false);
+	}
+}
+
+const char* Game::GetGameModeName(GameMode mode)
+{
+	switch (mode)
+	{
+	case GameMode::ATTRACT: return "Attract";
+	case GameMode::EDITOR: return "Editor";
+	case GameMode::ZOO: return "Zoo";
+	case GameMode::COMBO_ZOO: return "Combo Zoo";
+	case GameMode::CPU_PERF_ZOO: return "CPU Perf Zoo";
+	case GameMode::GPU_PERF_ZOO: return "GPU Perf Zoo";
+	}
+	return "";
+}
+
 void Game::RenderDebugStats() const
 {
 	/*if (!m_particleSystemBeingEdited)
 		return;*/
-	std::string modeString;
-	switch (m_currentGamemode)
-	{
-	case GameMode::ATTRACT: modeString = "Attract"; break;
-	case GameMode::EDITOR: modeString = "Editor"; break;
-	case GameMode::ZOO: modeString = "Zoo"; break;
-	case GameMode::COMBO_ZOO: modeString = "Combo Zoo"; break;
-	case GameMode::CPU_PERF_ZOO: modeString = "CPU Perf Zoo"; break;
-	case GameMode::GPU_PERF_ZOO: modeString = "GPU Perf Zoo"; break;
-	}
+	//a headless game has no font to lay the text out with
+	BitmapFont* font = g_theRenderResources->GetFont(m_debugFont);
+	if (!font)
+		return;
 
-	ParticlesDebugData debugData = g_theParticlesManager->GetDebugData();
+	std::string modeString = GetGameModeName(m_currentGamemode);
+
+	ParticlesDebugData debugData = m_particleWorld->GetParticlesManager()->GetDebugData();
 	std::string debugString;
 	debugString.append(Stringf("Mode = %s\n", modeString.c_str()));
 	debugString.append(Stringf("Max Particles = %d\n", debugData.m_maxParticles));
@@ -212,6 +387,16 @@ void Game::RenderDebugStats() const
 	debugString.append(Stringf("Total Alive Particles = %d\n", debugData.m_aliveParticles));
 	debugString.append(Stringf("Num CPU systems = %d\n", debugData.m_numCPUsystems));
 	debugString.append(Stringf("Num GPU systems = %d\n", debugData.m_numGPUsystems));
+	debugString.append(Stringf("Pooled systems active/free = %d/%d, refused one-shots = %d\n", m_particleWorld->GetSystemPool()->GetNumActiveInstances(), m_particleWorld->GetSystemPool()->GetNumFreeInstances(), m_particleWorld->GetSystemPool()->GetNumRefusedOneShots()));
+	debugString.append(Stringf("Retired systems = %d\n", m_particleWorld->GetReclaimer()->GetNumRetiredSystems()));
+	debugString.append(Stringf("Batched instances visible/culled/dormant/impostor = %d/%d/%d/%d\n", m_particleWorld->GetNumVisibleInstances(), m_particleWorld->GetNumCulledInstances(), m_particleWorld->GetNumDormantInstances(), m_particleWorld->GetNumImpostorInstances()));
+	debugString.append(Stringf("Batched instances occluded = %d\n", m_particleWorld->GetNumOccludedInstances()));
+	debugString.append(Stringf("Screen culled sub-pixel/tile cap = %d/%d\n", m_particleWorld->GetScreenCullStats().m_numSubPixelCulled, m_particleWorld->GetScreenCullStats().m_numTileCapCulled));
+	debugString.append(Stringf("Particle quality = %.2f (%.2f ms)\n", m_particleWorld->GetQualityController()->GetQuality(), m_particleWorld->GetQualityController()->GetSmoothedWorkMs()));
+	if (ParticleBudgetManager* budget = m_particleWorld->GetBudgetManager())
+		debugString.append(Stringf("Budget throttled effects/evicted = %d/%d\n", budget->GetNumThrottledEffects(), budget->GetNumEvictedParticles()));
+	const RenderQueueStats& queueStats = m_renderQueue->GetLastFrameStats();
+	debugString.append(Stringf("Queued draws/state changes = %d/%d, %d unsorted\n", queueStats.m_numCommands, queueStats.m_numStateChanges, queueStats.m_numUnsortedStateChanges));
 	Clock& gameClock = g_theApp->GetGameClock();
 	debugString.append(Stringf("dt = %.2f ms, fps = %.2f", gameClock.GetDeltaTime() * 1000.f, 1 / gameClock.GetDeltaTime()));
 
@@ -219,14 +404,16 @@ void Game::RenderDebugStats() const
 	Vec2 textBoxDimensions = Vec2(400.f, 500.f);	 //magic numbers
 	AABB2 textBoxBounds = AABB2(Vec2(m_uiScreenSize.x - textBoxDimensions.x, 0.f), Vec2(m_uiScreenSize.x, textBoxDimensions.y));	//bottom right
 	Vec2 textAlignment = Vec2(1.f, 0.f);
-	BitmapFont* font = g_theRenderer->CreateOrGetBitmapFont("Data/Fonts/MyFixedFont");
 	font->AddVertsForTextInBox2D(textVerts, textBoxBounds, 20.f, debugString, Rgba8::WHITE, 0.8f, textAlignment);
-	g_theRenderer->BindTexture(&font->GetTexture());
-	g_theRenderer->DrawVertexArray((int)textVerts.size(), textVerts.data());
+	m_renderQueue->DrawVertexArray(RenderLayer::OVERLAY, GetOverlayTextState(&font->GetTexture()), (int)textVerts.size(), textVerts.data());
 }
 
 void Game::RenderControls() const
 {
+	BitmapFont* font = g_theRenderResources->GetFont(m_debugFont);
+	if (!font)
+		return;
+
 	std::string controlsString = " F1 - toggle mouse, F3 - toggle cpu/gpu particles, Left/Right Arrow - Prev/Next Mode ";
 
 	std::vector<Vertex_PCU> textVerts;
@@ -234,42 +421,27 @@ void Game::RenderControls() const
 	Vec2 mins = Vec2(0.f, m_uiScreenSize.y - textBoxDimensions.y);
 	AABB2 textBoxBounds = AABB2(mins, mins + textBoxDimensions);	//bottom right
 	Vec2 textAlignment = Vec2(0.f, 1.f);
-	BitmapFont* font = g_theRenderer->CreateOrGetBitmapFont("Data/Fonts/MyFixedFont");
 	font->AddVertsForTextInBox2D(textVerts, textBoxBounds, 20.f, controlsString, Rgba8::WHITE, 0.8f, textAlignment);
-	g_theRenderer->BindTexture(&font->GetTexture());
-	g_theRenderer->DrawVertexArray((int)textVerts.size(), textVerts.data());
-}
-
-void Game::CleanUpJobs()
-{
-	if (g_theJobSystem)
-	{
-		g_theJobSystem->CancelAllJobs();
-
-		//block until all jobs are finished
-		/*while (g_theJobSystem->GetNumQueuedJobs() > 0 && g_theJobSystem->GetNumExecutingJobs() > 0)
-			;*/
-
-		//retrieve and delete all finished jobs
-		/*Job* finishedJob = g_theJobSystem->RetrieveFinishedJob();
-		while (finishedJob)
-		{
-			delete finishedJob;
-			finishedJob = g_theJobSystem->RetrieveFinishedJob();
-		}*/
-	}
+	m_renderQueue->DrawVertexArray(RenderLayer::OVERLAY, GetOverlayTextState(&font->GetTexture()), (int)textVerts.size(), textVerts.data());
 }
 
 ParticleSystem* Game::SpawnParticleSystem(const char* filepath, const Vec3& worldPosition, bool withEditorWindow, bool gpuParticles, bool defaultSystem)
 {
-	ParticleSystem* spawnedSystem = g_theParticlesManager->CreateParticleSystem(filepath, worldPosition, gpuParticles, defaultSystem);
+	//headless there is no renderer, so no engine system and no editor to show it in
+	ParticleSystem* spawnedSystem = m_particleWorld->CreateEngineSystem(filepath, worldPosition, gpuParticles, defaultSystem);
+	if (!spawnedSystem)
+		return nullptr;
 
+#if !defined(GAME_HEADLESS_ONLY)
 	if (withEditorWindow)
 	{
 		if (m_editorWindow)
 			delete m_editorWindow;
  		m_editorWindow = new ParticleEditor(this, spawnedSystem->GetEmitterDataForAllEmitters(), filepath);
 	}
+#else
+	UNUSED(withEditorWindow);
+#endif
 
 	bool gpuDebug = g_gameConfigBlackboard.GetValue("gpuParticlesStepUpdate", false);
 	if (gpuDebug)
@@ -278,6 +450,31 @@ ParticleSystem* Game::SpawnParticleSystem(const char* filepath, const Vec3& worl
 	return spawnedSystem;
 }
 
+//switches right away instead of with the next update, so the next frame is the first one of the new mode
+void Game::SetGameMode(GameMode mode)
+{
+	m_nextGamemode = mode;
+	ChangeMode();
+}
+
+float Game::GetClientAspect() const
+{
+#if !defined(GAME_HEADLESS_ONLY)
+	if (!m_isHeadless)
+		return g_theWindow->GetConfig().m_clientAspect;
+#endif
+	return float(m_headlessClientDimensions.x) / float(m_headlessClientDimensions.y);
+}
+
+IntVec2 Game::GetClientDimensions() const
+{
+#if !defined(GAME_HEADLESS_ONLY)
+	if (!m_isHeadless)
+		return g_theWindow->GetClientDimensions();
+#endif
+	return m_headlessClientDimensions;
+}
+
 void Game::ChangeMode()
 {
 	if (m_nextGamemode != m_currentGamemode)
@@ -287,7 +484,7 @@ void Game::ChangeMode()
 		{
 		case GameMode::EDITOR:
 		{
-			g_theParticlesManager->KillParticleSystem(m_particleSystemBeingEdited);
+			m_particleWorld->GetReclaimer()->Retire(m_particleSystemBeingEdited);
 			m_particleSystemBeingEdited = nullptr;
 			break;
 		}
@@ -395,7 +592,7 @@ void Game::CreateOrLoadParticleEffectWindow()
 			if (m_effectPath == "")
 				m_effectPath = TEST_PARTICLE_EFFECT_PATH;
 
-			g_theParticlesManager->KillParticleSystem(m_particleSystemBeingEdited);
+			m_particleWorld->GetReclaimer()->Retire(m_particleSystemBeingEdited);
 			m_particleSystemBeingEdited = SpawnParticleSystem(m_effectPath.c_str(), Vec3::ZERO, true, m_gpuParticles);
 		}
 		ImGui::InputText("New effect name", m_newEffectName, sizeof(m_newEffectName));
@@ -409,7 +606,7 @@ void Game::CreateOrLoadParticleEffectWindow()
 		{
 			if (ImGui::Button("Create New Effect"))
 			{
-				g_theParticlesManager->KillParticleSystem(m_particleSystemBeingEdited);
+				m_particleWorld->GetReclaimer()->Retire(m_particleSystemBeingEdited);
 				m_particleSystemBeingEdited = SpawnParticleSystem(newEffectPath.c_str(), Vec3::ZERO, true, m_gpuParticles, true);
 				memset(m_newEffectName, '\0', sizeof(m_newEffectName));
 				m_effectPath = newEffectPath;
@@ -427,6 +624,20 @@ void Game::CreateOrLoadParticleEffectWindow()
 	}
 	ImGui::End();
 }
+#else
+//headless only builds leave imgui and the editor out
+void Game::UpdateImGUIWindows()
+{
+}
+
+void Game::UpdateSystemFromEditor()
+{
+}
+
+void Game::CreateOrLoadParticleEffectWindow()
+{
+}
+#endif
 
 void Game::SetActiveInputField()
 {
@@ -435,6 +646,7 @@ void Game::SetActiveInputField()
 
 void Game::HandleMouseCursor()
 {
+#if !defined(GAME_HEADLESS_ONLY)
 	bool gameWindowFocused = g_theWindow->HasFocus();
 	if (gameWindowFocused && m_restrictMouse)
 	{
@@ -454,6 +666,7 @@ void Game::HandleMouseCursor()
 			}
 		}
 	}
+#endif
 }
 
 void Game::HandleAttractModeInput()
@@ -503,7 +716,7 @@ void Game::HandleGameInput()
 
 		if (m_currentGamemode == GameMode::EDITOR)
 		{
-			m_particleSystemBeingEdited = g_theParticlesManager->ChangeParticleSystemType(m_particleSystemBeingEdited);
+			m_particleSystemBeingEdited = m_particleWorld->ChangeEngineSystemType(m_particleSystemBeingEdited);
 		}
 		else if (m_currentGamemode == GameMode::ZOO)
 		{
@@ -573,8 +786,17 @@ void Game::RenderAttractScreen() const
 	}
 
 	TransformVertexArrayXY3D(3, tempCopyOfBlinkingTriangle, 25.f, 0.f, Vec2(m_uiScreenSize.x * 0.5f, m_uiScreenSize.y * 0.5f));
-	g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->DrawVertexArray(3, tempCopyOfBlinkingTriangle);
+	m_renderQueue->DrawVertexArray(RenderLayer::OVERLAY, GetOverlayTextState(nullptr), 3, tempCopyOfBlinkingTriangle);
+}
+
+RenderState Game::GetOverlayTextState(const Texture* texture) const
+{
+	RenderState state;
+	state.m_cullMode = CullMode::NONE;
+	state.m_depthTest = DepthTest::ALWAYS;
+	state.m_isDepthWriteEnabled = false;
+	state.m_texture = texture;
+	return state;
 }
 
 void Game::UpdateAttractMode(float deltaSeconds)
@@ -601,32 +823,15 @@ void Game::UpdateEntities(float deltaSeconds)
 
 void Game::UpdateMode(float deltaSeconds)
 {
+	ScopedMemoryCategory particlesScope(MemoryCategory::PARTICLES);
 	switch (m_currentGamemode)
 	{
 	case GameMode::EDITOR:
 	{
-		UpdateImGUIWindows();
-
-		if (m_editorWindow->RespawnSystem())
-		{
-			g_theParticlesManager->KillParticleSystem(m_particleSystemBeingEdited);
-			m_particleSystemBeingEdited = SpawnParticleSystem(m_effectPath.c_str(), Vec3(5.f, 5.f, 0.f), true, m_gpuParticles);
-		}
-
-		//update particle system with new data from the editor
-		if (m_editorWindow->IsEditorDataDirty())
-		{
-			if (m_particleSystemBeingEdited)
-			{
-				m_particleSystemBeingEdited->UpdateEmitterData(m_editorWindow->GetLatestEmitterData());
-				m_particleSystemBeingEdited->SetPosition(m_editorWindow->m_particleSystemPos);
-			}
-			m_editorWindow->SetEditorDataDirty(false);
-		}
+		if (!m_isHeadless)
+			UpdateImGUIWindows();
 
-		Vec3 currPos = m_particleSystemBeingEdited->GetPosition();
-		m_particleSystemBeingEdited->SetPosition(currPos + Vec3(0.f, -1.f, 0.f) * deltaSeconds * 0.f);
-		g_theParticlesManager->UpdateParticleSystems(deltaSeconds, m_worldCamera);
+		m_particleWorld->UpdateParticleSystems(deltaSeconds, m_worldCamera);
 		break;
 	}
 	case GameMode::COMBO_ZOO:
@@ -653,11 +858,12 @@ void Game::RenderEntities() const
 
 void Game::RenderMode() const
 {
+	ScopedMemoryCategory particlesScope(MemoryCategory::PARTICLES);
 	switch (m_currentGamemode)
 	{
 	case GameMode::EDITOR:
 	{
-		g_theParticlesManager->RenderParticleSystems(m_worldCamera);
+		m_particleWorld->RenderEngineSystems(m_worldCamera);
 		break;
 	}
 	case GameMode::COMBO_ZOO:
@@ -723,7 +929,9 @@ void Game::AddGridLines()
 	AddVertsForQuad3D(verts, Vec3(quad.m_mins.x, quad.m_maxs.y, 0.f), Vec3(quad.m_mins.x, quad.m_mins.y, 0.f), Vec3(quad.m_maxs.x, quad.m_mins.y, 0.f),
 		Vec3(quad.m_maxs.x, quad.m_maxs.y, 0.f), Rgba8(165, 42, 42, 255));
 
+	//the ground hides every particle below it from a camera above it
 	Prop* gridLines = new Prop(this, verts, nullptr);
+	gridLines->SetIsParticleOccluder(m_particleWorld, true);
 	m_allEntities.push_back(gridLines);
 }
 
@@ -732,6 +940,26 @@ Camera& Game::GetWorldCamera()
 	return m_worldCamera;
 }
 
+ParticleWorld* Game::GetParticleWorld() const
+{
+	return m_particleWorld;
+}
+
+ParticlesManager* Game::GetParticlesManager() const
+{
+	return m_particleWorld->GetParticlesManager();
+}
+
+ParticleSystemPool* Game::GetParticleSystemPool() const
+{
+	return m_particleWorld->GetSystemPool();
+}
+
+ParticleSystemReclaimer* Game::GetParticleSystemReclaimer() const
+{
+	return m_particleWorld->GetReclaimer();
+}
+
 bool Game::ControlsCommand(EventArgs& args)
 {
 	UNUSED(args);
@@ -757,27 +985,14 @@ void Game::DisablePlayerInputIfRequired()
 
 void Game::RenderSkybox() const
 {
-	std::vector<Vertex_PCU> cubeVerts;
-	AddVertsForAABB3D(cubeVerts, AABB3(Vec3(-1.f, -1.f, -1.f), Vec3(1.f, 1.f, 1.f)));
-	Shader* skyboxShader = g_theRenderer->CreateOrGetShader("Data/Shaders/Skybox");
-	g_theRenderer->BindShader(skyboxShader);
-
-	Texture* skyboxTexture = g_theRenderer->CreateSkyboxTexture(
-		"LightSkybox", 
-		"Data/Images/frontlabeled.png",
-		"Data/Images/backlabeled.png",
-		"Data/Images/leftlabeled.png",
-		"Data/Images/rightlabeled.png",
-		"Data/Images/toplabeled.png",
-		"Data/Images/bottomlabeled.png"
-	);
-
-	g_theRenderer->SetModelMatrix(Mat44::CreateTranslation3D(m_worldCamera.GetPosition()));
-	g_theRenderer->SetDepthStencilState(DepthTest::LESSEQUAL, false);
-	g_theRenderer->SetRasterizerState(CullMode::NONE, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
-	g_theRenderer->BindTexture(skyboxTexture);
-	g_theRenderer->DrawVertexArray((int)cubeVerts.size(), cubeVerts.data());
-	g_theRenderer->BindShaderByName("Default");
+	RenderState state;
+	state.m_shader = g_theRenderResources->GetShader(m_skyboxShader);
+	state.m_texture = g_theRenderResources->GetTexture(m_skyboxTexture);
+	state.m_cullMode = CullMode::NONE;
+	state.m_isDepthWriteEnabled = false;
+	state.m_modelMatrix = Mat44::CreateTranslation3D(m_worldCamera.GetPosition());
+	const StaticMesh& cube = g_theRenderResources->GetStaticMesh(m_skyboxMesh);
+	m_renderQueue->DrawVertexBuffer(RenderLayer::SKYBOX, state, cube.m_vertexBuffer, cube.m_numVerts);
 }
 
 bool Game::IsPlayerInputDisabled() const
@@ -1,20 +1,26 @@
 #pragma once
 #include "Engine/Renderer/Camera.hpp"
+#include "Engine/Math/IntVec2.hpp"
 #include "Engine/Core/Vertex_PCU.hpp"
 #include "Engine/Core/Stopwatch.hpp"
 #include "Engine/Core/Clock.hpp"
 #include "Engine/Core/EventSystem.hpp"
 #include "Game/GameCommon.hpp"
-#include "Game/ParticleEditorBaseModule.hpp"
-#include "Game/ParticleEditorShapeModule.hpp"
-#include "Game/CurveEditor.hpp"
+#include "Game/RenderCommandQueue.hpp"
+#include "Game/RenderResourceTable.hpp"
 
 class Entity;
 class Prop;
 class Player;
 class ParticleEmitter;
+class ParticleSystem;
 class ParticleEditor;
 class Zoo;
+class ParticleSystemPool;
+class ParticleSystemReclaimer;
+class ParticleWorld;
+class ParticlesManager;
+class ParticleInstanceCapture;
 
 enum class GameMode
 {
@@ -33,8 +39,21 @@ public:
 	void Startup();
 	void Update(float deltaSeconds);
 	void Render();
+	void EndFrame();
 	void ShutDown();
 	Camera& GetWorldCamera();
+	ParticleWorld* GetParticleWorld() const;
+	ParticlesManager* GetParticlesManager() const;
+	ParticleSystemPool* GetParticleSystemPool() const;
+	ParticleSystemReclaimer* GetParticleSystemReclaimer() const;
+	RenderCommandQueue* GetRenderQueue() const { return m_renderQueue; }
+	RenderBackend* GetRenderBackend() const { return m_renderBackend; }
+	bool IsHeadless() const { return m_isHeadless; }
+	void SetGameMode(GameMode mode);
+	GameMode GetGameMode() const { return m_currentGamemode; }
+	const RenderBackendCounts& GetHeadlessRenderCounts() const { return m_headlessBackend->GetCounts(); }
+	const ParticleInstanceCapture* GetParticleCapture() const { return m_particleCapture; }
+	static const char* GetGameModeName(GameMode mode);
 	static bool ControlsCommand(EventArgs& args);
 	
 	bool IsPlayerInputDisabled() const;
@@ -64,6 +83,17 @@ private:
 	GameMode m_currentGamemode = GameMode::ATTRACT;
 	GameMode m_nextGamemode = GameMode::ATTRACT;
 	Zoo* m_zoo = nullptr;
+	ParticleWorld* m_particleWorld = nullptr;
+	RenderCommandQueue* m_renderQueue = nullptr;
+	RenderBackend* m_renderBackend = nullptr;
+	bool m_isHeadless = false;
+	CountingRenderBackend* m_headlessBackend = nullptr;		//the render backend of a headless game, nothing is drawn
+	IntVec2 m_headlessClientDimensions = IntVec2(1600, 800);	//the render target a headless game culls and lods for
+	ParticleInstanceCapture* m_particleCapture = nullptr;
+	FontHandle m_debugFont;
+	ShaderHandle m_skyboxShader;
+	TextureHandle m_skyboxTexture;
+	StaticMeshHandle m_skyboxMesh;
 	Prop* sphere = nullptr;
 	bool m_anyInputFieldActive = false;
 
@@ -90,9 +120,10 @@ private:
 	void AddSphereProp();
 	void AddGridLines();
 	void UpdateImGUIWindows();
+	void UpdateSystemFromEditor();
 	void RenderDebugStats() const;
 	void RenderControls() const;
-	void CleanUpJobs();
+	RenderState GetOverlayTextState(const Texture* texture) const;
 	ParticleSystem* SpawnParticleSystem(const char* filepath, const Vec3& worldPosition, bool withEditorWindow, bool gpuParticles, bool defaultSystem = false);
 	void ChangeMode();
 	void SetupEditorMode();
@@ -103,4 +134,7 @@ private:
 	void CreateOrLoadParticleEffectWindow();
 	void DisablePlayerInputIfRequired();
 	void RenderSkybox() const;
+	void RenderHeadless();
+	float GetClientAspect() const;
+	IntVec2 GetClientDimensions() const;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <math.h>
+#include <string.h>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Game/GameTest.hpp"
+
+struct RegisteredGameTest
+{
+	const char* m_name = nullptr;
+	GameTestFunction m_function = nullptr;
+};
+
+//function local, so registrars in other files can run before the statics of this one are initialized
+static std::vector<RegisteredGameTest>& GetRegisteredTests()
+{
+	static std::vector<RegisteredGameTest> tests;
+	return tests;
+}
+
+static bool Command_RunTests(EventArgs& args)
+{
+	std::string filter = args.GetValue("filter", "");
+	std::vector<GameTestResult> results;
+	int numFailed = GameTestRegistry::RunAll(filter.c_str(), results);
+	for (int resultIndex = 0; resultIndex < int(results.size()); resultIndex++)
+	{
+		const GameTestResult& result = results[resultIndex];
+		bool hasPassed = result.m_failures.empty();
+		g_theConsole->AddLine(hasPassed ? g_theConsole->COMMAND : g_theConsole->INFO_ERROR, Stringf("%s %s", hasPassed ? "PASS" : "FAIL", result.m_name.c_str()));
+		for (int i = 0; i < int(result.m_failures.size()); i++)
+		{
+			g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("    %s", result.m_failures[i].c_str()));
+		}
+	}
+	g_theConsole->AddLine(numFailed == 0 ? g_theConsole->COMMAND : g_theConsole->INFO_ERROR, Stringf("%d of %d tests failed", numFailed, int(results.size())));
+	return true;
+}
+
+void GameTestContext::Check(bool condition, const char* expression, const char* file, int line)
+{
+	if (!condition)
+		m_failures.push_back(Stringf("%s(%d): %s", file, line, expression));
+}
+
+void GameTestContext::CheckNear(float value, float expected, float tolerance, const char* expression, const char* file, int line)
+{
+	if (!(fabsf(value - expected) <= tolerance))
+		m_failures.push_back(Stringf("%s(%d): %s is %g, expected %g within %g", file, line, expression, value, expected, tolerance));
+}
+
+void GameTestRegistry::Startup()
+{
+	SubscribeEventCallbackFunction("tests.run", Command_RunTests);
+}
+
+void GameTestRegistry::Shutdown()
+{
+	UnsubscribeEventCallbackFunction("tests.run", Command_RunTests);
+}
+
+void GameTestRegistry::Register(const char* name, GameTestFunction function)
+{
+	RegisteredGameTest test;
+	test.m_name = name;
+	test.m_function = function;
+	GetRegisteredTests().push_back(test);
+}
+
+//runs every test whose name contains the filter, in registration order
+int GameTestRegistry::RunAll(const char* nameFilter, std::vector<GameTestResult>& out_results)
+{
+	int numFailed = 0;
+	const std::vector<RegisteredGameTest>& tests = GetRegisteredTests();
+	for (int testIndex = 0; testIndex < int(tests.size()); testIndex++)
+	{
+		const RegisteredGameTest& test = tests[testIndex];
+		if (nameFilter && nameFilter[0] != '\0' && !strstr(test.m_name, nameFilter))
+			continue;
+
+		GameTestContext context;
+		test.m_function(context);
+		GameTestResult result;
+		result.m_name = test.m_name;
+		result.m_failures = context.GetFailures();
+		if (!result.m_failures.empty())
+			numFailed++;
+		out_results.push_back(result);
+	}
+	return numFailed;
+}
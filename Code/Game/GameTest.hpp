@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//Collects the failed checks of the test that is running.
+class GameTestContext
+{
+public:
+	void Check(bool condition, const char* expression, const char* file, int line);
+	void CheckNear(float value, float expected, float tolerance, const char* expression, const char* file, int line);
+	const std::vector<std::string>& GetFailures() const { return m_failures; }
+
+private:
+	std::vector<std::string> m_failures;
+};
+
+typedef void (*GameTestFunction)(GameTestContext& context);
+
+struct GameTestResult
+{
+	std::string m_name;
+	std::vector<std::string> m_failures;
+};
+
+//Behaviour tests of the game side systems. Test files register their tests at static init with GAME_TEST, and the
+//whole set runs from the tests.run console command or from a headless run with runTests="true".
+//Tests only touch cpu code, so they run the same on a machine without a gpu.
+class GameTestRegistry
+{
+public:
+	static void Startup();
+	static void Shutdown();
+	static void Register(const char* name, GameTestFunction function);
+	static int RunAll(const char* nameFilter, std::vector<GameTestResult>& out_results);		//returns the number of failed tests
+};
+
+struct GameTestRegistrar
+{
+	GameTestRegistrar(const char* name, GameTestFunction function) { GameTestRegistry::Register(name, function); }
+};
+
+#define GAME_TEST(testName) \
+	static void testName(GameTestContext& context); \
+	static GameTestRegistrar s_##testName##Registrar(#testName, testName); \
+	static void testName(GameTestContext& context)
+
+#define GAME_TEST_CHECK(condition) context.Check((condition), #condition, __FILE__, __LINE__)
+#define GAME_TEST_CHECK_NEAR(value, expected, tolerance) context.CheckNear((value), (expected), (tolerance), #value, __FILE__, __LINE__)
@@ -0,0 +1,42 @@
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/ParticleSystemPool.hpp"
+
+static const char* HEADLESS_TEST_EFFECT_PATH = "Data/ParticleSystemData/Hearts.xml";
+
+GAME_TEST(Headless_EngineSystemsAreSkippedWithoutARenderer)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	GAME_TEST_CHECK(!world->HasEngineSystems());
+
+	//asking for an engine system hands back nothing, and changing or drawing nothing is fine
+	ParticleSystem* system = world->CreateEngineSystem(HEADLESS_TEST_EFFECT_PATH, Vec3::ZERO, false);
+	GAME_TEST_CHECK(system == nullptr);
+	GAME_TEST_CHECK(world->CreateEngineSystem(HEADLESS_TEST_EFFECT_PATH, Vec3::ZERO, true) == nullptr);
+	GAME_TEST_CHECK(world->ChangeEngineSystemType(system) == nullptr);
+	Camera camera;
+	world->RenderEngineSystems(camera);
+
+	//the pool has no manager to spawn with, so one-shots are refused rather than crashing
+	ParticleSystemPool* pool = world->GetSystemPool();
+	pool->Prewarm(HEADLESS_TEST_EFFECT_PATH, 4);
+	GAME_TEST_CHECK(!pool->IsPrewarmed(HEADLESS_TEST_EFFECT_PATH));
+	Vec3 positions[2] = { Vec3::ZERO, Vec3(1.f, 0.f, 0.f) };
+	GAME_TEST_CHECK(pool->SpawnOneShot(HEADLESS_TEST_EFFECT_PATH, positions, 2) == 0);
+	GAME_TEST_CHECK(pool->GetNumRefusedOneShots() == 2);
+	GAME_TEST_CHECK(pool->Acquire(HEADLESS_TEST_EFFECT_PATH, Vec3::ZERO) == nullptr);
+	GAME_TEST_CHECK(pool->GetNumActiveInstances() == 0 && pool->GetNumColdSpawns() == 0);
+
+	for (int frame = 0; frame < 10; frame++)
+	{
+		world->BeginFrame();
+		world->UpdateParticleSystems(0.1f, camera);
+		world->EndFrame();
+	}
+	pool->RetireAllPooledSystems();
+	world->Shutdown();
+	delete world;
+}
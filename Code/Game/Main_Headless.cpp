@@ -0,0 +1,19 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if defined(GAME_HEADLESS_ONLY)
+#include "Game/App.hpp"
+
+extern App* g_theApp;
+
+int main()
+{
+	g_theApp = new App();
+	g_theApp->SetHeadless(true);
+	g_theApp->Startup();
+	int exitCode = g_theApp->RunHeadless();
+	g_theApp->Shutdown();
+	delete g_theApp;
+	g_theApp = nullptr;
+
+	return exitCode;
+}
+#endif
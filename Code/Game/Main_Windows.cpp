@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
 #include <windows.h>			// #include this (massive, platform-specific) header in very few places
 #include <math.h>
@@ -17,14 +19,15 @@ int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR command
 
 	g_theApp = new App();
 	g_theApp->Startup();
-	g_theApp->Run();
+	int exitCode = g_theApp->Run();
 	g_theApp->Shutdown();
 	delete g_theApp;
 	g_theApp = nullptr;
 
 	CoUninitialize();
 
-	return 0;
+	return exitCode;
 }
 
 
+#endif
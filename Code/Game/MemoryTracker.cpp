@@ -0,0 +1,386 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Game/EngineBuildPreferences.hpp"
+#include "Game/MemoryTracker.hpp"
+
+MemoryTracker* g_theMemoryTracker = nullptr;
+
+constexpr int NUM_MEMORY_CATEGORIES = static_cast<int>(MemoryCategory::COUNT);
+constexpr int MAX_CATEGORY_STACK_DEPTH = 32;
+const char* MEMORY_CATEGORY_NAMES[NUM_MEMORY_CATEGORIES] = { "Untagged", "Particles", "Editor", "Render", "Console" };
+
+//counters are plain static storage so they are valid before any constructor runs and never allocate themselves
+static std::atomic<int> s_numAllocations[NUM_MEMORY_CATEGORIES];
+static std::atomic<size_t> s_bytesAllocated[NUM_MEMORY_CATEGORIES];
+static std::atomic<int> s_numFrees[NUM_MEMORY_CATEGORIES];
+static std::atomic<size_t> s_bytesFreed[NUM_MEMORY_CATEGORIES];
+static std::atomic<size_t> s_liveBytes;
+
+thread_local MemoryCategory t_categoryStack[MAX_CATEGORY_STACK_DEPTH];
+thread_local int t_categoryStackDepth = 0;
+
+MemoryCategory MemoryTracker::GetCurrentCategory()
+{
+	if (t_categoryStackDepth <= 0)
+		return MemoryCategory::UNTAGGED;
+
+	int top = t_categoryStackDepth > MAX_CATEGORY_STACK_DEPTH ? MAX_CATEGORY_STACK_DEPTH : t_categoryStackDepth;
+	return t_categoryStack[top - 1];
+}
+
+ScopedMemoryCategory::ScopedMemoryCategory(MemoryCategory category)
+{
+	//deeper scopes than the stack can hold keep reporting the deepest recorded category
+	if (t_categoryStackDepth < MAX_CATEGORY_STACK_DEPTH)
+		t_categoryStack[t_categoryStackDepth] = category;
+	t_categoryStackDepth++;
+}
+
+ScopedMemoryCategory::~ScopedMemoryCategory()
+{
+	t_categoryStackDepth--;
+}
+
+void MemoryTaggedJob::Execute()
+{
+	ScopedMemoryCategory jobScope(m_memoryCategory);
+	ExecuteTagged();
+}
+
+#if defined(ENABLE_MEMORY_TRACKING)
+//every tracked block carries a small header so delete knows the size and category it was charged to.
+//16 bytes keeps the returned pointer aligned to the default new alignment.
+struct alignas(16) AllocationHeader
+{
+	size_t m_size = 0;
+	unsigned int m_category = 0;
+	unsigned int m_guard = 0;
+};
+constexpr unsigned int ALLOCATION_GUARD = 0x4D454D54;	//"MEMT"
+
+static void* TrackedAllocate(size_t size)
+{
+	AllocationHeader* header = static_cast<AllocationHeader*>(malloc(sizeof(AllocationHeader) + size));
+	if (!header)
+		return nullptr;
+
+	int category = static_cast<int>(MemoryTracker::GetCurrentCategory());
+	header->m_size = size;
+	header->m_category = category;
+	header->m_guard = ALLOCATION_GUARD;
+	s_numAllocations[category].fetch_add(1, std::memory_order_relaxed);
+	s_bytesAllocated[category].fetch_add(size, std::memory_order_relaxed);
+	s_liveBytes.fetch_add(size, std::memory_order_relaxed);
+	return header + 1;
+}
+
+static void TrackedFree(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	AllocationHeader* header = static_cast<AllocationHeader*>(ptr) - 1;
+	if (header->m_guard != ALLOCATION_GUARD)
+	{
+		ERROR_AND_DIE("Memory tracker: freeing a block that was not allocated through the tracked operator new");
+	}
+
+	int category = static_cast<int>(header->m_category);
+	s_numFrees[category].fetch_add(1, std::memory_order_relaxed);
+	s_bytesFreed[category].fetch_add(header->m_size, std::memory_order_relaxed);
+	s_liveBytes.fetch_sub(header->m_size, std::memory_order_relaxed);
+	header->m_guard = 0;
+	free(header);
+}
+
+void* operator new(size_t size)
+{
+	void* ptr = TrackedAllocate(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	void* ptr = TrackedAllocate(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	TrackedFree(ptr);
+}
+
+#if defined(__cpp_aligned_new)
+//over-aligned types go through these. The header sits right below the aligned pointer and remembers where the malloc block starts.
+struct AlignedAllocationHeader
+{
+	void* m_block = nullptr;
+	size_t m_size = 0;
+	unsigned int m_category = 0;
+	unsigned int m_guard = 0;
+};
+constexpr unsigned int ALIGNED_ALLOCATION_GUARD = 0x4D454D41;	//"MEMA"
+
+static void* TrackedAllocateAligned(size_t size, std::align_val_t alignment)
+{
+	size_t alignmentBytes = static_cast<size_t>(alignment);
+	void* block = malloc(sizeof(AlignedAllocationHeader) + alignmentBytes - 1 + size);
+	if (!block)
+		return nullptr;
+
+	uintptr_t firstUsable = reinterpret_cast<uintptr_t>(block) + sizeof(AlignedAllocationHeader);
+	uintptr_t aligned = (firstUsable + alignmentBytes - 1) & ~(uintptr_t(alignmentBytes) - 1);
+	AlignedAllocationHeader* header = reinterpret_cast<AlignedAllocationHeader*>(aligned) - 1;
+	int category = static_cast<int>(MemoryTracker::GetCurrentCategory());
+	header->m_block = block;
+	header->m_size = size;
+	header->m_category = category;
+	header->m_guard = ALIGNED_ALLOCATION_GUARD;
+	s_numAllocations[category].fetch_add(1, std::memory_order_relaxed);
+	s_bytesAllocated[category].fetch_add(size, std::memory_order_relaxed);
+	s_liveBytes.fetch_add(size, std::memory_order_relaxed);
+	return reinterpret_cast<void*>(aligned);
+}
+
+static void TrackedFreeAligned(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	AlignedAllocationHeader* header = static_cast<AlignedAllocationHeader*>(ptr) - 1;
+	if (header->m_guard != ALIGNED_ALLOCATION_GUARD)
+	{
+		ERROR_AND_DIE("Memory tracker: freeing a block that was not allocated through the tracked aligned operator new");
+	}
+
+	int category = static_cast<int>(header->m_category);
+	s_numFrees[category].fetch_add(1, std::memory_order_relaxed);
+	s_bytesFreed[category].fetch_add(header->m_size, std::memory_order_relaxed);
+	s_liveBytes.fetch_sub(header->m_size, std::memory_order_relaxed);
+	header->m_guard = 0;
+	free(header->m_block);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* ptr = TrackedAllocateAligned(size, alignment);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* ptr = TrackedAllocateAligned(size, alignment);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	TrackedFreeAligned(ptr);
+}
+#endif
+#endif
+
+MemoryTracker::MemoryTracker(const MemoryTrackerConfig& config)
+	:m_config(config)
+{
+}
+
+void MemoryTracker::Startup()
+{
+	SubscribeEventCallbackFunction("mem.frame", Command_MemFrame);
+	SubscribeEventCallbackFunction("mem.budget", Command_MemBudget);
+}
+
+void MemoryTracker::BeginFrame()
+{
+	m_frameNumber++;
+}
+
+void MemoryTracker::EndFrame()
+{
+	MemoryFrameStats stats;
+	stats.m_frameNumber = m_frameNumber;
+	for (int i = 0; i < NUM_MEMORY_CATEGORIES; i++)
+	{
+		MemoryCategoryStats& categoryStats = stats.m_categories[i];
+		categoryStats.m_numAllocations = s_numAllocations[i].exchange(0, std::memory_order_relaxed);
+		categoryStats.m_bytesAllocated = s_bytesAllocated[i].exchange(0, std::memory_order_relaxed);
+		categoryStats.m_numFrees = s_numFrees[i].exchange(0, std::memory_order_relaxed);
+		categoryStats.m_bytesFreed = s_bytesFreed[i].exchange(0, std::memory_order_relaxed);
+		stats.m_totalAllocations += categoryStats.m_numAllocations;
+		stats.m_totalBytesAllocated += categoryStats.m_bytesAllocated;
+	}
+	stats.m_liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+	m_lastFrameStats = stats;
+
+	CheckBudget();
+}
+
+void MemoryTracker::Shutdown()
+{
+}
+
+bool MemoryTracker::IsTrackingCompiledIn()
+{
+#if defined(ENABLE_MEMORY_TRACKING)
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category)
+{
+	int categoryIndex = static_cast<int>(category);
+	if (categoryIndex < 0 || categoryIndex >= NUM_MEMORY_CATEGORIES)
+		return "Unknown";
+
+	return MEMORY_CATEGORY_NAMES[categoryIndex];
+}
+
+void MemoryTracker::CheckBudget()
+{
+	bool overCountBudget = m_config.m_frameAllocationBudget > 0 && m_lastFrameStats.m_totalAllocations > m_config.m_frameAllocationBudget;
+	bool overByteBudget = m_config.m_frameByteBudget > 0 && m_lastFrameStats.m_totalBytesAllocated > static_cast<size_t>(m_config.m_frameByteBudget);
+	if (!overCountBudget && !overByteBudget)
+	{
+		m_numFramesOverBudget = 0;
+		return;
+	}
+
+	m_numFramesOverBudget++;
+	ScopedMemoryCategory consoleScope(MemoryCategory::CONSOLE);
+	std::string warning = Stringf("Frame %d over allocation budget: %d allocs (budget %d), %zu bytes (budget %d)",
+		m_lastFrameStats.m_frameNumber, m_lastFrameStats.m_totalAllocations, m_config.m_frameAllocationBudget,
+		m_lastFrameStats.m_totalBytesAllocated, m_config.m_frameByteBudget);
+	GUARANTEE_OR_DIE(!m_config.m_dieOnBudgetExceeded, warning);
+
+	//only report when a streak starts and then once a second's worth of frames, so the console stays readable
+	if (m_numFramesOverBudget == 1 || m_numFramesOverBudget % 60 == 0)
+	{
+		DebuggerPrintf("%s\n", warning.c_str());
+		if (g_theConsole)
+			g_theConsole->AddLine(Rgba8(255, 200, 0, 255), warning);
+	}
+}
+
+bool MemoryTracker::Command_MemFrame(EventArgs& args)
+{
+	UNUSED(args);
+	ScopedMemoryCategory consoleScope(MemoryCategory::CONSOLE);
+	if (!IsTrackingCompiledIn())
+	{
+		g_theConsole->AddLine(g_theConsole->COMMAND, "Memory tracking is not compiled in, define ENABLE_MEMORY_TRACKING in EngineBuildPreferences.hpp");
+		return false;
+	}
+	if (!g_theMemoryTracker)
+		return false;
+
+	const MemoryFrameStats& stats = g_theMemoryTracker->GetLastFrameStats();
+	g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("--- allocations for frame %d ---", stats.m_frameNumber));
+	for (int i = 0; i < NUM_MEMORY_CATEGORIES; i++)
+	{
+		const MemoryCategoryStats& categoryStats = stats.m_categories[i];
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("%-10s allocs = %6d (%9zu bytes), frees = %6d (%9zu bytes)", MEMORY_CATEGORY_NAMES[i],
+			categoryStats.m_numAllocations, categoryStats.m_bytesAllocated, categoryStats.m_numFrees, categoryStats.m_bytesFreed));
+	}
+	g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Total allocs = %d (%zu bytes), live = %zu bytes, budget = %d allocs / %d bytes",
+		stats.m_totalAllocations, stats.m_totalBytesAllocated, stats.m_liveBytes, g_theMemoryTracker->m_config.m_frameAllocationBudget, g_theMemoryTracker->m_config.m_frameByteBudget));
+	return false;
+}
+
+bool MemoryTracker::Command_MemBudget(EventArgs& args)
+{
+	if (!g_theMemoryTracker)
+		return false;
+
+	MemoryTrackerConfig& config = g_theMemoryTracker->m_config;
+	config.m_frameAllocationBudget = args.GetValue("allocs", config.m_frameAllocationBudget);
+	config.m_frameByteBudget = args.GetValue("bytes", config.m_frameByteBudget);
+	g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Frame allocation budget = %d allocs / %d bytes", config.m_frameAllocationBudget, config.m_frameByteBudget));
+	return false;
+}
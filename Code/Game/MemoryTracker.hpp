@@ -0,0 +1,91 @@
+#pragma once
+#include <string>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/JobSystem.hpp"
+
+enum class MemoryCategory
+{
+	UNTAGGED,
+	PARTICLES,
+	EDITOR,
+	RENDER,
+	CONSOLE,
+	COUNT
+};
+
+struct MemoryCategoryStats
+{
+	int m_numAllocations = 0;
+	size_t m_bytesAllocated = 0;
+	int m_numFrees = 0;
+	size_t m_bytesFreed = 0;
+};
+
+struct MemoryFrameStats
+{
+	MemoryCategoryStats m_categories[static_cast<int>(MemoryCategory::COUNT)];
+	int m_totalAllocations = 0;
+	size_t m_totalBytesAllocated = 0;
+	size_t m_liveBytes = 0;
+	int m_frameNumber = 0;
+};
+
+struct MemoryTrackerConfig
+{
+	int m_frameAllocationBudget = 0;		//0 means no budget
+	int m_frameByteBudget = 0;
+	bool m_dieOnBudgetExceeded = false;
+};
+
+//Counts every global new/delete per frame, bucketed by the category on top of the calling thread's scope stack.
+//The hooks are only compiled in when ENABLE_MEMORY_TRACKING is defined in EngineBuildPreferences.hpp.
+class MemoryTracker
+{
+public:
+	MemoryTracker(const MemoryTrackerConfig& config);
+	void Startup();
+	void BeginFrame();
+	void EndFrame();
+	void Shutdown();
+
+	const MemoryFrameStats& GetLastFrameStats() const { return m_lastFrameStats; }
+	static bool IsTrackingCompiledIn();
+	static MemoryCategory GetCurrentCategory();
+	static const char* GetCategoryName(MemoryCategory category);
+	static bool Command_MemFrame(EventArgs& args);
+	static bool Command_MemBudget(EventArgs& args);
+
+private:
+	MemoryTrackerConfig m_config;
+	MemoryFrameStats m_lastFrameStats;
+	int m_frameNumber = 0;
+	int m_numFramesOverBudget = 0;
+
+private:
+	void CheckBudget();
+};
+
+//Pushes a category onto the calling thread's category stack for the lifetime of the scope.
+class ScopedMemoryCategory
+{
+public:
+	explicit ScopedMemoryCategory(MemoryCategory category);
+	~ScopedMemoryCategory();
+	ScopedMemoryCategory(const ScopedMemoryCategory& copy) = delete;
+	ScopedMemoryCategory& operator=(const ScopedMemoryCategory& copy) = delete;
+};
+
+//A job that charges what it allocates on a worker to the category that was current where it was queued.
+//Call CaptureMemoryCategory on the queueing thread right before QueueJob, then implement ExecuteTagged instead of Execute.
+class MemoryTaggedJob : public Job
+{
+public:
+	void CaptureMemoryCategory() { m_memoryCategory = MemoryTracker::GetCurrentCategory(); }
+	virtual void Execute() override final;
+
+protected:
+	virtual void ExecuteTagged() = 0;
+
+private:
+	MemoryCategory m_memoryCategory = MemoryCategory::UNTAGGED;
+};
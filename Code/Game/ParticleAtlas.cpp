@@ -0,0 +1,350 @@
+#include <algorithm>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Image.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/XmlUtils.hpp"
+#include "Game/ParticleAtlas.hpp"
+#include "Game/ParticleImpostorBaker.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+std::vector<ParticleAtlasBaker*> ParticleAtlasBaker::s_consoleBakers;
+
+//effect files name the same texture with either slash
+static std::string GetAtlasSourcePath(const std::string& texturePath)
+{
+	std::string sourcePath = texturePath;
+	std::replace(sourcePath.begin(), sourcePath.end(), '\\', '/');
+	return sourcePath;
+}
+
+static bool IsTallerRect(const std::pair<int, int>& a, const std::pair<int, int>& b)
+{
+	return a.first > b.first;
+}
+
+ParticleRectPacker::ParticleRectPacker(int pageSize)
+	:m_pageSize(pageSize)
+{
+}
+
+int ParticleRectPacker::AddRect(const IntVec2& size)
+{
+	ParticlePackedRect rect;
+	rect.m_size = size;
+	m_rects.push_back(rect);
+	return int(m_rects.size()) - 1;
+}
+
+void ParticleRectPacker::Pack()
+{
+	//stable, so equal heights keep the order they were added in
+	std::vector<std::pair<int, int>> order;
+	order.reserve(m_rects.size());
+	for (int rectIndex = 0; rectIndex < int(m_rects.size()); rectIndex++)
+	{
+		order.push_back(std::make_pair(m_rects[rectIndex].m_size.y, rectIndex));
+	}
+	std::stable_sort(order.begin(), order.end(), IsTallerRect);
+
+	int page = 0;
+	int cursorX = 0;
+	int rowY = 0;
+	int rowHeight = 0;
+	for (int i = 0; i < int(order.size()); i++)
+	{
+		ParticlePackedRect& rect = m_rects[order[i].second];
+		if (rect.m_size.x > m_pageSize || rect.m_size.y > m_pageSize)
+		{
+			rect.m_page = -1;
+			continue;
+		}
+
+		if (cursorX + rect.m_size.x > m_pageSize)
+		{
+			rowY += rowHeight;
+			cursorX = 0;
+			rowHeight = 0;
+		}
+		if (rowY + rect.m_size.y > m_pageSize)
+		{
+			page++;
+			rowY = 0;
+			cursorX = 0;
+			rowHeight = 0;
+		}
+		rect.m_page = page;
+		rect.m_position = IntVec2(cursorX, rowY);
+		cursorX += rect.m_size.x;
+		rowHeight = std::max(rowHeight, rect.m_size.y);
+		m_numPages = page + 1;
+	}
+}
+
+ParticleAtlas* ParticleAtlas::Pack(const std::vector<std::string>& sourcePaths, const std::vector<IntVec2>& layouts, int pageSize, int gutter, const char* atlasPath)
+{
+	if (sourcePaths.empty() || sourcePaths.size() != layouts.size() || pageSize <= 0 || gutter < 0)
+		return nullptr;
+
+	//a whole sheet goes onto the page as one rect of framed cells, so its frames can never be split across pages
+	ParticleAtlas* atlas = new ParticleAtlas();
+	atlas->m_pageSize = pageSize;
+	std::vector<Image> images;
+	std::vector<ParticleAtlasRegion> regions;
+	ParticleRectPacker packer(pageSize);
+	for (int sourceIndex = 0; sourceIndex < int(sourcePaths.size()); sourceIndex++)
+	{
+		images.push_back(Image(sourcePaths[sourceIndex].c_str()));
+		IntVec2 dimensions = images.back().GetDimensions();
+		ParticleAtlasRegion region;
+		region.m_sourcePath = GetAtlasSourcePath(sourcePaths[sourceIndex]);
+		region.m_layout = layouts[sourceIndex];
+		region.m_frameSize = IntVec2(dimensions.x / region.m_layout.x, dimensions.y / region.m_layout.y);
+		if (region.m_frameSize.x <= 0 || region.m_frameSize.y <= 0)
+		{
+			delete atlas;
+			return nullptr;
+		}
+
+		IntVec2 cellSize(region.m_frameSize.x + gutter * 2, region.m_frameSize.y + gutter * 2);
+		packer.AddRect(IntVec2(cellSize.x * region.m_layout.x, cellSize.y * region.m_layout.y));
+		regions.push_back(region);
+	}
+	packer.Pack();
+
+	//pages are stored top down like the impostor sheets, images are read from the bottom left
+	std::vector<std::vector<Rgba8>> pages(packer.GetNumPages(), std::vector<Rgba8>(size_t(pageSize) * pageSize, Rgba8(0, 0, 0, 0)));
+	for (int regionIndex = 0; regionIndex < int(regions.size()); regionIndex++)
+	{
+		ParticleAtlasRegion& region = regions[regionIndex];
+		const ParticlePackedRect& rect = packer.GetRect(regionIndex);
+		if (rect.m_page < 0)
+		{
+			//emitters keep drawing from the source texture, just without sharing its draws
+			DebuggerPrintf("%s is too large for a %d pixel particle atlas page and was left out of the atlas\n", region.m_sourcePath.c_str(), pageSize);
+			continue;
+		}
+
+		region.m_page = rect.m_page;
+		const Image& image = images[regionIndex];
+		IntVec2 dimensions = image.GetDimensions();
+		IntVec2 cellSize(region.m_frameSize.x + gutter * 2, region.m_frameSize.y + gutter * 2);
+		std::vector<Rgba8>& page = pages[rect.m_page];
+		for (int frame = 0; frame < region.m_layout.x * region.m_layout.y; frame++)
+		{
+			int cellLeft = rect.m_position.x + (frame % region.m_layout.x) * cellSize.x;
+			int cellTop = rect.m_position.y + (frame / region.m_layout.x) * cellSize.y;
+			region.m_framePositions.push_back(IntVec2(cellLeft + gutter, cellTop + gutter));
+			int sourceLeft = (frame % region.m_layout.x) * region.m_frameSize.x;
+			int sourceTop = (frame / region.m_layout.x) * region.m_frameSize.y;
+			for (int y = 0; y < cellSize.y; y++)
+			{
+				//the gutter repeats the frame's edge texels
+				int frameY = std::min(std::max(y - gutter, 0), region.m_frameSize.y - 1);
+				int imageY = dimensions.y - 1 - (sourceTop + frameY);
+				for (int x = 0; x < cellSize.x; x++)
+				{
+					int frameX = std::min(std::max(x - gutter, 0), region.m_frameSize.x - 1);
+					page[size_t(cellTop + y) * pageSize + cellLeft + x] = image.GetTexelColor(IntVec2(sourceLeft + frameX, imageY));
+				}
+			}
+		}
+		atlas->m_regions.push_back(region);
+	}
+	if (atlas->m_regions.empty())
+	{
+		delete atlas;
+		return nullptr;
+	}
+
+	//Data/Images/ParticleAtlas.xml writes its pages to Data/Images/ParticleAtlas_0.tga and up
+	std::string basePath = atlasPath;
+	size_t extensionStart = basePath.find_last_of('.');
+	if (extensionStart != std::string::npos && extensionStart > basePath.find_last_of("/\\") + 1)
+		basePath.resize(extensionStart);
+	for (int pageIndex = 0; pageIndex < int(pages.size()); pageIndex++)
+	{
+		atlas->m_pageTexturePaths.push_back(Stringf("%s_%d.tga", basePath.c_str(), pageIndex));
+		if (!ParticleImpostorBaker::WriteTGA(pages[pageIndex], pageSize, pageSize, atlas->m_pageTexturePaths.back().c_str()))
+		{
+			delete atlas;
+			return nullptr;
+		}
+	}
+	return atlas;
+}
+
+ParticleAtlas* ParticleAtlas::LoadFromFile(const char* atlasPath)
+{
+	XmlDocument atlasDocument;
+	if (atlasDocument.LoadFile(atlasPath) != tinyxml2::XML_SUCCESS || !atlasDocument.RootElement())
+		return nullptr;
+
+	const XmlElement* rootElement = atlasDocument.RootElement();
+	ParticleAtlas* atlas = new ParticleAtlas();
+	atlas->m_pageSize = ParseXmlAttribute(*rootElement, "pageSize", 0);
+	for (const XmlElement* pageElement = rootElement->FirstChildElement("Page"); pageElement; pageElement = pageElement->NextSiblingElement("Page"))
+	{
+		atlas->m_pageTexturePaths.push_back(ParseXmlAttribute(*pageElement, "texture", ""));
+	}
+	for (const XmlElement* regionElement = rootElement->FirstChildElement("Region"); regionElement; regionElement = regionElement->NextSiblingElement("Region"))
+	{
+		ParticleAtlasRegion region;
+		region.m_sourcePath = ParseXmlAttribute(*regionElement, "source", "");
+		region.m_layout = ParseXmlAttribute(*regionElement, "layout", region.m_layout);
+		region.m_page = ParseXmlAttribute(*regionElement, "page", region.m_page);
+		region.m_frameSize = ParseXmlAttribute(*regionElement, "frameSize", region.m_frameSize);
+		for (const XmlElement* frameElement = regionElement->FirstChildElement("Frame"); frameElement; frameElement = frameElement->NextSiblingElement("Frame"))
+		{
+			region.m_framePositions.push_back(ParseXmlAttribute(*frameElement, "position", IntVec2(0, 0)));
+		}
+
+		//a stale atlas must not send an emitter to frames or pages that are not there
+		if (region.m_page < 0 || region.m_page >= int(atlas->m_pageTexturePaths.size()) || int(region.m_framePositions.size()) != region.m_layout.x * region.m_layout.y)
+			continue;
+		atlas->m_regions.push_back(region);
+	}
+
+	if (atlas->m_pageSize <= 0 || atlas->m_regions.empty())
+	{
+		delete atlas;
+		return nullptr;
+	}
+	return atlas;
+}
+
+bool ParticleAtlas::SaveToFile(const char* atlasPath) const
+{
+	tinyxml2::XMLDocument atlasDocument;
+	XmlElement* rootNode = atlasDocument.NewElement("ParticleAtlas");
+	rootNode->SetAttribute("pageSize", m_pageSize);
+	atlasDocument.InsertFirstChild(rootNode);
+
+	for (int pageIndex = 0; pageIndex < int(m_pageTexturePaths.size()); pageIndex++)
+	{
+		XmlElement* pageElement = atlasDocument.NewElement("Page");
+		pageElement->SetAttribute("texture", m_pageTexturePaths[pageIndex].c_str());
+		rootNode->InsertEndChild(pageElement);
+	}
+	for (int regionIndex = 0; regionIndex < int(m_regions.size()); regionIndex++)
+	{
+		const ParticleAtlasRegion& region = m_regions[regionIndex];
+		XmlElement* regionElement = atlasDocument.NewElement("Region");
+		regionElement->SetAttribute("source", region.m_sourcePath.c_str());
+		regionElement->SetAttribute("layout", region.m_layout.ToXMLString().c_str());
+		regionElement->SetAttribute("page", region.m_page);
+		regionElement->SetAttribute("frameSize", region.m_frameSize.ToXMLString().c_str());
+		for (int frame = 0; frame < int(region.m_framePositions.size()); frame++)
+		{
+			XmlElement* frameElement = atlasDocument.NewElement("Frame");
+			frameElement->SetAttribute("position", region.m_framePositions[frame].ToXMLString().c_str());
+			regionElement->InsertEndChild(frameElement);
+		}
+		rootNode->InsertEndChild(regionElement);
+	}
+
+	return atlasDocument.SaveFile(atlasPath) == tinyxml2::XML_SUCCESS;
+}
+
+const ParticleAtlasRegion* ParticleAtlas::FindRegion(const std::string& texturePath, const IntVec2& layout) const
+{
+	std::string sourcePath = GetAtlasSourcePath(texturePath);
+	for (int regionIndex = 0; regionIndex < int(m_regions.size()); regionIndex++)
+	{
+		const ParticleAtlasRegion& region = m_regions[regionIndex];
+		if (region.m_sourcePath == sourcePath && region.m_layout == layout)
+			return &region;
+	}
+	return nullptr;
+}
+
+AABB2 ParticleAtlas::GetFrameUVs(const ParticleAtlasRegion& region, int frame) const
+{
+	//v runs up from the bottom of the page while pixel rows run down from the top
+	const IntVec2& position = region.m_framePositions[frame];
+	float pageSize = float(m_pageSize);
+	return AABB2(float(position.x) / pageSize, 1.f - float(position.y + region.m_frameSize.y) / pageSize,
+		float(position.x + region.m_frameSize.x) / pageSize, 1.f - float(position.y) / pageSize);
+}
+
+ParticleAtlasBaker::ParticleAtlasBaker(ParticleWorld* world)
+	:m_world(world)
+{
+	if (s_consoleBakers.empty())
+		SubscribeEventCallbackFunction("particles.bakeatlas", Command_BakeAtlas);
+	s_consoleBakers.push_back(this);
+}
+
+ParticleAtlasBaker::~ParticleAtlasBaker()
+{
+	s_consoleBakers.erase(std::remove(s_consoleBakers.begin(), s_consoleBakers.end(), this), s_consoleBakers.end());
+	if (s_consoleBakers.empty())
+		UnsubscribeEventCallbackFunction("particles.bakeatlas", Command_BakeAtlas);
+}
+
+bool ParticleAtlasBaker::BakeEffectFiles(const std::vector<std::string>& effectPaths, int pageSize, int gutter, const char* atlasPath)
+{
+	//every distinct texture and sheet layout the effects draw with becomes one region
+	std::vector<std::string> sourcePaths;
+	std::vector<IntVec2> layouts;
+	for (int effectIndex = 0; effectIndex < int(effectPaths.size()); effectIndex++)
+	{
+		std::vector<ParticleEmitterData> emitterData = BatchedParticleEffect::LoadEmitterData(effectPaths[effectIndex].c_str(), m_world);
+		for (int emitterIndex = 0; emitterIndex < int(emitterData.size()); emitterIndex++)
+		{
+			const ParticleEmitterData& data = emitterData[emitterIndex];
+			if (data.m_textureFilepath.empty() || data.m_textureFilepath == "Default")
+				continue;
+
+			bool isSpriteSheet = data.m_isSpriteSheetTexture && data.m_spriteSheetGridLayout.x > 0 && data.m_spriteSheetGridLayout.y > 0;
+			IntVec2 layout = isSpriteSheet ? data.m_spriteSheetGridLayout : IntVec2(1, 1);
+			std::string sourcePath = GetAtlasSourcePath(data.m_textureFilepath);
+			bool isKnown = false;
+			for (int sourceIndex = 0; sourceIndex < int(sourcePaths.size()) && !isKnown; sourceIndex++)
+			{
+				isKnown = sourcePaths[sourceIndex] == sourcePath && layouts[sourceIndex] == layout;
+			}
+			if (!isKnown)
+			{
+				sourcePaths.push_back(sourcePath);
+				layouts.push_back(layout);
+			}
+		}
+	}
+
+	ParticleAtlas* atlas = ParticleAtlas::Pack(sourcePaths, layouts, pageSize, gutter, atlasPath);
+	if (!atlas)
+		return false;
+
+	bool isSaved = atlas->SaveToFile(atlasPath);
+	delete atlas;
+	return isSaved;
+}
+
+//particles.bakeatlas effects=<path>,<path> [world=index] ..., loading the effects through the first world unless another is picked
+bool ParticleAtlasBaker::Command_BakeAtlas(EventArgs& args)
+{
+	std::string effects = args.GetValue("effects", "");
+	std::string atlasPath = args.GetValue("out", "Data/Images/ParticleAtlas.xml");
+	if (effects.empty())
+	{
+		g_theConsole->AddLine(g_theConsole->COMMAND, "Usage: particles.bakeatlas effects=<path>,<path> world=0 out=Data/Images/ParticleAtlas.xml pageSize=2048 gutter=2");
+		return false;
+	}
+
+	int worldIndex = args.GetValue("world", 0);
+	if (worldIndex < 0 || worldIndex >= int(s_consoleBakers.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d particle worlds", int(s_consoleBakers.size())));
+		return false;
+	}
+
+	int pageSize = args.GetValue("pageSize", 2048);
+	int gutter = args.GetValue("gutter", 2);
+	Strings effectPaths = SplitStringOnDelimiter(effects, ',');
+	if (s_consoleBakers[worldIndex]->BakeEffectFiles(effectPaths, pageSize, gutter, atlasPath.c_str()))
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Baked the textures of %d effects into %s, point particleAtlas in GameConfig.xml at it to use it", int(effectPaths.size()), atlasPath.c_str()));
+	else
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("Could not bake a particle atlas into %s", atlasPath.c_str()));
+	return false;
+}
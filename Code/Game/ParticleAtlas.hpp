@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/AABB2.hpp"
+
+class ParticleWorld;
+
+struct ParticlePackedRect
+{
+	IntVec2 m_size;
+	IntVec2 m_position;		//top left pixel on its page
+	int m_page = -1;
+};
+
+//Shelf packer for atlas pages. Rects go tallest first onto rows across the page, a row full of similar heights wastes little,
+//and a new page opens when the next row no longer fits. Rects larger than a page are left on page -1.
+class ParticleRectPacker
+{
+public:
+	ParticleRectPacker(int pageSize);
+
+	int AddRect(const IntVec2& size);
+	void Pack();
+	int GetNumPages() const { return m_numPages; }
+	const ParticlePackedRect& GetRect(int rectIndex) const { return m_rects[rectIndex]; }
+
+private:
+	int m_pageSize = 0;
+	int m_numPages = 0;
+	std::vector<ParticlePackedRect> m_rects;
+};
+
+//Where one particle texture landed in the atlas. A sprite sheet stays whole on one page, but every frame gets its own cell
+//with its edge texels extruded into a gutter around it, so filtering never pulls in a neighbouring frame or texture.
+struct ParticleAtlasRegion
+{
+	std::string m_sourcePath;				//with forward slashes
+	IntVec2 m_layout = IntVec2(1, 1);		//sprite sheet layout the frames were cut with
+	int m_page = 0;
+	IntVec2 m_frameSize;
+	std::vector<IntVec2> m_framePositions;	//top left pixel of each frame, frames run from the top left of the sheet
+};
+
+//Particle textures packed into a few large pages, so emitters with different source textures can share a texture and a draw.
+//Pages are written as tga next to the atlas file, and the regions are looked up by the source texture each emitter names.
+//Textures too large for a page are left out with a warning, and their emitters keep drawing from the source texture.
+class ParticleAtlas
+{
+public:
+	static ParticleAtlas* Pack(const std::vector<std::string>& sourcePaths, const std::vector<IntVec2>& layouts, int pageSize, int gutter, const char* atlasPath);
+	static ParticleAtlas* LoadFromFile(const char* atlasPath);
+	bool SaveToFile(const char* atlasPath) const;
+
+	const ParticleAtlasRegion* FindRegion(const std::string& texturePath, const IntVec2& layout) const;
+	const std::string& GetPageTexturePath(int page) const { return m_pageTexturePaths[page]; }
+	int GetNumPages() const { return int(m_pageTexturePaths.size()); }
+	int GetNumRegions() const { return int(m_regions.size()); }
+	AABB2 GetFrameUVs(const ParticleAtlasRegion& region, int frame) const;
+
+private:
+	int m_pageSize = 0;
+	std::vector<std::string> m_pageTexturePaths;
+	std::vector<ParticleAtlasRegion> m_regions;
+};
+
+//Registers the console command that packs the textures of a list of effect files into an atlas.
+//Every live baker answers it, in the order their worlds were created.
+class ParticleAtlasBaker
+{
+public:
+	ParticleAtlasBaker(ParticleWorld* world);
+	~ParticleAtlasBaker();
+
+	bool BakeEffectFiles(const std::vector<std::string>& effectPaths, int pageSize, int gutter, const char* atlasPath);
+	static bool Command_BakeAtlas(EventArgs& args);
+
+private:
+	ParticleWorld* m_world = nullptr;
+
+private:
+	static std::vector<ParticleAtlasBaker*> s_consoleBakers;
+};
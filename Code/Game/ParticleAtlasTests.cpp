@@ -0,0 +1,184 @@
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleAtlas.hpp"
+#include "Game/ParticleDrawBatcher.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+static const char* SHIPPED_ATLAS_PATH = "Data/Images/ParticleAtlas.xml";
+
+static bool IsInsideUnitSquare(const AABB2& uvs)
+{
+	return uvs.m_mins.x >= 0.f && uvs.m_mins.y >= 0.f && uvs.m_maxs.x <= 1.f && uvs.m_maxs.y <= 1.f && uvs.m_mins.x < uvs.m_maxs.x && uvs.m_mins.y < uvs.m_maxs.y;
+}
+
+static bool DoRectsOverlap(const ParticlePackedRect& a, const ParticlePackedRect& b)
+{
+	return a.m_page == b.m_page && a.m_position.x < b.m_position.x + b.m_size.x && b.m_position.x < a.m_position.x + a.m_size.x
+		&& a.m_position.y < b.m_position.y + b.m_size.y && b.m_position.y < a.m_position.y + a.m_size.y;
+}
+
+//one emitter per blend mode in the order given, all on the same texture
+static BatchedParticleEffect* CreateBatcherTestEffect(const std::vector<BlendMode>& blendModes)
+{
+	std::vector<ParticleEmitterData> emitterData;
+	for (int emitterIndex = 0; emitterIndex < int(blendModes.size()); emitterIndex++)
+	{
+		emitterData.push_back(MakeTestEmitterData(100, 200.f, 10.f));
+		emitterData.back().m_textureFilepath = "Data/Images/RoundSoftParticle.png";
+		emitterData.back().m_blendMode = blendModes[emitterIndex];
+	}
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1);
+	effect->AddInstance(Mat44());
+	effect->Update(0.25f);
+	return effect;
+}
+
+GAME_TEST(ParticleAtlas_ShippedAtlasLoads)
+{
+	//GameConfig points particleAtlas at this file, every texture of the shipped batched effects that fits a page is in it
+	ParticleAtlas* atlas = ParticleAtlas::LoadFromFile(SHIPPED_ATLAS_PATH);
+	GAME_TEST_CHECK(atlas != nullptr);
+	if (!atlas)
+		return;
+
+	GAME_TEST_CHECK(atlas->GetNumPages() == 1);
+	GAME_TEST_CHECK(atlas->GetPageTexturePath(0) == "Data/Images/ParticleAtlas_0.tga");
+	const char* packedPaths[] = { "Data/Images/RoundSoftParticle.png", "Data/Images/SplashRing.png", "Data/Images/SquareSoftParticle_bg.png" };
+	for (int pathIndex = 0; pathIndex < 3; pathIndex++)
+	{
+		const ParticleAtlasRegion* region = atlas->FindRegion(packedPaths[pathIndex], IntVec2(1, 1));
+		GAME_TEST_CHECK(region != nullptr);
+		if (region)
+			GAME_TEST_CHECK(IsInsideUnitSquare(atlas->GetFrameUVs(*region, 0)));
+	}
+
+	//effect files name textures with either slash
+	GAME_TEST_CHECK(atlas->FindRegion("Data\\Images\\SplashRing.png", IntVec2(1, 1)) != nullptr);
+	GAME_TEST_CHECK(atlas->FindRegion("Data/Images/SplashRing.png", IntVec2(2, 2)) == nullptr);
+
+	//the fire and smoke sheets are larger than a page and keep drawing from their own textures
+	GAME_TEST_CHECK(atlas->FindRegion("Data/Images/T_Fire_SubUV.png", IntVec2(6, 6)) == nullptr);
+	GAME_TEST_CHECK(atlas->FindRegion("Data/Images/smoke.png", IntVec2(8, 8)) == nullptr);
+	delete atlas;
+}
+
+GAME_TEST(ParticleRectPacker_LeavesOversizedRectsOffThePages)
+{
+	ParticleRectPacker packer(64);
+	int fitting = packer.AddRect(IntVec2(40, 30));
+	int tooWide = packer.AddRect(IntVec2(65, 10));
+	int tooTall = packer.AddRect(IntVec2(10, 100));
+	int exact = packer.AddRect(IntVec2(64, 64));
+	packer.Pack();
+	GAME_TEST_CHECK(packer.GetRect(fitting).m_page >= 0);
+	GAME_TEST_CHECK(packer.GetRect(exact).m_page >= 0);
+	GAME_TEST_CHECK(packer.GetRect(tooWide).m_page == -1);
+	GAME_TEST_CHECK(packer.GetRect(tooTall).m_page == -1);
+	GAME_TEST_CHECK(packer.GetNumPages() == 2);
+}
+
+GAME_TEST(ParticleRectPacker_RectsStayOnTheirPageWithoutOverlapping)
+{
+	ParticleRectPacker packer(100);
+	for (int rectIndex = 0; rectIndex < 20; rectIndex++)
+	{
+		packer.AddRect(IntVec2(10 + (rectIndex * 7) % 40, 10 + (rectIndex * 13) % 45));
+	}
+	packer.Pack();
+
+	bool areAllOnAPage = true;
+	bool areAllApart = true;
+	for (int rectIndex = 0; rectIndex < 20; rectIndex++)
+	{
+		const ParticlePackedRect& rect = packer.GetRect(rectIndex);
+		areAllOnAPage = areAllOnAPage && rect.m_page >= 0 && rect.m_page < packer.GetNumPages() && rect.m_position.x >= 0 && rect.m_position.y >= 0
+			&& rect.m_position.x + rect.m_size.x <= 100 && rect.m_position.y + rect.m_size.y <= 100;
+		for (int otherIndex = rectIndex + 1; otherIndex < 20; otherIndex++)
+		{
+			areAllApart = areAllApart && !DoRectsOverlap(rect, packer.GetRect(otherIndex));
+		}
+	}
+	GAME_TEST_CHECK(areAllOnAPage);
+	GAME_TEST_CHECK(areAllApart);
+}
+
+GAME_TEST(ParticleDrawBatcher_JoinsMatchingDrawsOfDifferentEffects)
+{
+	Camera camera;
+	BatchedParticleEffect* first = CreateBatcherTestEffect({ BlendMode::ALPHA });
+	BatchedParticleEffect* second = CreateBatcherTestEffect({ BlendMode::ALPHA });
+	const BatchedParticleEffect* effects[] = { first, second };
+	ParticleDrawBatcher batcher;
+	GAME_TEST_CHECK(batcher.Build(effects, 2, camera));
+	GAME_TEST_CHECK(batcher.GetNumItems() == 2);
+	GAME_TEST_CHECK(batcher.GetNumDraws() == 1);
+	if (batcher.GetNumDraws() == 1)
+	{
+		const ParticleBatchedDraw& draw = batcher.GetDraw(0);
+		GAME_TEST_CHECK(draw.m_kind == BatchedDrawKind::VERTS);
+		GAME_TEST_CHECK(draw.m_numItems == 2);
+		GAME_TEST_CHECK(draw.m_count == int(first->GetEmitterVerts(0).size() + second->GetEmitterVerts(0).size()));
+		GAME_TEST_CHECK(draw.m_count > 0);
+	}
+
+	//nothing is laid out again until an effect rebuilds its render data
+	GAME_TEST_CHECK(!batcher.Build(effects, 2, camera));
+	second->Update(0.1f);
+	GAME_TEST_CHECK(batcher.Build(effects, 2, camera));
+	GAME_TEST_CHECK(batcher.Build(effects, 1, camera));
+	GAME_TEST_CHECK(batcher.GetNumDraws() == 1 && batcher.GetDraw(0).m_numItems == 1);
+	delete first;
+	delete second;
+}
+
+GAME_TEST(ParticleDrawBatcher_KeepsTheDrawOrderOfEachEffect)
+{
+	//the second effect's additive emitter may join the first effect's, but never ahead of its own alpha one
+	Camera camera;
+	BatchedParticleEffect* first = CreateBatcherTestEffect({ BlendMode::ALPHA, BlendMode::ADDITIVE });
+	BatchedParticleEffect* second = CreateBatcherTestEffect({ BlendMode::ADDITIVE, BlendMode::ALPHA });
+	const BatchedParticleEffect* effects[] = { first, second };
+	ParticleDrawBatcher batcher;
+	batcher.Build(effects, 2, camera);
+	GAME_TEST_CHECK(batcher.GetNumDraws() == 3);
+	if (batcher.GetNumDraws() == 3)
+	{
+		GAME_TEST_CHECK(batcher.GetDraw(0).m_effect == first && batcher.GetDraw(0).m_emitterIndex == 0 && batcher.GetDraw(0).m_numItems == 1);
+		GAME_TEST_CHECK(batcher.GetDraw(1).m_effect == first && batcher.GetDraw(1).m_emitterIndex == 1 && batcher.GetDraw(1).m_numItems == 2);
+		GAME_TEST_CHECK(batcher.GetDraw(2).m_effect == second && batcher.GetDraw(2).m_emitterIndex == 1 && batcher.GetDraw(2).m_numItems == 1);
+	}
+
+	//the same effect twice joins emitter for emitter
+	const BatchedParticleEffect* matchingEffects[] = { first, first };
+	batcher.Build(matchingEffects, 2, camera);
+	GAME_TEST_CHECK(batcher.GetNumDraws() == 2);
+	delete first;
+	delete second;
+}
+
+GAME_TEST(ParticleDrawBatcher_DrawsIntoTheBackendWithoutARenderer)
+{
+	//without a renderer the static batch has no gpu buffer, its draw still reaches the backend next to the moving emitter's
+	Camera camera;
+	std::vector<ParticleEmitterData> emitterData;
+	emitterData.push_back(MakeTestEmitterData(100, 200.f, 10.f, true));
+	emitterData.push_back(MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1);
+	effect->AddInstance(Mat44());
+	effect->Update(0.25f);
+	GAME_TEST_CHECK(effect->GetNumStaticParticles() == 50);
+
+	const BatchedParticleEffect* effects[] = { effect };
+	ParticleDrawBatcher batcher;
+	CountingRenderBackend backend;
+	batcher.Render(effects, 1, camera, backend);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 2);
+
+	//a frame with nothing rebuilt draws the same
+	backend.ResetCounts();
+	batcher.Render(effects, 1, camera, backend);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 2);
+	delete effect;
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include "Game/ParticleBoundsTree.hpp"
+#include "Game/ParticleFrustum.hpp"
+
+constexpr float BOUNDS_TREE_FAT_MARGIN = 1.f;
+
+static AABB3 GetUnion(const AABB3& a, const AABB3& b)
+{
+	AABB3 result;
+	result.m_mins = Vec3(std::min(a.m_mins.x, b.m_mins.x), std::min(a.m_mins.y, b.m_mins.y), std::min(a.m_mins.z, b.m_mins.z));
+	result.m_maxs = Vec3(std::max(a.m_maxs.x, b.m_maxs.x), std::max(a.m_maxs.y, b.m_maxs.y), std::max(a.m_maxs.z, b.m_maxs.z));
+	return result;
+}
+
+static float GetSurfaceArea(const AABB3& bounds)
+{
+	Vec3 dimensions = bounds.m_maxs - bounds.m_mins;
+	return 2.f * (dimensions.x * dimensions.y + dimensions.y * dimensions.z + dimensions.z * dimensions.x);
+}
+
+static bool IsContained(const AABB3& outer, const AABB3& inner)
+{
+	return outer.m_mins.x <= inner.m_mins.x && outer.m_mins.y <= inner.m_mins.y && outer.m_mins.z <= inner.m_mins.z
+		&& outer.m_maxs.x >= inner.m_maxs.x && outer.m_maxs.y >= inner.m_maxs.y && outer.m_maxs.z >= inner.m_maxs.z;
+}
+
+static AABB3 GetFattened(const AABB3& bounds)
+{
+	Vec3 margin = Vec3(BOUNDS_TREE_FAT_MARGIN, BOUNDS_TREE_FAT_MARGIN, BOUNDS_TREE_FAT_MARGIN);
+	return AABB3(bounds.m_mins - margin, bounds.m_maxs + margin);
+}
+
+int ParticleBoundsTree::CreateProxy(const AABB3& bounds, BatchedParticleEffect* effect, int instanceIndex)
+{
+	int leafIndex = AllocateNode();
+	ParticleBoundsNode& leaf = m_nodes[leafIndex];
+	leaf.m_bounds = GetFattened(bounds);
+	leaf.m_effect = effect;
+	leaf.m_instanceIndex = instanceIndex;
+	InsertLeaf(leafIndex);
+	m_numProxies++;
+	return leafIndex;
+}
+
+void ParticleBoundsTree::DestroyProxy(int proxyId)
+{
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+	m_numProxies--;
+}
+
+void ParticleBoundsTree::MoveProxy(int proxyId, const AABB3& bounds)
+{
+	if (IsContained(m_nodes[proxyId].m_bounds, bounds))
+		return;
+
+	RemoveLeaf(proxyId);
+	m_nodes[proxyId].m_bounds = GetFattened(bounds);
+	InsertLeaf(proxyId);
+}
+
+void ParticleBoundsTree::QueryFrustum(const ParticleFrustum& frustum, std::vector<int>& out_proxyIds) const
+{
+	if (m_root == -1)
+		return;
+
+	m_queryStack.clear();
+	m_queryStack.push_back(m_root);
+	while (!m_queryStack.empty())
+	{
+		int nodeIndex = m_queryStack.back();
+		m_queryStack.pop_back();
+		const ParticleBoundsNode& node = m_nodes[nodeIndex];
+		if (!frustum.IsOverlappingAABB(node.m_bounds))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			out_proxyIds.push_back(nodeIndex);
+			continue;
+		}
+		m_queryStack.push_back(node.m_left);
+		m_queryStack.push_back(node.m_right);
+	}
+}
+
+int ParticleBoundsTree::AllocateNode()
+{
+	if (m_freeNodes.empty())
+	{
+		m_nodes.emplace_back();
+		return int(m_nodes.size()) - 1;
+	}
+
+	int nodeIndex = m_freeNodes.back();
+	m_freeNodes.pop_back();
+	m_nodes[nodeIndex] = ParticleBoundsNode();
+	return nodeIndex;
+}
+
+void ParticleBoundsTree::FreeNode(int nodeIndex)
+{
+	m_nodes[nodeIndex].m_effect = nullptr;
+	m_freeNodes.push_back(nodeIndex);
+}
+
+void ParticleBoundsTree::InsertLeaf(int leafIndex)
+{
+	if (m_root == -1)
+	{
+		m_root = leafIndex;
+		m_nodes[leafIndex].m_parent = -1;
+		return;
+	}
+
+	//walk down towards the child whose bounds grow the least, then pair the leaf with the node we end on
+	AABB3 leafBounds = m_nodes[leafIndex].m_bounds;
+	int siblingIndex = m_root;
+	while (!m_nodes[siblingIndex].IsLeaf())
+	{
+		const ParticleBoundsNode& node = m_nodes[siblingIndex];
+		float combinedArea = GetSurfaceArea(GetUnion(node.m_bounds, leafBounds));
+		float costHere = 2.f * combinedArea;
+		float inheritedCost = 2.f * (combinedArea - GetSurfaceArea(node.m_bounds));
+
+		const ParticleBoundsNode& left = m_nodes[node.m_left];
+		const ParticleBoundsNode& right = m_nodes[node.m_right];
+		float costLeft = GetSurfaceArea(GetUnion(left.m_bounds, leafBounds)) + inheritedCost;
+		float costRight = GetSurfaceArea(GetUnion(right.m_bounds, leafBounds)) + inheritedCost;
+		if (!left.IsLeaf())
+			costLeft -= GetSurfaceArea(left.m_bounds);
+		if (!right.IsLeaf())
+			costRight -= GetSurfaceArea(right.m_bounds);
+
+		if (costHere < costLeft && costHere < costRight)
+			break;
+		siblingIndex = costLeft < costRight ? node.m_left : node.m_right;
+	}
+
+	int oldParentIndex = m_nodes[siblingIndex].m_parent;
+	int newParentIndex = AllocateNode();
+	ParticleBoundsNode& newParent = m_nodes[newParentIndex];
+	newParent.m_parent = oldParentIndex;
+	newParent.m_left = siblingIndex;
+	newParent.m_right = leafIndex;
+	newParent.m_bounds = GetUnion(leafBounds, m_nodes[siblingIndex].m_bounds);
+	m_nodes[siblingIndex].m_parent = newParentIndex;
+	m_nodes[leafIndex].m_parent = newParentIndex;
+
+	if (oldParentIndex == -1)
+	{
+		m_root = newParentIndex;
+	}
+	else
+	{
+		ParticleBoundsNode& oldParent = m_nodes[oldParentIndex];
+		if (oldParent.m_left == siblingIndex)
+			oldParent.m_left = newParentIndex;
+		else
+			oldParent.m_right = newParentIndex;
+	}
+	RefitAncestors(oldParentIndex);
+}
+
+void ParticleBoundsTree::RemoveLeaf(int leafIndex)
+{
+	if (leafIndex == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	//the leaf's sibling takes the place of their shared parent
+	int parentIndex = m_nodes[leafIndex].m_parent;
+	const ParticleBoundsNode& parent = m_nodes[parentIndex];
+	int grandParentIndex = parent.m_parent;
+	int siblingIndex = parent.m_left == leafIndex ? parent.m_right : parent.m_left;
+	if (grandParentIndex == -1)
+	{
+		m_root = siblingIndex;
+		m_nodes[siblingIndex].m_parent = -1;
+	}
+	else
+	{
+		ParticleBoundsNode& grandParent = m_nodes[grandParentIndex];
+		if (grandParent.m_left == parentIndex)
+			grandParent.m_left = siblingIndex;
+		else
+			grandParent.m_right = siblingIndex;
+		m_nodes[siblingIndex].m_parent = grandParentIndex;
+		RefitAncestors(grandParentIndex);
+	}
+	FreeNode(parentIndex);
+	m_nodes[leafIndex].m_parent = -1;
+}
+
+void ParticleBoundsTree::RefitAncestors(int nodeIndex)
+{
+	while (nodeIndex != -1)
+	{
+		ParticleBoundsNode& node = m_nodes[nodeIndex];
+		node.m_bounds = GetUnion(m_nodes[node.m_left].m_bounds, m_nodes[node.m_right].m_bounds);
+		nodeIndex = node.m_parent;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "Engine/Math/AABB3.hpp"
+
+struct ParticleFrustum;
+class BatchedParticleEffect;
+
+struct ParticleBoundsNode
+{
+	AABB3 m_bounds;					//fattened for leaves so small movements do not touch the tree
+	int m_parent = -1;
+	int m_left = -1;
+	int m_right = -1;
+	BatchedParticleEffect* m_effect = nullptr;
+	int m_instanceIndex = -1;
+
+	bool IsLeaf() const { return m_left == -1; }
+};
+
+//Dynamic AABB tree over the bounds of every live particle instance in a world.
+//Leaves store fattened bounds and are only reinserted once the tight bounds escape them.
+class ParticleBoundsTree
+{
+public:
+	int CreateProxy(const AABB3& bounds, BatchedParticleEffect* effect, int instanceIndex);
+	void DestroyProxy(int proxyId);
+	void MoveProxy(int proxyId, const AABB3& bounds);
+	void QueryFrustum(const ParticleFrustum& frustum, std::vector<int>& out_proxyIds) const;
+
+	BatchedParticleEffect* GetProxyEffect(int proxyId) const { return m_nodes[proxyId].m_effect; }
+	int GetProxyInstanceIndex(int proxyId) const { return m_nodes[proxyId].m_instanceIndex; }
+	int GetNumProxies() const { return m_numProxies; }
+
+private:
+	std::vector<ParticleBoundsNode> m_nodes;
+	std::vector<int> m_freeNodes;
+	mutable std::vector<int> m_queryStack;
+	int m_root = -1;
+	int m_numProxies = 0;
+
+private:
+	int AllocateNode();
+	void FreeNode(int nodeIndex);
+	void InsertLeaf(int leafIndex);
+	void RemoveLeaf(int leafIndex);
+	void RefitAncestors(int nodeIndex);
+};
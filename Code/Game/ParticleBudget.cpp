@@ -0,0 +1,101 @@
+#include <algorithm>
+#include "Engine/Core/XmlUtils.hpp"
+#include "Game/ParticleBudget.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+ParticleBudgetSettings ParticleBudgetSettings::LoadFromEffectFile(const char* effectPath)
+{
+	ParticleBudgetSettings settings;
+	XmlDocument effectDocument;
+	if (effectDocument.LoadFile(effectPath) != tinyxml2::XML_SUCCESS || !effectDocument.RootElement())
+		return settings;
+
+	const XmlElement* budgetElement = effectDocument.RootElement()->FirstChildElement("Budget");
+	if (!budgetElement)
+		return settings;
+
+	settings.m_priority = ParseXmlAttribute(*budgetElement, "priority", settings.m_priority);
+	settings.m_minGuaranteedParticles = ParseXmlAttribute(*budgetElement, "minParticles", settings.m_minGuaranteedParticles);
+	return settings;
+}
+
+static bool IsHigherPriority(const ParticleBudgetEntry& a, const ParticleBudgetEntry& b)
+{
+	return a.m_priority > b.m_priority;
+}
+
+ParticleBudgetManager::ParticleBudgetManager(int maxParticles)
+	:m_maxParticles(maxParticles)
+{
+}
+
+void ParticleBudgetManager::Arbitrate(const std::vector<BatchedParticleEffect*>& effects, float capacityScale)
+{
+	int maxParticles = int(float(m_maxParticles) * capacityScale);
+	m_entries.clear();
+	int totalAlive = 0;
+	for (int i = 0; i < int(effects.size()); i++)
+	{
+		ParticleBudgetEntry entry;
+		entry.m_effect = effects[i];
+		entry.m_priority = effects[i]->GetBudgetSettings().m_priority;
+		entry.m_numAlive = effects[i]->GetNumAliveParticles();
+		entry.m_demand = std::min(entry.m_numAlive + effects[i]->GetRequestedSpawnsPeak(), effects[i]->GetMaxParticles());
+		m_entries.push_back(entry);
+		totalAlive += entry.m_numAlive;
+	}
+	std::stable_sort(m_entries.begin(), m_entries.end(), IsHigherPriority);
+
+	//guarantees first, then whatever is left in priority order
+	int remaining = maxParticles;
+	for (int i = 0; i < int(m_entries.size()); i++)
+	{
+		ParticleBudgetEntry& entry = m_entries[i];
+		entry.m_cap = std::min(entry.m_demand, entry.m_effect->GetBudgetSettings().m_minGuaranteedParticles);
+		remaining -= entry.m_cap;
+	}
+	m_numThrottledEffects = 0;
+	for (int i = 0; i < int(m_entries.size()); i++)
+	{
+		ParticleBudgetEntry& entry = m_entries[i];
+		int extra = std::min(entry.m_demand - entry.m_cap, std::max(remaining, 0));
+		entry.m_cap += extra;
+		remaining -= extra;
+		if (entry.m_cap < entry.m_demand)
+			m_numThrottledEffects++;
+	}
+
+	//effects over their cap stop emitting and normally just wait for their particles to die, but when a higher
+	//priority effect needs room right now their oldest particles are evicted to make it
+	m_numEvictedParticles = 0;
+	int freeCapacity = maxParticles - totalAlive;
+	for (int i = 0; i < int(m_entries.size()); i++)
+	{
+		ParticleBudgetEntry& entry = m_entries[i];
+		//an effect already holding its cap needs nothing, even while the world as a whole is over budget
+		int needed = std::max(0, entry.m_cap - entry.m_numAlive);
+		for (int victim = int(m_entries.size()) - 1; victim > i && needed > 0 && needed > freeCapacity; victim--)
+		{
+			ParticleBudgetEntry& victimEntry = m_entries[victim];
+			if (victimEntry.m_priority >= entry.m_priority)
+				break;
+
+			int surplus = victimEntry.m_numAlive - victimEntry.m_cap;
+			int numToEvict = std::min(surplus, needed - freeCapacity);
+			if (numToEvict <= 0)
+				continue;
+
+			//static particles count as alive but cannot be evicted, so the victim may give up fewer than asked
+			int numEvicted = victimEntry.m_effect->EvictOldestParticles(numToEvict);
+			victimEntry.m_numAlive -= numEvicted;
+			freeCapacity += numEvicted;
+			m_numEvictedParticles += numEvicted;
+		}
+		freeCapacity -= std::min(needed, std::max(freeCapacity, 0));
+	}
+
+	for (int i = 0; i < int(m_entries.size()); i++)
+	{
+		m_entries[i].m_effect->SetBudgetCap(m_entries[i].m_cap);
+	}
+}
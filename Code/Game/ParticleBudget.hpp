@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+
+class BatchedParticleEffect;
+
+//Per effect budget settings read from the <Budget> element of an effect xml.
+struct ParticleBudgetSettings
+{
+	int m_priority = 0;					//higher priorities are served first and may evict lower ones
+	int m_minGuaranteedParticles = 0;	//capacity reserved for the effect before any priority ordering
+
+	static ParticleBudgetSettings LoadFromEffectFile(const char* effectPath);
+};
+
+struct ParticleBudgetEntry
+{
+	BatchedParticleEffect* m_effect = nullptr;
+	int m_priority = 0;
+	int m_numAlive = 0;
+	int m_demand = 0;
+	int m_cap = 0;
+};
+
+//Splits one particle budget across every batched effect of a world once per frame.
+//Guarantees are handed out first, then the rest goes to effects in priority order, so emission of low priority
+//effects is throttled first. An effect that is still short evicts the oldest particles of lower priority effects
+//that are holding more than their share, so ambient effects can never starve a critical one.
+class ParticleBudgetManager
+{
+public:
+	ParticleBudgetManager(int maxParticles);
+	void Arbitrate(const std::vector<BatchedParticleEffect*>& effects, float capacityScale = 1.f);
+
+	int GetMaxParticles() const { return m_maxParticles; }
+	int GetNumThrottledEffects() const { return m_numThrottledEffects; }
+	int GetNumEvictedParticles() const { return m_numEvictedParticles; }
+
+private:
+	int m_maxParticles = 0;
+	std::vector<ParticleBudgetEntry> m_entries;
+	int m_numThrottledEffects = 0;
+	int m_numEvictedParticles = 0;
+};
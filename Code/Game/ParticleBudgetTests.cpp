@@ -0,0 +1,137 @@
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleBudget.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/ParticleWorld.hpp"
+
+static BatchedParticleEffect* CreateBudgetTestEffect(int maxParticles, bool isStill, int priority)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(maxParticles, 200.f, 10.f, isStill));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1);
+	ParticleBudgetSettings settings;
+	settings.m_priority = priority;
+	effect->SetBudgetSettings(settings);
+	effect->AddInstance(Mat44());
+	return effect;
+}
+
+GAME_TEST(ParticleBudget_HigherPriorityEvictsLowerPriority)
+{
+	BatchedParticleEffect* ambient = CreateBudgetTestEffect(100, false, 0);
+	BatchedParticleEffect* critical = CreateBudgetTestEffect(100, false, 10);
+	ambient->Update(0.25f);
+	critical->Update(0.25f);
+	GAME_TEST_CHECK(ambient->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(critical->GetNumAliveParticles() == 50);
+
+	//60 fit, so the critical effect keeps all of them and the ambient one loses what it held
+	ParticleBudgetManager budget(60);
+	std::vector<BatchedParticleEffect*> effects = { ambient, critical };
+	budget.Arbitrate(effects);
+	GAME_TEST_CHECK(critical->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(ambient->GetNumAliveParticles() == 0);
+	GAME_TEST_CHECK(budget.GetNumEvictedParticles() == 50);
+	GAME_TEST_CHECK(budget.GetNumThrottledEffects() == 2);
+	delete ambient;
+	delete critical;
+}
+
+GAME_TEST(ParticleBudget_CountsOnlyParticlesActuallyEvicted)
+{
+	//static particles count as alive but cannot be evicted, so the budget must not count them as freed
+	BatchedParticleEffect* ambient = CreateBudgetTestEffect(100, true, 0);
+	BatchedParticleEffect* critical = CreateBudgetTestEffect(100, false, 10);
+	ambient->Update(0.25f);
+	critical->Update(0.25f);
+	GAME_TEST_CHECK(ambient->GetNumStaticParticles() == 50);
+
+	ParticleBudgetManager budget(60);
+	std::vector<BatchedParticleEffect*> effects = { ambient, critical };
+	budget.Arbitrate(effects);
+	GAME_TEST_CHECK(ambient->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(budget.GetNumEvictedParticles() == 0);
+	delete ambient;
+	delete critical;
+}
+
+GAME_TEST(ParticleBudget_DemandIsRecordedBeforeClamping)
+{
+	//the emitter asks for 50 particles but only has room for 10, all 50 are its demand
+	BatchedParticleEffect* effect = CreateBudgetTestEffect(10, false, 0);
+	effect->Update(0.25f);
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() == 10);
+	GAME_TEST_CHECK(effect->GetRequestedSpawnsPeak() == 50);
+	delete effect;
+}
+
+GAME_TEST(ParticleBudget_GuaranteesComeBeforePriority)
+{
+	BatchedParticleEffect* guaranteed = CreateBudgetTestEffect(100, false, 0);
+	BatchedParticleEffect* critical = CreateBudgetTestEffect(100, false, 10);
+	ParticleBudgetSettings settings = guaranteed->GetBudgetSettings();
+	settings.m_minGuaranteedParticles = 40;
+	guaranteed->SetBudgetSettings(settings);
+	guaranteed->Update(0.25f);
+	critical->Update(0.25f);
+
+	//40 of the 60 are reserved, so the critical effect gets the remaining 20 and cannot evict the guaranteed one
+	ParticleBudgetManager budget(60);
+	std::vector<BatchedParticleEffect*> effects = { guaranteed, critical };
+	budget.Arbitrate(effects);
+	GAME_TEST_CHECK(guaranteed->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(critical->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(budget.GetNumEvictedParticles() == 0);
+	GAME_TEST_CHECK(budget.GetNumThrottledEffects() == 2);
+	delete guaranteed;
+	delete critical;
+}
+
+static BatchedParticleEffect* CreateSleepingTestEffect(ParticleWorld* world)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	ParticleLODPolicy lodPolicy = ParticleLODPolicy::GetDefault();
+	lodPolicy.m_dormantDelaySeconds = 0.f;
+	effect->SetLODPolicy(lodPolicy);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->Update(0.05f);
+
+	//culled with no delay, so it sleeps right away and misses three seconds of emission
+	effect->SetAllInstancesCulled();
+	for (int frame = 0; frame < 30; frame++)
+	{
+		effect->Update(0.1f);
+	}
+	return effect;
+}
+
+GAME_TEST(ParticleBudget_CatchUpStaysWithinTheCap)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	Camera camera;
+	world->SetViewFrustum(ParticleFrustum::CreateFromCamera(camera, 60.f, 2.f, 0.1f, 100.f));
+	BatchedParticleEffect* unbudgeted = CreateSleepingTestEffect(world);
+	BatchedParticleEffect* budgeted = CreateSleepingTestEffect(world);
+	GAME_TEST_CHECK(budgeted->GetNumDormantInstances() == 1);
+	GAME_TEST_CHECK(budgeted->GetNumAliveParticles() == 10);
+
+	//waking up replays enough emission to fill the instance, unless the budget handed out less than that
+	ParticleBudgetManager budget(30);
+	std::vector<BatchedParticleEffect*> effects(1, budgeted);
+	budget.Arbitrate(effects);
+	unbudgeted->SetInstanceVisible(0);
+	budgeted->SetInstanceVisible(0);
+	unbudgeted->Update(0.1f);
+	budgeted->Update(0.1f);
+	GAME_TEST_CHECK(unbudgeted->GetNumDormantInstances() == 0 && budgeted->GetNumDormantInstances() == 0);
+	GAME_TEST_CHECK(unbudgeted->GetNumAliveParticles() == 100);
+	GAME_TEST_CHECK(budgeted->GetNumAliveParticles() <= 30);
+
+	delete unbudgeted;
+	delete budgeted;
+	world->Shutdown();
+	delete world;
+}
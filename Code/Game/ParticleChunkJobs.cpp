@@ -0,0 +1,87 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Game/ParticleChunkJobs.hpp"
+
+struct ParticleChunkDispatch
+{
+	std::mutex m_mutex;
+	std::condition_variable m_chunksFinished;
+	int m_numUnfinishedChunks = 0;
+};
+
+void ParticleChunkJob::ExecuteTagged()
+{
+	ExecuteChunk(m_chunkIndex);
+	if (!m_dispatch)
+		return;
+
+	//the dispatch lives on the waiting thread's stack, so it is only touched under its lock and the waiter wakes after the unlock
+	std::lock_guard<std::mutex> lock(m_dispatch->m_mutex);
+	m_dispatch->m_numUnfinishedChunks--;
+	if (m_dispatch->m_numUnfinishedChunks == 0)
+		m_dispatch->m_chunksFinished.notify_one();
+}
+
+void RunParticleChunkJobs(JobSystem* jobSystem, const std::vector<ParticleChunkJob*>& jobs, int numChunks)
+{
+	if (numChunks <= 0)
+		return;
+
+	//someone else's jobs in flight would finish into the same queue as ours, and hold up the workers we would be waiting on
+	bool isJobSystemFree = jobSystem && jobSystem->GetNumWorkerThreads() > 0 && jobSystem->GetNumQueuedJobs() == 0 && jobSystem->GetNumExecutingJobs() == 0;
+	if (!isJobSystemFree || numChunks == 1)
+	{
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			jobs[chunk]->ExecuteChunk(jobs[chunk]->m_chunkIndex);
+		}
+		return;
+	}
+
+	ParticleChunkDispatch dispatch;
+	dispatch.m_numUnfinishedChunks = numChunks - 1;
+	for (int chunk = 1; chunk < numChunks; chunk++)
+	{
+		jobs[chunk]->m_dispatch = &dispatch;
+		jobs[chunk]->CaptureMemoryCategory();
+		jobSystem->QueueJob(jobs[chunk]);
+	}
+	jobs[0]->ExecuteChunk(jobs[0]->m_chunkIndex);
+	{
+		std::unique_lock<std::mutex> lock(dispatch.m_mutex);
+		while (dispatch.m_numUnfinishedChunks > 0)
+		{
+			dispatch.m_chunksFinished.wait(lock);
+		}
+	}
+
+	//every chunk has run, but a job can report in just before the job system moves it to the finished queue,
+	//and it has to leave that queue before it can be queued again
+	int numRetrieved = 0;
+	while (numRetrieved < numChunks - 1)
+	{
+		Job* finishedJob = jobSystem->RetrieveFinishedJob();
+		if (!finishedJob)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		bool isOurs = false;
+		for (int chunk = 1; chunk < numChunks && !isOurs; chunk++)
+		{
+			isOurs = finishedJob == jobs[chunk];
+		}
+
+		//nothing else was queued or running when the dispatch started, so this was left behind by code that no longer waits on it
+		if (!isOurs)
+		{
+			ERROR_RECOVERABLE("Particle chunk jobs retrieved a finished job they did not queue, its owner never retrieved it");
+			continue;
+		}
+		static_cast<ParticleChunkJob*>(finishedJob)->m_dispatch = nullptr;
+		numRetrieved++;
+	}
+}
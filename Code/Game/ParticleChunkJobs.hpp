@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/MemoryTracker.hpp"
+
+struct ParticleChunkDispatch;
+
+//One chunk of a loop split across workers by RunParticleChunkJobs.
+class ParticleChunkJob : public MemoryTaggedJob
+{
+	friend void RunParticleChunkJobs(JobSystem* jobSystem, const std::vector<ParticleChunkJob*>& jobs, int numChunks);
+
+public:
+	ParticleChunkJob(int chunkIndex) : m_chunkIndex(chunkIndex) {}
+	virtual void ExecuteTagged() override final;
+
+protected:
+	virtual void ExecuteChunk(int chunkIndex) = 0;
+
+private:
+	int m_chunkIndex = 0;
+	ParticleChunkDispatch* m_dispatch = nullptr;		//the dispatch that queued this job, which it reports finishing to
+};
+
+//Runs the first numChunks jobs and returns once all of them are done. The calling thread runs the first chunk itself
+//instead of idling, the rest are queued, and it sleeps on a counter of this dispatch alone until they have all run.
+//The job system may be shared with code that retrieves its own jobs, like the particles manager, as long as that code has
+//retrieved everything it queued before a dispatch starts. When other jobs are still queued or running, the chunks run
+//serially on the calling thread instead, so their finished jobs are never taken and the dispatch never waits behind them.
+void RunParticleChunkJobs(JobSystem* jobSystem, const std::vector<ParticleChunkJob*>& jobs, int numChunks);
@@ -0,0 +1,280 @@
+#include <math.h>
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleFrustum.hpp"
+#include "Game/ParticleBoundsTree.hpp"
+#include "Game/ParticleOcclusionBuffer.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+//the default camera sits at the origin looking down +x
+static ParticleFrustum MakeTestFrustum()
+{
+	Camera camera;
+	return ParticleFrustum::CreateFromCamera(camera, 60.f, 2.f, 0.1f, 100.f);
+}
+
+static AABB3 MakeCube(const Vec3& center, float halfSize)
+{
+	return AABB3(center - Vec3(halfSize, halfSize, halfSize), center + Vec3(halfSize, halfSize, halfSize));
+}
+
+GAME_TEST(ParticleFrustum_KeepsBoundsInViewAndDropsTheRest)
+{
+	ParticleFrustum frustum = MakeTestFrustum();
+	GAME_TEST_CHECK(frustum.IsOverlappingAABB(MakeCube(Vec3(10.f, 0.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!frustum.IsOverlappingAABB(MakeCube(Vec3(-10.f, 0.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!frustum.IsOverlappingAABB(MakeCube(Vec3(200.f, 0.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!frustum.IsOverlappingAABB(MakeCube(Vec3(10.f, 50.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!frustum.IsOverlappingAABB(MakeCube(Vec3(10.f, 0.f, -20.f), 1.f)));
+
+	//bounds only partly inside still count, the test is conservative
+	GAME_TEST_CHECK(frustum.IsOverlappingAABB(MakeCube(Vec3(0.f, 0.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(frustum.IsOverlappingAABB(MakeCube(Vec3(10.f, 12.f, 0.f), 1.f)));
+}
+
+GAME_TEST(ParticleBoundsTree_QueryMatchesTestingEveryProxy)
+{
+	ParticleFrustum frustum = MakeTestFrustum();
+	ParticleBoundsTree tree;
+	std::vector<AABB3> bounds;
+	std::vector<int> proxyIds;
+	for (int i = 0; i < 200; i++)
+	{
+		//a ring of cubes around the camera, so about a sixth of them are in view
+		float degrees = float(i) * 1.8f;
+		Vec3 center(cosf(ConvertDegreesToRadians(degrees)) * float(5 + i % 40), sinf(ConvertDegreesToRadians(degrees)) * float(5 + i % 40), float(i % 7) - 3.f);
+		bounds.push_back(MakeCube(center, 0.5f));
+		proxyIds.push_back(tree.CreateProxy(bounds.back(), nullptr, i));
+	}
+	GAME_TEST_CHECK(tree.GetNumProxies() == 200);
+
+	std::vector<int> visibleIds;
+	tree.QueryFrustum(frustum, visibleIds);
+	std::vector<bool> isReturned(200, false);
+	for (int i = 0; i < int(visibleIds.size()); i++)
+	{
+		isReturned[tree.GetProxyInstanceIndex(visibleIds[i])] = true;
+	}
+	//leaves keep fattened bounds, so the query may return a proxy just outside the view but must never miss one inside it
+	int numMissed = 0;
+	int numTooFar = 0;
+	int numInView = 0;
+	for (int i = 0; i < 200; i++)
+	{
+		bool isInView = frustum.IsOverlappingAABB(bounds[i]);
+		numInView += isInView ? 1 : 0;
+		if (isInView && !isReturned[i])
+			numMissed++;
+		if (isReturned[i] && !frustum.IsOverlappingAABB(MakeCube((bounds[i].m_mins + bounds[i].m_maxs) * 0.5f, 1.5f)))
+			numTooFar++;
+	}
+	GAME_TEST_CHECK(numMissed == 0);
+	GAME_TEST_CHECK(numTooFar == 0);
+	GAME_TEST_CHECK(numInView > 0 && numInView < 200);
+
+	//moving a proxy from behind the camera into view and destroying another are both seen by the next query
+	int behindIndex = 100;
+	GAME_TEST_CHECK(!isReturned[behindIndex]);
+	tree.MoveProxy(proxyIds[behindIndex], MakeCube(Vec3(20.f, 0.f, 0.f), 0.5f));
+	tree.DestroyProxy(proxyIds[0]);
+	visibleIds.clear();
+	tree.QueryFrustum(frustum, visibleIds);
+	bool hasMovedProxy = false;
+	bool hasDestroyedProxy = false;
+	for (int i = 0; i < int(visibleIds.size()); i++)
+	{
+		hasMovedProxy = hasMovedProxy || visibleIds[i] == proxyIds[behindIndex];
+		hasDestroyedProxy = hasDestroyedProxy || visibleIds[i] == proxyIds[0];
+	}
+	GAME_TEST_CHECK(hasMovedProxy);
+	GAME_TEST_CHECK(!hasDestroyedProxy);
+	GAME_TEST_CHECK(tree.GetNumProxies() == 199);
+}
+
+GAME_TEST(ParticleWorld_CulledInstancesBuildNoRenderData)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	world->SetViewFrustum(MakeTestFrustum());
+
+	//one instance in front of the camera and one behind it, each spawning 50 particles
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 2, world);
+	ParticleLODPolicy lodPolicy = ParticleLODPolicy::GetDefault();
+	lodPolicy.m_dormantDelaySeconds = -1.f;
+	effect->SetLODPolicy(lodPolicy);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(-10.f, 0.f, 0.f)));
+	effect->Update(0.25f);
+	world->CullBatchedEffects();
+	GAME_TEST_CHECK(world->GetNumVisibleInstances() == 1);
+	GAME_TEST_CHECK(world->GetNumCulledInstances() == 1);
+
+	//both instances keep simulating, only the one in view builds quads
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() == 100);
+	Camera camera;
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetEmitterVerts(0).size() == 50 * 6);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
+
+//a 6x6 wall facing the camera at x = 10
+static std::vector<Vec3> MakeTestWallTriangles()
+{
+	Vec3 topLeft(10.f, 3.f, 3.f);
+	Vec3 botLeft(10.f, 3.f, -3.f);
+	Vec3 botRight(10.f, -3.f, -3.f);
+	Vec3 topRight(10.f, -3.f, 3.f);
+	std::vector<Vec3> triangles = { topLeft, botLeft, botRight, topLeft, botRight, topRight };
+	return triangles;
+}
+
+GAME_TEST(ParticleOcclusionBuffer_HidesBoundsBehindAnOccluderOnly)
+{
+	ParticleOcclusionBuffer occlusionBuffer(64, 32);
+	int wallId = occlusionBuffer.AddOccluder(MakeTestWallTriangles(), Mat44());
+	occlusionBuffer.RasterizeOccluders(MakeTestFrustum());
+	GAME_TEST_CHECK(occlusionBuffer.GetNumRasterizedTriangles() == 2);
+
+	//the wall covers y and z within 6 of the axis at x = 20, so a box on the axis is hidden and one off to the side is not
+	GAME_TEST_CHECK(occlusionBuffer.IsOccluded(MakeCube(Vec3(20.f, 0.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!occlusionBuffer.IsOccluded(MakeCube(Vec3(20.f, 12.f, 0.f), 1.f)));
+	GAME_TEST_CHECK(!occlusionBuffer.IsOccluded(MakeCube(Vec3(5.f, 0.f, 0.f), 1.f)));
+
+	//bounds reaching past the edge of the wall, or through it, may be partly seen
+	GAME_TEST_CHECK(!occlusionBuffer.IsOccluded(MakeCube(Vec3(20.f, 5.f, 0.f), 2.f)));
+	GAME_TEST_CHECK(!occlusionBuffer.IsOccluded(MakeCube(Vec3(10.f, 0.f, 0.f), 1.f)));
+
+	//moving the wall out of the way uncovers the box behind it
+	occlusionBuffer.SetOccluderTransform(wallId, Mat44::CreateTranslation3D(Vec3(0.f, 30.f, 0.f)));
+	occlusionBuffer.RasterizeOccluders(MakeTestFrustum());
+	GAME_TEST_CHECK(!occlusionBuffer.IsOccluded(MakeCube(Vec3(20.f, 0.f, 0.f), 1.f)));
+}
+
+GAME_TEST(ParticleWorld_OccludedInstancesBuildNoRenderData)
+{
+	ParticleWorldConfig config;
+	config.m_occlusionBufferSize = IntVec2(64, 32);
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	world->SetViewFrustum(MakeTestFrustum());
+	world->GetOcclusionBuffer()->AddOccluder(MakeTestWallTriangles(), Mat44());
+
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 2, world);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(20.f, 0.f, 0.f)));
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(20.f, 12.f, 0.f)));
+	effect->Update(0.25f);
+	world->CullBatchedEffects();
+	GAME_TEST_CHECK(world->GetNumOccludedInstances() == 1);
+	GAME_TEST_CHECK(world->GetNumVisibleInstances() == 1);
+
+	Camera camera;
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetEmitterVerts(0).size() == 50 * 6);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
+
+static BatchedParticleEffect* CreateScreenCullTestEffect(ParticleWorld* world, int maxParticles, float particlesPerSecond, const ParticleScreenCullSettings& settings)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(maxParticles, particlesPerSecond, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 2, world);
+	effect->SetScreenCullSettings(settings);
+
+	//a single band, so distance does not thin out the far instance before the screen cull sees it
+	ParticleLODPolicy lodPolicy;
+	lodPolicy.m_bands.push_back(ParticleLODBand());
+	lodPolicy.m_dormantDelaySeconds = -1.f;
+	effect->SetLODPolicy(lodPolicy);
+	return effect;
+}
+
+GAME_TEST(ParticleScreenCull_DropsSubPixelParticles)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	world->SetViewFrustum(MakeTestFrustum());
+	world->SetScreenSize(IntVec2(1600, 800));
+
+	//half unit particles are about 35 pixels across at 10 units and 4 at 90
+	ParticleScreenCullSettings settings;
+	settings.m_isEnabled = true;
+	settings.m_minPixelSize = 6.f;
+	settings.m_maxParticlesPerTile = 0;
+	BatchedParticleEffect* effect = CreateScreenCullTestEffect(world, 100, 200.f, settings);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(90.f, 0.f, 0.f)));
+	effect->Update(0.25f);
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() == 100);
+
+	Camera camera;
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetScreenCullStats().m_numSubPixelCulled == 50);
+	GAME_TEST_CHECK(effect->GetScreenCullStats().m_numTileCapCulled == 0);
+	GAME_TEST_CHECK(effect->GetEmitterVerts(0).size() == 50 * 6);
+
+	//the world reports what its effects culled on the last frame they were drawn
+	world->CullBatchedEffects();
+	GAME_TEST_CHECK(world->GetScreenCullStats().m_numSubPixelCulled == 50);
+
+	//turned off, nothing is dropped
+	settings.m_isEnabled = false;
+	effect->SetScreenCullSettings(settings);
+	effect->Update(0.f);
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetScreenCullStats().m_numSubPixelCulled == 0);
+	GAME_TEST_CHECK(effect->GetEmitterVerts(0).size() == 100 * 6);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
+
+GAME_TEST(ParticleScreenCull_CapsParticlesPerTile)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	world->SetViewFrustum(MakeTestFrustum());
+	world->SetScreenSize(IntVec2(1600, 800));
+
+	//a thousand particles within half a unit of each other all land in the few tiles around the center of the screen
+	ParticleScreenCullSettings settings;
+	settings.m_isEnabled = true;
+	settings.m_minPixelSize = 0.f;
+	settings.m_tileSizePixels = 64;
+	settings.m_maxParticlesPerTile = 8;
+	BatchedParticleEffect* effect = CreateScreenCullTestEffect(world, 1000, 4000.f, settings);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->Update(0.25f);
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() == 1000);
+
+	Camera camera;
+	effect->UpdateRenderData(camera);
+	int numCulled = effect->GetScreenCullStats().m_numTileCapCulled;
+	int numKept = int(effect->GetEmitterVerts(0).size()) / 6;
+	GAME_TEST_CHECK(numCulled + numKept == 1000);
+	GAME_TEST_CHECK(numKept > 0 && numKept < 200);
+
+	//survivors are picked by a rank fixed at spawn, so the same frame keeps the same particles
+	std::vector<Vertex_PCU> keptVerts = effect->GetEmitterVerts(0);
+	effect->Update(0.f);
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetEmitterVerts(0).size() == keptVerts.size());
+	GAME_TEST_CHECK(effect->GetScreenCullStats().m_numTileCapCulled == numCulled);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Math/EulerAngles.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/ParticleDrawBatcher.hpp"
+#include "Game/ParticleInstanceBuffer.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+ParticleDrawBatcher::~ParticleDrawBatcher()
+{
+	delete m_instanceBuffer;
+	m_instanceBuffer = nullptr;
+}
+
+void ParticleDrawBatcher::Render(const BatchedParticleEffect* const* effects, int numEffects, const Camera& camera, RenderBackend& backend)
+{
+	if (Build(effects, numEffects, camera))
+		UploadInstances();
+
+	Vec3 cameraForward, cameraLeft, cameraUp;
+	camera.GetOrientation().GetAsVectors_XFwd_YLeft_ZUp(cameraForward, cameraLeft, cameraUp);
+	Draw(backend, cameraLeft, cameraUp);
+}
+
+bool ParticleDrawBatcher::Build(const BatchedParticleEffect* const* effects, int numEffects, const Camera& camera)
+{
+	bool isChanged = numEffects != int(m_effects.size());
+	for (int effectIndex = 0; effectIndex < numEffects; effectIndex++)
+	{
+		effects[effectIndex]->UpdateRenderData(camera);
+		isChanged = isChanged || m_effects[effectIndex] != effects[effectIndex] || m_effectVersions[effectIndex] != effects[effectIndex]->GetRenderDataVersion();
+	}
+	if (!isChanged)
+		return false;
+
+	m_effects.assign(effects, effects + numEffects);
+	m_effectVersions.resize(numEffects);
+	for (int effectIndex = 0; effectIndex < numEffects; effectIndex++)
+	{
+		m_effectVersions[effectIndex] = effects[effectIndex]->GetRenderDataVersion();
+	}
+	LayOutDraws();
+	return true;
+}
+
+void ParticleDrawBatcher::LayOutDraws()
+{
+	int numEffects = int(m_effects.size());
+	m_items.clear();
+	m_itemStarts.clear();
+	m_origins.clear();
+	m_frameUVs.clear();
+	m_originBases.clear();
+	m_frameBases.clear();
+	m_maxInstances = 0;
+	for (int effectIndex = 0; effectIndex < numEffects; effectIndex++)
+	{
+		const BatchedParticleEffect* effect = m_effects[effectIndex];
+		m_itemStarts.push_back(int(m_items.size()));
+		effect->GetDrawItems(m_items);
+		m_originBases.push_back(int(m_origins.size()));
+		m_frameBases.push_back(int(m_frameUVs.size()));
+		m_origins.insert(m_origins.end(), effect->GetInstanceOrigins().begin(), effect->GetInstanceOrigins().end());
+		m_frameUVs.insert(m_frameUVs.end(), effect->GetFrameUVs().begin(), effect->GetFrameUVs().end());
+		m_maxInstances += effect->GetMaxParticles();
+	}
+	m_itemStarts.push_back(int(m_items.size()));
+	GUARANTEE_OR_DIE(m_origins.size() <= 0x10000 && m_frameUVs.size() <= 0x10000, "Batched particle effects drawn together have more origins or frames than a compact instance can index");
+
+	//the first effect with items left leads each draw, and every effect after it adds its next items while they match
+	m_cursors.assign(m_itemStarts.begin(), m_itemStarts.end() - 1);
+	m_draws.clear();
+	m_ranges.clear();
+	m_verts.clear();
+	m_numInstances = 0;
+	int leadEffect = 0;
+	for (;;)
+	{
+		while (leadEffect < numEffects && m_cursors[leadEffect] == m_itemStarts[leadEffect + 1])
+		{
+			leadEffect++;
+		}
+		if (leadEffect == numEffects)
+			break;
+
+		const BatchedDrawItem& leadItem = m_items[m_cursors[leadEffect]];
+		ParticleBatchedDraw draw;
+		draw.m_effect = m_effects[leadEffect];
+		draw.m_kind = leadItem.m_kind;
+		draw.m_emitterIndex = leadItem.m_emitterIndex;
+		if (draw.m_kind == BatchedDrawKind::EMITTER_PASSES || draw.m_kind == BatchedDrawKind::IMPOSTORS)
+		{
+			m_cursors[leadEffect]++;
+			m_draws.push_back(draw);
+			continue;
+		}
+
+		draw.m_first = draw.m_kind == BatchedDrawKind::COMPACT ? m_numInstances : int(m_verts.size());
+		for (int effectIndex = leadEffect; effectIndex < numEffects; effectIndex++)
+		{
+			const BatchedParticleEffect* effect = m_effects[effectIndex];
+			int& cursor = m_cursors[effectIndex];
+			while (cursor < m_itemStarts[effectIndex + 1] && CanJoin(draw, effect, m_items[cursor]))
+			{
+				int emitterIndex = m_items[cursor].m_emitterIndex;
+				if (draw.m_kind == BatchedDrawKind::COMPACT)
+				{
+					ParticleBatchedRange range;
+					range.m_effectIndex = effectIndex;
+					range.m_emitterIndex = emitterIndex;
+					range.m_firstInstance = m_numInstances;
+					m_ranges.push_back(range);
+					m_numInstances += effect->GetNumEmitterInstances(emitterIndex);
+					draw.m_count += effect->GetNumEmitterInstances(emitterIndex);
+				}
+				else
+				{
+					//only copied once a second item joins
+					const std::vector<Vertex_PCU>& verts = effect->GetEmitterVerts(emitterIndex);
+					if (draw.m_numItems == 1)
+					{
+						const std::vector<Vertex_PCU>& leadVerts = draw.m_effect->GetEmitterVerts(draw.m_emitterIndex);
+						m_verts.insert(m_verts.end(), leadVerts.begin(), leadVerts.end());
+					}
+					if (draw.m_numItems >= 1)
+						m_verts.insert(m_verts.end(), verts.begin(), verts.end());
+					draw.m_count += int(verts.size());
+				}
+				draw.m_numItems++;
+				cursor++;
+			}
+		}
+		m_draws.push_back(draw);
+	}
+}
+
+bool ParticleDrawBatcher::CanJoin(const ParticleBatchedDraw& draw, const BatchedParticleEffect* effect, const BatchedDrawItem& item) const
+{
+	if (item.m_kind != draw.m_kind)
+		return false;
+
+	//verts are billboarded already, compact instances take the billboard mode from the draw
+	const BakedParticleEmitter& leadEmitter = draw.m_effect->GetEmitter(draw.m_emitterIndex);
+	const BakedParticleEmitter& emitter = effect->GetEmitter(item.m_emitterIndex);
+	if (draw.m_kind == BatchedDrawKind::COMPACT && leadEmitter.m_renderMode != emitter.m_renderMode)
+		return false;
+	return leadEmitter.m_blendMode == emitter.m_blendMode && leadEmitter.m_textureHash == emitter.m_textureHash;
+}
+
+void ParticleDrawBatcher::UploadInstances()
+{
+	if (m_numInstances == 0)
+		return;
+
+	if (m_instanceBuffer && m_instanceBuffer->GetMaxInstances() < m_numInstances)
+	{
+		delete m_instanceBuffer;
+		m_instanceBuffer = nullptr;
+	}
+	if (!m_instanceBuffer)
+		m_instanceBuffer = new ParticleInstanceBuffer(std::max(m_maxInstances, m_numInstances));
+
+	CompactParticleInstance* mappedInstances = m_instanceBuffer->MapInstances();
+	for (int rangeIndex = 0; rangeIndex < int(m_ranges.size()); rangeIndex++)
+	{
+		const ParticleBatchedRange& range = m_ranges[rangeIndex];
+		m_effects[range.m_effectIndex]->WriteEmitterInstances(range.m_emitterIndex, mappedInstances + range.m_firstInstance, m_originBases[range.m_effectIndex], m_frameBases[range.m_effectIndex]);
+	}
+	m_instanceBuffer->UnmapInstances(m_numInstances);
+	m_instanceBuffer->SetOrigins(m_origins);
+	m_instanceBuffer->SetFrameUVs(m_frameUVs);
+}
+
+void ParticleDrawBatcher::CaptureCompactDraws(ParticleInstanceCapture& capture, const Camera& camera) const
+{
+	//the staging copy holds what was last sent up, with or without a renderer
+	const CompactParticleInstance* instances = m_instanceBuffer ? m_instanceBuffer->GetCpuInstances() : nullptr;
+	if (m_numInstances == 0 || !instances)
+		return;
+
+	Vec3 cameraForward, cameraLeft, cameraUp;
+	camera.GetOrientation().GetAsVectors_XFwd_YLeft_ZUp(cameraForward, cameraLeft, cameraUp);
+	CapturedParticleEffect& capturedEffect = capture.BeginEffect(m_origins, m_frameUVs);
+	capturedEffect.m_instances.assign(instances, instances + m_numInstances);
+	for (int drawIndex = 0; drawIndex < int(m_draws.size()); drawIndex++)
+	{
+		const ParticleBatchedDraw& draw = m_draws[drawIndex];
+		if (draw.m_kind != BatchedDrawKind::COMPACT)
+			continue;
+
+		const BakedParticleEmitter& emitter = draw.m_effect->GetEmitter(draw.m_emitterIndex);
+		CapturedParticleDraw capturedDraw;
+		capturedDraw.m_firstInstance = draw.m_first;
+		capturedDraw.m_numInstances = draw.m_count;
+		capturedDraw.m_blendMode = emitter.m_blendMode;
+		capturedDraw.m_texturePath = emitter.m_texturePath;
+		capturedDraw.m_isHorizontal = emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD;
+		capturedDraw.m_cameraLeft = cameraLeft;
+		capturedDraw.m_cameraUp = cameraUp;
+		capture.AddDraw(capturedDraw);
+	}
+}
+
+void ParticleDrawBatcher::Draw(RenderBackend& backend, const Vec3& cameraLeft, const Vec3& cameraUp) const
+{
+	backend.BindShader(nullptr);
+	backend.SetModelConstants(Mat44::IDENTITY, Rgba8::WHITE);
+	backend.SetRasterizerState(CullMode::NONE, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
+	backend.SetDepthStencilState(DepthTest::LESSEQUAL, false);
+	for (int drawIndex = 0; drawIndex < int(m_draws.size()); drawIndex++)
+	{
+		const ParticleBatchedDraw& draw = m_draws[drawIndex];
+		if (draw.m_kind == BatchedDrawKind::EMITTER_PASSES)
+		{
+			draw.m_effect->DrawEmitterPasses(backend, draw.m_emitterIndex, cameraLeft, cameraUp);
+			continue;
+		}
+		if (draw.m_kind == BatchedDrawKind::IMPOSTORS)
+		{
+			draw.m_effect->DrawImpostors(backend);
+			continue;
+		}
+
+		const BakedParticleEmitter& emitter = draw.m_effect->GetEmitter(draw.m_emitterIndex);
+		backend.SetBlendMode(emitter.m_blendMode);
+		backend.BindTexture(draw.m_effect->GetEmitterTexture(draw.m_emitterIndex));
+		if (draw.m_kind == BatchedDrawKind::COMPACT)
+		{
+			m_instanceBuffer->Draw(backend, draw.m_first, draw.m_count, cameraLeft, cameraUp, emitter.m_renderMode == RenderMode::HORIZONTAL_BILLBOARD);
+			backend.BindShader(nullptr);
+		}
+		else
+		{
+			const Vertex_PCU* verts = draw.m_numItems == 1 ? draw.m_effect->GetEmitterVerts(draw.m_emitterIndex).data() : &m_verts[draw.m_first];
+			backend.DrawVertexArray(draw.m_count, verts);
+		}
+	}
+	backend.SetDepthStencilState(DepthTest::LESSEQUAL, true);
+	backend.SetRasterizerState(CullMode::BACK, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
+	backend.SetBlendMode(BlendMode::ALPHA);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+class Camera;
+class RenderBackend;
+class ParticleInstanceBuffer;
+class ParticleInstanceCapture;
+
+//One draw of the batcher, made of the items of one or more effects that share a texture, blend and billboard mode.
+struct ParticleBatchedDraw
+{
+	const BatchedParticleEffect* m_effect = nullptr;		//effect whose emitter sets the state, or that draws its own passes
+	BatchedDrawKind m_kind = BatchedDrawKind::COMPACT;
+	int m_emitterIndex = -1;
+	int m_first = 0;		//first instance of the shared stream, or first vert
+	int m_count = 0;		//instances or verts
+	int m_numItems = 0;		//verts of a single item are drawn straight from their effect
+};
+
+//Where one emitter's compact instances go in the shared stream.
+struct ParticleBatchedRange
+{
+	int m_effectIndex = 0;
+	int m_emitterIndex = -1;
+	int m_firstInstance = 0;
+};
+
+//Draws a set of batched effects together, so many small effects on the same atlas page cost a handful of draws in total.
+//Every effect keeps its own draw order, while the next draws of different effects that share a texture, blend and billboard mode
+//become one draw. Effects have no order among each other, so joining only ever moves a draw ahead of another effect's.
+//Unsorted quads are joined into one vert array, and compact instances into one stream laid out in the joined order,
+//whose origin and frame tables hold those of every effect. Nothing is laid out again while no effect rebuilt its render data.
+//Every draw, including the ones effects make themselves, goes to the render backend passed in, so a headless world counts them.
+class ParticleDrawBatcher
+{
+public:
+	ParticleDrawBatcher() = default;
+	~ParticleDrawBatcher();
+
+	void Render(const BatchedParticleEffect* const* effects, int numEffects, const Camera& camera, RenderBackend& backend);
+	bool Build(const BatchedParticleEffect* const* effects, int numEffects, const Camera& camera);		//cpu half of Render, true when the draws were laid out again
+	void CaptureCompactDraws(ParticleInstanceCapture& capture, const Camera& camera) const;			//the shared stream of the last Render, without a renderer only
+	int GetNumDraws() const { return int(m_draws.size()); }
+	const ParticleBatchedDraw& GetDraw(int drawIndex) const { return m_draws[drawIndex]; }
+	int GetNumItems() const { return int(m_items.size()); }
+
+private:
+	std::vector<const BatchedParticleEffect*> m_effects;	//what the draws were laid out for
+	std::vector<unsigned int> m_effectVersions;			//render data version of each effect when the draws were laid out
+	std::vector<BatchedDrawItem> m_items;
+	std::vector<int> m_itemStarts;		//first item of each effect, plus the end
+	std::vector<int> m_cursors;
+	std::vector<ParticleBatchedDraw> m_draws;
+	std::vector<ParticleBatchedRange> m_ranges;
+	std::vector<Vertex_PCU> m_verts;
+	std::vector<Vec3> m_origins;
+	std::vector<AABB2> m_frameUVs;
+	std::vector<int> m_originBases;
+	std::vector<int> m_frameBases;
+	int m_numInstances = 0;
+	int m_maxInstances = 0;			//most compact instances the effects can have together
+	ParticleInstanceBuffer* m_instanceBuffer = nullptr;
+
+private:
+	void LayOutDraws();
+	bool CanJoin(const ParticleBatchedDraw& draw, const BatchedParticleEffect* effect, const BatchedDrawItem& item) const;
+	void UploadInstances();
+	void Draw(RenderBackend& backend, const Vec3& cameraLeft, const Vec3& cameraUp) const;
+};
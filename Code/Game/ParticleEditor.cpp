@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "ThirdParty/ImGUI/imgui.h"
 #include "Game/ParticleEditor.hpp"
 #include "Game/EmitterWindow.hpp"
@@ -98,6 +100,21 @@ void ParticleEditor::SaveDataToXML()
 	tinyxml2::XMLDocument particleSystemData;
 	XmlElement* rootNode = particleSystemData.NewElement("ParticleSystem");
 	particleSystemData.InsertFirstChild(rootNode);
+
+	//lod bands, screen culling, budget and loop clip settings are not edited here, carry over whatever the file already has
+	const char* preservedElementNames[] = { "LOD", "ScreenCull", "Budget", "Loop" };
+	tinyxml2::XMLDocument existingData;
+	if (existingData.LoadFile(m_filepath.c_str()) == tinyxml2::XML_SUCCESS && existingData.RootElement())
+	{
+		for (int i = 0; i < int(sizeof(preservedElementNames) / sizeof(preservedElementNames[0])); i++)
+		{
+			const XmlElement* preservedElement = existingData.RootElement()->FirstChildElement(preservedElementNames[i]);
+			if (preservedElement)
+			{
+				rootNode->InsertEndChild(preservedElement->DeepClone(&particleSystemData));
+			}
+		}
+	}
 	for (int i = 0; i < m_emitterWindows.size(); i++)
 	{
 		XmlElement* emitterData = m_emitterWindows[i]->SaveDataToXMLElement(particleSystemData);
@@ -118,3 +135,4 @@ void ParticleEditor::UpdateAndSaveData()
 	}
 	SaveDataToXML();
 }
+#endif
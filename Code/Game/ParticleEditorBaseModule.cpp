@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorBaseModule.hpp"
 #include "Engine/Core/XmlUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
@@ -58,3 +60,4 @@ void ParticleEditorBaseModule::UpdateWindow()
 		ImGui::Combo("SimSpace", (int*)&m_simSpace, SIM_SPACE_TYPES, SIM_SPACE_TYPE_COUNT);
 	}
 }
+#endif
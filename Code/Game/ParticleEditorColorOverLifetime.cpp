@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include <algorithm>
 #include "Game/ParticleEditorColorOverLifetime.hpp"
 
@@ -67,3 +69,4 @@ void ParticleEditorColorOverLifetime::UpdateWindow()
 		m_colorKeys.erase(m_colorKeys.begin() + keyToDelete);
 	}
 }
+#endif
@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "ThirdParty/ImGUI/imgui.h"
 #include "Game/ParticleEditorEmissionModule.hpp"
 
@@ -39,3 +41,4 @@ void ParticleEditorEmissionModule::UpdateWindow()
 	}
 }
 
+#endif
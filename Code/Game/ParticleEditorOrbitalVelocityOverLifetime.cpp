@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorOrbitalVelocityOverLifetime.hpp"
 
 void ParticleEditorOrbitalVelocityOverLifetime::LoadDataFromXML(const ParticleEmitterData& emitterData)
@@ -70,3 +72,4 @@ void ParticleEditorOrbitalVelocityOverLifetime::UpdateWindow()
 		}
 	}
 }
+#endif
@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorPhysicsModule.hpp"
 
 void ParticleEditorPhysicsModule::LoadDataFromXML(const ParticleEmitterData& emitterData)
@@ -54,3 +56,4 @@ void ParticleEditorPhysicsModule::UpdateWindow()
 		m_pointAttractors.erase(m_pointAttractors.begin() + indexToDeleteAt);
 	}
 }
+#endif
@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Engine/Renderer/Window.hpp"
 #include "Game/ParticleEditorRendererModule.hpp"
 #include "Game/Game.hpp"
@@ -78,3 +80,4 @@ void ParticleEditorRendererModule::UpdateWindow()
 		ImGui::Checkbox("Sort Particles", &m_sortParticles);
 	}
 }
+#endif
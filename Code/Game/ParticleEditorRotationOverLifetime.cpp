@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorRotationOverLifetime.hpp"
 
 void ParticleEditorRotationOverLifetime::LoadDataFromXML(const ParticleEmitterData& emitterData)
@@ -40,3 +42,4 @@ void ParticleEditorRotationOverLifetime::UpdateWindow()
 		}
 	}
 }
+#endif
@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorShapeModule.hpp"
 #include "ThirdParty/ImGUI/imgui.h"
 
@@ -84,3 +86,4 @@ std::string ParticleEditorShapeModule::GetStringForEmitterType(EmitterShape type
 	default: return "Cone";
 	}
 }
+#endif
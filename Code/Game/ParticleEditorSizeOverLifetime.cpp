@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "ThirdParty/ImGUI/imgui.h"
 #include "Game/ParticleEditorSizeOverLifetime.hpp"
 #include "Game/CurveEditor.hpp"
@@ -62,3 +64,4 @@ void ParticleEditorSizeOverLifetime::UpdateWindow()
 
 }
 
+#endif
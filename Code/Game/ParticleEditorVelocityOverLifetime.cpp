@@ -1,3 +1,5 @@
+#include "Game/EngineBuildPreferences.hpp"
+#if !defined(GAME_HEADLESS_ONLY)
 #include "Game/ParticleEditorVelocityOverLifetime.hpp"
 
 void ParticleEditorVelocityOverLifetime::LoadDataFromXML(const ParticleEmitterData& emitterData)
@@ -107,3 +109,4 @@ void ParticleEditorVelocityOverLifetime::UpdateWindow()
 		}
 	}
 }
+#endif
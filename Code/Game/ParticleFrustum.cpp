@@ -0,0 +1,56 @@
+#include <math.h>
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/EulerAngles.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/ParticleFrustum.hpp"
+
+static FrustumPlane MakePlane(const Vec3& normal, const Vec3& pointOnPlane)
+{
+	FrustumPlane plane;
+	plane.m_normal = normal.GetNormalized();
+	plane.m_distance = DotProduct3D(plane.m_normal, pointOnPlane);
+	return plane;
+}
+
+ParticleFrustum ParticleFrustum::CreateFromCamera(const Camera& camera, float fovDegrees, float aspect, float nearZ, float farZ)
+{
+	Vec3 forward, left, up;
+	camera.GetOrientation().GetAsVectors_XFwd_YLeft_ZUp(forward, left, up);
+	Vec3 position = camera.GetPosition();
+	float halfHeight = tanf(ConvertDegreesToRadians(fovDegrees * 0.5f));
+	float halfWidth = halfHeight * aspect;
+
+	ParticleFrustum frustum;
+	frustum.m_position = position;
+	frustum.m_forward = forward;
+	frustum.m_left = left;
+	frustum.m_up = up;
+	frustum.m_tanHalfFovX = halfWidth;
+	frustum.m_tanHalfFovY = halfHeight;
+	frustum.m_nearZ = nearZ;
+	frustum.m_farZ = farZ;
+	frustum.m_planes[0] = MakePlane(forward, position + forward * nearZ);
+	frustum.m_planes[1] = MakePlane(-forward, position + forward * farZ);
+	frustum.m_planes[2] = MakePlane(forward * halfWidth - left, position);		//left
+	frustum.m_planes[3] = MakePlane(forward * halfWidth + left, position);		//right
+	frustum.m_planes[4] = MakePlane(forward * halfHeight - up, position);		//top
+	frustum.m_planes[5] = MakePlane(forward * halfHeight + up, position);		//bottom
+	return frustum;
+}
+
+bool ParticleFrustum::IsOverlappingAABB(const AABB3& bounds) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		//the corner furthest along the plane normal is the last one to leave the frustum
+		const FrustumPlane& plane = m_planes[i];
+		Vec3 farthestCorner;
+		farthestCorner.x = plane.m_normal.x >= 0.f ? bounds.m_maxs.x : bounds.m_mins.x;
+		farthestCorner.y = plane.m_normal.y >= 0.f ? bounds.m_maxs.y : bounds.m_mins.y;
+		farthestCorner.z = plane.m_normal.z >= 0.f ? bounds.m_maxs.z : bounds.m_mins.z;
+		if (DotProduct3D(plane.m_normal, farthestCorner) < plane.m_distance)
+			return false;
+	}
+
+	return true;
+}
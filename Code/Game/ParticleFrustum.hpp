@@ -0,0 +1,28 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/AABB3.hpp"
+
+class Camera;
+
+struct FrustumPlane
+{
+	Vec3 m_normal;				//points into the frustum
+	float m_distance = 0.f;		//dot(m_normal, point on plane)
+};
+
+//The six planes of a perspective camera, used to cull particle bounds before any render data is built.
+struct ParticleFrustum
+{
+	FrustumPlane m_planes[6];
+	Vec3 m_position;
+	Vec3 m_forward;
+	Vec3 m_left;
+	Vec3 m_up;
+	float m_tanHalfFovX = 1.f;
+	float m_tanHalfFovY = 1.f;
+	float m_nearZ = 0.f;
+	float m_farZ = 0.f;
+
+	static ParticleFrustum CreateFromCamera(const Camera& camera, float fovDegrees, float aspect, float nearZ, float farZ);
+	bool IsOverlappingAABB(const AABB3& bounds) const;
+};
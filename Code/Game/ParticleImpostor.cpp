@@ -0,0 +1,85 @@
+#include "Engine/Core/XmlUtils.hpp"
+#include "Engine/Math/FloatRange.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Game/ParticleImpostor.hpp"
+
+const char* IMPOSTOR_BLEND_MODE_NAMES[3] = { "Alpha", "Additive", "Opaque" };
+
+ParticleImpostorDescriptor ParticleImpostorDescriptor::LoadFromFile(const char* descriptorPath)
+{
+	ParticleImpostorDescriptor descriptor;
+	XmlDocument descriptorDocument;
+	if (descriptorDocument.LoadFile(descriptorPath) != tinyxml2::XML_SUCCESS || !descriptorDocument.RootElement())
+		return descriptor;
+
+	const XmlElement* impostorElement = descriptorDocument.RootElement()->FirstChildElement("Impostor");
+	const XmlElement* emitterElement = descriptorDocument.RootElement()->FirstChildElement("EmitterData");
+	const XmlElement* rendererElement = emitterElement ? emitterElement->FirstChildElement("Renderer") : nullptr;
+	if (!impostorElement || !rendererElement)
+		return descriptor;
+
+	//the texture and blend mode live on the renderer element only, so the file also loads as a plain effect
+	descriptor.m_loopSeconds = ParseXmlAttribute(*impostorElement, "loopSeconds", descriptor.m_loopSeconds);
+	descriptor.m_worldSize = ParseXmlAttribute(*impostorElement, "worldSize", descriptor.m_worldSize);
+	descriptor.m_centerOffset = ParseXmlAttribute(*impostorElement, "centerOffset", descriptor.m_centerOffset);
+	descriptor.m_texturePath = ParseXmlAttribute(*rendererElement, "texture", descriptor.m_texturePath);
+	IntVec2 dimensions = ParseXmlAttribute(*rendererElement, "dimensions", IntVec2(0, 0));
+	descriptor.m_numFrames = dimensions.x;
+	descriptor.m_numViews = dimensions.y;
+	std::string blendName = ParseXmlAttribute(*rendererElement, "blend", "Alpha");
+	for (int i = 0; i < 3; i++)
+	{
+		if (blendName == IMPOSTOR_BLEND_MODE_NAMES[i])
+			descriptor.m_blendMode = static_cast<BlendMode>(i);
+	}
+	return descriptor;
+}
+
+bool ParticleImpostorDescriptor::SaveToFile(const char* descriptorPath) const
+{
+	tinyxml2::XMLDocument descriptorDocument;
+	XmlElement* rootNode = descriptorDocument.NewElement("ParticleSystem");
+	descriptorDocument.InsertFirstChild(rootNode);
+
+	XmlElement* impostorElement = descriptorDocument.NewElement("Impostor");
+	impostorElement->SetAttribute("loopSeconds", m_loopSeconds);
+	impostorElement->SetAttribute("worldSize", m_worldSize);
+	impostorElement->SetAttribute("centerOffset", m_centerOffset.ToXMLString().c_str());
+	rootNode->InsertEndChild(impostorElement);
+
+	//a single billboard living one loop, so the sheet also plays through the regular particles manager
+	//without the batched runtime picking a row per view it plays every view back to back
+	XmlElement* emitterElement = descriptorDocument.NewElement("EmitterData");
+	emitterElement->SetAttribute("name", "Impostor");
+	rootNode->InsertEndChild(emitterElement);
+
+	XmlElement* baseElement = descriptorDocument.NewElement("Base");
+	baseElement->SetAttribute("order", 0);
+	baseElement->SetAttribute("offset", m_centerOffset.ToXMLString().c_str());
+	baseElement->SetAttribute("maxParticles", 1);
+	baseElement->SetAttribute("lifetime", FloatRange(m_loopSeconds, m_loopSeconds).ToXMLString().c_str());
+	baseElement->SetAttribute("speed", FloatRange(0.f, 0.f).ToXMLString().c_str());
+	baseElement->SetAttribute("size", FloatRange(m_worldSize, m_worldSize).ToXMLString().c_str());
+	baseElement->SetAttribute("rotation", FloatRange(0.f, 0.f).ToXMLString().c_str());
+	baseElement->SetAttribute("startColor", Rgba8::WHITE.ToXMLString().c_str());
+	baseElement->SetAttribute("gravity", 0);
+	emitterElement->InsertEndChild(baseElement);
+
+	XmlElement* emissionElement = descriptorDocument.NewElement("Emission");
+	emissionElement->SetAttribute("mode", "Burst");
+	emissionElement->SetAttribute("emissionRate", 0.f);
+	emissionElement->SetAttribute("numBurstParticles", 1);
+	emissionElement->SetAttribute("burstInterval", m_loopSeconds);
+	emitterElement->InsertEndChild(emissionElement);
+
+	XmlElement* rendererElement = descriptorDocument.NewElement("Renderer");
+	rendererElement->SetAttribute("mode", "Billboard");
+	rendererElement->SetAttribute("texture", m_texturePath.c_str());
+	rendererElement->SetAttribute("isSpriteSheet", "true");
+	rendererElement->SetAttribute("dimensions", IntVec2(m_numFrames, m_numViews).ToXMLString().c_str());
+	rendererElement->SetAttribute("blend", IMPOSTOR_BLEND_MODE_NAMES[static_cast<int>(m_blendMode)]);
+	rendererElement->SetAttribute("sortParticles", "false");
+	emitterElement->InsertEndChild(rendererElement);
+
+	return descriptorDocument.SaveFile(descriptorPath) == tinyxml2::XML_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+
+//A flipbook baked by ParticleImpostorBaker: frames run left to right over one loop of the effect,
+//with one row per view direction around the effect's z axis, starting at its x axis and going counterclockwise.
+struct ParticleImpostorDescriptor
+{
+	std::string m_texturePath;
+	int m_numFrames = 0;
+	int m_numViews = 0;
+	float m_loopSeconds = 0.f;
+	float m_worldSize = 0.f;		//width and height of the billboard
+	Vec3 m_centerOffset;			//billboard center in instance space
+	BlendMode m_blendMode = BlendMode::ALPHA;
+
+	bool IsValid() const { return m_numFrames > 0 && m_numViews > 0 && m_loopSeconds > 0.f && m_worldSize > 0.f; }
+	static ParticleImpostorDescriptor LoadFromFile(const char* descriptorPath);
+	bool SaveToFile(const char* descriptorPath) const;
+};
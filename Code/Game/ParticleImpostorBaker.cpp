@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Game/ParticleImpostorBaker.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+constexpr float IMPOSTOR_MIN_SPLAT_RADIUS_PIXELS = 0.5f;
+
+std::vector<ParticleImpostorBaker*> ParticleImpostorBaker::s_consoleBakers;
+
+ParticleImpostorBaker::ParticleImpostorBaker(ParticleWorld* world)
+	:m_world(world)
+{
+	if (s_consoleBakers.empty())
+		SubscribeEventCallbackFunction("particles.bakeimpostor", Command_BakeImpostor);
+	s_consoleBakers.push_back(this);
+}
+
+ParticleImpostorBaker::~ParticleImpostorBaker()
+{
+	s_consoleBakers.erase(std::remove(s_consoleBakers.begin(), s_consoleBakers.end(), this), s_consoleBakers.end());
+	if (s_consoleBakers.empty())
+		UnsubscribeEventCallbackFunction("particles.bakeimpostor", Command_BakeImpostor);
+}
+
+bool ParticleImpostorBaker::BakeEffectFile(const char* effectPath, const ParticleImpostorBakeSettings& settings, std::string& out_descriptorPath)
+{
+	//Data/ParticleSystemData/Rain.xml bakes to Data/Images/Rain_Impostor.tga and Data/ParticleSystemData/Rain_Impostor.xml
+	std::string path = effectPath;
+	size_t nameStart = path.find_last_of("/\\") + 1;
+	size_t extensionStart = path.find_last_of('.');
+	if (extensionStart == std::string::npos || extensionStart < nameStart)
+		extensionStart = path.size();
+	std::string effectName = path.substr(nameStart, extensionStart - nameStart);
+	std::string texturePath = "Data/Images/" + effectName + "_Impostor.tga";
+	out_descriptorPath = path.substr(0, nameStart) + effectName + "_Impostor.xml";
+
+	std::vector<ParticleEmitterData> emitterData = BatchedParticleEffect::LoadEmitterData(effectPath, m_world);
+	return Bake(emitterData, settings, texturePath.c_str(), out_descriptorPath.c_str());
+}
+
+bool ParticleImpostorBaker::Bake(const std::vector<ParticleEmitterData>& emitterData, const ParticleImpostorBakeSettings& settings, const char* texturePath, const char* descriptorPath)
+{
+	if (emitterData.empty() || settings.m_numFrames <= 0 || settings.m_numViews <= 0 || settings.m_cellSizePixels <= 0)
+		return false;
+
+	//no world, so the effect never culls, sleeps, drops lod bands or answers to a budget
+	BatchedParticleEffect effect(emitterData, 1, nullptr);
+	effect.AddInstance(Mat44::IDENTITY);
+	float loopSeconds = settings.m_loopSeconds > 0.f ? settings.m_loopSeconds : effect.GetMaxParticleLifetime();
+	if (loopSeconds <= 0.f)
+		return false;
+
+	float frameSeconds = loopSeconds / float(settings.m_numFrames);
+	int numWarmUpFrames = int(ceilf(effect.GetMaxParticleLifetime() / frameSeconds));
+	for (int i = 0; i < numWarmUpFrames; i++)
+	{
+		effect.Update(frameSeconds);
+	}
+
+	std::vector<std::vector<BatchedParticleSprite>> spritesPerFrame(settings.m_numFrames);
+	for (int frame = 0; frame < settings.m_numFrames; frame++)
+	{
+		effect.Update(frameSeconds);
+		effect.GetParticleSprites(spritesPerFrame[frame]);
+	}
+
+	//one square billboard has to hold the whole loop from every view around the z axis
+	AABB3 bounds;
+	bool hasBounds = false;
+	for (int frame = 0; frame < settings.m_numFrames; frame++)
+	{
+		for (int i = 0; i < int(spritesPerFrame[frame].size()); i++)
+		{
+			const Vec3& position = spritesPerFrame[frame][i].m_position;
+			if (!hasBounds)
+			{
+				bounds = AABB3(position, position);
+				hasBounds = true;
+				continue;
+			}
+			bounds.m_mins = Vec3(std::min(bounds.m_mins.x, position.x), std::min(bounds.m_mins.y, position.y), std::min(bounds.m_mins.z, position.z));
+			bounds.m_maxs = Vec3(std::max(bounds.m_maxs.x, position.x), std::max(bounds.m_maxs.y, position.y), std::max(bounds.m_maxs.z, position.z));
+		}
+	}
+	if (!hasBounds)
+		return false;
+
+	Vec3 center = (bounds.m_mins + bounds.m_maxs) * 0.5f;
+	float halfSize = 0.f;
+	for (int frame = 0; frame < settings.m_numFrames; frame++)
+	{
+		for (int i = 0; i < int(spritesPerFrame[frame].size()); i++)
+		{
+			const BatchedParticleSprite& sprite = spritesPerFrame[frame][i];
+			Vec3 offset = sprite.m_position - center;
+			float spriteRadius = std::max(sprite.m_halfWidth, sprite.m_halfHeight);
+			halfSize = std::max(halfSize, sqrtf(offset.x * offset.x + offset.y * offset.y) + spriteRadius);
+			halfSize = std::max(halfSize, fabsf(offset.z) + spriteRadius);
+		}
+	}
+	if (halfSize <= 0.f)
+		return false;
+
+	//additive effects stay additive, anything with an alpha blended emitter is baked for alpha blending
+	BlendMode sheetBlendMode = BlendMode::ADDITIVE;
+	for (int i = 0; i < int(emitterData.size()); i++)
+	{
+		if (emitterData[i].m_blendMode != BlendMode::ADDITIVE)
+			sheetBlendMode = BlendMode::ALPHA;
+	}
+
+	int cellSize = settings.m_cellSizePixels;
+	int sheetWidth = cellSize * settings.m_numFrames;
+	int sheetHeight = cellSize * settings.m_numViews;
+	std::vector<Rgba8> texels(sheetWidth * sheetHeight, Rgba8(0, 0, 0, 0));
+	std::vector<float> cell;
+	for (int view = 0; view < settings.m_numViews; view++)
+	{
+		for (int frame = 0; frame < settings.m_numFrames; frame++)
+		{
+			SplatView(spritesPerFrame[frame], center, halfSize * 2.f, view, settings.m_numViews, cellSize, cell);
+
+			//the cell holds premultiplied color, the sheet is straight alpha so the regular blend modes reproduce it
+			for (int y = 0; y < cellSize; y++)
+			{
+				for (int x = 0; x < cellSize; x++)
+				{
+					const float* accumulated = &cell[(y * cellSize + x) * 4];
+					float alpha = accumulated[3];
+					if (sheetBlendMode == BlendMode::ADDITIVE)
+						alpha = std::max(accumulated[0], std::max(accumulated[1], accumulated[2]));
+					alpha = std::min(alpha, 1.f);
+					if (alpha <= 0.f)
+						continue;
+
+					float straightColor[4] = { std::min(accumulated[0] / alpha, 1.f), std::min(accumulated[1] / alpha, 1.f), std::min(accumulated[2] / alpha, 1.f), alpha };
+					int sheetX = frame * cellSize + x;
+					int sheetY = view * cellSize + (cellSize - 1 - y);		//sheet rows go top down, cell rows bottom up
+					texels[sheetY * sheetWidth + sheetX].SetFromFloats(straightColor);
+				}
+			}
+		}
+	}
+
+	if (!WriteTGA(texels, sheetWidth, sheetHeight, texturePath))
+		return false;
+
+	ParticleImpostorDescriptor descriptor;
+	descriptor.m_texturePath = texturePath;
+	descriptor.m_numFrames = settings.m_numFrames;
+	descriptor.m_numViews = settings.m_numViews;
+	descriptor.m_loopSeconds = loopSeconds;
+	descriptor.m_worldSize = halfSize * 2.f;
+	descriptor.m_centerOffset = center;
+	descriptor.m_blendMode = sheetBlendMode;
+	return descriptor.SaveToFile(descriptorPath);
+}
+
+void ParticleImpostorBaker::SplatView(const std::vector<BatchedParticleSprite>& sprites, const Vec3& center, float worldSize, int viewIndex, int numViews, int cellSize, std::vector<float>& out_cell)
+{
+	out_cell.assign(cellSize * cellSize * 4, 0.f);
+
+	//views look in at the center from a ring around the z axis, matching the row the runtime picks for a camera direction
+	float viewDegrees = 360.f * float(viewIndex) / float(numViews);
+	Vec3 toCamera = Vec3(CosDegrees(viewDegrees), SinDegrees(viewDegrees), 0.f);
+	Vec3 up = Vec3(0.f, 0.f, 1.f);
+	Vec3 right = -CrossProduct3D(up, -toCamera);
+	float pixelsPerUnit = float(cellSize) / worldSize;
+
+	//alpha blended sprites need back to front order, farthest from the camera first
+	std::vector<std::pair<float, int>> drawOrder;
+	drawOrder.reserve(sprites.size());
+	for (int i = 0; i < int(sprites.size()); i++)
+	{
+		drawOrder.emplace_back(DotProduct3D(sprites[i].m_position - center, toCamera), i);
+	}
+	std::sort(drawOrder.begin(), drawOrder.end());
+
+	for (int order = 0; order < int(drawOrder.size()); order++)
+	{
+		const BatchedParticleSprite& sprite = sprites[drawOrder[order].second];
+		Vec3 offset = sprite.m_position - center;
+		float pixelX = DotProduct3D(offset, right) * pixelsPerUnit + float(cellSize) * 0.5f;
+		float pixelY = DotProduct3D(offset, up) * pixelsPerUnit + float(cellSize) * 0.5f;
+		float radiusX = std::max(sprite.m_halfWidth * pixelsPerUnit, IMPOSTOR_MIN_SPLAT_RADIUS_PIXELS);
+		float radiusY = std::max(sprite.m_halfHeight * pixelsPerUnit, IMPOSTOR_MIN_SPLAT_RADIUS_PIXELS);
+		int minX = std::max(int(floorf(pixelX - radiusX)), 0);
+		int maxX = std::min(int(ceilf(pixelX + radiusX)), cellSize - 1);
+		int minY = std::max(int(floorf(pixelY - radiusY)), 0);
+		int maxY = std::min(int(ceilf(pixelY + radiusY)), cellSize - 1);
+
+		float color[4];
+		sprite.m_color.GetAsFloats(color);
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				//soft round falloff standing in for the particle texture
+				float dx = (float(x) + 0.5f - pixelX) / radiusX;
+				float dy = (float(y) + 0.5f - pixelY) / radiusY;
+				float distanceSquared = dx * dx + dy * dy;
+				if (distanceSquared >= 1.f)
+					continue;
+
+				float coverage = color[3] * (1.f - distanceSquared);
+				float* accumulated = &out_cell[(y * cellSize + x) * 4];
+				if (sprite.m_blendMode == BlendMode::ADDITIVE)
+				{
+					accumulated[0] += color[0] * coverage;
+					accumulated[1] += color[1] * coverage;
+					accumulated[2] += color[2] * coverage;
+					accumulated[3] = std::min(accumulated[3] + coverage, 1.f);
+					continue;
+				}
+				accumulated[0] = color[0] * coverage + accumulated[0] * (1.f - coverage);
+				accumulated[1] = color[1] * coverage + accumulated[1] * (1.f - coverage);
+				accumulated[2] = color[2] * coverage + accumulated[2] * (1.f - coverage);
+				accumulated[3] = coverage + accumulated[3] * (1.f - coverage);
+			}
+		}
+	}
+}
+
+bool ParticleImpostorBaker::WriteTGA(const std::vector<Rgba8>& texels, int width, int height, const char* texturePath)
+{
+	//uncompressed 32 bit truecolor, rows stored top down
+	unsigned char header[18] = {};
+	header[2] = 2;
+	header[12] = static_cast<unsigned char>(width & 0xFF);
+	header[13] = static_cast<unsigned char>((width >> 8) & 0xFF);
+	header[14] = static_cast<unsigned char>(height & 0xFF);
+	header[15] = static_cast<unsigned char>((height >> 8) & 0xFF);
+	header[16] = 32;
+	header[17] = 0x28;
+
+	std::vector<unsigned char> pixels(texels.size() * 4);
+	for (int i = 0; i < int(texels.size()); i++)
+	{
+		pixels[i * 4 + 0] = texels[i].b;
+		pixels[i * 4 + 1] = texels[i].g;
+		pixels[i * 4 + 2] = texels[i].r;
+		pixels[i * 4 + 3] = texels[i].a;
+	}
+
+	std::ofstream file(texturePath, std::ios::binary);
+	if (!file)
+		return false;
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	return bool(file);
+}
+
+//particles.bakeimpostor effect=<path> [world=index] ..., loading the effect through the first world unless another is picked
+bool ParticleImpostorBaker::Command_BakeImpostor(EventArgs& args)
+{
+	std::string effectPath = args.GetValue("effect", "");
+	if (effectPath.empty())
+	{
+		g_theConsole->AddLine(g_theConsole->COMMAND, "Usage: particles.bakeimpostor effect=<path> world=0 frames=16 views=4 cellSize=128 loopSeconds=0");
+		return false;
+	}
+
+	int worldIndex = args.GetValue("world", 0);
+	if (worldIndex < 0 || worldIndex >= int(s_consoleBakers.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d particle worlds", int(s_consoleBakers.size())));
+		return false;
+	}
+
+	ParticleImpostorBakeSettings settings;
+	settings.m_numFrames = args.GetValue("frames", settings.m_numFrames);
+	settings.m_numViews = args.GetValue("views", settings.m_numViews);
+	settings.m_cellSizePixels = args.GetValue("cellSize", settings.m_cellSizePixels);
+	settings.m_loopSeconds = args.GetValue("loopSeconds", settings.m_loopSeconds);
+	std::string descriptorPath;
+	if (s_consoleBakers[worldIndex]->BakeEffectFile(effectPath.c_str(), settings, descriptorPath))
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Baked %s into %s, reference it from <LOD impostor=\"...\"> to use it", effectPath.c_str(), descriptorPath.c_str()));
+	else
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("Could not bake an impostor for %s", effectPath.c_str()));
+	return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Renderer/ParticleEmitterData.hpp"
+#include "Game/ParticleImpostor.hpp"
+
+class ParticleWorld;
+struct BatchedParticleSprite;
+
+struct ParticleImpostorBakeSettings
+{
+	int m_numFrames = 16;
+	int m_numViews = 4;
+	int m_cellSizePixels = 128;
+	float m_loopSeconds = 0.f;		//0 to loop over the longest particle lifetime of the effect
+};
+
+//Bakes an effect into the flipbook its farthest lod band is drawn with. The effect runs headless through the batched runtime,
+//warmed up for a full particle lifetime so the loop starts in its steady state, and every frame of the loop is splatted on the cpu
+//from a ring of view directions, so baking works on machines without a gpu.
+//Every live baker answers the particles.bakeimpostor console command, in the order their worlds were created.
+class ParticleImpostorBaker
+{
+public:
+	ParticleImpostorBaker(ParticleWorld* world);
+	~ParticleImpostorBaker();
+
+	bool BakeEffectFile(const char* effectPath, const ParticleImpostorBakeSettings& settings, std::string& out_descriptorPath);
+	static bool Bake(const std::vector<ParticleEmitterData>& emitterData, const ParticleImpostorBakeSettings& settings, const char* texturePath, const char* descriptorPath);
+	static bool Command_BakeImpostor(EventArgs& args);
+	static bool WriteTGA(const std::vector<Rgba8>& texels, int width, int height, const char* texturePath);
+
+private:
+	ParticleWorld* m_world = nullptr;
+
+private:
+	static std::vector<ParticleImpostorBaker*> s_consoleBakers;
+
+	static void SplatView(const std::vector<BatchedParticleSprite>& sprites, const Vec3& center, float worldSize, int viewIndex, int numViews, int cellSize, std::vector<float>& out_cell);
+};
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <fstream>
+#include <iterator>
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleImpostorBaker.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+static const char* TEST_IMPOSTOR_TEXTURE_PATH = "ImpostorTest_Impostor.tga";
+static const char* TEST_IMPOSTOR_DESCRIPTOR_PATH = "ImpostorTest_Impostor.xml";
+
+static std::vector<unsigned char> ReadTestFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+GAME_TEST(ParticleImpostorBaker_WritesASheetAndADescriptorThatLoads)
+{
+	std::vector<ParticleEmitterData> emitterData;
+	emitterData.push_back(MakeTestEmitterData(100, 50.f, 1.f));
+	emitterData.push_back(MakeTestEmitterData(100, 50.f, 0.5f));
+	emitterData[1].m_blendMode = BlendMode::ADDITIVE;
+	ParticleImpostorBakeSettings settings;
+	settings.m_numFrames = 4;
+	settings.m_numViews = 2;
+	settings.m_cellSizePixels = 16;
+	GAME_TEST_CHECK(ParticleImpostorBaker::Bake(emitterData, settings, TEST_IMPOSTOR_TEXTURE_PATH, TEST_IMPOSTOR_DESCRIPTOR_PATH));
+
+	//a frame per column and a view per row, in an uncompressed 32 bit tga
+	std::vector<unsigned char> sheet = ReadTestFile(TEST_IMPOSTOR_TEXTURE_PATH);
+	bool isSheetSized = sheet.size() == 18 + 64 * 32 * 4;
+	GAME_TEST_CHECK(isSheetSized);
+	GAME_TEST_CHECK(isSheetSized && sheet[2] == 2 && sheet[12] == 64 && sheet[14] == 32 && sheet[16] == 32);
+	int numCoveredTexels = 0;
+	for (int i = 18 + 3; i < int(sheet.size()) && isSheetSized; i += 4)
+	{
+		numCoveredTexels += sheet[i] > 0 ? 1 : 0;
+	}
+	GAME_TEST_CHECK(numCoveredTexels > 0);
+
+	//the loop is the longest lifetime, and one alpha blended emitter makes the whole sheet alpha blended
+	ParticleImpostorDescriptor descriptor = ParticleImpostorDescriptor::LoadFromFile(TEST_IMPOSTOR_DESCRIPTOR_PATH);
+	GAME_TEST_CHECK(descriptor.IsValid());
+	GAME_TEST_CHECK(descriptor.m_texturePath == TEST_IMPOSTOR_TEXTURE_PATH);
+	GAME_TEST_CHECK(descriptor.m_numFrames == 4 && descriptor.m_numViews == 2);
+	GAME_TEST_CHECK(descriptor.m_loopSeconds == 1.f);
+	GAME_TEST_CHECK(descriptor.m_worldSize > 0.f);
+	GAME_TEST_CHECK(descriptor.m_blendMode == BlendMode::ALPHA);
+
+	//nothing to bake fails without writing anything
+	remove(TEST_IMPOSTOR_TEXTURE_PATH);
+	remove(TEST_IMPOSTOR_DESCRIPTOR_PATH);
+	GAME_TEST_CHECK(!ParticleImpostorBaker::Bake(std::vector<ParticleEmitterData>(), settings, TEST_IMPOSTOR_TEXTURE_PATH, TEST_IMPOSTOR_DESCRIPTOR_PATH));
+	settings.m_numFrames = 0;
+	GAME_TEST_CHECK(!ParticleImpostorBaker::Bake(emitterData, settings, TEST_IMPOSTOR_TEXTURE_PATH, TEST_IMPOSTOR_DESCRIPTOR_PATH));
+	GAME_TEST_CHECK(ReadTestFile(TEST_IMPOSTOR_TEXTURE_PATH).empty());
+}
+
+GAME_TEST(ParticleImpostor_FarInstancesSwapToTheFlipbookAndCatchUpWhenNear)
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	Camera camera;
+	world->SetViewFrustum(ParticleFrustum::CreateFromCamera(camera, 60.f, 2.f, 0.1f, 200.f));
+
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 50.f, 1.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	ParticleImpostorDescriptor impostor;
+	impostor.m_numFrames = 4;
+	impostor.m_numViews = 2;
+	impostor.m_loopSeconds = 1.f;
+	impostor.m_worldSize = 2.f;
+	effect->SetImpostor(impostor);
+
+	//in the far band the particles are dropped and the instance only advances the flipbook
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(150.f, 0.f, 0.f)));
+	for (int frame = 0; frame < 10; frame++)
+	{
+		effect->Update(0.1f);
+	}
+	GAME_TEST_CHECK(effect->GetInstanceLODBand(0) == 2);
+	GAME_TEST_CHECK(effect->GetNumImpostorInstances() == 1);
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() == 0);
+
+	//brought close it leaves the flipbook with a full lifetime of particles already in flight
+	effect->SetInstanceTransform(0, Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->Update(0.1f);
+	effect->Update(0.1f);
+	GAME_TEST_CHECK(effect->GetInstanceLODBand(0) == 0);
+	GAME_TEST_CHECK(effect->GetNumImpostorInstances() == 0);
+	GAME_TEST_CHECK(effect->GetNumAliveParticles() >= 45);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+#include "Engine/Renderer/ConstantBuffer.hpp"
+#include "Engine/Renderer/StructuredBuffer.hpp"
+#include "Game/ParticleInstanceBuffer.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern Renderer* g_theRenderer;
+
+constexpr int COMPACT_PARTICLE_CONSTANTS_SLOT = 11;
+constexpr int COMPACT_PARTICLE_INSTANCES_SLOT = 1;
+constexpr int COMPACT_PARTICLE_ORIGINS_SLOT = 2;
+constexpr int COMPACT_PARTICLE_FRAME_UVS_SLOT = 3;
+
+//matches CompactParticleConstants in CompactParticles.hlsl
+struct CompactParticleConstants
+{
+	float m_cameraLeft[4];
+	float m_cameraUp[4];
+	int m_isHorizontal;
+	int m_firstInstance;
+	int m_padding[2];
+};
+
+ParticleInstanceBuffer::ParticleInstanceBuffer(int maxInstances)
+	:m_maxInstances(maxInstances)
+{
+	m_cpuInstances.resize(m_maxInstances);
+	if (!g_theRenderer)
+		return;
+
+	m_instanceBuffer = g_theRenderer->CreateStructuredBuffer(size_t(m_maxInstances) * sizeof(CompactParticleInstance), sizeof(CompactParticleInstance));
+	m_constantBuffer = g_theRenderer->CreateConstantBuffer(sizeof(CompactParticleConstants));
+
+	//the shader takes both the instance and the corner from the vertex id, one quad of placeholder verts only gives the draw
+	//a vertex buffer to bind, see ParticleStaticBuffer
+	Vertex_PCU placeholderVerts[6];
+	m_placeholderBuffer = g_theRenderer->CreateVertexBuffer(sizeof(placeholderVerts));
+	g_theRenderer->CopyCPUToGPU(placeholderVerts, sizeof(placeholderVerts), m_placeholderBuffer);
+
+	m_shader = g_theRenderer->CreateOrGetShader("Data/Shaders/CompactParticles");
+}
+
+ParticleInstanceBuffer::~ParticleInstanceBuffer()
+{
+	delete m_placeholderBuffer;
+	m_placeholderBuffer = nullptr;
+	delete m_instanceBuffer;
+	m_instanceBuffer = nullptr;
+	delete m_originBuffer;
+	m_originBuffer = nullptr;
+	delete m_frameUVBuffer;
+	m_frameUVBuffer = nullptr;
+	delete m_constantBuffer;
+	m_constantBuffer = nullptr;
+}
+
+CompactParticleInstance* ParticleInstanceBuffer::MapInstances()
+{
+	//the staging array is only read back by the copy, so the gpu can still be drawing last frame's instances while it is written
+	return m_cpuInstances.data();
+}
+
+void ParticleInstanceBuffer::UnmapInstances(int numInstances)
+{
+	numInstances = std::min(numInstances, m_maxInstances);
+	if (!m_instanceBuffer || numInstances <= 0)
+		return;
+	g_theRenderer->CopyCPUToGPU(m_cpuInstances.data(), size_t(numInstances) * sizeof(CompactParticleInstance), m_instanceBuffer);
+}
+
+void ParticleInstanceBuffer::SetOrigins(const std::vector<Vec3>& origins)
+{
+	if (origins.empty())
+		return;
+
+	m_originData.resize(origins.size() * 4);
+	for (int i = 0; i < int(origins.size()); i++)
+	{
+		m_originData[i * 4 + 0] = origins[i].x;
+		m_originData[i * 4 + 1] = origins[i].y;
+		m_originData[i * 4 + 2] = origins[i].z;
+		m_originData[i * 4 + 3] = 1.f;
+	}
+	UploadFloat4s(m_originData, m_maxOrigins, m_originBuffer);
+}
+
+void ParticleInstanceBuffer::SetFrameUVs(const std::vector<AABB2>& frameUVs)
+{
+	if (frameUVs.empty())
+		return;
+
+	m_frameUVData.resize(frameUVs.size() * 4);
+	for (int i = 0; i < int(frameUVs.size()); i++)
+	{
+		m_frameUVData[i * 4 + 0] = frameUVs[i].m_mins.x;
+		m_frameUVData[i * 4 + 1] = frameUVs[i].m_mins.y;
+		m_frameUVData[i * 4 + 2] = frameUVs[i].m_maxs.x;
+		m_frameUVData[i * 4 + 3] = frameUVs[i].m_maxs.y;
+	}
+	UploadFloat4s(m_frameUVData, m_maxFrameUVs, m_frameUVBuffer);
+}
+
+void ParticleInstanceBuffer::Draw(RenderBackend& backend, int firstInstance, int numInstances, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal)
+{
+	if (numInstances <= 0 || m_originData.empty() || m_frameUVData.empty())
+		return;
+
+	if (m_constantBuffer)
+		BindInstances(firstInstance, cameraLeft, cameraUp, isHorizontal);
+	backend.BindShader(m_shader);
+	backend.DrawVertexBuffer(m_placeholderBuffer, numInstances * 6);
+	if (m_constantBuffer)
+	{
+		g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_INSTANCES_SLOT, nullptr);
+		g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_ORIGINS_SLOT, nullptr);
+		g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_FRAME_UVS_SLOT, nullptr);
+	}
+}
+
+void ParticleInstanceBuffer::BindInstances(int firstInstance, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal)
+{
+	CompactParticleConstants constants = {};
+	constants.m_cameraLeft[0] = cameraLeft.x;
+	constants.m_cameraLeft[1] = cameraLeft.y;
+	constants.m_cameraLeft[2] = cameraLeft.z;
+	constants.m_cameraUp[0] = cameraUp.x;
+	constants.m_cameraUp[1] = cameraUp.y;
+	constants.m_cameraUp[2] = cameraUp.z;
+	constants.m_isHorizontal = isHorizontal ? 1 : 0;
+	constants.m_firstInstance = firstInstance;
+	g_theRenderer->CopyCPUToGPU(&constants, sizeof(constants), m_constantBuffer);
+	g_theRenderer->BindConstantBuffer(COMPACT_PARTICLE_CONSTANTS_SLOT, m_constantBuffer);
+	g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_INSTANCES_SLOT, m_instanceBuffer);
+	g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_ORIGINS_SLOT, m_originBuffer);
+	g_theRenderer->BindStructuredBuffer(COMPACT_PARTICLE_FRAME_UVS_SLOT, m_frameUVBuffer);
+}
+
+void ParticleInstanceBuffer::UploadFloat4s(const std::vector<float>& data, int& maxElements, StructuredBuffer*& buffer)
+{
+	if (!g_theRenderer)
+		return;
+
+	int numElements = int(data.size()) / 4;
+	if (numElements > maxElements)
+	{
+		delete buffer;
+		maxElements = numElements * 2;
+		buffer = g_theRenderer->CreateStructuredBuffer(size_t(maxElements) * sizeof(float) * 4, sizeof(float) * 4);
+	}
+	g_theRenderer->CopyCPUToGPU(data.data(), data.size() * sizeof(float), buffer);
+}
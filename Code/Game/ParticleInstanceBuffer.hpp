@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include "Game/ParticleInstanceStream.hpp"
+
+class Shader;
+class VertexBuffer;
+class RenderBackend;
+class ConstantBuffer;
+class StructuredBuffer;
+
+//Gpu side of the compact instance stream. The stream builder's jobs write the instances into a cpu staging array once a frame,
+//unmapping sends the written part up to a structured buffer in one copy, and CompactParticles.hlsl expands each instance
+//into its quad. No vertex data is read, the shader takes the instance and the corner from the vertex id.
+//Without a renderer nothing is created, the instances stay on the cpu and draws only reach the render backend.
+class ParticleInstanceBuffer
+{
+public:
+	ParticleInstanceBuffer(int maxInstances);
+	~ParticleInstanceBuffer();
+
+	int GetMaxInstances() const { return m_maxInstances; }
+	CompactParticleInstance* MapInstances();
+	void UnmapInstances(int numInstances);
+	void SetOrigins(const std::vector<Vec3>& origins);
+	void SetFrameUVs(const std::vector<AABB2>& frameUVs);
+	void Draw(RenderBackend& backend, int firstInstance, int numInstances, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal);
+	const CompactParticleInstance* GetCpuInstances() const { return m_cpuInstances.data(); }
+
+private:
+	int m_maxInstances = 0;
+	int m_maxOrigins = 0;
+	StructuredBuffer* m_instanceBuffer = nullptr;
+	StructuredBuffer* m_originBuffer = nullptr;
+	int m_maxFrameUVs = 0;
+	StructuredBuffer* m_frameUVBuffer = nullptr;
+	ConstantBuffer* m_constantBuffer = nullptr;
+	VertexBuffer* m_placeholderBuffer = nullptr;
+	Shader* m_shader = nullptr;
+	std::vector<float> m_originData;
+	std::vector<float> m_frameUVData;
+	std::vector<CompactParticleInstance> m_cpuInstances;
+
+private:
+	void BindInstances(int firstInstance, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal);
+	void UploadFloat4s(const std::vector<float>& data, int& maxElements, StructuredBuffer*& buffer);
+};
@@ -0,0 +1,47 @@
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+
+void ParticleInstanceCapture::Clear()
+{
+	m_numEffects = 0;
+}
+
+CapturedParticleEffect& ParticleInstanceCapture::BeginEffect(const std::vector<Vec3>& origins, const std::vector<AABB2>& frameUVs)
+{
+	if (m_numEffects == int(m_effects.size()))
+		m_effects.emplace_back();
+
+	CapturedParticleEffect& effect = m_effects[m_numEffects];
+	m_numEffects++;
+	effect.m_instances.clear();
+	effect.m_origins = origins;
+	effect.m_frameUVs = frameUVs;
+	effect.m_draws.clear();
+	return effect;
+}
+
+void ParticleInstanceCapture::AddDraw(const CapturedParticleDraw& draw)
+{
+	GUARANTEE_OR_DIE(m_numEffects > 0, "Captured a particle draw before its effect");
+	m_effects[m_numEffects - 1].m_draws.push_back(draw);
+}
+
+int ParticleInstanceCapture::GetNumInstances() const
+{
+	int numInstances = 0;
+	for (int i = 0; i < m_numEffects; i++)
+	{
+		numInstances += int(m_effects[i].m_instances.size());
+	}
+	return numInstances;
+}
+
+int ParticleInstanceCapture::GetNumDraws() const
+{
+	int numDraws = 0;
+	for (int i = 0; i < m_numEffects; i++)
+	{
+		numDraws += int(m_effects[i].m_draws.size());
+	}
+	return numDraws;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Game/ParticleInstanceStream.hpp"
+
+//A draw the gpu path would have made of a range of captured instances.
+struct CapturedParticleDraw
+{
+	int m_firstInstance = 0;
+	int m_numInstances = 0;
+	BlendMode m_blendMode = BlendMode::ALPHA;
+	std::string m_texturePath;			//empty for untextured
+	bool m_isHorizontal = false;
+	Vec3 m_cameraLeft;
+	Vec3 m_cameraUp;
+};
+
+//The compact stream of one effect with the tables its instances index into.
+struct CapturedParticleEffect
+{
+	std::vector<CompactParticleInstance> m_instances;
+	std::vector<Vec3> m_origins;
+	std::vector<AABB2> m_frameUVs;
+	std::vector<CapturedParticleDraw> m_draws;
+};
+
+//Compact particle instances of a frame kept on the cpu instead of uploaded, with the draws made of them,
+//so a headless run can count, check or rasterize what would have been drawn. Effects keep their memory across frames.
+class ParticleInstanceCapture
+{
+public:
+	void Clear();
+	CapturedParticleEffect& BeginEffect(const std::vector<Vec3>& origins, const std::vector<AABB2>& frameUVs);
+	void AddDraw(const CapturedParticleDraw& draw);
+
+	int GetNumEffects() const { return m_numEffects; }
+	const CapturedParticleEffect& GetEffect(int effectIndex) const { return m_effects[effectIndex]; }
+	int GetNumInstances() const;
+	int GetNumDraws() const;
+
+private:
+	std::vector<CapturedParticleEffect> m_effects;
+	int m_numEffects = 0;
+};
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/ParticleInstanceStream.hpp"
+
+unsigned short FloatToHalf(float value)
+{
+	unsigned int bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000u;
+	int exponent = int((bits >> 23) & 0xffu) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffffu;
+
+	//nan stays nan, anything past the largest half clamps to it instead of becoming infinite
+	if (((bits >> 23) & 0xffu) == 0xffu && mantissa != 0)
+		return (unsigned short)(sign | 0x7e00u);
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7bffu);
+
+	//too small even for a denormal half
+	if (exponent <= -11)
+		return (unsigned short)sign;
+
+	if (exponent <= 0)
+	{
+		mantissa |= 0x800000u;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1u);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1u)))
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	//round to nearest even, a carry out of the mantissa correctly bumps the exponent
+	unsigned int half = ((unsigned int)(exponent) << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1fffu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+		half++;
+	if (half >= 0x7c00u)
+		half = 0x7bffu;
+	return (unsigned short)(sign | half);
+}
+
+float HalfToFloat(unsigned short half)
+{
+	unsigned int sign = ((unsigned int)(half) & 0x8000u) << 16;
+	int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ffu;
+	unsigned int bits = 0;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((unsigned int)(exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	else if (mantissa != 0)
+	{
+		//denormal half, normalized for the float
+		exponent = 1;
+		while ((mantissa & 0x400u) == 0)
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | ((unsigned int)(exponent - 15 + 127) << 23) | ((mantissa & 0x3ffu) << 13);
+	}
+	else
+	{
+		bits = sign;
+	}
+
+	float value = 0.f;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+ParticleInstanceBuildJob::ParticleInstanceBuildJob(ParticleInstanceStreamBuilder* builder, int chunkIndex)
+	:ParticleChunkJob(chunkIndex), m_builder(builder)
+{
+}
+
+void ParticleInstanceBuildJob::ExecuteChunk(int chunkIndex)
+{
+	m_builder->RunChunk(chunkIndex);
+}
+
+ParticleInstanceStreamBuilder::ParticleInstanceStreamBuilder(JobSystem* jobSystem, int minInstancesPerJob)
+	:m_jobSystem(jobSystem), m_minInstancesPerJob(minInstancesPerJob)
+{
+}
+
+ParticleInstanceStreamBuilder::~ParticleInstanceStreamBuilder()
+{
+	for (int i = 0; i < int(m_jobs.size()); i++)
+	{
+		delete m_jobs[i];
+	}
+}
+
+void ParticleInstanceStreamBuilder::Build(const ParticleInstanceSource& source, int numInstances, CompactParticleInstance* out_instances)
+{
+	BuildRange(source, 0, numInstances, out_instances);
+}
+
+void ParticleInstanceStreamBuilder::BuildRange(const ParticleInstanceSource& source, int firstInstance, int numInstances, CompactParticleInstance* out_instances)
+{
+	if (numInstances <= 0)
+		return;
+
+	m_source = &source;
+	m_destination = out_instances;
+	m_firstInstance = firstInstance;
+	m_numInstances = numInstances;
+	m_numChunks = 1;
+	if (m_jobSystem && m_minInstancesPerJob > 0)
+	{
+		int maxChunks = m_jobSystem->GetNumWorkerThreads() + 1;
+		m_numChunks = numInstances / m_minInstancesPerJob;
+		if (m_numChunks > maxChunks)
+		{
+			m_numChunks = maxChunks;
+		}
+		if (m_numChunks < 1)
+		{
+			m_numChunks = 1;
+		}
+	}
+	while (int(m_jobs.size()) < m_numChunks)
+	{
+		m_jobs.push_back(new ParticleInstanceBuildJob(this, int(m_jobs.size())));
+	}
+
+	RunParticleChunkJobs(m_jobSystem, m_jobs, m_numChunks);
+}
+
+void ParticleInstanceStreamBuilder::RunChunk(int chunkIndex)
+{
+	int begin = int((long long)m_numInstances * chunkIndex / m_numChunks);
+	int end = int((long long)m_numInstances * (chunkIndex + 1) / m_numChunks);
+	if (end > begin)
+		m_source->WriteInstances(m_firstInstance + begin, end - begin, m_destination + begin);
+}
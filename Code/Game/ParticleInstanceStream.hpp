@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/ParticleChunkJobs.hpp"
+
+class ParticleInstanceStreamBuilder;
+
+//Everything the vertex shader needs to expand one particle into its quad, 20 bytes against 144 for six Vertex_PCU.
+//Positions are relative to the origin of the particle's instance, so half floats keep their precision across a large world.
+struct CompactParticleInstance
+{
+	unsigned short m_position[3];		//half floats
+	unsigned short m_halfSize[2];		//half floats
+	unsigned short m_rotationDegrees;	//half float
+	Rgba8 m_color;
+	unsigned short m_spriteFrame;
+	unsigned short m_originIndex;
+};
+static_assert(sizeof(CompactParticleInstance) == 20, "CompactParticleInstance has to match CompactParticles.hlsl");
+
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short half);
+
+//Anything that can write a range of its render instances, so a stream can be built and checked without a gpu.
+class ParticleInstanceSource
+{
+public:
+	virtual ~ParticleInstanceSource() = default;
+	virtual void WriteInstances(int firstInstance, int numInstances, CompactParticleInstance* out_instances) const = 0;
+};
+
+//One chunk of a stream, run on a worker or inline on the building thread.
+class ParticleInstanceBuildJob : public ParticleChunkJob
+{
+public:
+	ParticleInstanceBuildJob(ParticleInstanceStreamBuilder* builder, int chunkIndex);
+
+protected:
+	virtual void ExecuteChunk(int chunkIndex) override;
+
+private:
+	ParticleInstanceStreamBuilder* m_builder = nullptr;
+};
+
+//Splits writing a stream across the job system. Every chunk writes straight to its own range of the destination,
+//which is normally the mapped upload region, so the instances are never copied after they are built.
+class ParticleInstanceStreamBuilder
+{
+	friend class ParticleInstanceBuildJob;
+
+public:
+	ParticleInstanceStreamBuilder(JobSystem* jobSystem = nullptr, int minInstancesPerJob = 4096);
+	~ParticleInstanceStreamBuilder();
+
+	void Build(const ParticleInstanceSource& source, int numInstances, CompactParticleInstance* out_instances);
+	void BuildRange(const ParticleInstanceSource& source, int firstInstance, int numInstances, CompactParticleInstance* out_instances);	//out_instances receives firstInstance
+
+private:
+	JobSystem* m_jobSystem = nullptr;
+	int m_minInstancesPerJob = 0;
+	std::vector<ParticleChunkJob*> m_jobs;
+
+	//state of the build being run, read by the jobs
+	const ParticleInstanceSource* m_source = nullptr;
+	CompactParticleInstance* m_destination = nullptr;
+	int m_firstInstance = 0;
+	int m_numInstances = 0;
+	int m_numChunks = 0;
+
+private:
+	void RunChunk(int chunkIndex);
+};
@@ -0,0 +1,241 @@
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/GameTest.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/ParticleInstanceStream.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+static unsigned int GetFloatBits(float value)
+{
+	unsigned int bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static bool IsSameFloat(float a, float b)
+{
+	return GetFloatBits(a) == GetFloatBits(b);
+}
+
+//numbers each instance by its index and counts every write, so a chunk written twice or skipped shows up
+class ParticleTestInstanceSource : public ParticleInstanceSource
+{
+public:
+	ParticleTestInstanceSource(int numInstances)
+		:m_writeCounts(new std::atomic<int>[numInstances])
+	{
+		for (int i = 0; i < numInstances; i++)
+		{
+			m_writeCounts[i] = 0;
+		}
+	}
+
+	~ParticleTestInstanceSource()
+	{
+		delete[] m_writeCounts;
+	}
+
+	virtual void WriteInstances(int firstInstance, int numInstances, CompactParticleInstance* out_instances) const override
+	{
+		for (int i = 0; i < numInstances; i++)
+		{
+			int instanceIndex = firstInstance + i;
+			CompactParticleInstance& instance = out_instances[i];
+			instance.m_position[0] = FloatToHalf(float(instanceIndex % 1000));
+			instance.m_position[1] = FloatToHalf(-0.25f * float(instanceIndex % 7));
+			instance.m_position[2] = FloatToHalf(0.f);
+			instance.m_halfSize[0] = FloatToHalf(0.5f);
+			instance.m_halfSize[1] = FloatToHalf(0.5f);
+			instance.m_rotationDegrees = FloatToHalf(float(instanceIndex % 360));
+			instance.m_color = Rgba8((unsigned char)instanceIndex, 0, 0, 255);
+			instance.m_spriteFrame = (unsigned short)(instanceIndex & 0xffff);
+			instance.m_originIndex = (unsigned short)(instanceIndex >> 16);
+			m_writeCounts[instanceIndex]++;
+		}
+	}
+
+	int GetWriteCount(int instanceIndex) const { return m_writeCounts[instanceIndex]; }
+
+private:
+	std::atomic<int>* m_writeCounts = nullptr;
+};
+
+static bool IsInstanceWrittenOnce(const ParticleTestInstanceSource& source, const std::vector<CompactParticleInstance>& instances, int instanceIndex)
+{
+	const CompactParticleInstance& instance = instances[instanceIndex];
+	int writtenIndex = int(instance.m_spriteFrame) | (int(instance.m_originIndex) << 16);
+	return writtenIndex == instanceIndex && source.GetWriteCount(instanceIndex) == 1;
+}
+
+GAME_TEST(ParticleHalf_ExactValuesRoundTrip)
+{
+	const float exactValues[] = { 0.f, 1.f, -2.5f, 0.099975586f, 360.f, 1000.f, 65504.f, -65504.f, 6.10351563e-05f, 5.96046448e-08f, -5.96046448e-08f };
+	for (int i = 0; i < int(sizeof(exactValues) / sizeof(exactValues[0])); i++)
+	{
+		GAME_TEST_CHECK(IsSameFloat(HalfToFloat(FloatToHalf(exactValues[i])), exactValues[i]));
+	}
+
+	//the sign of zero survives
+	GAME_TEST_CHECK(FloatToHalf(-0.f) == 0x8000);
+	GAME_TEST_CHECK(IsSameFloat(HalfToFloat(0x8000), -0.f));
+	GAME_TEST_CHECK(FloatToHalf(1.f) == 0x3c00);
+	GAME_TEST_CHECK(FloatToHalf(65504.f) == 0x7bff);
+	GAME_TEST_CHECK(FloatToHalf(6.10351563e-05f) == 0x0400);
+	GAME_TEST_CHECK(FloatToHalf(5.96046448e-08f) == 0x0001);
+}
+
+GAME_TEST(ParticleHalf_EveryFiniteHalfRoundTrips)
+{
+	int numMismatches = 0;
+	for (unsigned int half = 0; half <= 0xffffu; half++)
+	{
+		//infinities and nans have exponent 31, which the packing never produces
+		if (((half >> 10) & 0x1fu) == 0x1fu)
+			continue;
+
+		if (FloatToHalf(HalfToFloat((unsigned short)half)) != half)
+			numMismatches++;
+	}
+	GAME_TEST_CHECK(numMismatches == 0);
+}
+
+GAME_TEST(ParticleHalf_RoundsToNearestEven)
+{
+	//halfway between two halves goes to the one with an even mantissa
+	GAME_TEST_CHECK(FloatToHalf(1.f + ldexpf(1.f, -11)) == 0x3c00);
+	GAME_TEST_CHECK(FloatToHalf(1.f + 3.f * ldexpf(1.f, -11)) == 0x3c02);
+	GAME_TEST_CHECK(FloatToHalf(-(1.f + 3.f * ldexpf(1.f, -11))) == 0xbc02);
+
+	//just past halfway rounds up, just short of it rounds down
+	GAME_TEST_CHECK(FloatToHalf(1.f + ldexpf(1.f, -11) + ldexpf(1.f, -20)) == 0x3c01);
+	GAME_TEST_CHECK(FloatToHalf(1.f + ldexpf(1.f, -11) - ldexpf(1.f, -20)) == 0x3c00);
+
+	//a carry out of the mantissa moves up to the next exponent
+	GAME_TEST_CHECK(FloatToHalf(2.f - ldexpf(1.f, -12)) == 0x4000);
+
+	//the same rules hold for denormals, halfway between the first two goes to zero and between the next two up
+	GAME_TEST_CHECK(FloatToHalf(ldexpf(1.f, -25)) == 0x0000);
+	GAME_TEST_CHECK(FloatToHalf(3.f * ldexpf(1.f, -25)) == 0x0002);
+	GAME_TEST_CHECK(FloatToHalf(ldexpf(1.f, -24) * 1.75f) == 0x0002);
+}
+
+GAME_TEST(ParticleHalf_OutOfRangeValuesClamp)
+{
+	//past the largest half clamps to it, rounding included
+	GAME_TEST_CHECK(FloatToHalf(65520.f) == 0x7bff);
+	GAME_TEST_CHECK(FloatToHalf(1.0e6f) == 0x7bff);
+	GAME_TEST_CHECK(FloatToHalf(-1.0e6f) == 0xfbff);
+	GAME_TEST_CHECK(FloatToHalf(INFINITY) == 0x7bff);
+	GAME_TEST_CHECK(FloatToHalf(-INFINITY) == 0xfbff);
+
+	//too small for a denormal becomes a signed zero
+	GAME_TEST_CHECK(FloatToHalf(1.0e-10f) == 0x0000);
+	GAME_TEST_CHECK(FloatToHalf(-1.0e-10f) == 0x8000);
+
+	//nan stays nan
+	unsigned short nanHalf = FloatToHalf(NAN);
+	GAME_TEST_CHECK((nanHalf & 0x7c00) == 0x7c00 && (nanHalf & 0x03ff) != 0);
+	float nanValue = HalfToFloat(nanHalf);
+	GAME_TEST_CHECK(nanValue != nanValue);
+}
+
+GAME_TEST(ParticleInstanceStream_InlineBuildWritesEveryInstanceOnce)
+{
+	const int numInstances = 1000;
+	ParticleTestInstanceSource source(numInstances);
+	std::vector<CompactParticleInstance> instances(numInstances);
+	ParticleInstanceStreamBuilder builder;
+	builder.Build(source, numInstances, instances.data());
+	bool areAllWrittenOnce = true;
+	for (int i = 0; i < numInstances; i++)
+	{
+		areAllWrittenOnce = areAllWrittenOnce && IsInstanceWrittenOnce(source, instances, i);
+	}
+	GAME_TEST_CHECK(areAllWrittenOnce);
+
+	//a range lands at the start of its destination
+	ParticleTestInstanceSource rangeSource(numInstances);
+	std::vector<CompactParticleInstance> range(100);
+	builder.BuildRange(rangeSource, 250, 100, range.data());
+	GAME_TEST_CHECK(rangeSource.GetWriteCount(249) == 0 && rangeSource.GetWriteCount(250) == 1 && rangeSource.GetWriteCount(349) == 1 && rangeSource.GetWriteCount(350) == 0);
+	GAME_TEST_CHECK(range[0].m_spriteFrame == 250 && range[99].m_spriteFrame == 349);
+
+	//an empty build leaves the destination alone
+	ParticleTestInstanceSource emptySource(1);
+	builder.Build(emptySource, 0, instances.data());
+	GAME_TEST_CHECK(emptySource.GetWriteCount(0) == 0);
+}
+
+GAME_TEST(ParticleInstanceStream_ChunkedBuildMatchesInlineBuild)
+{
+	//small chunks so every build is split across all the workers, and uneven counts so chunks differ in size
+	JobSystemConfig config;
+	config.m_numWorkerThreads = 3;
+	JobSystem jobSystem(config);
+	jobSystem.Startup();
+	{
+		ParticleInstanceStreamBuilder inlineBuilder;
+		ParticleInstanceStreamBuilder chunkedBuilder(&jobSystem, 64);
+		const int instanceCounts[] = { 1, 63, 64, 129, 1000, 70001 };
+		for (int countIndex = 0; countIndex < int(sizeof(instanceCounts) / sizeof(instanceCounts[0])); countIndex++)
+		{
+			int numInstances = instanceCounts[countIndex];
+			ParticleTestInstanceSource inlineSource(numInstances);
+			ParticleTestInstanceSource chunkedSource(numInstances);
+			std::vector<CompactParticleInstance> expected(numInstances);
+			std::vector<CompactParticleInstance> instances(numInstances);
+			inlineBuilder.Build(inlineSource, numInstances, expected.data());
+			chunkedBuilder.Build(chunkedSource, numInstances, instances.data());
+
+			bool areAllWrittenOnce = true;
+			for (int i = 0; i < numInstances; i++)
+			{
+				areAllWrittenOnce = areAllWrittenOnce && IsInstanceWrittenOnce(chunkedSource, instances, i);
+			}
+			GAME_TEST_CHECK(areAllWrittenOnce);
+			GAME_TEST_CHECK(memcmp(instances.data(), expected.data(), sizeof(CompactParticleInstance) * numInstances) == 0);
+		}
+	}
+	GAME_TEST_CHECK(jobSystem.GetNumQueuedJobs() == 0);
+	GAME_TEST_CHECK(jobSystem.RetrieveFinishedJob() == nullptr);
+	jobSystem.Shutdown();
+}
+
+GAME_TEST(ParticleWorld_CapturesTheCompactStreamEveryFrame)
+{
+	//the capture is cleared every frame, so it must be filled on frames that reuse the last render data too
+	ParticleWorldConfig config;
+	config.m_isCompactInstanceStreamEnabled = true;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	ParticleInstanceCapture capture;
+	world->SetInstanceCapture(&capture);
+
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	effect->AddInstance(Mat44());
+	effect->Update(0.25f);
+
+	Camera camera;
+	CountingRenderBackend backend;
+	std::vector<const BatchedParticleEffect*> effects(1, effect);
+	for (int frame = 0; frame < 2; frame++)
+	{
+		capture.Clear();
+		backend.ResetCounts();
+		world->RenderBatchedEffects(effects, camera, backend);
+		GAME_TEST_CHECK(capture.GetNumInstances() == 50);
+		GAME_TEST_CHECK(capture.GetNumDraws() == 1);
+		GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 1);
+	}
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
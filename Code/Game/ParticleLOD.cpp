@@ -0,0 +1,78 @@
+#include <float.h>
+#include "Engine/Core/XmlUtils.hpp"
+#include "Game/ParticleLOD.hpp"
+
+ParticleLODPolicy ParticleLODPolicy::GetDefault()
+{
+	ParticleLODPolicy policy;
+
+	ParticleLODBand nearBand;
+	nearBand.m_maxDistance = 30.f;
+	nearBand.m_minScreenSize = 0.25f;
+	policy.m_bands.push_back(nearBand);
+
+	ParticleLODBand midBand;
+	midBand.m_maxDistance = 80.f;
+	midBand.m_minScreenSize = 0.08f;
+	midBand.m_tickInterval = 2;
+	midBand.m_emissionScale = 0.5f;
+	midBand.m_maxAliveFraction = 0.5f;
+	policy.m_bands.push_back(midBand);
+
+	ParticleLODBand farBand;
+	farBand.m_maxDistance = FLT_MAX;
+	farBand.m_tickInterval = 4;
+	farBand.m_emissionScale = 0.25f;
+	farBand.m_maxAliveFraction = 0.25f;
+	policy.m_bands.push_back(farBand);
+	return policy;
+}
+
+ParticleLODPolicy ParticleLODPolicy::LoadFromEffectFile(const char* effectPath)
+{
+	XmlDocument effectDocument;
+	if (effectDocument.LoadFile(effectPath) != tinyxml2::XML_SUCCESS || !effectDocument.RootElement())
+		return GetDefault();
+
+	const XmlElement* lodElement = effectDocument.RootElement()->FirstChildElement("LOD");
+	if (!lodElement)
+		return GetDefault();
+
+	ParticleLODPolicy policy;
+	policy.m_hysteresis = ParseXmlAttribute(*lodElement, "hysteresis", policy.m_hysteresis);
+	policy.m_dormantDelaySeconds = ParseXmlAttribute(*lodElement, "dormantDelay", policy.m_dormantDelaySeconds);
+	policy.m_impostorPath = ParseXmlAttribute(*lodElement, "impostor", policy.m_impostorPath);
+	for (const XmlElement* bandElement = lodElement->FirstChildElement("Band"); bandElement; bandElement = bandElement->NextSiblingElement("Band"))
+	{
+		ParticleLODBand band;
+		band.m_maxDistance = ParseXmlAttribute(*bandElement, "maxDistance", FLT_MAX);
+		band.m_minScreenSize = ParseXmlAttribute(*bandElement, "minScreenSize", band.m_minScreenSize);
+		band.m_tickInterval = ParseXmlAttribute(*bandElement, "tickInterval", band.m_tickInterval);
+		band.m_emissionScale = ParseXmlAttribute(*bandElement, "emissionScale", band.m_emissionScale);
+		band.m_maxAliveFraction = ParseXmlAttribute(*bandElement, "maxAliveFraction", band.m_maxAliveFraction);
+		if (band.m_tickInterval < 1)
+			band.m_tickInterval = 1;
+		policy.m_bands.push_back(band);
+	}
+
+	//an <LOD> element with only attributes keeps them on top of the default bands
+	if (policy.m_bands.empty())
+		policy.m_bands = GetDefault().m_bands;
+	return policy;
+}
+
+int ParticleLODPolicy::SelectBand(int currentBand, float distance, float screenSize) const
+{
+	for (int i = 0; i < int(m_bands.size()) - 1; i++)
+	{
+		//finer bands than the current one are harder to enter, the current band is harder to leave
+		float slack = i < currentBand ? (1.f - m_hysteresis) : (1.f + m_hysteresis);
+		const ParticleLODBand& band = m_bands[i];
+		if (distance <= band.m_maxDistance * slack)
+			return i;
+		if (band.m_minScreenSize > 0.f && screenSize >= band.m_minScreenSize / slack)
+			return i;
+	}
+
+	return int(m_bands.size()) - 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <string>
+
+struct ParticleLODBand
+{
+	float m_maxDistance = 0.f;			//instances closer than this use the band
+	float m_minScreenSize = 0.f;		//so do instances whose bounds cover at least this fraction of the half screen height, 0 to ignore
+	int m_tickInterval = 1;				//simulate every nth frame with the accumulated delta
+	float m_emissionScale = 1.f;
+	float m_maxAliveFraction = 1.f;		//fraction of the emitter's max particles that may be alive
+};
+
+//Distance and projected size bands read from the <LOD> element of an effect xml, ordered from nearest to farthest.
+//Thresholds are widened around the current band so an instance sitting on a boundary does not flip every frame.
+struct ParticleLODPolicy
+{
+	std::vector<ParticleLODBand> m_bands;
+	float m_hysteresis = 0.1f;
+	float m_dormantDelaySeconds = 1.f;		//culled instances stop simulating after this long, negative to never sleep
+	std::string m_impostorPath;				//baked flipbook descriptor drawn instead of the farthest band, empty for none
+
+	static ParticleLODPolicy GetDefault();
+	static ParticleLODPolicy LoadFromEffectFile(const char* effectPath);
+	int SelectBand(int currentBand, float distance, float screenSize) const;
+};
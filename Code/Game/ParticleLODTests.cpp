@@ -0,0 +1,148 @@
+#include <algorithm>
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleLOD.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+//a world whose camera sits at the origin looking down +x, so instances along +x are in view at their x distance
+static ParticleWorld* CreateLODTestWorld()
+{
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	Camera camera;
+	world->SetViewFrustum(ParticleFrustum::CreateFromCamera(camera, 60.f, 2.f, 0.1f, 200.f));
+	return world;
+}
+
+static void DestroyLODTestWorld(ParticleWorld* world)
+{
+	world->Shutdown();
+	delete world;
+}
+
+static BatchedParticleEffect* CreateLODTestEffect(ParticleWorld* world, const Vec3& position, float dormantDelaySeconds, float lifetimeSeconds = 10.f)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, lifetimeSeconds));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	ParticleLODPolicy lodPolicy = ParticleLODPolicy::GetDefault();
+	lodPolicy.m_dormantDelaySeconds = dormantDelaySeconds;
+	effect->SetLODPolicy(lodPolicy);
+	effect->AddInstance(Mat44::CreateTranslation3D(position));
+	return effect;
+}
+
+GAME_TEST(ParticleLOD_BandsAreHystereticAroundTheirBoundaries)
+{
+	//the default near band ends at 30 and hysteresis widens that by a tenth either way
+	ParticleLODPolicy policy = ParticleLODPolicy::GetDefault();
+	GAME_TEST_CHECK(policy.SelectBand(0, 10.f, 0.f) == 0);
+	GAME_TEST_CHECK(policy.SelectBand(0, 32.f, 0.f) == 0);
+	GAME_TEST_CHECK(policy.SelectBand(0, 34.f, 0.f) == 1);
+	GAME_TEST_CHECK(policy.SelectBand(1, 32.f, 0.f) == 1);
+	GAME_TEST_CHECK(policy.SelectBand(1, 28.f, 0.f) == 1);
+	GAME_TEST_CHECK(policy.SelectBand(1, 26.f, 0.f) == 0);
+	GAME_TEST_CHECK(policy.SelectBand(1, 500.f, 0.f) == 2);
+
+	//a big enough projected size keeps a far instance in a finer band
+	GAME_TEST_CHECK(policy.SelectBand(2, 500.f, 0.3f) == 0);
+	GAME_TEST_CHECK(policy.SelectBand(2, 500.f, 0.26f) == 1);
+	GAME_TEST_CHECK(policy.SelectBand(0, 500.f, 0.26f) == 0);
+}
+
+GAME_TEST(ParticleLOD_FarInstancesTickLessEmitLessAndCapTheirAliveCount)
+{
+	ParticleWorld* world = CreateLODTestWorld();
+	BatchedParticleEffect* nearEffect = CreateLODTestEffect(world, Vec3(10.f, 0.f, 0.f), -1.f);
+	BatchedParticleEffect* farEffect = CreateLODTestEffect(world, Vec3(150.f, 0.f, 0.f), -1.f);
+
+	//the far band only ticks every 4th frame, with the time of all four at a quarter of the emission rate
+	for (int frame = 0; frame < 3; frame++)
+	{
+		nearEffect->Update(0.0625f);
+		farEffect->Update(0.0625f);
+	}
+	GAME_TEST_CHECK(nearEffect->GetInstanceLODBand(0) == 0);
+	GAME_TEST_CHECK(farEffect->GetInstanceLODBand(0) == 2);
+	GAME_TEST_CHECK(nearEffect->GetNumAliveParticles() == 37);
+	GAME_TEST_CHECK(farEffect->GetNumAliveParticles() == 0);
+	nearEffect->Update(0.0625f);
+	farEffect->Update(0.0625f);
+	GAME_TEST_CHECK(nearEffect->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(farEffect->GetNumAliveParticles() == 12);
+
+	//after a second the near instance is at its max of 100 and the far one at a quarter of it
+	for (int frame = 4; frame < 16; frame++)
+	{
+		nearEffect->Update(0.0625f);
+		farEffect->Update(0.0625f);
+	}
+	GAME_TEST_CHECK(nearEffect->GetNumAliveParticles() == 100);
+	GAME_TEST_CHECK(farEffect->GetNumAliveParticles() == 25);
+
+	delete nearEffect;
+	delete farEffect;
+	DestroyLODTestWorld(world);
+}
+
+static const float SLEEP_TEST_DELTA_SECONDS = 1.f / 64.f;
+
+static float GetOldestParticleAge(const BatchedParticleEffect& effect)
+{
+	std::vector<BatchedParticleSprite> sprites;
+	effect.GetParticleSprites(sprites);
+	float oldestAge = 0.f;
+	for (int i = 0; i < int(sprites.size()); i++)
+	{
+		oldestAge = std::max(oldestAge, sprites[i].m_ageSeconds);
+	}
+	return oldestAge;
+}
+
+GAME_TEST(ParticleLOD_CulledInstancesSleepAndCatchUpWithoutRestarting)
+{
+	//two copies of the same looping effect, one of which is culled for a few seconds
+	ParticleWorld* world = CreateLODTestWorld();
+	BatchedParticleEffect* sleeper = CreateLODTestEffect(world, Vec3(10.f, 0.f, 0.f), 0.5f, 0.25f);
+	BatchedParticleEffect* reference = CreateLODTestEffect(world, Vec3(10.f, 0.f, 0.f), 0.5f, 0.25f);
+	for (int frame = 0; frame < 128; frame++)
+	{
+		sleeper->Update(SLEEP_TEST_DELTA_SECONDS);
+		reference->Update(SLEEP_TEST_DELTA_SECONDS);
+	}
+
+	//culled instances keep simulating for the dormant delay, then stop
+	sleeper->SetAllInstancesCulled();
+	for (int frame = 0; frame < 32; frame++)
+	{
+		sleeper->Update(SLEEP_TEST_DELTA_SECONDS);
+		reference->Update(SLEEP_TEST_DELTA_SECONDS);
+	}
+	GAME_TEST_CHECK(sleeper->GetNumDormantInstances() == 1);
+	GAME_TEST_CHECK(reference->GetNumDormantInstances() == 0);
+	int numSleepingParticles = sleeper->GetNumAliveParticles();
+	float sleepingOldestAge = GetOldestParticleAge(*sleeper);
+	for (int frame = 0; frame < 160; frame++)
+	{
+		sleeper->Update(SLEEP_TEST_DELTA_SECONDS);
+		reference->Update(SLEEP_TEST_DELTA_SECONDS);
+	}
+	GAME_TEST_CHECK(sleeper->GetNumAliveParticles() == numSleepingParticles);
+	GAME_TEST_CHECK(GetOldestParticleAge(*sleeper) == sleepingOldestAge);
+
+	//seen again, it looks like it ran all along: as many particles, and old ones among them rather than a fresh burst.
+	//The stepped reference ages what it spawns by a whole frame right away, so it runs up to a frame's emission short
+	sleeper->SetInstanceVisible(0);
+	sleeper->Update(SLEEP_TEST_DELTA_SECONDS);
+	reference->Update(SLEEP_TEST_DELTA_SECONDS);
+	GAME_TEST_CHECK(sleeper->GetNumDormantInstances() == 0);
+	int numParticlesDifference = sleeper->GetNumAliveParticles() - reference->GetNumAliveParticles();
+	GAME_TEST_CHECK(numParticlesDifference >= 0 && numParticlesDifference <= 4);
+	GAME_TEST_CHECK(GetOldestParticleAge(*sleeper) > 0.8f * sleeper->GetMaxParticleLifetime());
+
+	delete sleeper;
+	delete reference;
+	DestroyLODTestWorld(world);
+}
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/XmlUtils.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Game/ParticleLoopClip.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+constexpr unsigned int LOOP_CLIP_MAGIC = 0x504C4350;		//"PCLP"
+constexpr unsigned int LOOP_CLIP_VERSION = 1;
+constexpr float LOOP_CLIP_SPAWN_EPSILON = 0.0001f;
+
+std::vector<ParticleLoopClipBaker*> ParticleLoopClipBaker::s_consoleBakers;
+
+static unsigned char QuantizeUnsigned8(float value, float scale)
+{
+	return static_cast<unsigned char>(std::min(value / scale + 0.5f, 255.f));
+}
+
+static signed char QuantizeSigned8(float value, float scale)
+{
+	return static_cast<signed char>(Clamp(floorf(value / scale + 0.5f), -127.f, 127.f));
+}
+
+template<typename T>
+static void WriteValue(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void ReadValue(std::ifstream& file, T& out_value)
+{
+	file.read(reinterpret_cast<char*>(&out_value), sizeof(T));
+}
+
+ParticleLoopClip* ParticleLoopClip::Bake(const std::vector<ParticleEmitterData>& emitterData, float framesPerSecond, float periodSeconds)
+{
+	if (emitterData.empty() || int(emitterData.size()) > 255 || framesPerSecond <= 0.f)
+		return nullptr;
+
+	BatchedParticleEffect effect(emitterData, 1, nullptr);
+	effect.AddInstance(Mat44::IDENTITY);
+	float maxLifetime = effect.GetMaxParticleLifetime();
+	if (periodSeconds <= 0.f)
+	{
+		//bursts have to repeat a whole number of times per period or the loop would seam
+		periodSeconds = maxLifetime;
+		for (int i = 0; i < int(emitterData.size()); i++)
+		{
+			const ParticleEmitterData& emitter = emitterData[i];
+			if (emitter.m_emissionMode == EmissionMode::BURST && emitter.m_burstInterval > 0.f)
+				periodSeconds = ceilf(periodSeconds / emitter.m_burstInterval) * emitter.m_burstInterval;
+		}
+	}
+	if (periodSeconds <= 0.f)
+		return nullptr;
+
+	int numFrames = std::max(int(periodSeconds * framesPerSecond + 0.5f), 1);
+	float frameSeconds = periodSeconds / float(numFrames);
+
+	//a particle spawned during the period is recorded at every step of its life into frame (step % numFrames),
+	//so running a full lifetime past the period folds the tail of each particle back over the start of the clip
+	std::vector<std::vector<BatchedParticleSprite>> spritesPerFrame(numFrames);
+	std::vector<BatchedParticleSprite> sprites;
+	int numSteps = numFrames + int(ceilf(maxLifetime / frameSeconds));
+	for (int step = 1; step <= numSteps; step++)
+	{
+		effect.Update(frameSeconds);
+		effect.GetParticleSprites(sprites);
+		float stepSeconds = float(step) * frameSeconds;
+		for (int i = 0; i < int(sprites.size()); i++)
+		{
+			float spawnSeconds = stepSeconds - sprites[i].m_ageSeconds;
+			if (spawnSeconds >= -LOOP_CLIP_SPAWN_EPSILON && spawnSeconds < periodSeconds - LOOP_CLIP_SPAWN_EPSILON)
+				spritesPerFrame[step % numFrames].push_back(sprites[i]);
+		}
+	}
+
+	//quantization ranges over the whole clip
+	ParticleLoopClip* clip = new ParticleLoopClip();
+	clip->m_numEmitters = int(emitterData.size());
+	clip->m_periodSeconds = periodSeconds;
+	bool hasBounds = false;
+	Vec3 boundsMaxs;
+	float maxFrameDelta = 0.f;
+	float maxHalfSize = 0.f;
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		for (int i = 0; i < int(spritesPerFrame[frame].size()); i++)
+		{
+			const BatchedParticleSprite& sprite = spritesPerFrame[frame][i];
+			const Vec3& position = sprite.m_position;
+			if (!hasBounds)
+			{
+				clip->m_boundsMins = position;
+				boundsMaxs = position;
+				hasBounds = true;
+			}
+			clip->m_boundsMins = Vec3(std::min(clip->m_boundsMins.x, position.x), std::min(clip->m_boundsMins.y, position.y), std::min(clip->m_boundsMins.z, position.z));
+			boundsMaxs = Vec3(std::max(boundsMaxs.x, position.x), std::max(boundsMaxs.y, position.y), std::max(boundsMaxs.z, position.z));
+			Vec3 frameDelta = sprite.m_velocity * frameSeconds;
+			maxFrameDelta = std::max(maxFrameDelta, std::max(fabsf(frameDelta.x), std::max(fabsf(frameDelta.y), fabsf(frameDelta.z))));
+			maxHalfSize = std::max(maxHalfSize, std::max(sprite.m_halfWidth, sprite.m_halfHeight));
+		}
+	}
+	Vec3 extent = boundsMaxs - clip->m_boundsMins;
+	clip->m_positionScale = Vec3(std::max(extent.x, 0.0001f) / 65535.f, std::max(extent.y, 0.0001f) / 65535.f, std::max(extent.z, 0.0001f) / 65535.f);
+	clip->m_frameDeltaScale = std::max(maxFrameDelta, 0.0001f) / 127.f;
+	clip->m_halfSizeScale = std::max(maxHalfSize, 0.0001f) / 255.f;
+
+	clip->m_frameStarts.reserve(numFrames + 1);
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		clip->m_frameStarts.push_back(int(clip->m_samples.size()));
+		for (int i = 0; i < int(spritesPerFrame[frame].size()); i++)
+		{
+			const BatchedParticleSprite& sprite = spritesPerFrame[frame][i];
+			Vec3 offset = sprite.m_position - clip->m_boundsMins;
+			Vec3 frameDelta = sprite.m_velocity * frameSeconds;
+			float rotationTurns = sprite.m_rotationDegrees / 360.f;
+
+			ParticleClipSample sample;
+			sample.m_position[0] = static_cast<unsigned short>(std::min(offset.x / clip->m_positionScale.x + 0.5f, 65535.f));
+			sample.m_position[1] = static_cast<unsigned short>(std::min(offset.y / clip->m_positionScale.y + 0.5f, 65535.f));
+			sample.m_position[2] = static_cast<unsigned short>(std::min(offset.z / clip->m_positionScale.z + 0.5f, 65535.f));
+			sample.m_frameDelta[0] = QuantizeSigned8(frameDelta.x, clip->m_frameDeltaScale);
+			sample.m_frameDelta[1] = QuantizeSigned8(frameDelta.y, clip->m_frameDeltaScale);
+			sample.m_frameDelta[2] = QuantizeSigned8(frameDelta.z, clip->m_frameDeltaScale);
+			sample.m_emitterIndex = static_cast<unsigned char>(sprite.m_emitterIndex);
+			sample.m_halfWidth = QuantizeUnsigned8(sprite.m_halfWidth, clip->m_halfSizeScale);
+			sample.m_halfHeight = QuantizeUnsigned8(sprite.m_halfHeight, clip->m_halfSizeScale);
+			sample.m_rotation = static_cast<unsigned char>(int(floorf((rotationTurns - floorf(rotationTurns)) * 256.f + 0.5f)) & 0xFF);
+			sample.m_spriteFrame = static_cast<unsigned char>(std::min(sprite.m_spriteFrame, 255));
+			sample.m_color = sprite.m_color;
+			clip->m_samples.push_back(sample);
+		}
+	}
+	clip->m_frameStarts.push_back(int(clip->m_samples.size()));
+	return clip;
+}
+
+ParticleLoopClip* ParticleLoopClip::LoadFromFile(const char* clipPath)
+{
+	std::ifstream file(clipPath, std::ios::binary);
+	if (!file)
+		return nullptr;
+
+	unsigned int magic = 0;
+	unsigned int version = 0;
+	ReadValue(file, magic);
+	ReadValue(file, version);
+	if (!file || magic != LOOP_CLIP_MAGIC || version != LOOP_CLIP_VERSION)
+		return nullptr;
+
+	ParticleLoopClip* clip = new ParticleLoopClip();
+	int numFrames = 0;
+	int numSamples = 0;
+	ReadValue(file, clip->m_numEmitters);
+	ReadValue(file, clip->m_periodSeconds);
+	ReadValue(file, clip->m_boundsMins);
+	ReadValue(file, clip->m_positionScale);
+	ReadValue(file, clip->m_frameDeltaScale);
+	ReadValue(file, clip->m_halfSizeScale);
+	ReadValue(file, numFrames);
+	ReadValue(file, numSamples);
+	if (!file || numFrames <= 0 || numSamples < 0)
+	{
+		delete clip;
+		return nullptr;
+	}
+
+	//the counts decide how much gets allocated, so they have to agree with the size of the file before anything is read
+	std::streamoff tablesStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff tablesSize = file.tellg() - tablesStart;
+	file.seekg(tablesStart);
+	if (tablesSize != std::streamoff(numFrames + 1) * std::streamoff(sizeof(int)) + std::streamoff(numSamples) * std::streamoff(sizeof(ParticleClipSample)))
+	{
+		delete clip;
+		return nullptr;
+	}
+
+	clip->m_frameStarts.resize(numFrames + 1);
+	clip->m_samples.resize(numSamples);
+	file.read(reinterpret_cast<char*>(clip->m_frameStarts.data()), clip->m_frameStarts.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(clip->m_samples.data()), clip->m_samples.size() * sizeof(ParticleClipSample));
+	if (!file || !clip->IsValid())
+	{
+		delete clip;
+		return nullptr;
+	}
+	return clip;
+}
+
+ParticleLoopClip* ParticleLoopClip::LoadFromEffectFile(const char* effectPath)
+{
+	XmlDocument effectDocument;
+	if (effectDocument.LoadFile(effectPath) != tinyxml2::XML_SUCCESS || !effectDocument.RootElement())
+		return nullptr;
+
+	const XmlElement* loopElement = effectDocument.RootElement()->FirstChildElement("Loop");
+	if (!loopElement)
+		return nullptr;
+
+	std::string clipPath = ParseXmlAttribute(*loopElement, "clip", "");
+	if (clipPath.empty())
+		return nullptr;
+	return LoadFromFile(clipPath.c_str());
+}
+
+bool ParticleLoopClip::SaveToFile(const char* clipPath) const
+{
+	std::ofstream file(clipPath, std::ios::binary);
+	if (!file)
+		return false;
+
+	WriteValue(file, LOOP_CLIP_MAGIC);
+	WriteValue(file, LOOP_CLIP_VERSION);
+	WriteValue(file, m_numEmitters);
+	WriteValue(file, m_periodSeconds);
+	WriteValue(file, m_boundsMins);
+	WriteValue(file, m_positionScale);
+	WriteValue(file, m_frameDeltaScale);
+	WriteValue(file, m_halfSizeScale);
+	WriteValue(file, GetNumFrames());
+	WriteValue(file, GetNumSamples());
+	file.write(reinterpret_cast<const char*>(m_frameStarts.data()), m_frameStarts.size() * sizeof(int));
+	file.write(reinterpret_cast<const char*>(m_samples.data()), m_samples.size() * sizeof(ParticleClipSample));
+	return bool(file);
+}
+
+bool ParticleLoopClip::FitsEmitters(const std::vector<int>& numSpriteFramesPerEmitter) const
+{
+	if (int(numSpriteFramesPerEmitter.size()) != m_numEmitters)
+		return false;
+
+	for (int i = 0; i < int(m_samples.size()); i++)
+	{
+		const ParticleClipSample& sample = m_samples[i];
+		if (int(sample.m_spriteFrame) >= numSpriteFramesPerEmitter[sample.m_emitterIndex])
+			return false;
+	}
+	return true;
+}
+
+AABB3 ParticleLoopClip::GetBounds() const
+{
+	//samples can sit up to a frame of movement and a rotated quad away from their stored position
+	float margin = m_frameDeltaScale * 127.f + m_halfSizeScale * 255.f * 1.4142136f;
+	Vec3 boundsMaxs = m_boundsMins + m_positionScale * 65535.f;
+	return AABB3(m_boundsMins - Vec3(margin, margin, margin), boundsMaxs + Vec3(margin, margin, margin));
+}
+
+const ParticleClipSample* ParticleLoopClip::GetFrameSamples(int frame, int& out_numSamples) const
+{
+	out_numSamples = m_frameStarts[frame + 1] - m_frameStarts[frame];
+	return m_samples.data() + m_frameStarts[frame];
+}
+
+Vec3 ParticleLoopClip::DecodePosition(const ParticleClipSample& sample, float frameFraction) const
+{
+	float deltaScale = m_frameDeltaScale * frameFraction;
+	return Vec3(m_boundsMins.x + float(sample.m_position[0]) * m_positionScale.x + float(sample.m_frameDelta[0]) * deltaScale,
+		m_boundsMins.y + float(sample.m_position[1]) * m_positionScale.y + float(sample.m_frameDelta[1]) * deltaScale,
+		m_boundsMins.z + float(sample.m_position[2]) * m_positionScale.z + float(sample.m_frameDelta[2]) * deltaScale);
+}
+
+bool ParticleLoopClip::IsValid() const
+{
+	if (m_numEmitters <= 0 || m_numEmitters > 255 || !(m_periodSeconds > 0.f))
+		return false;
+	if (!(m_positionScale.x > 0.f) || !(m_positionScale.y > 0.f) || !(m_positionScale.z > 0.f) || !(m_frameDeltaScale > 0.f) || !(m_halfSizeScale > 0.f))
+		return false;
+
+	//frames have to tile the samples exactly, in order
+	if (m_frameStarts.size() < 2 || m_frameStarts.front() != 0 || m_frameStarts.back() != int(m_samples.size()))
+		return false;
+	for (int frame = 1; frame < int(m_frameStarts.size()); frame++)
+	{
+		if (m_frameStarts[frame] < m_frameStarts[frame - 1])
+			return false;
+	}
+
+	for (int i = 0; i < int(m_samples.size()); i++)
+	{
+		if (int(m_samples[i].m_emitterIndex) >= m_numEmitters)
+			return false;
+	}
+	return true;
+}
+
+ParticleLoopClipBaker::ParticleLoopClipBaker(ParticleWorld* world)
+	:m_world(world)
+{
+	if (s_consoleBakers.empty())
+		SubscribeEventCallbackFunction("particles.bakeloop", Command_BakeLoopClip);
+	s_consoleBakers.push_back(this);
+}
+
+ParticleLoopClipBaker::~ParticleLoopClipBaker()
+{
+	s_consoleBakers.erase(std::remove(s_consoleBakers.begin(), s_consoleBakers.end(), this), s_consoleBakers.end());
+	if (s_consoleBakers.empty())
+		UnsubscribeEventCallbackFunction("particles.bakeloop", Command_BakeLoopClip);
+}
+
+bool ParticleLoopClipBaker::BakeEffectFile(const char* effectPath, float framesPerSecond, float periodSeconds, std::string& out_clipPath)
+{
+	//Data/ParticleSystemData/Rain.xml bakes to Data/ParticleSystemData/Rain.clip
+	out_clipPath = effectPath;
+	size_t extensionStart = out_clipPath.find_last_of('.');
+	if (extensionStart != std::string::npos && extensionStart > out_clipPath.find_last_of("/\\") + 1)
+		out_clipPath.resize(extensionStart);
+	out_clipPath += ".clip";
+
+	ParticleLoopClip* clip = ParticleLoopClip::Bake(BatchedParticleEffect::LoadEmitterData(effectPath, m_world), framesPerSecond, periodSeconds);
+	if (!clip)
+		return false;
+
+	bool isSaved = clip->SaveToFile(out_clipPath.c_str());
+	delete clip;
+	return isSaved;
+}
+
+//particles.bakeloop effect=<path> [world=index] ..., loading the effect through the first world unless another is picked
+bool ParticleLoopClipBaker::Command_BakeLoopClip(EventArgs& args)
+{
+	std::string effectPath = args.GetValue("effect", "");
+	if (effectPath.empty())
+	{
+		g_theConsole->AddLine(g_theConsole->COMMAND, "Usage: particles.bakeloop effect=<path> world=0 fps=30 period=0");
+		return false;
+	}
+
+	int worldIndex = args.GetValue("world", 0);
+	if (worldIndex < 0 || worldIndex >= int(s_consoleBakers.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d particle worlds", int(s_consoleBakers.size())));
+		return false;
+	}
+
+	float framesPerSecond = args.GetValue("fps", 30.f);
+	float periodSeconds = args.GetValue("period", 0.f);
+	std::string clipPath;
+	if (s_consoleBakers[worldIndex]->BakeEffectFile(effectPath.c_str(), framesPerSecond, periodSeconds, clipPath))
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Baked %s into %s, reference it from <Loop clip=\"...\"/> to play it back", effectPath.c_str(), clipPath.c_str()));
+	else
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("Could not bake a loop clip for %s", effectPath.c_str()));
+	return false;
+}
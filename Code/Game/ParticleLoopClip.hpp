@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Math/AABB3.hpp"
+#include "Engine/Renderer/ParticleEmitterData.hpp"
+
+class ParticleWorld;
+
+//One particle in one frame of a clip, 18 bytes. Positions are quantized to the clip bounds,
+//the movement to the next frame to the largest movement in the clip, and sizes to the largest half size.
+struct ParticleClipSample
+{
+	unsigned short m_position[3];
+	signed char m_frameDelta[3];
+	unsigned char m_emitterIndex;
+	unsigned char m_halfWidth;
+	unsigned char m_halfHeight;
+	unsigned char m_rotation;		//256 steps per turn
+	unsigned char m_spriteFrame;
+	Rgba8 m_color;
+};
+
+//One seamless period of a looping effect, recorded in instance space. Only particles spawned during the period are kept,
+//and each one shows up at its age modulo the period, so the clip is in its steady state from the first frame and wraps without a seam.
+//The samples of all frames sit back to back, so playing a frame is one linear pass over a contiguous block.
+class ParticleLoopClip
+{
+public:
+	static ParticleLoopClip* Bake(const std::vector<ParticleEmitterData>& emitterData, float framesPerSecond, float periodSeconds = 0.f);
+	static ParticleLoopClip* LoadFromFile(const char* clipPath);		//null for a missing, truncated or inconsistent file
+	static ParticleLoopClip* LoadFromEffectFile(const char* effectPath);
+	bool SaveToFile(const char* clipPath) const;
+
+	int GetNumFrames() const { return int(m_frameStarts.size()) - 1; }
+	int GetNumEmitters() const { return m_numEmitters; }
+	float GetPeriodSeconds() const { return m_periodSeconds; }
+	float GetFrameSeconds() const { return m_periodSeconds / float(GetNumFrames()); }
+	AABB3 GetBounds() const;
+	int GetNumSamples() const { return int(m_samples.size()); }
+	const ParticleClipSample* GetFrameSamples(int frame, int& out_numSamples) const;
+	Vec3 DecodePosition(const ParticleClipSample& sample, float frameFraction) const;
+	float DecodeHalfSize(unsigned char quantizedHalfSize) const { return float(quantizedHalfSize) * m_halfSizeScale; }
+	float DecodeRotationDegrees(unsigned char quantizedRotation) const { return float(quantizedRotation) * (360.f / 256.f); }
+	bool FitsEmitters(const std::vector<int>& numSpriteFramesPerEmitter) const;
+
+private:
+	std::vector<ParticleClipSample> m_samples;
+	std::vector<int> m_frameStarts;		//one entry per frame plus the end
+	int m_numEmitters = 0;
+	float m_periodSeconds = 0.f;
+	Vec3 m_boundsMins;
+	Vec3 m_positionScale;
+	float m_frameDeltaScale = 0.f;
+	float m_halfSizeScale = 0.f;
+
+private:
+	bool IsValid() const;
+};
+
+//Registers the console command that bakes an effect file into a loop clip next to it.
+//Every live baker answers it, in the order their worlds were created.
+class ParticleLoopClipBaker
+{
+public:
+	ParticleLoopClipBaker(ParticleWorld* world);
+	~ParticleLoopClipBaker();
+
+	bool BakeEffectFile(const char* effectPath, float framesPerSecond, float periodSeconds, std::string& out_clipPath);
+	static bool Command_BakeLoopClip(EventArgs& args);
+
+private:
+	ParticleWorld* m_world = nullptr;
+
+private:
+	static std::vector<ParticleLoopClipBaker*> s_consoleBakers;
+};
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+#include "Engine/Renderer/ConstantBuffer.hpp"
+#include "Engine/Renderer/StructuredBuffer.hpp"
+#include "Game/ParticleLoopClipBuffer.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern Renderer* g_theRenderer;
+
+constexpr int LOOP_CLIP_CONSTANTS_SLOT = 12;
+constexpr int LOOP_CLIP_PARTICLES_SLOT = 1;
+constexpr int LOOP_CLIP_SEGMENTS_SLOT = 2;
+
+//matches LoopClipConstants in LoopClipParticles.hlsl
+struct LoopClipConstants
+{
+	float m_cameraLeft[4];
+	float m_cameraUp[4];
+	int m_isHorizontal;
+	int m_firstSegment;
+	int m_quadsPerSegment;
+	int m_padding;
+};
+
+ParticleLoopClipBuffer::ParticleLoopClipBuffer(const std::vector<LoopClipParticleInstance>& particles, int maxSegments)
+	:m_maxSegments(maxSegments)
+{
+	if (!g_theRenderer)
+		return;
+
+	//the clip never changes, so its particles go up once here and are only bound after that
+	int numParticles = std::max(int(particles.size()), 1);
+	LoopClipParticleInstance emptyParticle = {};
+	m_particleBuffer = g_theRenderer->CreateStructuredBuffer(size_t(numParticles) * sizeof(LoopClipParticleInstance), sizeof(LoopClipParticleInstance));
+	g_theRenderer->CopyCPUToGPU(particles.empty() ? &emptyParticle : particles.data(), size_t(numParticles) * sizeof(LoopClipParticleInstance), m_particleBuffer);
+	m_segmentBuffer = g_theRenderer->CreateStructuredBuffer(size_t(m_maxSegments) * sizeof(LoopClipSegment), sizeof(LoopClipSegment));
+	m_constantBuffer = g_theRenderer->CreateConstantBuffer(sizeof(LoopClipConstants));
+
+	//the shader reads nothing but the vertex id, see ParticleStaticBuffer
+	Vertex_PCU placeholderVerts[6];
+	m_placeholderBuffer = g_theRenderer->CreateVertexBuffer(sizeof(placeholderVerts));
+	g_theRenderer->CopyCPUToGPU(placeholderVerts, sizeof(placeholderVerts), m_placeholderBuffer);
+
+	m_shader = g_theRenderer->CreateOrGetShader("Data/Shaders/LoopClipParticles");
+}
+
+ParticleLoopClipBuffer::~ParticleLoopClipBuffer()
+{
+	delete m_placeholderBuffer;
+	m_placeholderBuffer = nullptr;
+	delete m_particleBuffer;
+	m_particleBuffer = nullptr;
+	delete m_segmentBuffer;
+	m_segmentBuffer = nullptr;
+	delete m_constantBuffer;
+	m_constantBuffer = nullptr;
+}
+
+void ParticleLoopClipBuffer::SetSegments(const std::vector<LoopClipSegment>& segments)
+{
+	int numSegments = std::min(int(segments.size()), m_maxSegments);
+	if (numSegments == 0 || !m_segmentBuffer)
+		return;
+
+	g_theRenderer->CopyCPUToGPU(segments.data(), size_t(numSegments) * sizeof(LoopClipSegment), m_segmentBuffer);
+}
+
+void ParticleLoopClipBuffer::Draw(RenderBackend& backend, int firstSegment, int numSegments, int quadsPerSegment, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal) const
+{
+	numSegments = std::min(numSegments, m_maxSegments - firstSegment);
+	if (numSegments <= 0 || quadsPerSegment <= 0)
+		return;
+
+	if (m_constantBuffer)
+		BindSegments(firstSegment, quadsPerSegment, cameraLeft, cameraUp, isHorizontal);
+	backend.BindShader(m_shader);
+	backend.DrawVertexBuffer(m_placeholderBuffer, numSegments * quadsPerSegment * 6);
+	if (m_constantBuffer)
+	{
+		g_theRenderer->BindStructuredBuffer(LOOP_CLIP_PARTICLES_SLOT, nullptr);
+		g_theRenderer->BindStructuredBuffer(LOOP_CLIP_SEGMENTS_SLOT, nullptr);
+	}
+}
+
+void ParticleLoopClipBuffer::BindSegments(int firstSegment, int quadsPerSegment, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal) const
+{
+	LoopClipConstants constants = {};
+	constants.m_cameraLeft[0] = cameraLeft.x;
+	constants.m_cameraLeft[1] = cameraLeft.y;
+	constants.m_cameraLeft[2] = cameraLeft.z;
+	constants.m_cameraUp[0] = cameraUp.x;
+	constants.m_cameraUp[1] = cameraUp.y;
+	constants.m_cameraUp[2] = cameraUp.z;
+	constants.m_isHorizontal = isHorizontal ? 1 : 0;
+	constants.m_firstSegment = firstSegment;
+	constants.m_quadsPerSegment = quadsPerSegment;
+	g_theRenderer->CopyCPUToGPU(&constants, sizeof(constants), m_constantBuffer);
+	g_theRenderer->BindConstantBuffer(LOOP_CLIP_CONSTANTS_SLOT, m_constantBuffer);
+	g_theRenderer->BindStructuredBuffer(LOOP_CLIP_PARTICLES_SLOT, m_particleBuffer);
+	g_theRenderer->BindStructuredBuffer(LOOP_CLIP_SEGMENTS_SLOT, m_segmentBuffer);
+}
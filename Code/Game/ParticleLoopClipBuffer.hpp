@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include "Engine/Math/Vec3.hpp"
+
+class Shader;
+class VertexBuffer;
+class RenderBackend;
+class ConstantBuffer;
+class StructuredBuffer;
+
+//64 bytes, laid out like ClipParticle in LoopClipParticles.hlsl. One decoded clip sample in instance space.
+struct LoopClipParticleInstance
+{
+	float m_position[3];
+	float m_halfWidth = 0.f;
+	float m_halfHeight = 0.f;
+	float m_rotationDegrees = 0.f;
+	unsigned int m_color = 0;		//rgba8
+	float m_padding = 0.f;
+	float m_uvMinsMaxs[4];
+	float m_frameDelta[3];			//movement to the next frame
+	float m_padding2 = 0.f;
+};
+
+//80 bytes, laid out like ClipSegment in LoopClipParticles.hlsl. The particles of one emitter in the current frame of one instance.
+struct LoopClipSegment
+{
+	float m_iBasis[4];
+	float m_jBasis[4];
+	float m_kBasis[4];
+	float m_translation[4];
+	unsigned int m_firstParticle = 0;
+	unsigned int m_numParticles = 0;
+	float m_frameFraction = 0.f;
+	float m_padding = 0.f;
+};
+
+//Gpu side of a loop clip. Every frame of the clip is decoded and uploaded once, and playing it back only uploads one segment per
+//visible instance and emitter. Each segment gets the same number of quads in the draw, the emitter's most particles in any frame,
+//and LoopClipParticles.hlsl collapses the quads past the end of the segment's frame. Without a renderer nothing is uploaded
+//and draws only reach the render backend.
+class ParticleLoopClipBuffer
+{
+public:
+	ParticleLoopClipBuffer(const std::vector<LoopClipParticleInstance>& particles, int maxSegments);
+	~ParticleLoopClipBuffer();
+
+	void SetSegments(const std::vector<LoopClipSegment>& segments);
+	void Draw(RenderBackend& backend, int firstSegment, int numSegments, int quadsPerSegment, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal) const;
+	int GetMaxSegments() const { return m_maxSegments; }
+
+private:
+	int m_maxSegments = 0;
+	StructuredBuffer* m_particleBuffer = nullptr;
+	StructuredBuffer* m_segmentBuffer = nullptr;
+	ConstantBuffer* m_constantBuffer = nullptr;
+	VertexBuffer* m_placeholderBuffer = nullptr;
+	Shader* m_shader = nullptr;
+
+private:
+	void BindSegments(int firstSegment, int quadsPerSegment, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal) const;
+};
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleLoopClip.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+extern RenderResourceTable* g_theRenderResources;
+
+static const char* LOOP_CLIP_TEST_PATH = "ParticleLoopClipTest.clip";
+
+static std::vector<ParticleEmitterData> MakeLoopClipTestData(bool isSpriteSheet)
+{
+	std::vector<ParticleEmitterData> emitterData;
+	emitterData.push_back(MakeTestEmitterData(100, 40.f, 1.f));
+	emitterData.push_back(MakeTestEmitterData(100, 20.f, 0.5f));
+	emitterData[1].m_isSpriteSheetTexture = isSpriteSheet;
+	emitterData[1].m_spriteSheetGridLayout = IntVec2(2, 2);
+	return emitterData;
+}
+
+static std::vector<char> ReadFileBytes(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFileBytes(const char* path, const std::vector<char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(bytes.data(), bytes.size());
+}
+
+//bakes and saves a clip, and returns the bytes of the file along with where its tables start
+static std::vector<char> SaveTestClip(int& out_numFrames, int& out_numSamples, size_t& out_frameStartsOffset, size_t& out_samplesOffset)
+{
+	ParticleLoopClip* clip = ParticleLoopClip::Bake(MakeLoopClipTestData(true), 10.f);
+	out_numFrames = clip ? clip->GetNumFrames() : 0;
+	out_numSamples = clip ? clip->GetNumSamples() : 0;
+	bool isSaved = clip && clip->SaveToFile(LOOP_CLIP_TEST_PATH);
+	delete clip;
+	if (!isSaved)
+		return std::vector<char>();
+
+	//the tables close the file, frame starts and then samples
+	std::vector<char> bytes = ReadFileBytes(LOOP_CLIP_TEST_PATH);
+	out_samplesOffset = bytes.size() - size_t(out_numSamples) * sizeof(ParticleClipSample);
+	out_frameStartsOffset = out_samplesOffset - size_t(out_numFrames + 1) * sizeof(int);
+	return bytes;
+}
+
+GAME_TEST(ParticleLoopClip_SavedClipLoadsBackUnchanged)
+{
+	int numFrames = 0;
+	int numSamples = 0;
+	size_t frameStartsOffset = 0;
+	size_t samplesOffset = 0;
+	std::vector<char> bytes = SaveTestClip(numFrames, numSamples, frameStartsOffset, samplesOffset);
+	GAME_TEST_CHECK(!bytes.empty());
+
+	//the longest lifetime sets the period, 1 second at 10 frames per second
+	GAME_TEST_CHECK(numFrames == 10);
+	GAME_TEST_CHECK(numSamples > 0);
+	ParticleLoopClip* clip = ParticleLoopClip::LoadFromFile(LOOP_CLIP_TEST_PATH);
+	GAME_TEST_CHECK(clip != nullptr);
+	if (clip)
+	{
+		GAME_TEST_CHECK(clip->GetNumFrames() == numFrames);
+		GAME_TEST_CHECK(clip->GetNumSamples() == numSamples);
+		GAME_TEST_CHECK(clip->GetNumEmitters() == 2);
+		GAME_TEST_CHECK_NEAR(clip->GetPeriodSeconds(), 1.f, 0.0001f);
+		int numFrameSamples = 0;
+		const ParticleClipSample* firstSamples = clip->GetFrameSamples(0, numFrameSamples);
+		GAME_TEST_CHECK(numFrameSamples > 0 && memcmp(firstSamples, &bytes[samplesOffset], sizeof(ParticleClipSample)) == 0);
+	}
+	delete clip;
+	remove(LOOP_CLIP_TEST_PATH);
+}
+
+GAME_TEST(ParticleLoopClip_RejectsSampleOfMissingEmitter)
+{
+	int numFrames = 0;
+	int numSamples = 0;
+	size_t frameStartsOffset = 0;
+	size_t samplesOffset = 0;
+	std::vector<char> bytes = SaveTestClip(numFrames, numSamples, frameStartsOffset, samplesOffset);
+	GAME_TEST_CHECK(numSamples > 0);
+	if (numSamples <= 0)
+		return;
+
+	bytes[samplesOffset + offsetof(ParticleClipSample, m_emitterIndex)] = 2;
+	WriteFileBytes(LOOP_CLIP_TEST_PATH, bytes);
+	ParticleLoopClip* clip = ParticleLoopClip::LoadFromFile(LOOP_CLIP_TEST_PATH);
+	GAME_TEST_CHECK(clip == nullptr);
+	delete clip;
+	remove(LOOP_CLIP_TEST_PATH);
+}
+
+GAME_TEST(ParticleLoopClip_RejectsFramesOutOfOrder)
+{
+	int numFrames = 0;
+	int numSamples = 0;
+	size_t frameStartsOffset = 0;
+	size_t samplesOffset = 0;
+	std::vector<char> bytes = SaveTestClip(numFrames, numSamples, frameStartsOffset, samplesOffset);
+	GAME_TEST_CHECK(numFrames > 1);
+	if (numFrames <= 1)
+		return;
+
+	//the second frame starting past the end of the clip
+	int badStart = numSamples + 1;
+	memcpy(&bytes[frameStartsOffset + sizeof(int)], &badStart, sizeof(int));
+	WriteFileBytes(LOOP_CLIP_TEST_PATH, bytes);
+	ParticleLoopClip* clip = ParticleLoopClip::LoadFromFile(LOOP_CLIP_TEST_PATH);
+	GAME_TEST_CHECK(clip == nullptr);
+	delete clip;
+	remove(LOOP_CLIP_TEST_PATH);
+}
+
+GAME_TEST(ParticleLoopClip_RejectsTruncatedFile)
+{
+	int numFrames = 0;
+	int numSamples = 0;
+	size_t frameStartsOffset = 0;
+	size_t samplesOffset = 0;
+	std::vector<char> bytes = SaveTestClip(numFrames, numSamples, frameStartsOffset, samplesOffset);
+	GAME_TEST_CHECK(numSamples > 0);
+	if (numSamples <= 0)
+		return;
+
+	bytes.resize(bytes.size() - sizeof(ParticleClipSample) / 2);
+	WriteFileBytes(LOOP_CLIP_TEST_PATH, bytes);
+	ParticleLoopClip* clip = ParticleLoopClip::LoadFromFile(LOOP_CLIP_TEST_PATH);
+	GAME_TEST_CHECK(clip == nullptr);
+	delete clip;
+	remove(LOOP_CLIP_TEST_PATH);
+}
+
+GAME_TEST(ParticleLoopClip_EffectRejectsClipOfOtherSpriteSheet)
+{
+	//the clip shows all four frames of the sprite sheet, which an effect drawing a plain texture does not have
+	BatchedParticleEffect matching(MakeLoopClipTestData(true), 1);
+	matching.SetLoopClip(ParticleLoopClip::Bake(MakeLoopClipTestData(true), 10.f));
+	GAME_TEST_CHECK(matching.IsPlayingLoopClip());
+
+	BatchedParticleEffect plain(MakeLoopClipTestData(false), 1);
+	plain.SetLoopClip(ParticleLoopClip::Bake(MakeLoopClipTestData(true), 10.f));
+	GAME_TEST_CHECK(!plain.IsPlayingLoopClip());
+
+	std::vector<ParticleEmitterData> oneEmitter(1, MakeTestEmitterData(100, 40.f, 1.f));
+	BatchedParticleEffect fewerEmitters(oneEmitter, 1);
+	fewerEmitters.SetLoopClip(ParticleLoopClip::Bake(MakeLoopClipTestData(true), 10.f));
+	GAME_TEST_CHECK(!fewerEmitters.IsPlayingLoopClip());
+}
+
+GAME_TEST(ParticleLoopClip_BakesWithoutRenderResources)
+{
+	//tools bake before any renderer exists, textures are only interned once an emitter draws
+	RenderResourceTable* renderResources = g_theRenderResources;
+	g_theRenderResources = nullptr;
+	std::vector<ParticleEmitterData> emitterData = MakeLoopClipTestData(true);
+	emitterData[0].m_textureFilepath = "Data/Images/RoundSoftParticle.png";
+	emitterData[1].m_textureFilepath = "Data\\Images\\SplashRing.png";
+	ParticleLoopClip* clip = ParticleLoopClip::Bake(emitterData, 10.f);
+	GAME_TEST_CHECK(clip != nullptr && clip->GetNumSamples() > 0);
+	delete clip;
+
+	BatchedParticleEffect effect(emitterData, 1);
+	GAME_TEST_CHECK(effect.GetEmitter(0).m_textureHash == HashResourcePath("Data/Images/RoundSoftParticle.png"));
+	GAME_TEST_CHECK(effect.GetEmitter(1).m_textureHash == HashResourcePath("Data\\Images\\SplashRing.png"));
+	GAME_TEST_CHECK(!effect.GetEmitter(0).m_texture.IsValid() && !effect.GetEmitter(1).m_texture.IsValid());
+	g_theRenderResources = renderResources;
+}
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include <emmintrin.h>
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Game/ParticleOcclusionBuffer.hpp"
+
+constexpr float MIN_OCCLUDER_TRIANGLE_AREA = 0.0001f;
+
+ParticleOcclusionBuffer::ParticleOcclusionBuffer(int width, int height)
+{
+	GUARANTEE_OR_DIE(width > 0 && height > 0, "Particle occlusion buffer needs a non zero size");
+
+	//rows are rasterized four texels at a time, so level 0 is padded to a multiple of four
+	IntVec2 dimensions = IntVec2((width + 3) & ~3, height);
+	while (true)
+	{
+		m_levelDimensions.push_back(dimensions);
+		m_levels.emplace_back(dimensions.x * dimensions.y, 0.f);
+		if (dimensions.x == 1 && dimensions.y == 1)
+			break;
+		dimensions = IntVec2(std::max(1, (dimensions.x + 1) / 2), std::max(1, (dimensions.y + 1) / 2));
+	}
+}
+
+int ParticleOcclusionBuffer::AddOccluder(const std::vector<Vec3>& localTriangles, const Mat44& transform)
+{
+	int occluderId = -1;
+	if (m_freeOccluders.empty())
+	{
+		occluderId = int(m_occluders.size());
+		m_occluders.emplace_back();
+	}
+	else
+	{
+		occluderId = m_freeOccluders.back();
+		m_freeOccluders.pop_back();
+	}
+
+	ParticleOccluder& occluder = m_occluders[occluderId];
+	occluder.m_localTriangles = localTriangles;
+	occluder.m_transform = transform;
+	occluder.m_isActive = true;
+	return occluderId;
+}
+
+void ParticleOcclusionBuffer::SetOccluderTransform(int occluderId, const Mat44& transform)
+{
+	m_occluders[occluderId].m_transform = transform;
+}
+
+void ParticleOcclusionBuffer::RemoveOccluder(int occluderId)
+{
+	ParticleOccluder& occluder = m_occluders[occluderId];
+	occluder.m_localTriangles.clear();
+	occluder.m_isActive = false;
+	m_freeOccluders.push_back(occluderId);
+}
+
+void ParticleOcclusionBuffer::RasterizeOccluders(const ParticleFrustum& view)
+{
+	m_view = view;
+	m_numRasterizedTriangles = 0;
+	std::fill(m_levels[0].begin(), m_levels[0].end(), 0.f);
+
+	for (int occluderIndex = 0; occluderIndex < int(m_occluders.size()); occluderIndex++)
+	{
+		const ParticleOccluder& occluder = m_occluders[occluderIndex];
+		if (!occluder.m_isActive)
+			continue;
+
+		for (int i = 0; i + 2 < int(occluder.m_localTriangles.size()); i += 3)
+		{
+			//triangles crossing the near plane are dropped rather than clipped, which can only make the buffer emptier
+			Vec3 a, b, c;
+			if (!ProjectToScreen(occluder.m_transform.TransformPosition3D(occluder.m_localTriangles[i]), a))
+				continue;
+			if (!ProjectToScreen(occluder.m_transform.TransformPosition3D(occluder.m_localTriangles[i + 1]), b))
+				continue;
+			if (!ProjectToScreen(occluder.m_transform.TransformPosition3D(occluder.m_localTriangles[i + 2]), c))
+				continue;
+			RasterizeTriangle(a, b, c);
+		}
+	}
+
+	BuildHierarchicalZ();
+}
+
+bool ParticleOcclusionBuffer::IsOccluded(const AABB3& bounds) const
+{
+	if (m_numRasterizedTriangles == 0)
+		return false;
+
+	Vec2 screenMins = Vec2(FLT_MAX, FLT_MAX);
+	Vec2 screenMaxs = Vec2(-FLT_MAX, -FLT_MAX);
+	float nearestInverseDepth = 0.f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		Vec3 cornerPosition = Vec3((corner & 1) ? bounds.m_maxs.x : bounds.m_mins.x, (corner & 2) ? bounds.m_maxs.y : bounds.m_mins.y, (corner & 4) ? bounds.m_maxs.z : bounds.m_mins.z);
+		Vec3 screenPosition;
+		if (!ProjectToScreen(cornerPosition, screenPosition))
+			return false;		//bounds reaching past the near plane are always drawn
+
+		screenMins = Vec2(std::min(screenMins.x, screenPosition.x), std::min(screenMins.y, screenPosition.y));
+		screenMaxs = Vec2(std::max(screenMaxs.x, screenPosition.x), std::max(screenMaxs.y, screenPosition.y));
+		nearestInverseDepth = std::max(nearestInverseDepth, screenPosition.z);
+	}
+
+	const IntVec2& dimensions = m_levelDimensions[0];
+	if (screenMaxs.x < 0.f || screenMaxs.y < 0.f || screenMins.x >= float(dimensions.x) || screenMins.y >= float(dimensions.y))
+		return false;		//off screen is the frustum cull's call, not ours
+
+	int minX = std::max(0, int(floorf(screenMins.x)));
+	int minY = std::max(0, int(floorf(screenMins.y)));
+	int maxX = std::min(dimensions.x - 1, int(floorf(screenMaxs.x)));
+	int maxY = std::min(dimensions.y - 1, int(floorf(screenMaxs.y)));
+
+	//climb until the screen rect covers at most 2x2 texels
+	int level = 0;
+	while (level < int(m_levels.size()) - 1 && ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1))
+	{
+		level++;
+	}
+
+	const std::vector<float>& texels = m_levels[level];
+	int levelWidth = m_levelDimensions[level].x;
+	for (int y = minY >> level; y <= maxY >> level; y++)
+	{
+		for (int x = minX >> level; x <= maxX >> level; x++)
+		{
+			//the farthest occluder in this texel is not in front of the nearest point of the bounds
+			if (texels[y * levelWidth + x] <= nearestInverseDepth)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool ParticleOcclusionBuffer::ProjectToScreen(const Vec3& worldPosition, Vec3& out_screenPosition) const
+{
+	Vec3 relative = worldPosition - m_view.m_position;
+	float depth = DotProduct3D(relative, m_view.m_forward);
+	if (depth < m_view.m_nearZ || depth <= 0.f)
+		return false;
+
+	float inverseDepth = 1.f / depth;
+	float ndcX = -DotProduct3D(relative, m_view.m_left) * inverseDepth / m_view.m_tanHalfFovX;
+	float ndcY = DotProduct3D(relative, m_view.m_up) * inverseDepth / m_view.m_tanHalfFovY;
+	const IntVec2& dimensions = m_levelDimensions[0];
+	out_screenPosition.x = (ndcX * 0.5f + 0.5f) * float(dimensions.x);
+	out_screenPosition.y = (ndcY * 0.5f + 0.5f) * float(dimensions.y);
+	out_screenPosition.z = inverseDepth;
+	return true;
+}
+
+void ParticleOcclusionBuffer::RasterizeTriangle(Vec3 a, Vec3 b, Vec3 c)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (fabsf(area) < MIN_OCCLUDER_TRIANGLE_AREA)
+		return;
+	if (area < 0.f)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+
+	const IntVec2& dimensions = m_levelDimensions[0];
+	int minX = std::max(0, int(floorf(std::min(a.x, std::min(b.x, c.x)))));
+	int minY = std::max(0, int(floorf(std::min(a.y, std::min(b.y, c.y)))));
+	int maxX = std::min(dimensions.x - 1, int(ceilf(std::max(a.x, std::max(b.x, c.x)))));
+	int maxY = std::min(dimensions.y - 1, int(ceilf(std::max(a.y, std::max(b.y, c.y)))));
+	if (minX > maxX || minY > maxY)
+		return;
+	minX &= ~3;
+	m_numRasterizedTriangles++;
+
+	//edge functions as A*x + B*y + C, each one is the barycentric weight of the opposite vertex scaled by the area
+	float inverseArea = 1.f / area;
+	float edgeA[3] = { b.y - c.y, c.y - a.y, a.y - b.y };
+	float edgeB[3] = { c.x - b.x, a.x - c.x, b.x - a.x };
+	float edgeC[3] = { b.x * c.y - c.x * b.y, c.x * a.y - a.x * c.y, a.x * b.y - b.x * a.y };
+	__m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 edgeStepX[3];
+	for (int i = 0; i < 3; i++)
+	{
+		edgeStepX[i] = _mm_set1_ps(edgeA[i]);
+	}
+	__m128 depthA = _mm_set1_ps(a.z * inverseArea);
+	__m128 depthB = _mm_set1_ps(b.z * inverseArea);
+	__m128 depthC = _mm_set1_ps(c.z * inverseArea);
+
+	float* texels = m_levels[0].data();
+	for (int y = minY; y <= maxY; y++)
+	{
+		float pixelY = float(y) + 0.5f;
+		__m128 rowEdge[3];
+		for (int i = 0; i < 3; i++)
+		{
+			rowEdge[i] = _mm_set1_ps(edgeB[i] * pixelY + edgeC[i]);
+		}
+
+		float* row = texels + y * dimensions.x;
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x)), pixelOffsets);
+			__m128 weightA = _mm_add_ps(rowEdge[0], _mm_mul_ps(edgeStepX[0], pixelX));
+			__m128 weightB = _mm_add_ps(rowEdge[1], _mm_mul_ps(edgeStepX[1], pixelX));
+			__m128 weightC = _mm_add_ps(rowEdge[2], _mm_mul_ps(edgeStepX[2], pixelX));
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(weightA, zero), _mm_and_ps(_mm_cmpge_ps(weightB, zero), _mm_cmpge_ps(weightC, zero)));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			//inverse depth is linear in screen space, so it interpolates straight from the weights
+			__m128 depth = _mm_add_ps(_mm_mul_ps(weightA, depthA), _mm_add_ps(_mm_mul_ps(weightB, depthB), _mm_mul_ps(weightC, depthC)));
+			__m128 previous = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_max_ps(previous, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+		}
+	}
+}
+
+void ParticleOcclusionBuffer::BuildHierarchicalZ()
+{
+	for (int level = 1; level < int(m_levels.size()); level++)
+	{
+		const std::vector<float>& source = m_levels[level - 1];
+		const IntVec2& sourceDimensions = m_levelDimensions[level - 1];
+		std::vector<float>& destination = m_levels[level];
+		const IntVec2& dimensions = m_levelDimensions[level];
+		for (int y = 0; y < dimensions.y; y++)
+		{
+			int sourceY0 = y * 2;
+			int sourceY1 = std::min(sourceY0 + 1, sourceDimensions.y - 1);
+			for (int x = 0; x < dimensions.x; x++)
+			{
+				int sourceX0 = x * 2;
+				int sourceX1 = std::min(sourceX0 + 1, sourceDimensions.x - 1);
+				float farthest = std::min(std::min(source[sourceY0 * sourceDimensions.x + sourceX0], source[sourceY0 * sourceDimensions.x + sourceX1]),
+					std::min(source[sourceY1 * sourceDimensions.x + sourceX0], source[sourceY1 * sourceDimensions.x + sourceX1]));
+				destination[y * dimensions.x + x] = farthest;
+			}
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "Engine/Math/Mat44.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Game/ParticleFrustum.hpp"
+
+struct ParticleOccluder
+{
+	std::vector<Vec3> m_localTriangles;		//three positions per triangle, winding does not matter
+	Mat44 m_transform;
+	bool m_isActive = false;
+};
+
+//Low resolution depth buffer rasterized on the CPU from designated occluder meshes, four pixels at a time.
+//Texels hold inverse view depth, and a hierarchical-Z pyramid keeps the farthest occluder of each 2x2 block,
+//so testing particle bounds against it costs a handful of texel reads no matter how big the bounds are on screen.
+class ParticleOcclusionBuffer
+{
+public:
+	ParticleOcclusionBuffer(int width, int height);
+
+	int AddOccluder(const std::vector<Vec3>& localTriangles, const Mat44& transform);
+	void SetOccluderTransform(int occluderId, const Mat44& transform);
+	void RemoveOccluder(int occluderId);
+
+	void RasterizeOccluders(const ParticleFrustum& view);
+	bool IsOccluded(const AABB3& bounds) const;
+
+	IntVec2 GetDimensions() const { return m_levelDimensions[0]; }
+	int GetNumActiveOccluders() const { return int(m_occluders.size() - m_freeOccluders.size()); }
+	int GetNumRasterizedTriangles() const { return m_numRasterizedTriangles; }
+
+private:
+	std::vector<std::vector<float>> m_levels;		//level 0 is the full buffer, each level above halves both dimensions
+	std::vector<IntVec2> m_levelDimensions;
+	std::vector<ParticleOccluder> m_occluders;
+	std::vector<int> m_freeOccluders;
+	ParticleFrustum m_view;
+	int m_numRasterizedTriangles = 0;
+
+private:
+	bool ProjectToScreen(const Vec3& worldPosition, Vec3& out_screenPosition) const;
+	void RasterizeTriangle(Vec3 a, Vec3 b, Vec3 c);
+	void BuildHierarchicalZ();
+};
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <math.h>
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Game/ParticleQualityController.hpp"
+
+constexpr float QUALITY_KNOB_STEP = 0.05f;
+constexpr float WORK_SMOOTHING = 0.1f;
+constexpr float SORTING_OFF_QUALITY = 0.4f;
+constexpr float SORTING_ON_QUALITY = 0.6f;
+
+std::vector<ParticleQualityController*> ParticleQualityController::s_consoleControllers;
+
+ParticleQualityController::ParticleQualityController(const ParticleQualityConfig& config)
+	:m_config(config)
+{
+	m_lastEndFrameTime = GetCurrentTimeSeconds();
+	if (s_consoleControllers.empty())
+		SubscribeEventCallbackFunction("particles.quality", Command_ParticleQuality);
+	s_consoleControllers.push_back(this);
+}
+
+ParticleQualityController::~ParticleQualityController()
+{
+	s_consoleControllers.erase(std::remove(s_consoleControllers.begin(), s_consoleControllers.end(), this), s_consoleControllers.end());
+	if (s_consoleControllers.empty())
+		UnsubscribeEventCallbackFunction("particles.quality", Command_ParticleQuality);
+}
+
+void ParticleQualityController::AddWorkSeconds(double seconds)
+{
+	m_workSecondsThisFrame += seconds;
+}
+
+void ParticleQualityController::EndFrame()
+{
+	double now = GetCurrentTimeSeconds();
+	float deltaSeconds = std::min(float(now - m_lastEndFrameTime), 0.1f);
+	m_lastEndFrameTime = now;
+	EndFrame(deltaSeconds);
+}
+
+//with the frame time given rather than measured, for tools and tests that step frames faster or slower than real time
+void ParticleQualityController::EndFrame(float deltaSeconds)
+{
+	float workMs = float(m_workSecondsThisFrame * 1000.0);
+	m_workSecondsThisFrame = 0.0;
+	m_smoothedWorkMs += (workMs - m_smoothedWorkMs) * WORK_SMOOTHING;
+	if (m_config.m_frameBudgetMs <= 0.f || deltaSeconds <= 0.f)
+		return;
+
+	//positive error means headroom, and the integral doubles as the steady state quality
+	float error = (m_config.m_frameBudgetMs - m_smoothedWorkMs) / m_config.m_frameBudgetMs;
+	if (fabsf(error) < m_config.m_deadband)
+		error = 0.f;
+	m_integral = Clamp(m_integral + m_config.m_integralGain * error * deltaSeconds, m_config.m_minQuality, 1.f);
+	//rising work time is falling headroom, so the derivative of the measurement is negated to act like one of the error
+	float derivative = -(m_smoothedWorkMs - m_previousWorkMs) / (m_config.m_frameBudgetMs * deltaSeconds);
+	m_previousWorkMs = m_smoothedWorkMs;
+	m_quality = Clamp(m_integral + m_config.m_proportionalGain * error + m_config.m_derivativeGain * derivative, m_config.m_minQuality, 1.f);
+
+	if (fabsf(m_quality - m_appliedQuality) >= QUALITY_KNOB_STEP || (m_quality == 1.f && m_appliedQuality != 1.f))
+		ApplyKnobs();
+}
+
+void ParticleQualityController::SetFrameBudgetMs(float frameBudgetMs)
+{
+	m_config.m_frameBudgetMs = frameBudgetMs;
+	m_previousWorkMs = m_smoothedWorkMs;
+	if (frameBudgetMs <= 0.f)
+	{
+		m_integral = 1.f;
+		m_quality = 1.f;
+		ApplyKnobs();
+	}
+}
+
+void ParticleQualityController::ApplyKnobs()
+{
+	m_appliedQuality = m_quality;
+	m_knobs.m_emissionScale = m_quality;
+	m_knobs.m_maxAliveScale = m_quality;
+	m_knobs.m_lodDistanceScale = 1.f / m_quality;
+	bool wasSortingEnabled = m_knobs.m_isSortingEnabled;
+	if (m_knobs.m_isSortingEnabled && m_quality < SORTING_OFF_QUALITY)
+		m_knobs.m_isSortingEnabled = false;
+	else if (!m_knobs.m_isSortingEnabled && m_quality > SORTING_ON_QUALITY)
+		m_knobs.m_isSortingEnabled = true;
+
+	//the scales move every step, only the sorting switch is a change worth reporting unless asked for more
+	if (!g_theConsole)
+		return;
+	if (wasSortingEnabled != m_knobs.m_isSortingEnabled)
+		g_theConsole->AddLine(g_theConsole->INFO_WARNING, Stringf("Particle sorting %s at quality %.2f (work %.2f ms, budget %.2f ms)", m_knobs.m_isSortingEnabled ? "on" : "off", m_quality, m_smoothedWorkMs, m_config.m_frameBudgetMs));
+	else if (m_config.m_isLoggingKnobs)
+		g_theConsole->AddLine(g_theConsole->INFO_WARNING, Stringf("Particle quality = %.2f (work %.2f ms, budget %.2f ms)", m_quality, m_smoothedWorkMs, m_config.m_frameBudgetMs));
+}
+
+//particles.quality [world=index] [budget=ms] [log=true|false], without a world every live controller is changed
+bool ParticleQualityController::Command_ParticleQuality(EventArgs& args)
+{
+	int worldIndex = args.GetValue("world", -1);
+	if (worldIndex >= int(s_consoleControllers.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d particle worlds", int(s_consoleControllers.size())));
+		return false;
+	}
+
+	for (int controllerIndex = 0; controllerIndex < int(s_consoleControllers.size()); controllerIndex++)
+	{
+		if (worldIndex >= 0 && controllerIndex != worldIndex)
+			continue;
+
+		ParticleQualityController& controller = *s_consoleControllers[controllerIndex];
+		float frameBudgetMs = args.GetValue("budget", controller.m_config.m_frameBudgetMs);
+		if (frameBudgetMs != controller.m_config.m_frameBudgetMs)
+			controller.SetFrameBudgetMs(frameBudgetMs);
+		controller.m_config.m_isLoggingKnobs = args.GetValue("log", controller.m_config.m_isLoggingKnobs);
+
+		const ParticleQualityKnobs& knobs = controller.m_knobs;
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("World %d: particle quality = %.2f, work = %.2f ms, budget = %.2f ms", controllerIndex, controller.m_quality, controller.m_smoothedWorkMs, controller.m_config.m_frameBudgetMs));
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Emission x%.2f, max alive x%.2f, lod distance x%.2f, sorting %s", knobs.m_emissionScale, knobs.m_maxAliveScale, knobs.m_lodDistanceScale, knobs.m_isSortingEnabled ? "on" : "off"));
+	}
+	return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include "Engine/Core/EventSystem.hpp"
+
+struct ParticleQualityConfig
+{
+	float m_frameBudgetMs = 0.f;		//particle update and render prep time to hold, 0 disables the controller
+	float m_proportionalGain = 0.6f;
+	float m_integralGain = 0.8f;
+	float m_derivativeGain = 0.05f;
+	float m_deadband = 0.1f;			//relative error inside which the loop holds still
+	float m_minQuality = 0.1f;
+	bool m_isLoggingKnobs = false;		//debug, logs every knob step instead of only the sorting switches
+};
+
+//Global knobs every batched effect of a world reads each frame.
+struct ParticleQualityKnobs
+{
+	float m_emissionScale = 1.f;
+	float m_lodDistanceScale = 1.f;		//distances are multiplied by this before picking an lod band
+	float m_maxAliveScale = 1.f;
+	bool m_isSortingEnabled = true;
+};
+
+//PID loop that measures the particle work of each frame and turns one quality value up or down to hold a frame time budget.
+//The measured time is smoothed, errors inside the deadband are ignored, and the knobs only move once the quality has drifted
+//a full step from what they were last set to, so a scene sitting near the budget does not make them oscillate.
+//The derivative term follows the measured time rather than the error, so the deadband edge does not kick it.
+//Every live controller answers the particles.quality console command, in the order their worlds were created.
+class ParticleQualityController
+{
+public:
+	ParticleQualityController(const ParticleQualityConfig& config);
+	~ParticleQualityController();
+
+	void AddWorkSeconds(double seconds);
+	void EndFrame();
+	void EndFrame(float deltaSeconds);
+	void SetFrameBudgetMs(float frameBudgetMs);
+
+	float GetQuality() const { return m_quality; }
+	float GetSmoothedWorkMs() const { return m_smoothedWorkMs; }
+	const ParticleQualityConfig& GetConfig() const { return m_config; }
+	const ParticleQualityKnobs& GetKnobs() const { return m_knobs; }
+	static bool Command_ParticleQuality(EventArgs& args);
+
+private:
+	ParticleQualityConfig m_config;
+	ParticleQualityKnobs m_knobs;
+	double m_workSecondsThisFrame = 0.0;
+	double m_lastEndFrameTime = 0.0;
+	float m_smoothedWorkMs = 0.f;
+	float m_integral = 1.f;
+	float m_previousWorkMs = 0.f;
+	float m_quality = 1.f;
+	float m_appliedQuality = 1.f;
+
+private:
+	void ApplyKnobs();
+	static std::vector<ParticleQualityController*> s_consoleControllers;
+};
@@ -0,0 +1,131 @@
+#include <math.h>
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleQualityController.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+
+static const float QUALITY_TEST_FRAME_SECONDS = 1.f / 60.f;
+
+//one frame of the given particle work, stepped at a fixed frame time so the loop does not depend on how fast the test runs
+static void RunQualityFrame(ParticleQualityController& controller, float workMs)
+{
+	controller.AddWorkSeconds(double(workMs) * 0.001);
+	controller.EndFrame(QUALITY_TEST_FRAME_SECONDS);
+}
+
+GAME_TEST(ParticleQuality_KnobsStepDownOverBudgetAndRecoverWithHysteresis)
+{
+	ParticleQualityConfig config;
+	config.m_frameBudgetMs = 1.f;
+	ParticleQualityController controller(config);
+
+	//three times the budget drives the knobs down, in steps rather than every frame
+	int numKnobChanges = 0;
+	bool areStepsWhole = true;
+	float lastEmissionScale = controller.GetKnobs().m_emissionScale;
+	for (int frame = 0; frame < 600; frame++)
+	{
+		RunQualityFrame(controller, 3.f);
+		float emissionScale = controller.GetKnobs().m_emissionScale;
+		if (emissionScale != lastEmissionScale)
+		{
+			numKnobChanges++;
+			areStepsWhole = areStepsWhole && fabsf(emissionScale - lastEmissionScale) >= 0.05f;
+			lastEmissionScale = emissionScale;
+		}
+	}
+	const ParticleQualityKnobs& knobs = controller.GetKnobs();
+	GAME_TEST_CHECK(controller.GetQuality() < 0.4f);
+	GAME_TEST_CHECK(knobs.m_emissionScale < 0.45f && knobs.m_maxAliveScale < 0.45f && knobs.m_lodDistanceScale > 2.f);
+	GAME_TEST_CHECK(!knobs.m_isSortingEnabled);
+	GAME_TEST_CHECK(numKnobChanges > 1 && numKnobChanges < 60);
+	GAME_TEST_CHECK(areStepsWhole);
+
+	//sitting at the budget is inside the deadband, so nothing moves
+	for (int frame = 0; frame < 300; frame++)
+	{
+		RunQualityFrame(controller, controller.GetSmoothedWorkMs());
+	}
+	float heldEmissionScale = controller.GetKnobs().m_emissionScale;
+	for (int frame = 0; frame < 300; frame++)
+	{
+		RunQualityFrame(controller, 1.f);
+	}
+	GAME_TEST_CHECK(controller.GetKnobs().m_emissionScale == heldEmissionScale);
+
+	//with headroom the quality climbs back to full, and sorting only comes back on well past where it went off
+	bool wasSortingOnTooEarly = false;
+	for (int frame = 0; frame < 1200; frame++)
+	{
+		RunQualityFrame(controller, 0.3f);
+		if (controller.GetKnobs().m_isSortingEnabled && controller.GetKnobs().m_emissionScale <= 0.6f)
+			wasSortingOnTooEarly = true;
+	}
+	GAME_TEST_CHECK(!wasSortingOnTooEarly);
+	GAME_TEST_CHECK(controller.GetQuality() == 1.f);
+	GAME_TEST_CHECK(controller.GetKnobs().m_emissionScale == 1.f && controller.GetKnobs().m_maxAliveScale == 1.f);
+	GAME_TEST_CHECK(controller.GetKnobs().m_isSortingEnabled);
+}
+
+static BatchedParticleEffect* CreateQualityTestEffect(ParticleWorld* world)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 200.f, 10.f));
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	ParticleLODPolicy lodPolicy = ParticleLODPolicy::GetDefault();
+	lodPolicy.m_dormantDelaySeconds = 0.f;
+	effect->SetLODPolicy(lodPolicy);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	return effect;
+}
+
+GAME_TEST(ParticleQuality_ReducedQualityEmitsFewerParticles)
+{
+	//two worlds running the same effect, one of them far over its particle budget
+	ParticleWorldConfig config;
+	config.m_qualityFrameBudgetMs = 1.f;
+	ParticleWorld* fullWorld = new ParticleWorld(config);
+	ParticleWorld* degradedWorld = new ParticleWorld(config);
+	fullWorld->Startup();
+	degradedWorld->Startup();
+	for (int frame = 0; frame < 600; frame++)
+	{
+		RunQualityFrame(*degradedWorld->GetQualityController(), 5.f);
+	}
+	float quality = degradedWorld->GetQualityController()->GetQuality();
+	GAME_TEST_CHECK(quality < 0.5f);
+
+	BatchedParticleEffect* fullEffect = CreateQualityTestEffect(fullWorld);
+	BatchedParticleEffect* degradedEffect = CreateQualityTestEffect(degradedWorld);
+	fullEffect->Update(0.25f);
+	degradedEffect->Update(0.25f);
+	GAME_TEST_CHECK(fullEffect->GetNumAliveParticles() == 50);
+	GAME_TEST_CHECK(degradedEffect->GetNumAliveParticles() <= int(50.f * quality) + 1);
+
+	//an instance waking from dormancy catches up at the reduced rate and cap too
+	Camera camera;
+	ParticleFrustum frustum = ParticleFrustum::CreateFromCamera(camera, 60.f, 2.f, 0.1f, 100.f);
+	fullWorld->SetViewFrustum(frustum);
+	degradedWorld->SetViewFrustum(frustum);
+	fullEffect->SetAllInstancesCulled();
+	degradedEffect->SetAllInstancesCulled();
+	for (int frame = 0; frame < 30; frame++)
+	{
+		fullEffect->Update(0.1f);
+		degradedEffect->Update(0.1f);
+	}
+	fullEffect->SetInstanceVisible(0);
+	degradedEffect->SetInstanceVisible(0);
+	fullEffect->Update(0.1f);
+	degradedEffect->Update(0.1f);
+	GAME_TEST_CHECK(fullEffect->GetNumAliveParticles() == 100);
+	GAME_TEST_CHECK(degradedEffect->GetNumAliveParticles() <= int(100.f * quality) + 1);
+
+	delete fullEffect;
+	delete degradedEffect;
+	fullWorld->Shutdown();
+	degradedWorld->Shutdown();
+	delete fullWorld;
+	delete degradedWorld;
+}
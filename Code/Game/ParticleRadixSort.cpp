@@ -0,0 +1,170 @@
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/ParticleRadixSort.hpp"
+
+ParticleRadixSortJob::ParticleRadixSortJob(ParticleRadixSorter* sorter, int chunkIndex)
+	:ParticleChunkJob(chunkIndex), m_sorter(sorter)
+{
+}
+
+void ParticleRadixSortJob::ExecuteChunk(int chunkIndex)
+{
+	m_sorter->RunChunk(chunkIndex);
+}
+
+ParticleRadixSorter::ParticleRadixSorter(JobSystem* jobSystem, int minPairsPerJob)
+	:m_jobSystem(jobSystem), m_minPairsPerJob(minPairsPerJob)
+{
+}
+
+ParticleRadixSorter::~ParticleRadixSorter()
+{
+	for (int i = 0; i < int(m_jobs.size()); i++)
+	{
+		delete m_jobs[i];
+	}
+}
+
+void ParticleRadixSorter::Sort(std::vector<ParticleSortPair>& pairs, int keyBits)
+{
+	m_numPairs = int(pairs.size());
+	if (m_numPairs < 2)
+		return;
+
+	//one chunk per worker plus the sorting thread, but never chunks too small to pay for their job
+	m_numChunks = 1;
+	if (m_jobSystem && m_minPairsPerJob > 0)
+	{
+		int maxChunks = m_jobSystem->GetNumWorkerThreads() + 1;
+		m_numChunks = m_numPairs / m_minPairsPerJob;
+		if (m_numChunks > maxChunks)
+		{
+			m_numChunks = maxChunks;
+		}
+		if (m_numChunks < 1)
+		{
+			m_numChunks = 1;
+		}
+	}
+	while (int(m_jobs.size()) < m_numChunks)
+	{
+		m_jobs.push_back(new ParticleRadixSortJob(this, int(m_jobs.size())));
+	}
+
+	m_scratch.resize(pairs.size());
+	m_chunkCounts.resize(size_t(m_numChunks) * PARTICLE_RADIX_BUCKETS);
+	ParticleSortPair* source = pairs.data();
+	ParticleSortPair* destination = m_scratch.data();
+
+	for (m_shift = 0; m_shift < keyBits; m_shift += PARTICLE_RADIX_BITS)
+	{
+		m_source = source;
+		m_destination = destination;
+		RunPhase(ParticleRadixPhase::HISTOGRAM);
+
+		//a digit every key shares would only copy the pairs across
+		unsigned int firstDigit = (source[0].m_key >> m_shift) & (PARTICLE_RADIX_BUCKETS - 1);
+		unsigned int numWithFirstDigit = 0;
+		for (int chunk = 0; chunk < m_numChunks; chunk++)
+		{
+			numWithFirstDigit += m_chunkCounts[size_t(chunk) * PARTICLE_RADIX_BUCKETS + firstDigit];
+		}
+		if (numWithFirstDigit == (unsigned int)m_numPairs)
+			continue;
+
+		//exclusive prefix over digits first, then chunks, so each chunk writes its pairs after those of earlier chunks with the same digit
+		unsigned int offset = 0;
+		for (int digit = 0; digit < PARTICLE_RADIX_BUCKETS; digit++)
+		{
+			for (int chunk = 0; chunk < m_numChunks; chunk++)
+			{
+				unsigned int& count = m_chunkCounts[size_t(chunk) * PARTICLE_RADIX_BUCKETS + digit];
+				unsigned int chunkCount = count;
+				count = offset;
+				offset += chunkCount;
+			}
+		}
+
+		RunPhase(ParticleRadixPhase::SCATTER);
+		ParticleSortPair* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	if (source != pairs.data())
+	{
+		pairs.swap(m_scratch);
+	}
+}
+
+bool ParticleRadixSorter::RepairNearlySorted(std::vector<ParticleSortPair>& pairs, int maxMoves)
+{
+	//insertion sort, linear when only a few pairs are out of place, abandoned once it has shifted maxMoves pairs
+	int numMoves = 0;
+	for (int i = 1; i < int(pairs.size()); i++)
+	{
+		ParticleSortPair pair = pairs[i];
+		int j = i;
+		while (j > 0 && pairs[j - 1].m_key > pair.m_key)
+		{
+			pairs[j] = pairs[j - 1];
+			j--;
+			numMoves++;
+		}
+		pairs[j] = pair;
+		if (numMoves > maxMoves)
+			return false;
+	}
+	return true;
+}
+
+void ParticleRadixSorter::MergeSortedRuns(const std::vector<ParticleSortPair>& first, const std::vector<ParticleSortPair>& second, std::vector<ParticleSortPair>& out_merged)
+{
+	out_merged.resize(first.size() + second.size());
+	int firstIndex = 0;
+	int secondIndex = 0;
+	for (int i = 0; i < int(out_merged.size()); i++)
+	{
+		//ties go to the first run so the merge is stable
+		if (secondIndex == int(second.size()) || (firstIndex < int(first.size()) && first[firstIndex].m_key <= second[secondIndex].m_key))
+		{
+			out_merged[i] = first[firstIndex++];
+		}
+		else
+		{
+			out_merged[i] = second[secondIndex++];
+		}
+	}
+}
+
+void ParticleRadixSorter::RunPhase(ParticleRadixPhase phase)
+{
+	m_phase = phase;
+	RunParticleChunkJobs(m_jobSystem, m_jobs, m_numChunks);
+}
+
+void ParticleRadixSorter::RunChunk(int chunkIndex)
+{
+	int begin = int((long long)m_numPairs * chunkIndex / m_numChunks);
+	int end = int((long long)m_numPairs * (chunkIndex + 1) / m_numChunks);
+	unsigned int* counts = &m_chunkCounts[size_t(chunkIndex) * PARTICLE_RADIX_BUCKETS];
+	const unsigned int digitMask = PARTICLE_RADIX_BUCKETS - 1;
+
+	if (m_phase == ParticleRadixPhase::HISTOGRAM)
+	{
+		for (int digit = 0; digit < PARTICLE_RADIX_BUCKETS; digit++)
+		{
+			counts[digit] = 0;
+		}
+		for (int i = begin; i < end; i++)
+		{
+			counts[(m_source[i].m_key >> m_shift) & digitMask]++;
+		}
+		return;
+	}
+
+	for (int i = begin; i < end; i++)
+	{
+		const ParticleSortPair& pair = m_source[i];
+		m_destination[counts[(pair.m_key >> m_shift) & digitMask]++] = pair;
+	}
+}
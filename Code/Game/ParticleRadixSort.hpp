@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/ParticleChunkJobs.hpp"
+
+class ParticleRadixSorter;
+
+constexpr int PARTICLE_RADIX_BITS = 8;
+constexpr int PARTICLE_RADIX_BUCKETS = 1 << PARTICLE_RADIX_BITS;
+
+struct ParticleSortPair
+{
+	unsigned int m_key = 0;
+	unsigned int m_index = 0;
+};
+
+enum class ParticleSortMode
+{
+	FULL,			//radix sort every frame
+	COHERENT,		//repair last frame's order, radix sort only what is new to it
+};
+
+struct ParticleSortSettings
+{
+	ParticleSortMode m_mode = ParticleSortMode::COHERENT;
+	float m_maxRepairMovesPerQuad = 4.f;	//disorder past this falls back to a full sort, as after a camera cut
+	float m_cameraTolerance = 0.001f;		//camera movement under which a still effect keeps last frame's order and render data
+	bool m_isGlobalOrderEnabled = true;		//merge sorted emitters sharing a blend mode into one stream instead of drawing them one after the other
+};
+
+enum class ParticleRadixPhase
+{
+	HISTOGRAM,
+	SCATTER,
+};
+
+//One chunk of one radix pass, run on a worker or inline on the sorting thread.
+class ParticleRadixSortJob : public ParticleChunkJob
+{
+public:
+	ParticleRadixSortJob(ParticleRadixSorter* sorter, int chunkIndex);
+
+protected:
+	virtual void ExecuteChunk(int chunkIndex) override;
+
+private:
+	ParticleRadixSorter* m_sorter = nullptr;
+};
+
+//LSD radix sort over (key, index) pairs, 8 bits per pass, stable so equal keys keep their order.
+//Each pass splits the pairs into chunks; every chunk builds its own histogram and scatters its own pairs
+//through prefix sums taken across all chunks, so workers never share a counter.
+//Passes whose digit is the same for every key are skipped, which makes quantized 16 bit keys two passes at most.
+class ParticleRadixSorter
+{
+	friend class ParticleRadixSortJob;
+
+public:
+	ParticleRadixSorter(JobSystem* jobSystem = nullptr, int minPairsPerJob = 16384);
+	~ParticleRadixSorter();
+
+	void Sort(std::vector<ParticleSortPair>& pairs, int keyBits);
+	static bool RepairNearlySorted(std::vector<ParticleSortPair>& pairs, int maxMoves);
+	static void MergeSortedRuns(const std::vector<ParticleSortPair>& first, const std::vector<ParticleSortPair>& second, std::vector<ParticleSortPair>& out_merged);
+
+private:
+	JobSystem* m_jobSystem = nullptr;
+	int m_minPairsPerJob = 0;
+	std::vector<ParticleSortPair> m_scratch;
+	std::vector<unsigned int> m_chunkCounts;		//PARTICLE_RADIX_BUCKETS entries per chunk, turned into write offsets before the scatter
+	std::vector<ParticleChunkJob*> m_jobs;
+
+	//state of the pass being run, read by the jobs
+	ParticleRadixPhase m_phase = ParticleRadixPhase::HISTOGRAM;
+	const ParticleSortPair* m_source = nullptr;
+	ParticleSortPair* m_destination = nullptr;
+	int m_numPairs = 0;
+	int m_numChunks = 0;
+	int m_shift = 0;
+
+private:
+	void RunPhase(ParticleRadixPhase phase);
+	void RunChunk(int chunkIndex);
+};
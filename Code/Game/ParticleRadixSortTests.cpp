@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <thread>
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Renderer/Camera.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleRadixSort.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+static bool IsLessByKey(const ParticleSortPair& a, const ParticleSortPair& b)
+{
+	return a.m_key < b.m_key;
+}
+
+//pairs numbered in order with keys from a fixed lcg, masked so plenty of keys repeat
+static std::vector<ParticleSortPair> MakeTestPairs(int numPairs, unsigned int keyMask)
+{
+	std::vector<ParticleSortPair> pairs(numPairs);
+	unsigned int state = 12345u;
+	for (int i = 0; i < numPairs; i++)
+	{
+		state = state * 1664525u + 1013904223u;
+		pairs[i].m_key = (state >> 8) & keyMask;
+		pairs[i].m_index = (unsigned int)i;
+	}
+	return pairs;
+}
+
+static bool AreSamePairs(const std::vector<ParticleSortPair>& a, const std::vector<ParticleSortPair>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (int i = 0; i < int(a.size()); i++)
+	{
+		if (a[i].m_key != b[i].m_key || a[i].m_index != b[i].m_index)
+			return false;
+	}
+	return true;
+}
+
+GAME_TEST(ParticleRadixSort_MatchesStableSort)
+{
+	ParticleRadixSorter sorter;
+	std::vector<ParticleSortPair> pairs = MakeTestPairs(3000, 0x3FF);
+	std::vector<ParticleSortPair> expected = pairs;
+	std::stable_sort(expected.begin(), expected.end(), IsLessByKey);
+	sorter.Sort(pairs, 16);
+	GAME_TEST_CHECK(AreSamePairs(pairs, expected));
+
+	//keys sharing their high byte skip that pass, which must leave the pairs in the right buffer
+	std::vector<ParticleSortPair> lowKeys = MakeTestPairs(500, 0xFF);
+	expected = lowKeys;
+	std::stable_sort(expected.begin(), expected.end(), IsLessByKey);
+	sorter.Sort(lowKeys, 32);
+	GAME_TEST_CHECK(AreSamePairs(lowKeys, expected));
+}
+
+GAME_TEST(ParticleRadixSort_ChunkedSortMatchesStableSort)
+{
+	//small chunks so every pass is split across all the workers, and several sorts so finished jobs get queued again
+	JobSystemConfig config;
+	config.m_numWorkerThreads = 3;
+	JobSystem jobSystem(config);
+	jobSystem.Startup();
+	{
+		ParticleRadixSorter sorter(&jobSystem, 256);
+		for (int round = 0; round < 8; round++)
+		{
+			std::vector<ParticleSortPair> pairs = MakeTestPairs(5000 + round * 777, round % 2 == 0 ? 0xFFFFFF : 0xFFF);
+			std::vector<ParticleSortPair> expected = pairs;
+			std::stable_sort(expected.begin(), expected.end(), IsLessByKey);
+			sorter.Sort(pairs, 32);
+			GAME_TEST_CHECK(AreSamePairs(pairs, expected));
+		}
+	}
+	GAME_TEST_CHECK(jobSystem.GetNumQueuedJobs() == 0);
+	GAME_TEST_CHECK(jobSystem.RetrieveFinishedJob() == nullptr);
+	jobSystem.Shutdown();
+}
+
+//stands in for a job of the particles manager, running on the shared job system until it is let go
+class BlockingTestJob : public Job
+{
+public:
+	virtual void Execute() override
+	{
+		while (!m_isReleased.load())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::atomic<bool> m_isReleased{ false };
+};
+
+GAME_TEST(ParticleRadixSort_ChunkedSortSharesItsJobSystem)
+{
+	JobSystemConfig config;
+	config.m_numWorkerThreads = 3;
+	JobSystem jobSystem(config);
+	jobSystem.Startup();
+	{
+		ParticleRadixSorter sorter(&jobSystem, 256);
+
+		//with another job still running, the sort runs on the calling thread and leaves that job's result for its owner
+		BlockingTestJob otherJob;
+		jobSystem.QueueJob(&otherJob);
+		while (jobSystem.GetNumExecutingJobs() == 0)
+		{
+			std::this_thread::yield();
+		}
+		std::vector<ParticleSortPair> pairs = MakeTestPairs(5000, 0xFFFF);
+		std::vector<ParticleSortPair> expected = pairs;
+		std::stable_sort(expected.begin(), expected.end(), IsLessByKey);
+		sorter.Sort(pairs, 32);
+		GAME_TEST_CHECK(AreSamePairs(pairs, expected));
+		GAME_TEST_CHECK(jobSystem.RetrieveFinishedJob() == nullptr);
+		otherJob.m_isReleased.store(true);
+		Job* finishedJob = nullptr;
+		while (!finishedJob)
+		{
+			finishedJob = jobSystem.RetrieveFinishedJob();
+		}
+		GAME_TEST_CHECK(finishedJob == &otherJob);
+
+		//once its owner has it back, the next sort is split across the workers again and takes back only its own jobs
+		pairs = MakeTestPairs(5000, 0xFFF);
+		expected = pairs;
+		std::stable_sort(expected.begin(), expected.end(), IsLessByKey);
+		sorter.Sort(pairs, 32);
+		GAME_TEST_CHECK(AreSamePairs(pairs, expected));
+	}
+	GAME_TEST_CHECK(jobSystem.GetNumQueuedJobs() == 0);
+	GAME_TEST_CHECK(jobSystem.RetrieveFinishedJob() == nullptr);
+	jobSystem.Shutdown();
+}
+
+GAME_TEST(ParticleRadixSort_RepairGivesUpOnlyPastItsMoveLimit)
+{
+	std::vector<ParticleSortPair> nearlySorted = MakeTestPairs(1000, 0xFFFF);
+	std::stable_sort(nearlySorted.begin(), nearlySorted.end(), IsLessByKey);
+	std::vector<ParticleSortPair> expected = nearlySorted;
+	std::swap(nearlySorted[10], nearlySorted[12]);
+	GAME_TEST_CHECK(ParticleRadixSorter::RepairNearlySorted(nearlySorted, 8));
+	GAME_TEST_CHECK(AreSamePairs(nearlySorted, expected));
+
+	std::vector<ParticleSortPair> reversed = expected;
+	std::reverse(reversed.begin(), reversed.end());
+	GAME_TEST_CHECK(!ParticleRadixSorter::RepairNearlySorted(reversed, 8));
+}
+
+GAME_TEST(ParticleRadixSort_MergeKeepsTiesInFirstRun)
+{
+	std::vector<ParticleSortPair> first(3);
+	std::vector<ParticleSortPair> second(2);
+	first[0].m_key = 1;
+	first[0].m_index = 0;
+	first[1].m_key = 5;
+	first[1].m_index = 1;
+	first[2].m_key = 9;
+	first[2].m_index = 2;
+	second[0].m_key = 5;
+	second[0].m_index = 10;
+	second[1].m_key = 7;
+	second[1].m_index = 11;
+	std::vector<ParticleSortPair> merged;
+	ParticleRadixSorter::MergeSortedRuns(first, second, merged);
+	GAME_TEST_CHECK(merged.size() == 5);
+	if (merged.size() != 5)
+		return;
+
+	unsigned int expectedIndices[5] = { 0, 1, 10, 11, 2 };
+	for (int i = 0; i < 5; i++)
+	{
+		GAME_TEST_CHECK(merged[i].m_index == expectedIndices[i]);
+	}
+}
+
+GAME_TEST(ParticleRadixSort_CameraMovesUnderTheToleranceReuseRenderData)
+{
+	ParticleWorldConfig config;
+	config.m_sortSettings.m_cameraTolerance = 0.01f;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 100.f, 10.f));
+	emitterData[0].m_sortParticles = true;
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->Update(0.5f);
+
+	Camera camera;
+	camera.SetTransform(Vec3(0.f, 0.f, 0.f), EulerAngles(0.f, 0.f, 0.f));
+	effect->UpdateRenderData(camera);
+	unsigned int builtVersion = effect->GetRenderDataVersion();
+
+	//a jitter in place and a fraction of a degree of turn keep what was built
+	camera.SetTransform(Vec3(0.004f, -0.004f, 0.002f), EulerAngles(0.5f, 0.25f, 0.f));
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetRenderDataVersion() == builtVersion);
+
+	//walking or turning rebuilds it, and so do small steps once they add up past the tolerance
+	camera.SetTransform(Vec3(0.5f, 0.f, 0.f), EulerAngles(0.f, 0.f, 0.f));
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetRenderDataVersion() == builtVersion + 1);
+	camera.SetTransform(Vec3(0.5f, 0.f, 0.f), EulerAngles(20.f, 0.f, 0.f));
+	effect->UpdateRenderData(camera);
+	GAME_TEST_CHECK(effect->GetRenderDataVersion() == builtVersion + 2);
+	for (int step = 1; step <= 4; step++)
+	{
+		camera.SetTransform(Vec3(0.5f + 0.004f * float(step), 0.f, 0.f), EulerAngles(20.f, 0.f, 0.f));
+		effect->UpdateRenderData(camera);
+	}
+	GAME_TEST_CHECK(effect->GetRenderDataVersion() == builtVersion + 3);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
+
+//keeps the verts of every vertex array drawn, in the order they were drawn
+class RecordingRenderBackend : public CountingRenderBackend
+{
+public:
+	virtual void DrawVertexArray(int numVerts, const Vertex_PCU* verts) override
+	{
+		CountingRenderBackend::DrawVertexArray(numVerts, verts);
+		m_verts.insert(m_verts.end(), verts, verts + numVerts);
+	}
+
+	std::vector<Vertex_PCU> m_verts;
+};
+
+GAME_TEST(ParticleRadixSort_MergedStreamsStayBackToFrontAcrossEmitters)
+{
+	//two alpha blended sorted emitters with their own textures, spraying through each other
+	ParticleWorldConfig config;
+	ParticleWorld* world = new ParticleWorld(config);
+	world->Startup();
+	std::vector<ParticleEmitterData> emitterData;
+	emitterData.push_back(MakeTestEmitterData(100, 100.f, 10.f));
+	emitterData.push_back(MakeTestEmitterData(100, 100.f, 10.f));
+	emitterData[0].m_sortParticles = true;
+	emitterData[0].m_startColor = Rgba8(255, 0, 0, 255);
+	emitterData[0].m_textureFilepath = "Data/Images/RoundSoftParticle.png";
+	emitterData[1].m_sortParticles = true;
+	emitterData[1].m_startColor = Rgba8(0, 0, 255, 255);
+	emitterData[1].m_textureFilepath = "Data/Images/smoke.png";
+	emitterData[1].m_drawOrder = 1;
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 1, world);
+	effect->AddInstance(Mat44::CreateTranslation3D(Vec3(10.f, 0.f, 0.f)));
+	effect->Update(0.5f);
+
+	Camera camera;
+	camera.SetTransform(Vec3(0.f, 0.f, 0.f), EulerAngles(0.f, 0.f, 0.f));
+	effect->UpdateRenderData(camera);
+	RecordingRenderBackend backend;
+	effect->DrawEmitterPasses(backend, 0, Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f));
+	effect->DrawEmitterPasses(backend, 1, Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f));
+
+	//every quad drawn once, farthest first whichever emitter it came from, with a draw per switch of texture
+	int numQuads = int(backend.m_verts.size()) / 6;
+	GAME_TEST_CHECK(numQuads == 100);
+	bool isBackToFront = true;
+	int numEmitterSwitches = 0;
+	float lastDepth = FLT_MAX;
+	for (int quad = 0; quad < numQuads; quad++)
+	{
+		Vec3 center;
+		for (int corner = 0; corner < 6; corner++)
+		{
+			center += backend.m_verts[quad * 6 + corner].m_position / 6.f;
+		}
+		isBackToFront = isBackToFront && center.x <= lastDepth + 0.0001f;
+		lastDepth = center.x;
+		if (quad > 0 && backend.m_verts[quad * 6].m_color.r != backend.m_verts[quad * 6 - 6].m_color.r)
+			numEmitterSwitches++;
+	}
+	GAME_TEST_CHECK(isBackToFront);
+	GAME_TEST_CHECK(numEmitterSwitches > 2);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == numEmitterSwitches + 1);
+
+	delete effect;
+	world->Shutdown();
+	delete world;
+}
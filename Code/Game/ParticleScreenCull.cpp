@@ -0,0 +1,22 @@
+#include "Engine/Core/XmlUtils.hpp"
+#include "Game/ParticleScreenCull.hpp"
+
+ParticleScreenCullSettings ParticleScreenCullSettings::LoadFromEffectFile(const char* effectPath)
+{
+	ParticleScreenCullSettings settings;
+	XmlDocument effectDocument;
+	if (effectDocument.LoadFile(effectPath) != tinyxml2::XML_SUCCESS || !effectDocument.RootElement())
+		return settings;
+
+	const XmlElement* cullElement = effectDocument.RootElement()->FirstChildElement("ScreenCull");
+	if (!cullElement)
+		return settings;
+
+	settings.m_isEnabled = ParseXmlAttribute(*cullElement, "enabled", true);
+	settings.m_minPixelSize = ParseXmlAttribute(*cullElement, "minPixelSize", settings.m_minPixelSize);
+	settings.m_tileSizePixels = ParseXmlAttribute(*cullElement, "tileSize", settings.m_tileSizePixels);
+	settings.m_maxParticlesPerTile = ParseXmlAttribute(*cullElement, "maxPerTile", settings.m_maxParticlesPerTile);
+	if (settings.m_tileSizePixels < 1)
+		settings.m_tileSizePixels = 1;
+	return settings;
+}
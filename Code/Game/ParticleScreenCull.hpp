@@ -0,0 +1,19 @@
+#pragma once
+
+//Per effect settings for dropping particles that contribute nothing on screen, read from the <ScreenCull> element of an effect xml.
+//Effects without the element are never culled. Tile caps count particles per blend mode, since additive and alpha blended particles stack differently.
+struct ParticleScreenCullSettings
+{
+	bool m_isEnabled = false;
+	float m_minPixelSize = 0.75f;		//particles whose quad is smaller than this on screen are dropped
+	int m_tileSizePixels = 32;
+	int m_maxParticlesPerTile = 64;		//per blend mode, 0 for no cap
+
+	static ParticleScreenCullSettings LoadFromEffectFile(const char* effectPath);
+};
+
+struct ParticleScreenCullStats
+{
+	int m_numSubPixelCulled = 0;
+	int m_numTileCapCulled = 0;
+};
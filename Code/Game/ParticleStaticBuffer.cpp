@@ -0,0 +1,92 @@
+#include <algorithm>
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+#include "Engine/Renderer/ConstantBuffer.hpp"
+#include "Engine/Renderer/StructuredBuffer.hpp"
+#include "Game/ParticleStaticBuffer.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern Renderer* g_theRenderer;
+
+constexpr int STATIC_PARTICLE_CONSTANTS_SLOT = 12;
+constexpr int STATIC_PARTICLE_INSTANCES_SLOT = 1;
+
+//matches StaticParticleConstants in StaticParticles.hlsl
+struct StaticParticleConstants
+{
+	float m_cameraLeft[4];
+	float m_cameraUp[4];
+	float m_uvMinsMaxs[4];
+	int m_isHorizontal;
+	int m_padding[3];
+};
+
+ParticleStaticBuffer::ParticleStaticBuffer(int maxParticles)
+	:m_maxParticles(maxParticles)
+{
+	if (!g_theRenderer)
+		return;
+
+	m_particleBuffer = g_theRenderer->CreateStructuredBuffer(size_t(m_maxParticles) * sizeof(StaticParticleInstance), sizeof(StaticParticleInstance));
+	m_constantBuffer = g_theRenderer->CreateConstantBuffer(sizeof(StaticParticleConstants));
+
+	//the shader reads nothing but the vertex id, one quad of placeholder verts only gives the draw a vertex buffer to bind
+	//and fetches past its end read zeros
+	Vertex_PCU placeholderVerts[6];
+	m_placeholderBuffer = g_theRenderer->CreateVertexBuffer(sizeof(placeholderVerts));
+	g_theRenderer->CopyCPUToGPU(placeholderVerts, sizeof(placeholderVerts), m_placeholderBuffer);
+
+	m_shader = g_theRenderer->CreateOrGetShader("Data/Shaders/StaticParticles");
+}
+
+ParticleStaticBuffer::~ParticleStaticBuffer()
+{
+	delete m_placeholderBuffer;
+	m_placeholderBuffer = nullptr;
+	delete m_particleBuffer;
+	m_particleBuffer = nullptr;
+	delete m_constantBuffer;
+	m_constantBuffer = nullptr;
+}
+
+void ParticleStaticBuffer::Upload(const std::vector<StaticParticleInstance>& particles)
+{
+	m_numParticles = std::min(int(particles.size()), m_maxParticles);
+	if (m_numParticles == 0 || !m_particleBuffer)
+		return;
+
+	g_theRenderer->CopyCPUToGPU(particles.data(), size_t(m_numParticles) * sizeof(StaticParticleInstance), m_particleBuffer);
+}
+
+void ParticleStaticBuffer::Draw(RenderBackend& backend, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal, const Vec2& uvMins, const Vec2& uvMaxs) const
+{
+	if (m_numParticles <= 0)
+		return;
+
+	if (m_constantBuffer)
+		BindParticles(cameraLeft, cameraUp, isHorizontal, uvMins, uvMaxs);
+	backend.BindShader(m_shader);
+	backend.DrawVertexBuffer(m_placeholderBuffer, m_numParticles * 6);
+	if (m_constantBuffer)
+		g_theRenderer->BindStructuredBuffer(STATIC_PARTICLE_INSTANCES_SLOT, nullptr);
+}
+
+void ParticleStaticBuffer::BindParticles(const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal, const Vec2& uvMins, const Vec2& uvMaxs) const
+{
+	StaticParticleConstants constants = {};
+	constants.m_cameraLeft[0] = cameraLeft.x;
+	constants.m_cameraLeft[1] = cameraLeft.y;
+	constants.m_cameraLeft[2] = cameraLeft.z;
+	constants.m_cameraUp[0] = cameraUp.x;
+	constants.m_cameraUp[1] = cameraUp.y;
+	constants.m_cameraUp[2] = cameraUp.z;
+	constants.m_uvMinsMaxs[0] = uvMins.x;
+	constants.m_uvMinsMaxs[1] = uvMins.y;
+	constants.m_uvMinsMaxs[2] = uvMaxs.x;
+	constants.m_uvMinsMaxs[3] = uvMaxs.y;
+	constants.m_isHorizontal = isHorizontal ? 1 : 0;
+	g_theRenderer->CopyCPUToGPU(&constants, sizeof(constants), m_constantBuffer);
+	g_theRenderer->BindConstantBuffer(STATIC_PARTICLE_CONSTANTS_SLOT, m_constantBuffer);
+	g_theRenderer->BindStructuredBuffer(STATIC_PARTICLE_INSTANCES_SLOT, m_particleBuffer);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+class Shader;
+class VertexBuffer;
+class RenderBackend;
+class ConstantBuffer;
+class StructuredBuffer;
+
+//32 bytes, laid out like StaticParticle in StaticParticles.hlsl
+struct StaticParticleInstance
+{
+	float m_position[3];
+	float m_halfWidth = 0.f;
+	float m_halfHeight = 0.f;
+	float m_rotationDegrees = 0.f;
+	unsigned int m_color = 0;		//rgba8
+	float m_padding = 0.f;
+};
+
+//Gpu side of one static batch. Its particles never change between spawns and expiries, so they are uploaded once when the batch
+//changes and StaticParticles.hlsl billboards them from the vertex id, which keeps camera turns from touching the buffer.
+//Without a renderer only the number of particles is kept, so draws still reach the render backend.
+class ParticleStaticBuffer
+{
+public:
+	ParticleStaticBuffer(int maxParticles);
+	~ParticleStaticBuffer();
+
+	void Upload(const std::vector<StaticParticleInstance>& particles);
+	void Draw(RenderBackend& backend, const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal, const Vec2& uvMins, const Vec2& uvMaxs) const;
+	int GetNumParticles() const { return m_numParticles; }
+
+private:
+	int m_maxParticles = 0;
+	int m_numParticles = 0;
+	StructuredBuffer* m_particleBuffer = nullptr;
+	ConstantBuffer* m_constantBuffer = nullptr;
+	VertexBuffer* m_placeholderBuffer = nullptr;
+	Shader* m_shader = nullptr;
+
+private:
+	void BindParticles(const Vec3& cameraLeft, const Vec3& cameraUp, bool isHorizontal, const Vec2& uvMins, const Vec2& uvMaxs) const;
+};
@@ -0,0 +1,88 @@
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+static const Vec3 STATIC_TEST_CAMERA_LEFT = Vec3(0.f, 1.f, 0.f);
+static const Vec3 STATIC_TEST_CAMERA_UP = Vec3(0.f, 0.f, 1.f);
+
+static void DrawStaticTestEffect(const BatchedParticleEffect& effect, CountingRenderBackend& backend, const Vec3& cameraLeft, const Vec3& cameraUp)
+{
+	backend.ResetCounts();
+	effect.DrawEmitterPasses(backend, 0, cameraLeft, cameraUp);
+}
+
+GAME_TEST(ParticleStatic_StillEmittersSkipTheSimAndKeepTheirParticles)
+{
+	std::vector<ParticleEmitterData> stillData(1, MakeTestEmitterData(100, 50.f, 10.f, true));
+	std::vector<ParticleEmitterData> movingData(1, MakeTestEmitterData(100, 50.f, 10.f));
+	BatchedParticleEffect stillEffect(stillData, 1);
+	BatchedParticleEffect movingEffect(movingData, 1);
+	GAME_TEST_CHECK(stillEffect.GetEmitter(0).m_isStatic);
+	GAME_TEST_CHECK(!movingEffect.GetEmitter(0).m_isStatic);
+	stillEffect.AddInstance(Mat44());
+	movingEffect.AddInstance(Mat44());
+
+	//spawned particles go straight to the static batch and stay where they spawned
+	stillEffect.Update(0.5f);
+	movingEffect.Update(0.5f);
+	GAME_TEST_CHECK(stillEffect.GetNumAliveParticles() == 25);
+	GAME_TEST_CHECK(stillEffect.GetNumStaticParticles() == 25);
+	GAME_TEST_CHECK(movingEffect.GetNumStaticParticles() == 0);
+	std::vector<BatchedParticleSprite> spawnedSprites;
+	stillEffect.GetParticleSprites(spawnedSprites);
+	stillEffect.Update(0.1f);
+	std::vector<BatchedParticleSprite> laterSprites;
+	stillEffect.GetParticleSprites(laterSprites);
+	bool haveParticlesStayed = laterSprites.size() > spawnedSprites.size();
+	for (int i = 0; i < int(spawnedSprites.size()) && haveParticlesStayed; i++)
+	{
+		bool isStillThere = false;
+		for (int j = 0; j < int(laterSprites.size()) && !isStillThere; j++)
+		{
+			isStillThere = laterSprites[j].m_position == spawnedSprites[i].m_position;
+		}
+		haveParticlesStayed = isStillThere;
+	}
+	GAME_TEST_CHECK(haveParticlesStayed);
+}
+
+GAME_TEST(ParticleStatic_OnlyChangedBatchesAreUploaded)
+{
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 50.f, 1.f, true));
+	BatchedParticleEffect effect(emitterData, 1);
+	effect.AddInstance(Mat44());
+	effect.Update(0.5f);
+	CountingRenderBackend backend;
+
+	//the first draw uploads the batch, and the whole batch is one draw
+	DrawStaticTestEffect(effect, backend, STATIC_TEST_CAMERA_LEFT, STATIC_TEST_CAMERA_UP);
+	GAME_TEST_CHECK(effect.GetNumStaticUploads() == 1);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 1);
+
+	//turning the camera only changes what the shader billboards with
+	DrawStaticTestEffect(effect, backend, Vec3(-1.f, 0.f, 0.f), STATIC_TEST_CAMERA_UP);
+	DrawStaticTestEffect(effect, backend, STATIC_TEST_CAMERA_LEFT, Vec3(0.f, 1.f, 0.f));
+	GAME_TEST_CHECK(effect.GetNumStaticUploads() == 1);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 1);
+
+	//a frame that spawns sends the batch again, once however often it is drawn
+	effect.Update(0.1f);
+	DrawStaticTestEffect(effect, backend, STATIC_TEST_CAMERA_LEFT, STATIC_TEST_CAMERA_UP);
+	DrawStaticTestEffect(effect, backend, STATIC_TEST_CAMERA_LEFT, STATIC_TEST_CAMERA_UP);
+	GAME_TEST_CHECK(effect.GetNumStaticUploads() == 2);
+
+	//at its cap with nothing expiring, the sim leaves the batch alone
+	std::vector<ParticleEmitterData> cappedData(1, MakeTestEmitterData(20, 200.f, 10.f, true));
+	BatchedParticleEffect cappedEffect(cappedData, 1);
+	cappedEffect.AddInstance(Mat44());
+	cappedEffect.Update(0.2f);
+	DrawStaticTestEffect(cappedEffect, backend, STATIC_TEST_CAMERA_LEFT, STATIC_TEST_CAMERA_UP);
+	GAME_TEST_CHECK(cappedEffect.GetNumStaticParticles() == 20);
+	for (int frame = 0; frame < 10; frame++)
+	{
+		cappedEffect.Update(0.1f);
+		DrawStaticTestEffect(cappedEffect, backend, STATIC_TEST_CAMERA_LEFT, STATIC_TEST_CAMERA_UP);
+	}
+	GAME_TEST_CHECK(cappedEffect.GetNumStaticUploads() == 1);
+}
@@ -0,0 +1,237 @@
+#include "Engine/Renderer/ParticlesManager.hpp"
+#include "Engine/Renderer/ParticleSystem.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Game/ParticleSystemPool.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+
+ParticleSystemPool::ParticleSystemPool(ParticlesManager* manager, ParticleSystemReclaimer* reclaimer)
+	:m_manager(manager), m_reclaimer(reclaimer)
+{
+}
+
+ParticleSystemPool::~ParticleSystemPool()
+{
+	RetireAllPooledSystems();
+}
+
+//called right after the particles manager stepped every system, so the timers only count time that was actually simulated
+void ParticleSystemPool::OnSystemsSimulated(float deltaSeconds)
+{
+	for (int i = 0; i < int(m_activeOneShots.size()); )
+	{
+		PooledParticleSystem& instance = m_instances[m_activeOneShots[i]];
+		if (instance.m_isEmitting)
+		{
+			instance.m_secondsEmitted += deltaSeconds;
+			if (instance.m_secondsEmitted >= instance.m_emitDuration)
+			{
+				instance.m_system->UpdateEmitterData(instance.m_stoppedData);
+				instance.m_isEmitting = false;
+				instance.m_secondsSinceEmission = 0.f;
+			}
+			i++;
+			continue;
+		}
+
+		//particles from the last emitting step are all dead once that step is the longest lifetime of the effect behind
+		instance.m_secondsSinceEmission += deltaSeconds;
+		if (instance.m_secondsSinceEmission >= m_effects[instance.m_effectIndex].m_maxParticleLifetime)
+		{
+			ReleaseInstance(m_activeOneShots[i]);
+			m_activeOneShots[i] = m_activeOneShots.back();
+			m_activeOneShots.pop_back();
+			continue;
+		}
+		i++;
+	}
+}
+
+//without a manager the effect is never registered, so every one-shot of it is refused
+void ParticleSystemPool::Prewarm(const char* effectPath, int numInstances, bool gpuParticles)
+{
+	if (!m_manager)
+		return;
+
+	int effectIndex = GetOrCreateEffectIndex(effectPath, gpuParticles);
+	m_instances.reserve(m_instances.size() + numInstances);
+	m_effects[effectIndex].m_freeInstances.reserve(m_effects[effectIndex].m_freeInstances.size() + numInstances);
+	for (int i = 0; i < numInstances; i++)
+	{
+		int instanceIndex = CreateInstance(effectIndex);
+		m_effects[effectIndex].m_freeInstances.push_back(instanceIndex);
+	}
+	m_activeOneShots.reserve(m_instances.size());
+}
+
+ParticleSystem* ParticleSystemPool::Acquire(const char* effectPath, const Vec3& position, bool gpuParticles)
+{
+	if (!m_manager)
+		return nullptr;
+
+	int effectIndex = GetOrCreateEffectIndex(effectPath, gpuParticles);
+	int instanceIndex = AcquireInstance(effectIndex, position);
+	return m_instances[instanceIndex].m_system;
+}
+
+void ParticleSystemPool::Release(ParticleSystem* system)
+{
+	int instanceIndex = FindInstanceIndex(system);
+	GUARANTEE_OR_DIE(instanceIndex >= 0, "Releasing a particle system that does not belong to this pool");
+
+	PooledParticleSystem& instance = m_instances[instanceIndex];
+	if (instance.m_isOneShot)
+	{
+		for (int i = 0; i < int(m_activeOneShots.size()); i++)
+		{
+			if (m_activeOneShots[i] == instanceIndex)
+			{
+				m_activeOneShots[i] = m_activeOneShots.back();
+				m_activeOneShots.pop_back();
+				break;
+			}
+		}
+	}
+	ReleaseInstance(instanceIndex);
+}
+
+//only ever takes parked instances, a dry pool refuses the rest of the spawns instead of loading the effect on the hot path
+int ParticleSystemPool::SpawnOneShot(const char* effectPath, const Vec3* positions, int count, float emitDuration, bool gpuParticles)
+{
+	int effectIndex = FindEffectIndex(effectPath, gpuParticles);
+	int numSpawned = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (effectIndex < 0 || m_effects[effectIndex].m_freeInstances.empty())
+			break;
+
+		int instanceIndex = AcquireInstance(effectIndex, positions[i]);
+		PooledParticleSystem& instance = m_instances[instanceIndex];
+		instance.m_isOneShot = true;
+		instance.m_emitDuration = emitDuration;
+		instance.m_secondsEmitted = 0.f;
+		instance.m_secondsSinceEmission = 0.f;
+		m_activeOneShots.push_back(instanceIndex);
+		numSpawned++;
+	}
+
+	m_numRefusedOneShots += count - numSpawned;
+	return numSpawned;
+}
+
+bool ParticleSystemPool::IsPrewarmed(const char* effectPath, bool gpuParticles) const
+{
+	return FindEffectIndex(effectPath, gpuParticles) >= 0;
+}
+
+void ParticleSystemPool::RetireAllPooledSystems()
+{
+	for (int i = 0; i < int(m_instances.size()); i++)
+	{
+		m_reclaimer->Retire(m_instances[i].m_system);
+	}
+	m_instances.clear();
+	m_effects.clear();
+	m_activeOneShots.clear();
+	m_numActiveInstances = 0;
+}
+
+int ParticleSystemPool::GetOrCreateEffectIndex(const char* effectPath, bool gpuParticles)
+{
+	int effectIndex = FindEffectIndex(effectPath, gpuParticles);
+	if (effectIndex >= 0)
+		return effectIndex;
+
+	PooledEffect effect;
+	effect.m_effectPath = effectPath;
+	effect.m_gpuParticles = gpuParticles;
+	m_effects.push_back(effect);
+	return int(m_effects.size()) - 1;
+}
+
+int ParticleSystemPool::FindEffectIndex(const char* effectPath, bool gpuParticles) const
+{
+	for (int i = 0; i < int(m_effects.size()); i++)
+	{
+		if (m_effects[i].m_gpuParticles == gpuParticles && m_effects[i].m_effectPath == effectPath)
+			return i;
+	}
+
+	return -1;
+}
+
+int ParticleSystemPool::CreateInstance(int effectIndex)
+{
+	PooledEffect& effect = m_effects[effectIndex];
+	PooledParticleSystem instance;
+	instance.m_effectIndex = effectIndex;
+	instance.m_system = m_manager->CreateParticleSystem(effect.m_effectPath.c_str(), Vec3::ZERO, effect.m_gpuParticles);
+	instance.m_emittingData = instance.m_system->GetEmitterDataForAllEmitters();
+	instance.m_stoppedData = instance.m_emittingData;
+	for (int i = 0; i < int(instance.m_stoppedData.size()); i++)
+	{
+		ParticleEmitterData& stoppedEmitter = instance.m_stoppedData[i];
+		stoppedEmitter.m_particlesEmittedPerSecond = 0.f;
+		stoppedEmitter.m_numBurstParticles = 0.f;
+		if (stoppedEmitter.m_particleLifetime.m_max > effect.m_maxParticleLifetime)
+			effect.m_maxParticleLifetime = stoppedEmitter.m_particleLifetime.m_max;
+	}
+
+	//pooled systems sit parked until they are acquired
+	instance.m_system->UpdateEmitterData(instance.m_stoppedData);
+	m_instances.push_back(instance);
+	return int(m_instances.size()) - 1;
+}
+
+int ParticleSystemPool::AcquireInstance(int effectIndex, const Vec3& position)
+{
+	PooledEffect& effect = m_effects[effectIndex];
+	int instanceIndex = -1;
+	if (effect.m_freeInstances.empty())
+	{
+		//pool ran dry, this is the slow path that Prewarm is meant to avoid, one-shots never get here
+		instanceIndex = CreateInstance(effectIndex);
+		m_numColdSpawns++;
+	}
+	else
+	{
+		instanceIndex = effect.m_freeInstances.back();
+		effect.m_freeInstances.pop_back();
+	}
+
+	PooledParticleSystem& instance = m_instances[instanceIndex];
+	instance.m_isActive = true;
+	instance.m_isOneShot = false;
+	instance.m_isEmitting = true;
+	instance.m_system->SetPosition(position);
+	instance.m_system->UpdateEmitterData(instance.m_emittingData);
+	m_numActiveInstances++;
+	return instanceIndex;
+}
+
+void ParticleSystemPool::ReleaseInstance(int instanceIndex)
+{
+	PooledParticleSystem& instance = m_instances[instanceIndex];
+	if (!instance.m_isActive)
+		return;
+
+	if (instance.m_isEmitting)
+	{
+		instance.m_system->UpdateEmitterData(instance.m_stoppedData);
+		instance.m_isEmitting = false;
+	}
+	instance.m_isActive = false;
+	instance.m_isOneShot = false;
+	m_effects[instance.m_effectIndex].m_freeInstances.push_back(instanceIndex);
+	m_numActiveInstances--;
+}
+
+int ParticleSystemPool::FindInstanceIndex(const ParticleSystem* system) const
+{
+	for (int i = 0; i < int(m_instances.size()); i++)
+	{
+		if (m_instances[i].m_system == system)
+			return i;
+	}
+
+	return -1;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Renderer/ParticleEmitterData.hpp"
+
+class ParticlesManager;
+class ParticleSystem;
+class ParticleSystemReclaimer;
+
+struct PooledParticleSystem
+{
+	ParticleSystem* m_system = nullptr;
+	int m_effectIndex = -1;
+	std::vector<ParticleEmitterData> m_emittingData;	//data as loaded from the effect xml
+	std::vector<ParticleEmitterData> m_stoppedData;		//same data with emission switched off
+	bool m_isActive = false;
+	bool m_isOneShot = false;
+	bool m_isEmitting = false;
+	float m_emitDuration = 0.f;
+	float m_secondsEmitted = 0.f;			//simulated with emission on
+	float m_secondsSinceEmission = 0.f;		//simulated since emission was switched off
+};
+
+struct PooledEffect
+{
+	std::string m_effectPath;
+	bool m_gpuParticles = false;
+	float m_maxParticleLifetime = 0.f;
+	std::vector<int> m_freeInstances;
+};
+
+//Keeps parked particle systems per effect so respawning an effect does not re-read its xml or reallocate its emitters.
+//Parked systems stay registered with the particles manager with emission switched off, which makes them free to update.
+//One-shots are timed in simulated steps: they emit for at least one step, and go back to the pool once they have been
+//simulated for the effect's longest particle lifetime after their last emitting step, so no live particle is ever moved.
+//A pool without a manager, as a world without a renderer makes it, hands out nothing.
+class ParticleSystemPool
+{
+public:
+	ParticleSystemPool(ParticlesManager* manager, ParticleSystemReclaimer* reclaimer);
+	~ParticleSystemPool();
+	void OnSystemsSimulated(float deltaSeconds);
+
+	void Prewarm(const char* effectPath, int numInstances, bool gpuParticles = false);
+	ParticleSystem* Acquire(const char* effectPath, const Vec3& position, bool gpuParticles = false);
+	void Release(ParticleSystem* system);
+	int SpawnOneShot(const char* effectPath, const Vec3* positions, int count, float emitDuration = 0.f, bool gpuParticles = false);
+	bool IsPrewarmed(const char* effectPath, bool gpuParticles = false) const;
+	void RetireAllPooledSystems();
+
+	int GetNumActiveInstances() const { return m_numActiveInstances; }
+	int GetNumFreeInstances() const { return int(m_instances.size()) - m_numActiveInstances; }
+	int GetNumColdSpawns() const { return m_numColdSpawns; }
+	int GetNumRefusedOneShots() const { return m_numRefusedOneShots; }
+
+private:
+	ParticlesManager* m_manager = nullptr;
+	ParticleSystemReclaimer* m_reclaimer = nullptr;
+	std::vector<PooledEffect> m_effects;
+	std::vector<PooledParticleSystem> m_instances;
+	std::vector<int> m_activeOneShots;
+	int m_numActiveInstances = 0;
+	int m_numColdSpawns = 0;
+	int m_numRefusedOneShots = 0;
+
+private:
+	int GetOrCreateEffectIndex(const char* effectPath, bool gpuParticles);
+	int FindEffectIndex(const char* effectPath, bool gpuParticles) const;
+	int CreateInstance(int effectIndex);
+	int AcquireInstance(int effectIndex, const Vec3& position);
+	void ReleaseInstance(int instanceIndex);
+	int FindInstanceIndex(const ParticleSystem* system) const;
+};
@@ -0,0 +1,93 @@
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Renderer/ParticlesManager.hpp"
+#include "Engine/Renderer/ParticleSystem.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+
+ParticleSystemReclaimer::ParticleSystemReclaimer(ParticlesManager* manager)
+	:m_manager(manager)
+{
+}
+
+ParticleSystemReclaimer::~ParticleSystemReclaimer()
+{
+	ReclaimAll();
+}
+
+void ParticleSystemReclaimer::BeginFrame()
+{
+	//systems retired this epoch may have been handed to jobs earlier in it, so they wait for the next boundary at least
+	ReclaimIdleSystemsRetiredBefore(m_currentEpoch);
+	m_currentEpoch++;
+}
+
+void ParticleSystemReclaimer::Retire(ParticleSystem* system)
+{
+	if (!system)
+		return;
+
+	for (int i = 0; i < int(m_retiredSystems.size()); i++)
+	{
+		if (m_retiredSystems[i].m_system == system)
+			return;
+	}
+
+	//the system keeps being updated until it is killed, but it never emits or draws again
+	std::vector<ParticleEmitterData> stoppedData = system->GetEmitterDataForAllEmitters();
+	for (int i = 0; i < int(stoppedData.size()); i++)
+	{
+		stoppedData[i].m_particlesEmittedPerSecond = 0.f;
+		stoppedData[i].m_numBurstParticles = 0.f;
+		stoppedData[i].m_stopRender = true;
+	}
+	system->UpdateEmitterData(stoppedData);
+
+	RetiredParticleSystem retired;
+	retired.m_system = system;
+	retired.m_retireEpoch = m_currentEpoch;
+	retired.m_numJobBatchesInFlight = m_areSystemJobsInFlight ? 1 : 0;
+	m_retiredSystems.push_back(retired);
+}
+
+//every retired system is still registered with the manager, so the update about to run hands each of them to a job batch
+void ParticleSystemReclaimer::BeginSystemJobs()
+{
+	GUARANTEE_OR_DIE(!m_areSystemJobsInFlight, "Particle system job batches are not nested");
+	m_areSystemJobsInFlight = true;
+	for (int i = 0; i < int(m_retiredSystems.size()); i++)
+	{
+		m_retiredSystems[i].m_numJobBatchesInFlight++;
+	}
+}
+
+//the manager retrieves every job it queued before its update returns, so the batches begun above are all back
+void ParticleSystemReclaimer::EndSystemJobs()
+{
+	GUARANTEE_OR_DIE(m_areSystemJobsInFlight, "Ending particle system job batches that were never begun");
+	m_areSystemJobsInFlight = false;
+	for (int i = 0; i < int(m_retiredSystems.size()); i++)
+	{
+		m_retiredSystems[i].m_numJobBatchesInFlight--;
+	}
+}
+
+void ParticleSystemReclaimer::ReclaimAll()
+{
+	//only used on shutdown, the world has stopped updating by then so no batch can be outstanding
+	GUARANTEE_OR_DIE(!m_areSystemJobsInFlight, "Reclaiming every particle system while the manager is updating them");
+	ReclaimIdleSystemsRetiredBefore(m_currentEpoch + 1);
+}
+
+void ParticleSystemReclaimer::ReclaimIdleSystemsRetiredBefore(unsigned int epoch)
+{
+	for (int i = 0; i < int(m_retiredSystems.size()); )
+	{
+		if (m_retiredSystems[i].m_retireEpoch < epoch && m_retiredSystems[i].m_numJobBatchesInFlight == 0)
+		{
+			m_manager->KillParticleSystem(m_retiredSystems[i].m_system);
+			m_retiredSystems[i] = m_retiredSystems.back();
+			m_retiredSystems.pop_back();
+			continue;
+		}
+		i++;
+	}
+}
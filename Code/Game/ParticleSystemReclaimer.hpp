@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+
+class ParticlesManager;
+class ParticleSystem;
+
+struct RetiredParticleSystem
+{
+	ParticleSystem* m_system = nullptr;
+	unsigned int m_retireEpoch = 0;
+	int m_numJobBatchesInFlight = 0;
+};
+
+//Epoch based reclamation for particle systems that may still be referenced by in-flight particle jobs.
+//Retiring a system stops it at once: emission goes off and it stops rendering, so it is gone from the player's point of view.
+//The particles manager still owns it until every job batch issued for it has come back, which the world reports by
+//bracketing each manager update with BeginSystemJobs and EndSystemJobs. A retired system is killed at the first frame
+//boundary after its own batches have all returned, whatever other work the job system is busy with.
+class ParticleSystemReclaimer
+{
+public:
+	ParticleSystemReclaimer(ParticlesManager* manager);
+	~ParticleSystemReclaimer();
+	void BeginFrame();
+
+	void Retire(ParticleSystem* system);
+	void BeginSystemJobs();
+	void EndSystemJobs();
+	void ReclaimAll();
+
+	unsigned int GetCurrentEpoch() const { return m_currentEpoch; }
+	int GetNumRetiredSystems() const { return int(m_retiredSystems.size()); }
+
+private:
+	ParticlesManager* m_manager = nullptr;
+	std::vector<RetiredParticleSystem> m_retiredSystems;
+	unsigned int m_currentEpoch = 1;
+	bool m_areSystemJobsInFlight = false;
+
+private:
+	void ReclaimIdleSystemsRetiredBefore(unsigned int epoch);
+};
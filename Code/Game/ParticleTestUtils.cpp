@@ -0,0 +1,16 @@
+#include "Game/ParticleTestUtils.hpp"
+
+ParticleEmitterData MakeTestEmitterData(int maxParticles, float particlesPerSecond, float lifetimeSeconds, bool isStill)
+{
+	ParticleEmitterData data;
+	data.m_maxParticles = maxParticles;
+	data.m_emissionMode = EmissionMode::CONSTANT;
+	data.m_particlesEmittedPerSecond = particlesPerSecond;
+	data.m_particleLifetime = FloatRange(lifetimeSeconds, lifetimeSeconds);
+	data.m_startSpeed = isStill ? FloatRange(0.f, 0.f) : FloatRange(1.f, 2.f);
+	data.m_startSize = FloatRange(0.5f, 0.5f);
+	data.m_startRotationDegrees = FloatRange(0.f, 0.f);
+	data.m_startColor = Rgba8::WHITE;
+	data.m_simulationSpace = SimulationSpace::LOCAL;
+	return data;
+}
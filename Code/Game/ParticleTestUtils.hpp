@@ -0,0 +1,6 @@
+#pragma once
+#include "Engine/Renderer/ParticleEmitterData.hpp"
+
+//Emitter data built in code, so tests depend on neither effect files nor the particles manager.
+//Particles of a still emitter never move or change, which the batched runtime keeps as static particles.
+ParticleEmitterData MakeTestEmitterData(int maxParticles, float particlesPerSecond, float lifetimeSeconds, bool isStill = false);
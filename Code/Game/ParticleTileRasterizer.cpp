@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <emmintrin.h>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Image.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Game/ParticleTileRasterizer.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/ParticleWorld.hpp"
+
+std::vector<ParticleSnapshotRenderer*> ParticleSnapshotRenderer::s_consoleRenderers;
+
+ParticleRasterTileJob::ParticleRasterTileJob(ParticleTileRasterizer* rasterizer, int chunkIndex)
+	:ParticleChunkJob(chunkIndex), m_rasterizer(rasterizer)
+{
+}
+
+void ParticleRasterTileJob::ExecuteChunk(int chunkIndex)
+{
+	m_rasterizer->RunChunk(chunkIndex);
+}
+
+ParticleTileRasterizer::ParticleTileRasterizer(int width, int height, JobSystem* jobSystem, int tileSize)
+	:m_width(width), m_height(height), m_tileSize(tileSize), m_jobSystem(jobSystem)
+{
+	m_numTilesX = (m_width + m_tileSize - 1) / m_tileSize;
+	m_numTilesY = (m_height + m_tileSize - 1) / m_tileSize;
+	m_tileQuads.resize(m_numTilesX * m_numTilesY);
+	m_tileFragments.resize(m_numTilesX * m_numTilesY);
+	m_colors.resize(size_t(m_width) * m_height * 4);
+	m_overdraw.resize(size_t(m_width) * m_height);
+}
+
+ParticleTileRasterizer::~ParticleTileRasterizer()
+{
+	for (int i = 0; i < int(m_jobs.size()); i++)
+	{
+		delete m_jobs[i];
+	}
+}
+
+void ParticleTileRasterizer::Render(const ParticleInstanceCapture& capture, const ParticleRasterView& view, const Rgba8& clearColor)
+{
+	m_stats = ParticleRasterStats();
+	float clear[4];
+	clearColor.GetAsFloats(clear);
+	for (int pixel = 0; pixel < m_width * m_height; pixel++)
+	{
+		std::copy(clear, clear + 4, &m_colors[size_t(pixel) * 4]);
+	}
+	std::fill(m_overdraw.begin(), m_overdraw.end(), (unsigned short)0);
+	for (int tileIndex = 0; tileIndex < int(m_tileQuads.size()); tileIndex++)
+	{
+		m_tileQuads[tileIndex].clear();
+		m_tileFragments[tileIndex] = 0;
+	}
+
+	double binStart = GetCurrentTimeSeconds();
+	BinQuads(capture, view);
+	double shadeStart = GetCurrentTimeSeconds();
+	m_stats.m_binMs = (shadeStart - binStart) * 1000.0;
+
+	int numTiles = m_numTilesX * m_numTilesY;
+	m_numChunks = 1;
+	if (m_jobSystem)
+		m_numChunks = std::max(std::min(numTiles, m_jobSystem->GetNumWorkerThreads() + 1), 1);
+	while (int(m_jobs.size()) < m_numChunks)
+	{
+		m_jobs.push_back(new ParticleRasterTileJob(this, int(m_jobs.size())));
+	}
+
+	//the tiles never overlap, so the chunks share nothing they write
+	RunParticleChunkJobs(m_jobSystem, m_jobs, m_numChunks);
+	m_stats.m_shadeMs = (GetCurrentTimeSeconds() - shadeStart) * 1000.0;
+
+	m_stats.m_numQuads = int(m_quads.size());
+	for (int tileIndex = 0; tileIndex < numTiles; tileIndex++)
+	{
+		m_stats.m_numFragments += m_tileFragments[tileIndex];
+	}
+	for (int pixel = 0; pixel < int(m_overdraw.size()); pixel++)
+	{
+		if (m_overdraw[pixel] > 0)
+			m_stats.m_numCoveredPixels++;
+		m_stats.m_maxOverdraw = std::max(m_stats.m_maxOverdraw, int(m_overdraw[pixel]));
+	}
+}
+
+void ParticleTileRasterizer::BinQuads(const ParticleInstanceCapture& capture, const ParticleRasterView& view)
+{
+	m_quads.clear();
+	Vec3 viewForward, viewLeft, viewUp;
+	view.m_orientation.GetAsVectors_XFwd_YLeft_ZUp(viewForward, viewLeft, viewUp);
+	float tanHalfFov = tanf(ConvertDegreesToRadians(view.m_fovDegrees * 0.5f));
+	float aspect = float(m_width) / float(m_height);
+	static const float cornerX[4] = { 0.f, 1.f, 1.f, 0.f };
+	static const float cornerY[4] = { 0.f, 0.f, 1.f, 1.f };
+
+	for (int effectIndex = 0; effectIndex < capture.GetNumEffects(); effectIndex++)
+	{
+		const CapturedParticleEffect& effect = capture.GetEffect(effectIndex);
+		for (int drawIndex = 0; drawIndex < int(effect.m_draws.size()); drawIndex++)
+		{
+			const CapturedParticleDraw& draw = effect.m_draws[drawIndex];
+			int textureIndex = draw.m_texturePath.empty() ? -1 : GetOrLoadTexture(draw.m_texturePath);
+			for (int instanceIndex = draw.m_firstInstance; instanceIndex < draw.m_firstInstance + draw.m_numInstances; instanceIndex++)
+			{
+				//expanded exactly like CompactParticles.hlsl
+				const CompactParticleInstance& instance = effect.m_instances[instanceIndex];
+				Vec3 position = effect.m_origins[instance.m_originIndex] + Vec3(HalfToFloat(instance.m_position[0]), HalfToFloat(instance.m_position[1]), HalfToFloat(instance.m_position[2]));
+				float halfWidth = HalfToFloat(instance.m_halfSize[0]);
+				float halfHeight = HalfToFloat(instance.m_halfSize[1]);
+				float rotationDegrees = HalfToFloat(instance.m_rotationDegrees);
+				Vec3 right = -draw.m_cameraLeft;
+				Vec3 up = draw.m_cameraUp;
+				if (draw.m_isHorizontal)
+				{
+					right = Vec3(1.f, 0.f, 0.f);
+					up = Vec3(0.f, 1.f, 0.f);
+				}
+				float rotationCos = CosDegrees(rotationDegrees);
+				float rotationSin = SinDegrees(rotationDegrees);
+				Vec3 rotatedRight = right * rotationCos + up * rotationSin;
+				up = up * rotationCos - right * rotationSin;
+				right = rotatedRight;
+				const AABB2& frameUVs = effect.m_frameUVs[instance.m_spriteFrame];
+
+				float screenX[4];
+				float screenY[4];
+				float attributes[3][4];		//1/w, u/w, v/w at each corner
+				bool isBehindNearPlane = false;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					Vec3 worldPosition = position + right * (halfWidth * (cornerX[corner] * 2.f - 1.f)) + up * (halfHeight * (cornerY[corner] * 2.f - 1.f));
+					Vec3 toCorner = worldPosition - view.m_position;
+					float depth = DotProduct3D(toCorner, viewForward);
+					if (depth < view.m_nearZ)
+					{
+						isBehindNearPlane = true;
+						break;
+					}
+					float inverseDepth = 1.f / depth;
+					screenX[corner] = (DotProduct3D(toCorner, -viewLeft) * inverseDepth / (tanHalfFov * aspect) * 0.5f + 0.5f) * float(m_width);
+					screenY[corner] = (0.5f - DotProduct3D(toCorner, viewUp) * inverseDepth / tanHalfFov * 0.5f) * float(m_height);
+					attributes[0][corner] = inverseDepth;
+					attributes[1][corner] = Interpolate(frameUVs.m_mins.x, frameUVs.m_maxs.x, cornerX[corner]) * inverseDepth;
+					attributes[2][corner] = Interpolate(frameUVs.m_mins.y, frameUVs.m_maxs.y, cornerY[corner]) * inverseDepth;
+				}
+				//particles crossing the near plane are dropped rather than clipped, they would mostly cover the screen anyway
+				if (isBehindNearPlane)
+					continue;
+
+				float area = 0.f;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int next = (corner + 1) % 4;
+					area += screenX[corner] * screenY[next] - screenX[next] * screenY[corner];
+				}
+				float planeDeterminant = (screenX[1] - screenX[0]) * (screenY[2] - screenY[0]) - (screenX[2] - screenX[0]) * (screenY[1] - screenY[0]);
+				if (fabsf(area) < 1e-6f || fabsf(planeDeterminant) < 1e-6f)
+					continue;
+
+				ParticleRasterQuad quad;
+				quad.m_minX = std::max(int(floorf(std::min(std::min(screenX[0], screenX[1]), std::min(screenX[2], screenX[3])))), 0);
+				quad.m_maxX = std::min(int(ceilf(std::max(std::max(screenX[0], screenX[1]), std::max(screenX[2], screenX[3])))), m_width - 1);
+				quad.m_minY = std::max(int(floorf(std::min(std::min(screenY[0], screenY[1]), std::min(screenY[2], screenY[3])))), 0);
+				quad.m_maxY = std::min(int(ceilf(std::max(std::max(screenY[0], screenY[1]), std::max(screenY[2], screenY[3])))), m_height - 1);
+				if (quad.m_minX > quad.m_maxX || quad.m_minY > quad.m_maxY)
+					continue;
+
+				//particles are drawn without culling, so the edges are flipped to face inward whichever way the quad winds
+				float windingSign = area > 0.f ? 1.f : -1.f;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int next = (corner + 1) % 4;
+					float deltaX = screenX[next] - screenX[corner];
+					float deltaY = screenY[next] - screenY[corner];
+					quad.m_edgeX[corner] = -deltaY * windingSign;
+					quad.m_edgeY[corner] = deltaX * windingSign;
+					quad.m_edgeC[corner] = (deltaY * screenX[corner] - deltaX * screenY[corner]) * windingSign;
+				}
+				for (int attribute = 0; attribute < 3; attribute++)
+				{
+					const float* values = attributes[attribute];
+					quad.m_planeX[attribute] = ((values[1] - values[0]) * (screenY[2] - screenY[0]) - (values[2] - values[0]) * (screenY[1] - screenY[0])) / planeDeterminant;
+					quad.m_planeY[attribute] = ((values[2] - values[0]) * (screenX[1] - screenX[0]) - (values[1] - values[0]) * (screenX[2] - screenX[0])) / planeDeterminant;
+					quad.m_planeC[attribute] = values[0] - quad.m_planeX[attribute] * screenX[0] - quad.m_planeY[attribute] * screenY[0];
+				}
+				instance.m_color.GetAsFloats(quad.m_color);
+				quad.m_blendMode = draw.m_blendMode;
+				quad.m_textureIndex = textureIndex;
+
+				int quadIndex = int(m_quads.size());
+				m_quads.push_back(quad);
+				for (int tileY = quad.m_minY / m_tileSize; tileY <= quad.m_maxY / m_tileSize; tileY++)
+				{
+					for (int tileX = quad.m_minX / m_tileSize; tileX <= quad.m_maxX / m_tileSize; tileX++)
+					{
+						m_tileQuads[tileY * m_numTilesX + tileX].push_back(quadIndex);
+					}
+				}
+			}
+		}
+	}
+}
+
+int ParticleTileRasterizer::GetOrLoadTexture(const std::string& texturePath)
+{
+	for (int i = 0; i < int(m_texturePaths.size()); i++)
+	{
+		if (m_texturePaths[i] == texturePath)
+			return i;
+	}
+
+	Image image(texturePath.c_str());
+	ParticleRasterTexture texture;
+	texture.m_width = image.GetDimensions().x;
+	texture.m_height = image.GetDimensions().y;
+	if (texture.m_width <= 0 || texture.m_height <= 0)
+		return -1;
+
+	texture.m_texels.resize(size_t(texture.m_width) * texture.m_height * 4);
+	for (int y = 0; y < texture.m_height; y++)
+	{
+		for (int x = 0; x < texture.m_width; x++)
+		{
+			image.GetTexelColor(IntVec2(x, y)).GetAsFloats(&texture.m_texels[(size_t(y) * texture.m_width + x) * 4]);
+		}
+	}
+	m_texturePaths.push_back(texturePath);
+	m_textures.push_back(texture);
+	return int(m_textures.size()) - 1;
+}
+
+void ParticleTileRasterizer::RunChunk(int chunkIndex)
+{
+	int numTiles = m_numTilesX * m_numTilesY;
+	int begin = numTiles * chunkIndex / m_numChunks;
+	int end = numTiles * (chunkIndex + 1) / m_numChunks;
+	for (int tileIndex = begin; tileIndex < end; tileIndex++)
+	{
+		int tileMinX = (tileIndex % m_numTilesX) * m_tileSize;
+		int tileMinY = (tileIndex / m_numTilesX) * m_tileSize;
+		int tileMaxX = std::min(tileMinX + m_tileSize, m_width) - 1;
+		int tileMaxY = std::min(tileMinY + m_tileSize, m_height) - 1;
+		const std::vector<int>& quads = m_tileQuads[tileIndex];
+		for (int i = 0; i < int(quads.size()); i++)
+		{
+			ShadeQuadInTile(m_quads[quads[i]], tileIndex, tileMinX, tileMinY, tileMaxX, tileMaxY);
+		}
+	}
+}
+
+//coverage and the uv planes are evaluated four pixels at a time, texturing and blending work on the four channels of one pixel
+void ParticleTileRasterizer::ShadeQuadInTile(const ParticleRasterQuad& quad, int tileIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+	int minX = std::max(quad.m_minX, tileMinX);
+	int maxX = std::min(quad.m_maxX, tileMaxX);
+	int minY = std::max(quad.m_minY, tileMinY);
+	int maxY = std::min(quad.m_maxY, tileMaxY);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	const ParticleRasterTexture* texture = quad.m_textureIndex >= 0 ? &m_textures[quad.m_textureIndex] : nullptr;
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 color = _mm_loadu_ps(quad.m_color);
+	__m128 edgeStepX[4];
+	for (int i = 0; i < 4; i++)
+	{
+		edgeStepX[i] = _mm_set1_ps(quad.m_edgeX[i]);
+	}
+	__m128 planeStepX[3];
+	for (int i = 0; i < 3; i++)
+	{
+		planeStepX[i] = _mm_set1_ps(quad.m_planeX[i]);
+	}
+
+	long long numFragments = 0;
+	for (int y = minY; y <= maxY; y++)
+	{
+		float pixelY = float(y) + 0.5f;
+		__m128 rowEdge[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rowEdge[i] = _mm_set1_ps(quad.m_edgeY[i] * pixelY + quad.m_edgeC[i]);
+		}
+		__m128 rowPlane[3];
+		for (int i = 0; i < 3; i++)
+		{
+			rowPlane[i] = _mm_set1_ps(quad.m_planeY[i] * pixelY + quad.m_planeC[i]);
+		}
+
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x)), pixelOffsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(rowEdge[0], _mm_mul_ps(edgeStepX[0], pixelX)), zero);
+			for (int i = 1; i < 4; i++)
+			{
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(rowEdge[i], _mm_mul_ps(edgeStepX[i], pixelX)), zero));
+			}
+			int laneMask = _mm_movemask_ps(inside) & ((1 << std::min(4, maxX - x + 1)) - 1);
+			if (laneMask == 0)
+				continue;
+
+			__m128 w = _mm_div_ps(one, _mm_add_ps(rowPlane[0], _mm_mul_ps(planeStepX[0], pixelX)));
+			float u[4];
+			float v[4];
+			_mm_storeu_ps(u, _mm_mul_ps(_mm_add_ps(rowPlane[1], _mm_mul_ps(planeStepX[1], pixelX)), w));
+			_mm_storeu_ps(v, _mm_mul_ps(_mm_add_ps(rowPlane[2], _mm_mul_ps(planeStepX[2], pixelX)), w));
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((laneMask & (1 << lane)) == 0)
+					continue;
+
+				int pixel = y * m_width + x + lane;
+				__m128 source = color;
+				if (texture)
+				{
+					int texelX = std::min(std::max(int(floorf(u[lane] * float(texture->m_width))), 0), texture->m_width - 1);
+					int texelY = std::min(std::max(int(floorf(v[lane] * float(texture->m_height))), 0), texture->m_height - 1);
+					source = _mm_mul_ps(source, _mm_loadu_ps(&texture->m_texels[(size_t(texelY) * texture->m_width + texelX) * 4]));
+				}
+
+				//the same equations as the renderer's blend states, clamped like a unorm target after every draw
+				float* destinationTexel = &m_colors[size_t(pixel) * 4];
+				__m128 destination = _mm_loadu_ps(destinationTexel);
+				__m128 sourceAlpha = _mm_shuffle_ps(source, source, _MM_SHUFFLE(3, 3, 3, 3));
+				__m128 result = source;
+				if (quad.m_blendMode == BlendMode::ALPHA)
+					result = _mm_add_ps(_mm_mul_ps(source, sourceAlpha), _mm_mul_ps(destination, _mm_sub_ps(one, sourceAlpha)));
+				else if (quad.m_blendMode == BlendMode::ADDITIVE)
+					result = _mm_add_ps(destination, _mm_mul_ps(source, sourceAlpha));
+				_mm_storeu_ps(destinationTexel, _mm_min_ps(_mm_max_ps(result, zero), one));
+
+				if (m_overdraw[pixel] < 0xFFFF)
+					m_overdraw[pixel]++;
+				numFragments++;
+			}
+		}
+	}
+	m_tileFragments[tileIndex] += numFragments;
+}
+
+void ParticleTileRasterizer::GetImage(std::vector<Rgba8>& out_texels) const
+{
+	out_texels.resize(size_t(m_width) * m_height);
+	for (int pixel = 0; pixel < int(out_texels.size()); pixel++)
+	{
+		out_texels[pixel].SetFromFloats(&m_colors[size_t(pixel) * 4]);
+	}
+}
+
+//black where nothing was drawn, then blue through green to red at the most overdrawn pixel
+void ParticleTileRasterizer::GetOverdrawImage(std::vector<Rgba8>& out_texels) const
+{
+	out_texels.resize(size_t(m_width) * m_height);
+	float inverseMaxOverdraw = m_stats.m_maxOverdraw > 0 ? 1.f / float(m_stats.m_maxOverdraw) : 0.f;
+	for (int pixel = 0; pixel < int(out_texels.size()); pixel++)
+	{
+		if (m_overdraw[pixel] == 0)
+		{
+			out_texels[pixel] = Rgba8(0, 0, 0, 255);
+			continue;
+		}
+		float heat = float(m_overdraw[pixel]) * inverseMaxOverdraw;
+		float color[4] = { Clamp(heat * 2.f - 1.f, 0.f, 1.f), 1.f - fabsf(heat * 2.f - 1.f), Clamp(1.f - heat * 2.f, 0.f, 1.f), 1.f };
+		out_texels[pixel].SetFromFloats(color);
+	}
+}
+
+static unsigned int UpdatePNGCRC(unsigned int crc, const unsigned char* data, size_t size)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+	}
+	return ~crc;
+}
+
+static void AppendBigEndian(std::vector<unsigned char>& bytes, unsigned int value)
+{
+	bytes.push_back((unsigned char)(value >> 24));
+	bytes.push_back((unsigned char)(value >> 16));
+	bytes.push_back((unsigned char)(value >> 8));
+	bytes.push_back((unsigned char)value);
+}
+
+static void AppendPNGChunk(std::vector<unsigned char>& file, const char* type, const std::vector<unsigned char>& data)
+{
+	AppendBigEndian(file, (unsigned int)data.size());
+	size_t typeStart = file.size();
+	file.insert(file.end(), type, type + 4);
+	file.insert(file.end(), data.begin(), data.end());
+	AppendBigEndian(file, UpdatePNGCRC(0, &file[typeStart], file.size() - typeStart));
+}
+
+bool ParticleTileRasterizer::WritePNG(const std::vector<Rgba8>& texels, int width, int height, const char* imagePath)
+{
+	//8 bit rgba rows from the top, every row unfiltered, in stored deflate blocks, so no compression library is needed
+	std::vector<unsigned char> rows;
+	rows.reserve(size_t(height) * (size_t(width) * 4 + 1));
+	for (int y = 0; y < height; y++)
+	{
+		rows.push_back(0);
+		for (int x = 0; x < width; x++)
+		{
+			const Rgba8& texel = texels[size_t(y) * width + x];
+			rows.push_back(texel.r);
+			rows.push_back(texel.g);
+			rows.push_back(texel.b);
+			rows.push_back(texel.a);
+		}
+	}
+
+	std::vector<unsigned char> compressed;
+	compressed.push_back(0x78);
+	compressed.push_back(0x01);
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = std::min(rows.size() - offset, size_t(65535));
+		bool isFinal = offset + blockSize == rows.size();
+		compressed.push_back(isFinal ? 1 : 0);
+		compressed.push_back((unsigned char)(blockSize & 0xFF));
+		compressed.push_back((unsigned char)(blockSize >> 8));
+		compressed.push_back((unsigned char)(~blockSize & 0xFF));
+		compressed.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+		compressed.insert(compressed.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < rows.size());
+
+	unsigned int adlerA = 1;
+	unsigned int adlerB = 0;
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		adlerA = (adlerA + rows[i]) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	}
+	AppendBigEndian(compressed, (adlerB << 16) | adlerA);
+
+	std::vector<unsigned char> header;
+	AppendBigEndian(header, (unsigned int)width);
+	AppendBigEndian(header, (unsigned int)height);
+	header.push_back(8);	//bits per channel
+	header.push_back(6);	//rgba
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<unsigned char> file(signature, signature + 8);
+	AppendPNGChunk(file, "IHDR", header);
+	AppendPNGChunk(file, "IDAT", compressed);
+	AppendPNGChunk(file, "IEND", std::vector<unsigned char>());
+
+	std::ofstream stream(imagePath, std::ios::binary);
+	if (!stream)
+		return false;
+	stream.write(reinterpret_cast<const char*>(file.data()), file.size());
+	return bool(stream);
+}
+
+ParticleSnapshotRenderer::ParticleSnapshotRenderer(ParticleWorld* world)
+	:m_world(world)
+{
+	if (s_consoleRenderers.empty())
+		SubscribeEventCallbackFunction("particles.rasterize", Command_Rasterize);
+	s_consoleRenderers.push_back(this);
+}
+
+ParticleSnapshotRenderer::~ParticleSnapshotRenderer()
+{
+	s_consoleRenderers.erase(std::remove(s_consoleRenderers.begin(), s_consoleRenderers.end(), this), s_consoleRenderers.end());
+	if (s_consoleRenderers.empty())
+		UnsubscribeEventCallbackFunction("particles.rasterize", Command_Rasterize);
+}
+
+bool ParticleSnapshotRenderer::RenderEffectFile(const char* effectPath, float seconds, int width, int height, const char* imagePath, const char* overdrawImagePath, ParticleRasterStats& out_stats)
+{
+	if (width <= 0 || height <= 0)
+		return false;
+	std::vector<ParticleEmitterData> emitterData = BatchedParticleEffect::LoadEmitterData(effectPath, m_world);
+	if (emitterData.empty())
+		return false;
+
+	//no world, like the impostor baker, so the effect never culls, sleeps or answers to a budget, and the same time gives the same image
+	BatchedParticleEffect effect(emitterData, 1, nullptr);
+	effect.AddInstance(Mat44::IDENTITY);
+	constexpr float stepSeconds = 1.f / 60.f;
+	for (float time = 0.f; time < seconds; time += stepSeconds)
+	{
+		effect.Update(std::min(stepSeconds, seconds - time));
+	}
+
+	//the camera looks down +x at the particles from far enough back to fit all of them
+	std::vector<BatchedParticleSprite> sprites;
+	effect.GetParticleSprites(sprites);
+	Vec3 center;
+	for (int i = 0; i < int(sprites.size()); i++)
+	{
+		center += sprites[i].m_position;
+	}
+	if (!sprites.empty())
+		center *= 1.f / float(sprites.size());
+	float radius = 1.f;
+	for (int i = 0; i < int(sprites.size()); i++)
+	{
+		radius = std::max(radius, (sprites[i].m_position - center).GetLength() + std::max(sprites[i].m_halfWidth, sprites[i].m_halfHeight));
+	}
+	ParticleRasterView view;
+	float fitDistance = radius / SinDegrees(view.m_fovDegrees * 0.5f * std::min(1.f, float(width) / float(height)));
+	view.m_position = center - Vec3(fitDistance, 0.f, 0.f);
+	Vec3 viewForward, viewLeft, viewUp;
+	view.m_orientation.GetAsVectors_XFwd_YLeft_ZUp(viewForward, viewLeft, viewUp);
+
+	ParticleInstanceCapture capture;
+	effect.CaptureParticles(view.m_position, viewForward, viewLeft, viewUp, capture);
+	ParticleTileRasterizer rasterizer(width, height, m_world ? m_world->GetJobSystem() : nullptr);
+	rasterizer.Render(capture, view, Rgba8(0, 0, 0, 255));
+	out_stats = rasterizer.GetStats();
+
+	std::vector<Rgba8> texels;
+	rasterizer.GetImage(texels);
+	if (!ParticleTileRasterizer::WritePNG(texels, width, height, imagePath))
+		return false;
+	if (overdrawImagePath && overdrawImagePath[0] != '\0')
+	{
+		rasterizer.GetOverdrawImage(texels);
+		return ParticleTileRasterizer::WritePNG(texels, width, height, overdrawImagePath);
+	}
+	return true;
+}
+
+//particles.rasterize effect=<path> [world=index] ..., loading the effect through the first world unless another is picked
+bool ParticleSnapshotRenderer::Command_Rasterize(EventArgs& args)
+{
+	std::string effectPath = args.GetValue("effect", "");
+	if (effectPath.empty())
+	{
+		g_theConsole->AddLine(g_theConsole->COMMAND, "Usage: particles.rasterize effect=<path> world=0 t=1.0 width=512 height=512 out=<png> overdraw=<png>");
+		return false;
+	}
+
+	int worldIndex = args.GetValue("world", 0);
+	if (worldIndex < 0 || worldIndex >= int(s_consoleRenderers.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d particle worlds", int(s_consoleRenderers.size())));
+		return false;
+	}
+
+	//Data/ParticleSystemData/Rain.xml renders to Data/Images/Rain_Snapshot.png
+	size_t nameStart = effectPath.find_last_of("/\\") + 1;
+	size_t extensionStart = effectPath.find_last_of('.');
+	if (extensionStart == std::string::npos || extensionStart < nameStart)
+		extensionStart = effectPath.size();
+	std::string imagePath = args.GetValue("out", "Data/Images/" + effectPath.substr(nameStart, extensionStart - nameStart) + "_Snapshot.png");
+	std::string overdrawImagePath = args.GetValue("overdraw", "");
+	float seconds = args.GetValue("t", 1.f);
+	int width = args.GetValue("width", 512);
+	int height = args.GetValue("height", 512);
+
+	ParticleRasterStats stats;
+	if (!s_consoleRenderers[worldIndex]->RenderEffectFile(effectPath.c_str(), seconds, width, height, imagePath.c_str(), overdrawImagePath.c_str(), stats))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("Could not rasterize %s", effectPath.c_str()));
+		return false;
+	}
+	g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Rasterized %s at %.2fs into %s: %d quads, %lld fragments, overdraw %.2f average %d max, %.2f ms binning %.2f ms shading",
+		effectPath.c_str(), seconds, imagePath.c_str(), stats.m_numQuads, stats.m_numFragments, stats.GetAverageOverdraw(), stats.m_maxOverdraw, stats.m_binMs, stats.m_shadeMs));
+	return false;
+}
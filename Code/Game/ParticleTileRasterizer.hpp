@@ -0,0 +1,136 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/JobSystem.hpp"
+#include "Game/ParticleChunkJobs.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/EulerAngles.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+
+class ParticleWorld;
+class ParticleInstanceCapture;
+class ParticleTileRasterizer;
+
+//Pinhole camera the rasterizer projects through, x forward, y left and z up like the game camera.
+struct ParticleRasterView
+{
+	Vec3 m_position;
+	EulerAngles m_orientation;
+	float m_fovDegrees = 60.f;		//vertical
+	float m_nearZ = 0.1f;
+};
+
+struct ParticleRasterStats
+{
+	int m_numQuads = 0;
+	int m_numCoveredPixels = 0;
+	long long m_numFragments = 0;	//pixels shaded, which is what fill cost scales with
+	int m_maxOverdraw = 0;
+	double m_binMs = 0.0;
+	double m_shadeMs = 0.0;
+
+	float GetAverageOverdraw() const { return m_numCoveredPixels > 0 ? float(double(m_numFragments) / double(m_numCoveredPixels)) : 0.f; }
+};
+
+//One particle billboard in screen space. A billboard stays planar and convex after projection, so it is rasterized as one quad
+//against its four edges, and 1/w, u/w and v/w are planes across the screen for perspective correct uvs.
+struct ParticleRasterQuad
+{
+	float m_edgeX[4];
+	float m_edgeY[4];
+	float m_edgeC[4];
+	float m_planeX[3];		//1/w, u/w, v/w
+	float m_planeY[3];
+	float m_planeC[3];
+	float m_color[4];
+	BlendMode m_blendMode = BlendMode::ALPHA;
+	int m_textureIndex = -1;		//-1 for untextured
+	int m_minX = 0;
+	int m_minY = 0;
+	int m_maxX = 0;
+	int m_maxY = 0;
+};
+
+struct ParticleRasterTexture
+{
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_texels;		//rgba, rows from the bottom like uvs
+};
+
+//A range of tiles, run on a worker or inline on the rendering thread.
+class ParticleRasterTileJob : public ParticleChunkJob
+{
+public:
+	ParticleRasterTileJob(ParticleTileRasterizer* rasterizer, int chunkIndex);
+
+protected:
+	virtual void ExecuteChunk(int chunkIndex) override;
+
+private:
+	ParticleTileRasterizer* m_rasterizer = nullptr;
+};
+
+//Draws a captured particle stream on the cpu the way CompactParticles.hlsl and the blend states draw it on the gpu, point sampled
+//with clamped uvs. Quads are binned into square tiles in the order they were drawn, then the tiles are shaded in parallel on the
+//job system, each blending its own quads in draw order, so the image comes out the same however the tiles are split.
+class ParticleTileRasterizer
+{
+	friend class ParticleRasterTileJob;
+
+public:
+	ParticleTileRasterizer(int width, int height, JobSystem* jobSystem = nullptr, int tileSize = 32);
+	~ParticleTileRasterizer();
+
+	void Render(const ParticleInstanceCapture& capture, const ParticleRasterView& view, const Rgba8& clearColor);
+	void GetImage(std::vector<Rgba8>& out_texels) const;
+	void GetOverdrawImage(std::vector<Rgba8>& out_texels) const;
+	const ParticleRasterStats& GetStats() const { return m_stats; }
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	static bool WritePNG(const std::vector<Rgba8>& texels, int width, int height, const char* imagePath);
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	int m_tileSize = 0;
+	int m_numTilesX = 0;
+	int m_numTilesY = 0;
+	JobSystem* m_jobSystem = nullptr;
+	std::vector<ParticleChunkJob*> m_jobs;
+	int m_numChunks = 0;
+	std::vector<ParticleRasterQuad> m_quads;
+	std::vector<std::vector<int>> m_tileQuads;		//quads touching each tile, in draw order
+	std::vector<long long> m_tileFragments;
+	std::vector<std::string> m_texturePaths;
+	std::vector<ParticleRasterTexture> m_textures;
+	std::vector<float> m_colors;					//rgba, rows from the top
+	std::vector<unsigned short> m_overdraw;
+	ParticleRasterStats m_stats;
+
+private:
+	void BinQuads(const ParticleInstanceCapture& capture, const ParticleRasterView& view);
+	int GetOrLoadTexture(const std::string& texturePath);
+	void RunChunk(int chunkIndex);
+	void ShadeQuadInTile(const ParticleRasterQuad& quad, int tileIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+};
+
+//Registers the console command that renders an effect file at a point in time into a png.
+//Every live renderer answers it, in the order their worlds were created.
+class ParticleSnapshotRenderer
+{
+public:
+	ParticleSnapshotRenderer(ParticleWorld* world);
+	~ParticleSnapshotRenderer();
+
+	bool RenderEffectFile(const char* effectPath, float seconds, int width, int height, const char* imagePath, const char* overdrawImagePath, ParticleRasterStats& out_stats);
+	static bool Command_Rasterize(EventArgs& args);
+
+private:
+	ParticleWorld* m_world = nullptr;
+
+private:
+	static std::vector<ParticleSnapshotRenderer*> s_consoleRenderers;
+};
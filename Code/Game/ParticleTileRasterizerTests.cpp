@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include "Engine/Core/Image.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/ParticleTileRasterizer.hpp"
+#include "Game/ParticleInstanceCapture.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderResourceTable.hpp"
+
+extern RenderResourceTable* g_theRenderResources;
+
+static const char* REFERENCE_IMAGE_PATH = "Data/Images/ParticleRaster_Reference.png";
+static const char* ACTUAL_IMAGE_PATH = "Data/Images/ParticleRaster_Actual.png";
+static const int REFERENCE_WIDTH = 96;
+static const int REFERENCE_HEIGHT = 64;
+
+//one untextured quad facing the default view, which looks down +x from the origin
+static void AddTestQuad(ParticleInstanceCapture& capture, const Vec3& position, float halfSize, const Rgba8& color, BlendMode blendMode)
+{
+	CapturedParticleEffect& effect = capture.BeginEffect(std::vector<Vec3>(1, position), std::vector<AABB2>(1, AABB2(Vec2(0.f, 0.f), Vec2(1.f, 1.f))));
+	CompactParticleInstance instance;
+	instance.m_position[0] = FloatToHalf(0.f);
+	instance.m_position[1] = FloatToHalf(0.f);
+	instance.m_position[2] = FloatToHalf(0.f);
+	instance.m_halfSize[0] = FloatToHalf(halfSize);
+	instance.m_halfSize[1] = FloatToHalf(halfSize);
+	instance.m_rotationDegrees = FloatToHalf(0.f);
+	instance.m_color = color;
+	instance.m_spriteFrame = 0;
+	instance.m_originIndex = 0;
+	effect.m_instances.push_back(instance);
+
+	CapturedParticleDraw draw;
+	draw.m_numInstances = 1;
+	draw.m_blendMode = blendMode;
+	draw.m_cameraLeft = Vec3(0.f, 1.f, 0.f);
+	draw.m_cameraUp = Vec3(0.f, 0.f, 1.f);
+	capture.AddDraw(draw);
+}
+
+static bool IsNearColor(const Rgba8& color, int r, int g, int b, int a)
+{
+	return abs(int(color.r) - r) <= 1 && abs(int(color.g) - g) <= 1 && abs(int(color.b) - b) <= 1 && abs(int(color.a) - a) <= 1;
+}
+
+static Rgba8 RenderCenterTexel(BlendMode blendMode, const Rgba8& color, const Rgba8& clearColor)
+{
+	ParticleInstanceCapture capture;
+	AddTestQuad(capture, Vec3(5.f, 0.f, 0.f), 1.f, color, blendMode);
+	ParticleTileRasterizer rasterizer(64, 64);
+	rasterizer.Render(capture, ParticleRasterView(), clearColor);
+	std::vector<Rgba8> texels;
+	rasterizer.GetImage(texels);
+	return texels[32 * 64 + 32];
+}
+
+//particles that only depend on time: every range is constant and the emitters have no shape, so each one leaves along its
+//instance's x axis, and the instances point it different ways across the screen
+static BatchedParticleEffect* CreateReferenceEffect()
+{
+	std::vector<ParticleEmitterData> emitterData;
+	emitterData.push_back(MakeTestEmitterData(40, 6.f, 10.f));
+	emitterData[0].m_startSpeed = FloatRange(1.5f, 1.5f);
+	emitterData[0].m_startSize = FloatRange(0.8f, 0.8f);
+	emitterData[0].m_startRotationDegrees = FloatRange(30.f, 30.f);
+	emitterData[0].m_startColor = Rgba8(255, 200, 120, 255);
+	emitterData[0].m_textureFilepath = "Data/Images/RoundSoftParticle.png";
+	emitterData.push_back(MakeTestEmitterData(40, 10.f, 10.f));
+	emitterData[1].m_startSpeed = FloatRange(0.75f, 0.75f);
+	emitterData[1].m_startSize = FloatRange(0.3f, 0.3f);
+	emitterData[1].m_startColor = Rgba8(60, 120, 255, 160);
+	emitterData[1].m_offsetFromWorldPos = Vec3(0.f, 0.f, 0.5f);
+	emitterData[1].m_blendMode = BlendMode::ADDITIVE;
+
+	BatchedParticleEffect* effect = new BatchedParticleEffect(emitterData, 3);
+	effect->AddInstance(Mat44(Vec3(0.f, 1.f, 0.f), Vec3(-1.f, 0.f, 0.f), Vec3(0.f, 0.f, 1.f), Vec3(0.f, 0.5f, -1.f)));
+	effect->AddInstance(Mat44(Vec3(0.f, 0.f, 1.f), Vec3(0.f, 1.f, 0.f), Vec3(-1.f, 0.f, 0.f), Vec3(1.f, -1.f, -1.5f)));
+	effect->AddInstance(Mat44(Vec3(0.f, -0.7f, -0.7f), Vec3(0.f, 0.7f, -0.7f), Vec3(1.f, 0.f, 0.f), Vec3(-1.f, -0.5f, 1.5f)));
+	for (int step = 0; step < 60; step++)
+	{
+		effect->Update(1.f / 60.f);
+	}
+	return effect;
+}
+
+static void RenderReferenceScene(int tileSize, std::vector<Rgba8>& out_texels, ParticleRasterStats& out_stats)
+{
+	//tools run without a renderer, so nothing on the way may need render resources
+	RenderResourceTable* renderResources = g_theRenderResources;
+	g_theRenderResources = nullptr;
+	BatchedParticleEffect* effect = CreateReferenceEffect();
+	ParticleRasterView view;
+	view.m_position = Vec3(-4.f, 0.f, 0.f);
+	ParticleInstanceCapture capture;
+	effect->CaptureParticles(view.m_position, Vec3(1.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f), capture);
+	ParticleTileRasterizer rasterizer(REFERENCE_WIDTH, REFERENCE_HEIGHT, nullptr, tileSize);
+	rasterizer.Render(capture, view, Rgba8(0, 0, 0, 255));
+	rasterizer.GetImage(out_texels);
+	out_stats = rasterizer.GetStats();
+	delete effect;
+	g_theRenderResources = renderResources;
+}
+
+GAME_TEST(ParticleTileRasterizer_BlendsLikeTheBlendStates)
+{
+	Rgba8 clearColor(0, 0, 255, 255);
+	GAME_TEST_CHECK(IsNearColor(RenderCenterTexel(BlendMode::OPAQUE, Rgba8(255, 0, 0, 128), clearColor), 255, 0, 0, 128));
+	GAME_TEST_CHECK(IsNearColor(RenderCenterTexel(BlendMode::ALPHA, Rgba8(255, 0, 0, 128), clearColor), 128, 0, 127, 191));
+	GAME_TEST_CHECK(IsNearColor(RenderCenterTexel(BlendMode::ADDITIVE, Rgba8(0, 255, 0, 64), clearColor), 0, 64, 255, 255));
+
+	//additive saturates like a unorm target
+	GAME_TEST_CHECK(IsNearColor(RenderCenterTexel(BlendMode::ADDITIVE, Rgba8(0, 0, 255, 255), clearColor), 0, 0, 255, 255));
+}
+
+GAME_TEST(ParticleTileRasterizer_DrawsInOrderAndCountsOverdraw)
+{
+	ParticleInstanceCapture capture;
+	AddTestQuad(capture, Vec3(5.f, 0.f, 0.f), 1.f, Rgba8(255, 0, 0, 255), BlendMode::OPAQUE);
+	AddTestQuad(capture, Vec3(5.f, 0.f, 0.f), 0.5f, Rgba8(0, 255, 0, 255), BlendMode::OPAQUE);
+	ParticleTileRasterizer rasterizer(64, 64, nullptr, 8);
+	rasterizer.Render(capture, ParticleRasterView(), Rgba8(0, 0, 0, 255));
+	std::vector<Rgba8> texels;
+	rasterizer.GetImage(texels);
+
+	//the smaller quad was drawn last, so it covers the middle of the larger one
+	GAME_TEST_CHECK(texels[32 * 64 + 32] == Rgba8(0, 255, 0, 255));
+	GAME_TEST_CHECK(texels[32 * 64 + 24] == Rgba8(255, 0, 0, 255));
+	GAME_TEST_CHECK(texels[0] == Rgba8(0, 0, 0, 255));
+
+	const ParticleRasterStats& stats = rasterizer.GetStats();
+	GAME_TEST_CHECK(stats.m_numQuads == 2);
+	GAME_TEST_CHECK(stats.m_maxOverdraw == 2);
+	GAME_TEST_CHECK(stats.m_numFragments > stats.m_numCoveredPixels);
+	GAME_TEST_CHECK(stats.GetAverageOverdraw() > 1.f && stats.GetAverageOverdraw() < 2.f);
+}
+
+GAME_TEST(ParticleTileRasterizer_DropsQuadsCrossingTheNearPlane)
+{
+	ParticleInstanceCapture capture;
+	AddTestQuad(capture, Vec3(0.05f, 0.f, 0.f), 1.f, Rgba8(255, 0, 0, 255), BlendMode::OPAQUE);
+	AddTestQuad(capture, Vec3(-5.f, 0.f, 0.f), 1.f, Rgba8(255, 0, 0, 255), BlendMode::OPAQUE);
+	ParticleTileRasterizer rasterizer(32, 32);
+	rasterizer.Render(capture, ParticleRasterView(), Rgba8(0, 0, 0, 255));
+	GAME_TEST_CHECK(rasterizer.GetStats().m_numQuads == 0);
+	GAME_TEST_CHECK(rasterizer.GetStats().m_numFragments == 0);
+}
+
+GAME_TEST(ParticleTileRasterizer_ImageDoesNotDependOnTheTiles)
+{
+	std::vector<Rgba8> smallTiles;
+	std::vector<Rgba8> oneTile;
+	ParticleRasterStats smallTileStats;
+	ParticleRasterStats oneTileStats;
+	RenderReferenceScene(8, smallTiles, smallTileStats);
+	RenderReferenceScene(128, oneTile, oneTileStats);
+	GAME_TEST_CHECK(smallTiles == oneTile);
+	GAME_TEST_CHECK(smallTileStats.m_numQuads > 0 && smallTileStats.m_numQuads == oneTileStats.m_numQuads);
+	GAME_TEST_CHECK(smallTileStats.m_numFragments == oneTileStats.m_numFragments);
+}
+
+GAME_TEST(ParticleTileRasterizer_MatchesTheReferenceImage)
+{
+	std::vector<Rgba8> texels;
+	ParticleRasterStats stats;
+	RenderReferenceScene(32, texels, stats);
+
+	//compilers may round the projection differently, so a few texels on quad edges are let off by a small amount
+	Image reference(REFERENCE_IMAGE_PATH);
+	bool isSameSize = reference.GetDimensions() == IntVec2(REFERENCE_WIDTH, REFERENCE_HEIGHT);
+	GAME_TEST_CHECK(isSameSize);
+	int numDifferentTexels = 0;
+	for (int y = 0; y < REFERENCE_HEIGHT && isSameSize; y++)
+	{
+		for (int x = 0; x < REFERENCE_WIDTH; x++)
+		{
+			//images keep their rows from the bottom, the rasterizer from the top
+			Rgba8 expected = reference.GetTexelColor(IntVec2(x, REFERENCE_HEIGHT - 1 - y));
+			const Rgba8& actual = texels[y * REFERENCE_WIDTH + x];
+			if (!IsNearColor(actual, expected.r, expected.g, expected.b, expected.a))
+				numDifferentTexels++;
+		}
+	}
+	bool isMatching = isSameSize && numDifferentTexels * 200 <= REFERENCE_WIDTH * REFERENCE_HEIGHT;
+	GAME_TEST_CHECK(isMatching);
+
+	//written next to the reference to look at, or to replace it with when the rasterizer changes on purpose
+	if (!isMatching)
+		ParticleTileRasterizer::WritePNG(texels, REFERENCE_WIDTH, REFERENCE_HEIGHT, ACTUAL_IMAGE_PATH);
+}
@@ -0,0 +1,250 @@
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Renderer/ParticlesManager.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/ParticleSystemPool.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+#include "Game/ParticleBoundsTree.hpp"
+#include "Game/ParticleOcclusionBuffer.hpp"
+#include "Game/ParticleBudget.hpp"
+#include "Game/ParticleQualityController.hpp"
+#include "Game/ParticleImpostorBaker.hpp"
+#include "Game/ParticleLoopClip.hpp"
+#include "Game/ParticleTileRasterizer.hpp"
+#include "Game/ParticleAtlas.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/ParticleDrawBatcher.hpp"
+
+ParticleWorld::ParticleWorld(const ParticleWorldConfig& config)
+	:m_config(config)
+{
+	m_jobSystem = m_config.m_sharedJobSystem;
+	if (m_config.m_numDedicatedWorkerThreads > 0)
+	{
+		JobSystemConfig jobSystemConfig;
+		jobSystemConfig.m_numWorkerThreads = m_config.m_numDedicatedWorkerThreads;
+		m_jobSystem = new JobSystem(jobSystemConfig);
+		m_ownsJobSystem = true;
+	}
+
+	ParticlesManagerConfig particleConfig;
+	particleConfig.m_maxParticles = m_config.m_maxParticles;
+	particleConfig.m_numPools = m_config.m_numPools;
+	particleConfig.m_renderer = m_config.m_renderer;
+	particleConfig.m_jobSystem = m_jobSystem;
+	m_particlesManager = new ParticlesManager(particleConfig);
+	m_reclaimer = new ParticleSystemReclaimer(m_particlesManager);
+	m_systemPool = new ParticleSystemPool(HasEngineSystems() ? m_particlesManager : nullptr, m_reclaimer);
+	m_boundsTree = new ParticleBoundsTree();
+	if (m_config.m_occlusionBufferSize.x > 0 && m_config.m_occlusionBufferSize.y > 0)
+		m_occlusionBuffer = new ParticleOcclusionBuffer(m_config.m_occlusionBufferSize.x, m_config.m_occlusionBufferSize.y);
+	if (m_config.m_maxBatchedParticles > 0)
+		m_budgetManager = new ParticleBudgetManager(m_config.m_maxBatchedParticles);
+
+	//the controller always measures, a zero budget only keeps it from touching the knobs
+	ParticleQualityConfig qualityConfig;
+	qualityConfig.m_frameBudgetMs = m_config.m_qualityFrameBudgetMs;
+	m_qualityController = new ParticleQualityController(qualityConfig);
+	m_impostorBaker = new ParticleImpostorBaker(this);
+	m_loopClipBaker = new ParticleLoopClipBaker(this);
+	m_atlasBaker = new ParticleAtlasBaker(this);
+	m_snapshotRenderer = new ParticleSnapshotRenderer(this);
+	m_drawBatcher = new ParticleDrawBatcher();
+
+	//effects bake their emitters against the atlas when they are created, so it has to be loaded before any of them
+	if (!m_config.m_atlasPath.empty())
+		m_atlas = ParticleAtlas::LoadFromFile(m_config.m_atlasPath.c_str());
+}
+
+ParticleWorld::~ParticleWorld()
+{
+	delete m_atlas;
+	m_atlas = nullptr;
+	delete m_drawBatcher;
+	m_drawBatcher = nullptr;
+	delete m_snapshotRenderer;
+	m_snapshotRenderer = nullptr;
+	delete m_atlasBaker;
+	m_atlasBaker = nullptr;
+	delete m_loopClipBaker;
+	m_loopClipBaker = nullptr;
+	delete m_impostorBaker;
+	m_impostorBaker = nullptr;
+	delete m_qualityController;
+	m_qualityController = nullptr;
+	delete m_budgetManager;
+	m_budgetManager = nullptr;
+	delete m_occlusionBuffer;
+	m_occlusionBuffer = nullptr;
+	delete m_boundsTree;
+	m_boundsTree = nullptr;
+	delete m_systemPool;
+	m_systemPool = nullptr;
+	delete m_reclaimer;
+	m_reclaimer = nullptr;
+	delete m_particlesManager;
+	m_particlesManager = nullptr;
+	if (m_ownsJobSystem)
+	{
+		delete m_jobSystem;
+	}
+	m_jobSystem = nullptr;
+}
+
+void ParticleWorld::Startup()
+{
+	if (m_ownsJobSystem)
+		m_jobSystem->Startup();
+	m_particlesManager->Startup();
+}
+
+void ParticleWorld::BeginFrame()
+{
+	//the shared job system is ticked by the app, a dedicated one is ticked by its world
+	if (m_ownsJobSystem)
+		m_jobSystem->BeginFrame();
+	m_reclaimer->BeginFrame();
+
+	//batched effects emit during the frame against the caps handed out here
+	if (m_budgetManager)
+		m_budgetManager->Arbitrate(m_batchedEffects, GetQualityKnobs().m_maxAliveScale);
+}
+
+void ParticleWorld::EndFrame()
+{
+	m_qualityController->EndFrame();
+	if (m_ownsJobSystem)
+		m_jobSystem->EndFrame();
+}
+
+void ParticleWorld::Shutdown()
+{
+	m_systemPool->RetireAllPooledSystems();
+
+	//a shared job system may hold other worlds' jobs, so only a dedicated one gets its queue cancelled.
+	//no manager update is running here, so every retired system is free to go
+	if (m_ownsJobSystem)
+		m_jobSystem->CancelAllJobs();
+	m_reclaimer->ReclaimAll();
+	m_particlesManager->KillAllParticleSystems();
+	m_particlesManager->Shutdown();
+
+	if (m_ownsJobSystem)
+		m_jobSystem->Shutdown();
+}
+
+void ParticleWorld::UpdateParticleSystems(float deltaSeconds, const Camera& camera)
+{
+	double startTime = GetCurrentTimeSeconds();
+	if (HasEngineSystems())
+	{
+		m_reclaimer->BeginSystemJobs();
+		m_particlesManager->UpdateParticleSystems(deltaSeconds, camera);
+		m_reclaimer->EndSystemJobs();
+		m_systemPool->OnSystemsSimulated(deltaSeconds);
+	}
+	AddParticleWorkSeconds(GetCurrentTimeSeconds() - startTime);
+}
+
+ParticleSystem* ParticleWorld::CreateEngineSystem(const char* effectPath, const Vec3& position, bool gpuParticles, bool defaultSystem)
+{
+	if (!HasEngineSystems())
+		return nullptr;
+	return m_particlesManager->CreateParticleSystem(effectPath, position, gpuParticles, defaultSystem);
+}
+
+ParticleSystem* ParticleWorld::ChangeEngineSystemType(ParticleSystem* system)
+{
+	if (!system || !HasEngineSystems())
+		return system;
+	return m_particlesManager->ChangeParticleSystemType(system);
+}
+
+void ParticleWorld::RenderEngineSystems(const Camera& camera) const
+{
+	if (HasEngineSystems())
+		m_particlesManager->RenderParticleSystems(camera);
+}
+
+void ParticleWorld::AddParticleWorkSeconds(double seconds)
+{
+	m_qualityController->AddWorkSeconds(seconds);
+}
+
+const ParticleQualityKnobs& ParticleWorld::GetQualityKnobs() const
+{
+	return m_qualityController->GetKnobs();
+}
+
+void ParticleWorld::RegisterBatchedEffect(BatchedParticleEffect* effect)
+{
+	m_batchedEffects.push_back(effect);
+}
+
+void ParticleWorld::UnregisterBatchedEffect(BatchedParticleEffect* effect)
+{
+	for (int i = 0; i < int(m_batchedEffects.size()); i++)
+	{
+		if (m_batchedEffects[i] == effect)
+		{
+			m_batchedEffects[i] = m_batchedEffects.back();
+			m_batchedEffects.pop_back();
+			return;
+		}
+	}
+}
+
+void ParticleWorld::SetViewFrustum(const ParticleFrustum& frustum)
+{
+	m_viewFrustum = frustum;
+	m_hasViewFrustum = true;
+}
+
+void ParticleWorld::RenderBatchedEffects(const std::vector<const BatchedParticleEffect*>& effects, const Camera& camera, RenderBackend& backend)
+{
+	//a headless world draws into a backend that only counts, and keeps what the gpu would have been sent in the capture
+	m_drawBatcher->Render(effects.data(), int(effects.size()), camera, backend);
+	if (m_instanceCapture)
+		m_drawBatcher->CaptureCompactDraws(*m_instanceCapture, camera);
+}
+
+void ParticleWorld::CullBatchedEffects()
+{
+	if (!m_hasViewFrustum)
+		return;
+
+	//one walk of the bounds tree covers every batched effect in the world
+	m_numDormantInstances = 0;
+	m_numImpostorInstances = 0;
+	m_screenCullStats = ParticleScreenCullStats();
+	for (int i = 0; i < int(m_batchedEffects.size()); i++)
+	{
+		BatchedParticleEffect* effect = m_batchedEffects[i];
+		effect->SetAllInstancesCulled();
+		m_numDormantInstances += effect->GetNumDormantInstances();
+		m_numImpostorInstances += effect->GetNumImpostorInstances();
+		m_screenCullStats.m_numSubPixelCulled += effect->GetScreenCullStats().m_numSubPixelCulled;
+		m_screenCullStats.m_numTileCapCulled += effect->GetScreenCullStats().m_numTileCapCulled;
+	}
+
+	m_visibleProxies.clear();
+	m_boundsTree->QueryFrustum(m_viewFrustum, m_visibleProxies);
+
+	//survivors of the frustum are tested against the occluders before they are allowed to build render data
+	m_numOccludedInstances = 0;
+	if (m_occlusionBuffer)
+		m_occlusionBuffer->RasterizeOccluders(m_viewFrustum);
+	for (int i = 0; i < int(m_visibleProxies.size()); i++)
+	{
+		int proxyId = m_visibleProxies[i];
+		BatchedParticleEffect* effect = m_boundsTree->GetProxyEffect(proxyId);
+		int instanceIndex = m_boundsTree->GetProxyInstanceIndex(proxyId);
+		if (m_occlusionBuffer && m_occlusionBuffer->IsOccluded(effect->GetInstanceBounds(instanceIndex)))
+		{
+			m_numOccludedInstances++;
+			continue;
+		}
+		effect->SetInstanceVisible(instanceIndex);
+	}
+	m_numCulledInstances = m_boundsTree->GetNumProxies() - int(m_visibleProxies.size()) + m_numOccludedInstances;
+}
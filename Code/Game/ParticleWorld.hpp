@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Engine/Math/IntVec2.hpp"
+#include "Game/ParticleFrustum.hpp"
+#include "Game/ParticleScreenCull.hpp"
+#include "Game/ParticleQualityController.hpp"
+#include "Game/ParticleRadixSort.hpp"
+
+class Renderer;
+class JobSystem;
+class ParticlesManager;
+class ParticleSystem;
+class ParticleSystemPool;
+class ParticleSystemReclaimer;
+class ParticleBoundsTree;
+class ParticleOcclusionBuffer;
+class ParticleBudgetManager;
+class ParticleQualityController;
+class ParticleImpostorBaker;
+class ParticleLoopClipBaker;
+class ParticleAtlas;
+class ParticleAtlasBaker;
+class ParticleInstanceCapture;
+class ParticleSnapshotRenderer;
+class ParticleDrawBatcher;
+class Camera;
+struct Vec3;
+class RenderBackend;
+class BatchedParticleEffect;
+
+struct ParticleWorldConfig
+{
+	int m_maxParticles = 0;
+	int m_numPools = 1;
+	Renderer* m_renderer = nullptr;
+	JobSystem* m_sharedJobSystem = nullptr;
+	int m_numDedicatedWorkerThreads = 0;	//0 means the world schedules on the shared job system
+	IntVec2 m_occlusionBufferSize;			//0 disables occlusion culling of batched instances
+	int m_maxBatchedParticles = 0;			//shared by every batched effect of the world, 0 for no budget
+	float m_qualityFrameBudgetMs = 0.f;		//particle work the quality controller aims for, 0 to keep full quality
+	ParticleSortSettings m_sortSettings;	//how batched effects with sorted emitters order their quads
+	bool m_isCompactInstanceStreamEnabled = false;	//unsorted batched emitters upload compact instances instead of quads
+	std::string m_atlasPath;				//baked particle atlas batched effects remap their textures into, empty for none
+};
+
+//One isolated particle scene: its own particles manager, pools, reclaimer and optionally its own worker threads.
+//Nothing here is global, so the game, an editor preview or a bake can each own a world side by side.
+//Engine particle systems draw straight to the gpu, so a world without a renderer never spawns, steps or draws them,
+//its particles manager only reads effect files for batched effects.
+class ParticleWorld
+{
+public:
+	ParticleWorld(const ParticleWorldConfig& config);
+	~ParticleWorld();
+	void Startup();
+	void BeginFrame();
+	void EndFrame();
+	void Shutdown();
+
+	void RegisterBatchedEffect(BatchedParticleEffect* effect);
+	void UnregisterBatchedEffect(BatchedParticleEffect* effect);
+	void SetViewFrustum(const ParticleFrustum& frustum);
+	void SetScreenSize(const IntVec2& screenSize) { m_screenSize = screenSize; }
+	void CullBatchedEffects();
+	void UpdateParticleSystems(float deltaSeconds, const Camera& camera);
+	ParticleSystem* CreateEngineSystem(const char* effectPath, const Vec3& position, bool gpuParticles, bool defaultSystem = false);	//nullptr without a renderer
+	ParticleSystem* ChangeEngineSystemType(ParticleSystem* system);
+	void RenderEngineSystems(const Camera& camera) const;
+	void RenderBatchedEffects(const std::vector<const BatchedParticleEffect*>& effects, const Camera& camera, RenderBackend& backend);	//joins the draws of every effect passed
+	void AddParticleWorkSeconds(double seconds);
+	const ParticleQualityKnobs& GetQualityKnobs() const;
+	const ParticleSortSettings& GetSortSettings() const { return m_config.m_sortSettings; }
+	bool IsCompactInstanceStreamEnabled() const { return m_config.m_isCompactInstanceStreamEnabled; }
+	const ParticleAtlas* GetAtlas() const { return m_atlas; }
+	void SetInstanceCapture(ParticleInstanceCapture* capture) { m_instanceCapture = capture; }
+	ParticleInstanceCapture* GetInstanceCapture() const { return m_instanceCapture; }
+
+	bool HasEngineSystems() const { return m_config.m_renderer != nullptr; }
+	ParticlesManager* GetParticlesManager() const { return m_particlesManager; }
+	ParticleSystemPool* GetSystemPool() const { return m_systemPool; }
+	ParticleSystemReclaimer* GetReclaimer() const { return m_reclaimer; }
+	JobSystem* GetJobSystem() const { return m_jobSystem; }
+	ParticleBoundsTree* GetBoundsTree() const { return m_boundsTree; }
+	ParticleOcclusionBuffer* GetOcclusionBuffer() const { return m_occlusionBuffer; }
+	ParticleBudgetManager* GetBudgetManager() const { return m_budgetManager; }
+	ParticleQualityController* GetQualityController() const { return m_qualityController; }
+	const ParticleFrustum& GetViewFrustum() const { return m_viewFrustum; }
+	bool HasViewFrustum() const { return m_hasViewFrustum; }
+	const IntVec2& GetScreenSize() const { return m_screenSize; }
+	int GetNumCulledInstances() const { return m_numCulledInstances; }
+	int GetNumVisibleInstances() const { return int(m_visibleProxies.size()) - m_numOccludedInstances; }
+	int GetNumOccludedInstances() const { return m_numOccludedInstances; }
+	const ParticleScreenCullStats& GetScreenCullStats() const { return m_screenCullStats; }
+	int GetNumDormantInstances() const { return m_numDormantInstances; }
+	int GetNumImpostorInstances() const { return m_numImpostorInstances; }
+	bool HasDedicatedJobSystem() const { return m_ownsJobSystem; }
+
+private:
+	ParticleWorldConfig m_config;
+	ParticlesManager* m_particlesManager = nullptr;
+	ParticleSystemPool* m_systemPool = nullptr;
+	ParticleSystemReclaimer* m_reclaimer = nullptr;
+	JobSystem* m_jobSystem = nullptr;
+	bool m_ownsJobSystem = false;
+	ParticleBoundsTree* m_boundsTree = nullptr;
+	ParticleOcclusionBuffer* m_occlusionBuffer = nullptr;
+	ParticleBudgetManager* m_budgetManager = nullptr;
+	ParticleQualityController* m_qualityController = nullptr;
+	ParticleImpostorBaker* m_impostorBaker = nullptr;
+	ParticleLoopClipBaker* m_loopClipBaker = nullptr;
+	ParticleAtlas* m_atlas = nullptr;
+	ParticleAtlasBaker* m_atlasBaker = nullptr;
+	ParticleSnapshotRenderer* m_snapshotRenderer = nullptr;
+	ParticleDrawBatcher* m_drawBatcher = nullptr;
+	ParticleInstanceCapture* m_instanceCapture = nullptr;		//not owned, only filled without a renderer
+	std::vector<BatchedParticleEffect*> m_batchedEffects;
+	std::vector<int> m_visibleProxies;
+	ParticleFrustum m_viewFrustum;
+	bool m_hasViewFrustum = false;
+	IntVec2 m_screenSize = IntVec2(1600, 800);
+	ParticleScreenCullStats m_screenCullStats;		//from the last rendered frame
+	int m_numCulledInstances = 0;
+	int m_numDormantInstances = 0;
+	int m_numImpostorInstances = 0;
+	int m_numOccludedInstances = 0;
+};
@@ -22,9 +22,14 @@ void Player::Update(float deltaSeconds)
 {
 	UNUSED(deltaSeconds);
 	moveDirection = Vec3();
-	HandleMouseInput();
-	HandleKeyboardInput();
-	HandleControllerInput();
+
+	//a headless game has no input, the camera stays where the mode put it
+	if (!m_game->IsHeadless())
+	{
+		HandleMouseInput();
+		HandleKeyboardInput();
+		HandleControllerInput();
+	}
 
 	float currentMoveSpeed = moveSpeed;
 	if (m_isSprinting)
@@ -1,7 +1,12 @@
 #include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Math/MathUtils.hpp"
 #include "Game/Prop.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/ParticleOcclusionBuffer.hpp"
+#include "Game/RenderCommandQueue.hpp"
+#include "Game/Game.hpp"
 
 extern Renderer* g_theRenderer;
 
@@ -13,25 +18,45 @@ Prop::Prop(Game* game, Vec3 spawnPosition)
 Prop::Prop(Game* game, std::vector<Vertex_PCU>& vertices, const char* imageFilepath)
 	:Entity(game), m_localVertices(vertices)
 {
+	//a headless game has no renderer, the prop still records its draw with nothing to draw from
+	if (!g_theRenderer)
+		return;
+
 	if (imageFilepath)
 	{
 		m_texture = g_theRenderer->CreateOrGetTextureFromFile(imageFilepath);
 	}
+	if (!m_localVertices.empty())
+	{
+		m_vertexBuffer = g_theRenderer->CreateVertexBuffer(m_localVertices.size() * sizeof(Vertex_PCU));
+		g_theRenderer->CopyCPUToGPU(m_localVertices.data(), m_localVertices.size() * sizeof(Vertex_PCU), m_vertexBuffer);
+	}
+}
+
+Prop::~Prop()
+{
+	SetIsParticleOccluder(nullptr, false);
+	delete m_vertexBuffer;
+	m_vertexBuffer = nullptr;
 }
 
 void Prop::Update(float deltaSeonds)
 {
 	m_orientation3D += (m_angularVelocity3D * deltaSeonds);
+	if (m_occluderId != -1)
+	{
+		m_occluderWorld->GetOcclusionBuffer()->SetOccluderTransform(m_occluderId, GetModelMatrix());
+	}
 }
 
 void Prop::Render() const
 {
-	g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-	g_theRenderer->SetRasterizerState(CullMode::BACK, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
-	g_theRenderer->SetModelMatrix(GetModelMatrix());
-	g_theRenderer->SetModelColor(m_tintColor);
-	g_theRenderer->BindTexture(m_texture);
-	g_theRenderer->DrawVertexArray((int)m_localVertices.size(), m_localVertices.data());
+	RenderState state;
+	state.m_blendMode = BlendMode::OPAQUE;
+	state.m_texture = m_texture;
+	state.m_modelMatrix = GetModelMatrix();
+	state.m_modelColor = m_tintColor;
+	m_game->GetRenderQueue()->DrawVertexBuffer(RenderLayer::WORLD, state, m_vertexBuffer, (int)m_localVertices.size());
 }
 
 void Prop::SetTintColor(const Rgba8& color)
@@ -39,3 +64,24 @@ void Prop::SetTintColor(const Rgba8& color)
 	m_tintColor = color;
 }
 
+
+void Prop::SetIsParticleOccluder(ParticleWorld* world, bool isOccluder)
+{
+	if (m_occluderId != -1)
+	{
+		m_occluderWorld->GetOcclusionBuffer()->RemoveOccluder(m_occluderId);
+		m_occluderId = -1;
+		m_occluderWorld = nullptr;
+	}
+	if (!isOccluder || !world || !world->GetOcclusionBuffer())
+		return;
+
+	std::vector<Vec3> triangles;
+	triangles.reserve(m_localVertices.size());
+	for (int i = 0; i < int(m_localVertices.size()); i++)
+	{
+		triangles.push_back(m_localVertices[i].m_position);
+	}
+	m_occluderWorld = world;
+	m_occluderId = world->GetOcclusionBuffer()->AddOccluder(triangles, GetModelMatrix());
+}
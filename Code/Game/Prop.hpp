@@ -4,6 +4,8 @@
 #include <vector>
 
 class Texture;
+class ParticleWorld;
+class VertexBuffer;
 
 class Prop : public Entity
 {
@@ -11,12 +13,17 @@ public:
 	Prop() = default;
 	Prop(Game* game, Vec3 spawnPosition);
 	Prop(Game* game, std::vector<Vertex_PCU>& vertices, const char* imageFilepath);
+	virtual ~Prop();
 	virtual void Update(float deltaSeonds) override;
 	virtual void Render() const override;
 	void SetTintColor(const Rgba8& color);
+	void SetIsParticleOccluder(ParticleWorld* world, bool isOccluder);
 
 private:
-	std::vector<Vertex_PCU> m_localVertices;
+	std::vector<Vertex_PCU> m_localVertices;		//kept for the occluder, drawing uses the uploaded copy
+	VertexBuffer* m_vertexBuffer = nullptr;
 	Texture* m_texture = nullptr;
 	Rgba8 m_tintColor;
+	ParticleWorld* m_occluderWorld = nullptr;
+	int m_occluderId = -1;
 };
\ No newline at end of file
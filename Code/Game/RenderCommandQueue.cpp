@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <string.h>
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern Renderer* g_theRenderer;
+
+constexpr int SORT_KEY_DEPTH_BITS = 24;
+constexpr unsigned long long SORT_KEY_DEPTH_MASK = (1ull << SORT_KEY_DEPTH_BITS) - 1ull;
+constexpr unsigned long long SORT_KEY_SHADER_MASK = (1ull << 12) - 1ull;
+constexpr unsigned long long SORT_KEY_TEXTURE_MASK = (1ull << 16) - 1ull;
+
+std::vector<RenderCommandQueue*> RenderCommandQueue::s_consoleQueues;
+
+void RendererRenderBackend::SetBlendMode(BlendMode blendMode)
+{
+	g_theRenderer->SetBlendMode(blendMode);
+}
+
+void RendererRenderBackend::SetRasterizerState(CullMode cullMode, FillMode fillMode, WindingOrder windingOrder)
+{
+	g_theRenderer->SetRasterizerState(cullMode, fillMode, windingOrder);
+}
+
+void RendererRenderBackend::SetDepthStencilState(DepthTest depthTest, bool isDepthWriteEnabled)
+{
+	g_theRenderer->SetDepthStencilState(depthTest, isDepthWriteEnabled);
+}
+
+void RendererRenderBackend::BindShader(Shader* shader)
+{
+	if (shader)
+		g_theRenderer->BindShader(shader);
+	else
+		g_theRenderer->BindShaderByName("Default");
+}
+
+void RendererRenderBackend::BindTexture(const Texture* texture)
+{
+	g_theRenderer->BindTexture(texture);
+}
+
+void RendererRenderBackend::SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor)
+{
+	g_theRenderer->SetModelMatrix(modelMatrix);
+	g_theRenderer->SetModelColor(modelColor);
+}
+
+void RendererRenderBackend::DrawVertexArray(int numVerts, const Vertex_PCU* verts)
+{
+	g_theRenderer->DrawVertexArray(numVerts, verts);
+}
+
+void RendererRenderBackend::DrawVertexBuffer(VertexBuffer* vertexBuffer, int numVerts)
+{
+	g_theRenderer->DrawVertexBuffer(vertexBuffer, numVerts);
+}
+
+void RendererRenderBackend::DrawIndexed(VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices)
+{
+	g_theRenderer->BindVertexBuffer(vertexBuffer);
+	g_theRenderer->BindIndexBuffer(indexBuffer);
+	g_theRenderer->DrawIndexed(numIndices);
+}
+
+void CountingRenderBackend::SetBlendMode(BlendMode blendMode)
+{
+	UNUSED(blendMode);
+	m_counts.m_numBlendChanges++;
+}
+
+void CountingRenderBackend::SetRasterizerState(CullMode cullMode, FillMode fillMode, WindingOrder windingOrder)
+{
+	UNUSED(cullMode);
+	UNUSED(fillMode);
+	UNUSED(windingOrder);
+	m_counts.m_numRasterizerChanges++;
+}
+
+void CountingRenderBackend::SetDepthStencilState(DepthTest depthTest, bool isDepthWriteEnabled)
+{
+	UNUSED(depthTest);
+	UNUSED(isDepthWriteEnabled);
+	m_counts.m_numDepthChanges++;
+}
+
+void CountingRenderBackend::BindShader(Shader* shader)
+{
+	UNUSED(shader);
+	m_counts.m_numShaderBinds++;
+}
+
+void CountingRenderBackend::BindTexture(const Texture* texture)
+{
+	UNUSED(texture);
+	m_counts.m_numTextureBinds++;
+}
+
+void CountingRenderBackend::SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor)
+{
+	UNUSED(modelMatrix);
+	UNUSED(modelColor);
+	m_counts.m_numModelConstantChanges++;
+}
+
+void CountingRenderBackend::DrawVertexArray(int numVerts, const Vertex_PCU* verts)
+{
+	UNUSED(numVerts);
+	UNUSED(verts);
+	m_counts.m_numDraws++;
+}
+
+void CountingRenderBackend::DrawVertexBuffer(VertexBuffer* vertexBuffer, int numVerts)
+{
+	UNUSED(vertexBuffer);
+	UNUSED(numVerts);
+	m_counts.m_numDraws++;
+}
+
+void CountingRenderBackend::DrawIndexed(VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices)
+{
+	UNUSED(vertexBuffer);
+	UNUSED(indexBuffer);
+	UNUSED(numIndices);
+	m_counts.m_numDraws++;
+}
+
+RenderCommandQueue::RenderCommandQueue()
+{
+	if (s_consoleQueues.empty())
+		SubscribeEventCallbackFunction("render.countqueue", Command_CountQueue);
+	s_consoleQueues.push_back(this);
+}
+
+RenderCommandQueue::~RenderCommandQueue()
+{
+	s_consoleQueues.erase(std::remove(s_consoleQueues.begin(), s_consoleQueues.end(), this), s_consoleQueues.end());
+	if (s_consoleQueues.empty())
+		UnsubscribeEventCallbackFunction("render.countqueue", Command_CountQueue);
+}
+
+void RenderCommandQueue::BeginFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats = RenderQueueStats();
+	m_isCountingFrame = m_isCountRequested;
+	m_isCountRequested = false;
+
+	//ids only have to agree within a frame, so resources released since the last one never pile up
+	m_shaderIds.clear();
+	m_textureIds.clear();
+}
+
+void RenderCommandQueue::BeginPass(const Vec3& viewPosition)
+{
+	m_viewPosition = viewPosition;
+	m_commands.clear();
+	m_sortedCommands.clear();
+	m_vertexPool.clear();
+}
+
+void RenderCommandQueue::DrawVertexArray(RenderLayer layer, const RenderState& state, int numVerts, const Vertex_PCU* verts)
+{
+	if (numVerts <= 0)
+		return;
+
+	RenderCommand command;
+	command.m_type = RenderCommandType::VERTEX_ARRAY;
+	command.m_state = state;
+	command.m_firstVertex = int(m_vertexPool.size());
+	command.m_count = numVerts;
+	m_vertexPool.insert(m_vertexPool.end(), verts, verts + numVerts);
+
+	//vertex arrays are sorted by the center of their bounds
+	Vec3 mins = verts[0].m_position;
+	Vec3 maxs = verts[0].m_position;
+	for (int i = 1; i < numVerts; i++)
+	{
+		const Vec3& position = verts[i].m_position;
+		mins = Vec3(std::min(mins.x, position.x), std::min(mins.y, position.y), std::min(mins.z, position.z));
+		maxs = Vec3(std::max(maxs.x, position.x), std::max(maxs.y, position.y), std::max(maxs.z, position.z));
+	}
+	Record(layer, command, state.m_modelMatrix.TransformPosition3D((mins + maxs) * 0.5f));
+}
+
+void RenderCommandQueue::DrawVertexBuffer(RenderLayer layer, const RenderState& state, VertexBuffer* vertexBuffer, int numVerts)
+{
+	if (numVerts <= 0)
+		return;
+
+	RenderCommand command;
+	command.m_type = RenderCommandType::VERTEX_BUFFER;
+	command.m_state = state;
+	command.m_count = numVerts;
+	command.m_vertexBuffer = vertexBuffer;
+	Record(layer, command, state.m_modelMatrix.GetTranslation3D());
+}
+
+void RenderCommandQueue::DrawIndexed(RenderLayer layer, const RenderState& state, VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices)
+{
+	if (numIndices <= 0)
+		return;
+
+	RenderCommand command;
+	command.m_type = RenderCommandType::INDEXED;
+	command.m_state = state;
+	command.m_count = numIndices;
+	command.m_vertexBuffer = vertexBuffer;
+	command.m_indexBuffer = indexBuffer;
+	Record(layer, command, state.m_modelMatrix.GetTranslation3D());
+}
+
+void RenderCommandQueue::Submit(RenderBackend& backend)
+{
+	//the command index breaks key ties, so equal keys keep the order they were recorded in
+	std::sort(m_sortedCommands.begin(), m_sortedCommands.end());
+
+	if (m_isCountingFrame)
+	{
+		CountingRenderBackend recordedBackend;
+		SubmitCommands(recordedBackend, false, false);
+		CountingRenderBackend filteredBackend;
+		SubmitCommands(filteredBackend, false, true);
+		CountingRenderBackend sortedBackend;
+		SubmitCommands(sortedBackend, true, true);
+		const RenderBackendCounts& counts = sortedBackend.GetCounts();
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("Render pass with %d draws: %d state changes as recorded, %d without redundant ones, %d sorted",
+			int(m_commands.size()), recordedBackend.GetCounts().GetNumStateChanges(), filteredBackend.GetCounts().GetNumStateChanges(), counts.GetNumStateChanges()));
+		g_theConsole->AddLine(g_theConsole->COMMAND, Stringf("  sorted blend/rasterizer/depth/shader/texture/constants = %d/%d/%d/%d/%d/%d",
+			counts.m_numBlendChanges, counts.m_numRasterizerChanges, counts.m_numDepthChanges, counts.m_numShaderBinds, counts.m_numTextureBinds, counts.m_numModelConstantChanges));
+	}
+
+	//replaying the recorded order into a counter gives the transitions sorting saved, without touching the gpu
+	CountingRenderBackend unsortedBackend;
+	m_frameStats.m_numCommands += int(m_commands.size());
+	m_frameStats.m_numUnsortedStateChanges += SubmitCommands(unsortedBackend, false, true);
+	m_frameStats.m_numStateChanges += SubmitCommands(backend, true, true);
+	m_commands.clear();
+	m_sortedCommands.clear();
+	m_vertexPool.clear();
+}
+
+//render.countqueue [queue=index], counting the first queue unless another is picked
+bool RenderCommandQueue::Command_CountQueue(EventArgs& args)
+{
+	int queueIndex = args.GetValue("queue", 0);
+	if (queueIndex < 0 || queueIndex >= int(s_consoleQueues.size()))
+	{
+		g_theConsole->AddLine(g_theConsole->INFO_ERROR, Stringf("There are only %d render queues", int(s_consoleQueues.size())));
+		return false;
+	}
+
+	s_consoleQueues[queueIndex]->m_isCountRequested = true;
+	g_theConsole->AddLine(g_theConsole->COMMAND, "Counting the state changes of every render pass next frame");
+	return false;
+}
+
+void RenderCommandQueue::Record(RenderLayer layer, const RenderCommand& command, const Vec3& sortPosition)
+{
+	m_commands.push_back(command);
+	m_sortedCommands.push_back(std::make_pair(MakeSortKey(layer, command.m_state, sortPosition), int(m_commands.size()) - 1));
+}
+
+unsigned long long RenderCommandQueue::MakeSortKey(RenderLayer layer, const RenderState& state, const Vec3& sortPosition)
+{
+	//the bits of a positive float already sort like the float, the top 24 of them are plenty to order draws
+	float distanceSquared = (sortPosition - m_viewPosition).GetLengthSquared();
+	unsigned int distanceBits = 0;
+	memcpy(&distanceBits, &distanceSquared, sizeof(distanceBits));
+	unsigned long long depth = (unsigned long long)(distanceBits >> 7) & SORT_KEY_DEPTH_MASK;
+
+	unsigned long long layerBits = (unsigned long long)(layer) << 60;
+	unsigned long long blend = (unsigned long long)(state.m_blendMode) & 0x7ull;
+	unsigned long long shader = (unsigned long long)(GetResourceId(state.m_shader, m_shaderIds)) & SORT_KEY_SHADER_MASK;
+	unsigned long long texture = (unsigned long long)(GetResourceId(state.m_texture, m_textureIds)) & SORT_KEY_TEXTURE_MASK;
+	if (layer == RenderLayer::TRANSLUCENT)
+	{
+		//far to near first, state only groups draws at the same depth
+		return layerBits | ((SORT_KEY_DEPTH_MASK - depth) << 36) | (blend << 33) | (shader << 21) | (texture << 5);
+	}
+	return layerBits | (blend << 57) | (shader << 45) | (texture << 29) | (depth << 5);
+}
+
+int RenderCommandQueue::GetResourceId(const void* resource, std::unordered_map<const void*, int>& resourceIds)
+{
+	if (!resource)
+		return 0;
+
+	std::unordered_map<const void*, int>::const_iterator found = resourceIds.find(resource);
+	if (found != resourceIds.end())
+		return found->second;
+
+	int resourceId = int(resourceIds.size()) + 1;
+	resourceIds[resource] = resourceId;
+	return resourceId;
+}
+
+int RenderCommandQueue::SubmitCommands(RenderBackend& backend, bool isSorted, bool isFiltered) const
+{
+	int numStateChanges = 0;
+	const RenderState* lastState = nullptr;
+	for (int i = 0; i < int(m_commands.size()); i++)
+	{
+		const RenderCommand& command = m_commands[isSorted ? m_sortedCommands[i].second : i];
+		const RenderState& state = command.m_state;
+		bool isKnown = isFiltered && lastState;
+		if (!isKnown || state.m_blendMode != lastState->m_blendMode)
+		{
+			backend.SetBlendMode(state.m_blendMode);
+			numStateChanges++;
+		}
+		if (!isKnown || state.m_cullMode != lastState->m_cullMode || state.m_fillMode != lastState->m_fillMode || state.m_windingOrder != lastState->m_windingOrder)
+		{
+			backend.SetRasterizerState(state.m_cullMode, state.m_fillMode, state.m_windingOrder);
+			numStateChanges++;
+		}
+		if (!isKnown || state.m_depthTest != lastState->m_depthTest || state.m_isDepthWriteEnabled != lastState->m_isDepthWriteEnabled)
+		{
+			backend.SetDepthStencilState(state.m_depthTest, state.m_isDepthWriteEnabled);
+			numStateChanges++;
+		}
+		if (!isKnown || state.m_shader != lastState->m_shader)
+		{
+			backend.BindShader(state.m_shader);
+			numStateChanges++;
+		}
+		if (!isKnown || state.m_texture != lastState->m_texture)
+		{
+			backend.BindTexture(state.m_texture);
+			numStateChanges++;
+		}
+		const Rgba8& color = state.m_modelColor;
+		const Rgba8& lastColor = isKnown ? lastState->m_modelColor : color;
+		if (!isKnown || memcmp(&state.m_modelMatrix, &lastState->m_modelMatrix, sizeof(Mat44)) != 0
+			|| color.r != lastColor.r || color.g != lastColor.g || color.b != lastColor.b || color.a != lastColor.a)
+		{
+			backend.SetModelConstants(state.m_modelMatrix, state.m_modelColor);
+			numStateChanges++;
+		}
+		lastState = &state;
+
+		switch (command.m_type)
+		{
+		case RenderCommandType::VERTEX_ARRAY: backend.DrawVertexArray(command.m_count, &m_vertexPool[command.m_firstVertex]); break;
+		case RenderCommandType::VERTEX_BUFFER: backend.DrawVertexBuffer(command.m_vertexBuffer, command.m_count); break;
+		case RenderCommandType::INDEXED: backend.DrawIndexed(command.m_vertexBuffer, command.m_indexBuffer, command.m_count); break;
+		}
+	}
+	return numStateChanges;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "Engine/Core/EventSystem.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Math/Mat44.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+
+class Shader;
+class Texture;
+class VertexBuffer;
+class IndexBuffer;
+
+//Passes drawn one after the other, whatever the rest of the sort key says.
+enum class RenderLayer
+{
+	SKYBOX,
+	WORLD,			//front to back, grouped by state
+	TRANSLUCENT,	//back to front, state only breaks depth ties
+	OVERLAY,
+	COUNT
+};
+
+//Everything a draw sets on the pipeline, so the queue can tell which changes between two draws are real.
+struct RenderState
+{
+	BlendMode m_blendMode = BlendMode::ALPHA;
+	CullMode m_cullMode = CullMode::BACK;
+	FillMode m_fillMode = FillMode::SOLID;
+	WindingOrder m_windingOrder = WindingOrder::COUNTERCLOCKWISE;
+	DepthTest m_depthTest = DepthTest::LESSEQUAL;
+	bool m_isDepthWriteEnabled = true;
+	Shader* m_shader = nullptr;		//nullptr for the default shader
+	const Texture* m_texture = nullptr;
+	Mat44 m_modelMatrix;
+	Rgba8 m_modelColor = Rgba8::WHITE;
+};
+
+enum class RenderCommandType
+{
+	VERTEX_ARRAY,
+	VERTEX_BUFFER,
+	INDEXED,
+};
+
+struct RenderCommand
+{
+	RenderCommandType m_type = RenderCommandType::VERTEX_ARRAY;
+	RenderState m_state;
+	int m_firstVertex = 0;		//into the queue's vertex pool, for vertex arrays
+	int m_count = 0;			//verts, or indices for indexed draws
+	VertexBuffer* m_vertexBuffer = nullptr;
+	IndexBuffer* m_indexBuffer = nullptr;
+};
+
+//Calls the queue makes to draw, one per kind of state, so a frame can also be drawn into something that only counts.
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() = default;
+	virtual void SetBlendMode(BlendMode blendMode) = 0;
+	virtual void SetRasterizerState(CullMode cullMode, FillMode fillMode, WindingOrder windingOrder) = 0;
+	virtual void SetDepthStencilState(DepthTest depthTest, bool isDepthWriteEnabled) = 0;
+	virtual void BindShader(Shader* shader) = 0;
+	virtual void BindTexture(const Texture* texture) = 0;
+	virtual void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) = 0;
+	virtual void DrawVertexArray(int numVerts, const Vertex_PCU* verts) = 0;
+	virtual void DrawVertexBuffer(VertexBuffer* vertexBuffer, int numVerts) = 0;
+	virtual void DrawIndexed(VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices) = 0;
+};
+
+//Forwards to g_theRenderer.
+class RendererRenderBackend : public RenderBackend
+{
+public:
+	virtual void SetBlendMode(BlendMode blendMode) override;
+	virtual void SetRasterizerState(CullMode cullMode, FillMode fillMode, WindingOrder windingOrder) override;
+	virtual void SetDepthStencilState(DepthTest depthTest, bool isDepthWriteEnabled) override;
+	virtual void BindShader(Shader* shader) override;
+	virtual void BindTexture(const Texture* texture) override;
+	virtual void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) override;
+	virtual void DrawVertexArray(int numVerts, const Vertex_PCU* verts) override;
+	virtual void DrawVertexBuffer(VertexBuffer* vertexBuffer, int numVerts) override;
+	virtual void DrawIndexed(VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices) override;
+};
+
+struct RenderBackendCounts
+{
+	int m_numBlendChanges = 0;
+	int m_numRasterizerChanges = 0;
+	int m_numDepthChanges = 0;
+	int m_numShaderBinds = 0;
+	int m_numTextureBinds = 0;
+	int m_numModelConstantChanges = 0;
+	int m_numDraws = 0;
+
+	int GetNumStateChanges() const { return m_numBlendChanges + m_numRasterizerChanges + m_numDepthChanges + m_numShaderBinds + m_numTextureBinds + m_numModelConstantChanges; }
+};
+
+//Draws nothing and counts every call, so the state changes of a frame can be measured without a gpu.
+class CountingRenderBackend : public RenderBackend
+{
+public:
+	virtual void SetBlendMode(BlendMode blendMode) override;
+	virtual void SetRasterizerState(CullMode cullMode, FillMode fillMode, WindingOrder windingOrder) override;
+	virtual void SetDepthStencilState(DepthTest depthTest, bool isDepthWriteEnabled) override;
+	virtual void BindShader(Shader* shader) override;
+	virtual void BindTexture(const Texture* texture) override;
+	virtual void SetModelConstants(const Mat44& modelMatrix, const Rgba8& modelColor) override;
+	virtual void DrawVertexArray(int numVerts, const Vertex_PCU* verts) override;
+	virtual void DrawVertexBuffer(VertexBuffer* vertexBuffer, int numVerts) override;
+	virtual void DrawIndexed(VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices) override;
+
+	const RenderBackendCounts& GetCounts() const { return m_counts; }
+	void ResetCounts() { m_counts = RenderBackendCounts(); }
+
+private:
+	RenderBackendCounts m_counts;
+};
+
+struct RenderQueueStats
+{
+	int m_numCommands = 0;
+	int m_numStateChanges = 0;				//made after sorting and dropping redundant ones
+	int m_numUnsortedStateChanges = 0;		//made in the order the draws were recorded, also without redundant ones
+};
+
+//Records the draws of a pass instead of issuing them. Submitting sorts them by a 64 bit key of layer, blend, shader, texture
+//and depth, then only passes on the state that differs from the draw before, so callers can always describe their full state.
+//Direct renderer calls between submits are fine, the first draw of a submit sets everything.
+//Every live queue answers render.countqueue, in the order they were created.
+class RenderCommandQueue
+{
+public:
+	RenderCommandQueue();
+	~RenderCommandQueue();
+
+	void BeginFrame();
+	void BeginPass(const Vec3& viewPosition);
+	void DrawVertexArray(RenderLayer layer, const RenderState& state, int numVerts, const Vertex_PCU* verts);
+	void DrawVertexBuffer(RenderLayer layer, const RenderState& state, VertexBuffer* vertexBuffer, int numVerts);
+	void DrawIndexed(RenderLayer layer, const RenderState& state, VertexBuffer* vertexBuffer, IndexBuffer* indexBuffer, int numIndices);
+	void Submit(RenderBackend& backend);
+	const RenderQueueStats& GetLastFrameStats() const { return m_lastFrameStats; }
+	static bool Command_CountQueue(EventArgs& args);
+
+private:
+	Vec3 m_viewPosition;
+	std::vector<RenderCommand> m_commands;
+	std::vector<std::pair<unsigned long long, int>> m_sortedCommands;		//sort key and command index
+	std::vector<Vertex_PCU> m_vertexPool;
+	std::unordered_map<const void*, int> m_shaderIds;		//id a shader sorts by, handed out again every frame
+	std::unordered_map<const void*, int> m_textureIds;
+	RenderQueueStats m_frameStats;
+	RenderQueueStats m_lastFrameStats;
+	bool m_isCountRequested = false;
+	bool m_isCountingFrame = false;
+
+private:
+	void Record(RenderLayer layer, const RenderCommand& command, const Vec3& sortPosition);
+	unsigned long long MakeSortKey(RenderLayer layer, const RenderState& state, const Vec3& sortPosition);
+	int GetResourceId(const void* resource, std::unordered_map<const void*, int>& resourceIds);
+	int SubmitCommands(RenderBackend& backend, bool isSorted, bool isFiltered) const;
+
+private:
+	static std::vector<RenderCommandQueue*> s_consoleQueues;
+};
@@ -0,0 +1,42 @@
+#include "Game/GameTest.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+//draws alternating between two textures at the same depth, which sorting groups by texture
+static void RecordAlternatingDraws(RenderCommandQueue& queue, const Texture* firstTexture, const Texture* secondTexture, int numDraws)
+{
+	Vertex_PCU vert(Vec3(5.f, 0.f, 0.f), Rgba8::WHITE, Vec2(0.f, 0.f));
+	for (int drawIndex = 0; drawIndex < numDraws; drawIndex++)
+	{
+		RenderState state;
+		state.m_texture = drawIndex % 2 == 0 ? firstTexture : secondTexture;
+		queue.DrawVertexArray(RenderLayer::WORLD, state, 1, &vert);
+	}
+}
+
+GAME_TEST(RenderCommandQueue_CountsTheTransitionsItReplays)
+{
+	//only the addresses of the textures are used
+	int firstTextureStandIn = 0;
+	int secondTextureStandIn = 0;
+	const Texture* firstTexture = reinterpret_cast<const Texture*>(&firstTextureStandIn);
+	const Texture* secondTexture = reinterpret_cast<const Texture*>(&secondTextureStandIn);
+
+	RenderCommandQueue queue;
+	CountingRenderBackend backend;
+	for (int frame = 0; frame < 2; frame++)
+	{
+		queue.BeginFrame();
+		queue.BeginPass(Vec3(0.f, 0.f, 0.f));
+		RecordAlternatingDraws(queue, firstTexture, secondTexture, 6);
+		queue.Submit(backend);
+	}
+	queue.BeginFrame();
+
+	//the first draw sets all six kinds of state, after that only the texture changes, once per draw as recorded and once sorted
+	const RenderQueueStats& stats = queue.GetLastFrameStats();
+	GAME_TEST_CHECK(stats.m_numCommands == 6);
+	GAME_TEST_CHECK(stats.m_numUnsortedStateChanges == 6 + 5);
+	GAME_TEST_CHECK(stats.m_numStateChanges == 6 + 1);
+	GAME_TEST_CHECK(backend.GetCounts().m_numDraws == 12);
+	GAME_TEST_CHECK(backend.GetCounts().m_numTextureBinds == 4);
+}
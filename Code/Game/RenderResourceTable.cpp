@@ -0,0 +1,108 @@
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+#include "Game/RenderResourceTable.hpp"
+
+extern Renderer* g_theRenderer;
+
+RenderResourceTable::~RenderResourceTable()
+{
+	for (int i = 0; i < int(m_staticMeshes.size()); i++)
+	{
+		delete m_staticMeshes[i].m_vertexBuffer;
+	}
+}
+
+TextureHandle RenderResourceTable::InternTexture(const char* path)
+{
+	TextureHandle handle;
+	handle.m_index = FindInternedIndex(m_textureIndices, m_texturePaths, path);
+	if (handle.m_index >= 0)
+		return handle;
+
+	handle.m_index = int(m_textures.size());
+	m_textures.push_back(g_theRenderer ? g_theRenderer->CreateOrGetTextureFromFile(path) : nullptr);
+	m_texturePaths.push_back(path);
+	m_textureIndices[HashResourcePath(path)] = handle.m_index;
+	return handle;
+}
+
+//skyboxes are interned by their name, the six faces only matter the first time
+TextureHandle RenderResourceTable::InternSkyboxTexture(const char* name, const char* front, const char* back, const char* left, const char* right, const char* top, const char* bottom)
+{
+	TextureHandle handle;
+	handle.m_index = FindInternedIndex(m_textureIndices, m_texturePaths, name);
+	if (handle.m_index >= 0)
+		return handle;
+
+	handle.m_index = int(m_textures.size());
+	m_textures.push_back(g_theRenderer ? g_theRenderer->CreateSkyboxTexture(name, front, back, left, right, top, bottom) : nullptr);
+	m_texturePaths.push_back(name);
+	m_textureIndices[HashResourcePath(name)] = handle.m_index;
+	return handle;
+}
+
+ShaderHandle RenderResourceTable::InternShader(const char* path)
+{
+	ShaderHandle handle;
+	handle.m_index = FindInternedIndex(m_shaderIndices, m_shaderPaths, path);
+	if (handle.m_index >= 0)
+		return handle;
+
+	handle.m_index = int(m_shaders.size());
+	m_shaders.push_back(g_theRenderer ? g_theRenderer->CreateOrGetShader(path) : nullptr);
+	m_shaderPaths.push_back(path);
+	m_shaderIndices[HashResourcePath(path)] = handle.m_index;
+	return handle;
+}
+
+FontHandle RenderResourceTable::InternFont(const char* path)
+{
+	FontHandle handle;
+	handle.m_index = FindInternedIndex(m_fontIndices, m_fontPaths, path);
+	if (handle.m_index >= 0)
+		return handle;
+
+	handle.m_index = int(m_fonts.size());
+	m_fonts.push_back(g_theRenderer ? g_theRenderer->CreateOrGetBitmapFont(path) : nullptr);
+	m_fontPaths.push_back(path);
+	m_fontIndices[HashResourcePath(path)] = handle.m_index;
+	return handle;
+}
+
+StaticMeshHandle RenderResourceTable::InternStaticMesh(const char* name, const std::vector<Vertex_PCU>& verts)
+{
+	StaticMeshHandle handle;
+	handle.m_index = FindInternedIndex(m_staticMeshIndices, m_staticMeshNames, name);
+	if (handle.m_index >= 0)
+		return handle;
+
+	StaticMesh mesh;
+	mesh.m_numVerts = int(verts.size());
+	if (g_theRenderer)
+	{
+		mesh.m_vertexBuffer = g_theRenderer->CreateVertexBuffer(verts.size() * sizeof(Vertex_PCU));
+		g_theRenderer->CopyCPUToGPU(verts.data(), verts.size() * sizeof(Vertex_PCU), mesh.m_vertexBuffer);
+	}
+	handle.m_index = int(m_staticMeshes.size());
+	m_staticMeshes.push_back(mesh);
+	m_staticMeshNames.push_back(name);
+	m_staticMeshIndices[HashResourcePath(name)] = handle.m_index;
+	return handle;
+}
+
+int RenderResourceTable::FindIndex(const std::unordered_map<unsigned int, int>& indices, unsigned int pathHash) const
+{
+	std::unordered_map<unsigned int, int>::const_iterator found = indices.find(pathHash);
+	return found == indices.end() ? -1 : found->second;
+}
+
+int RenderResourceTable::FindInternedIndex(const std::unordered_map<unsigned int, int>& indices, const std::vector<std::string>& paths, const char* path) const
+{
+	int index = FindIndex(indices, HashResourcePath(path));
+	if (index >= 0)
+	{
+		GUARANTEE_OR_DIE(paths[index] == path, Stringf("Resource paths %s and %s hash the same", paths[index].c_str(), path));
+	}
+	return index;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "Engine/Core/Vertex_PCU.hpp"
+
+class Texture;
+class Shader;
+class BitmapFont;
+class VertexBuffer;
+
+//FNV-1a of a resource path, constexpr so literal paths can be hashed at compile time.
+constexpr unsigned int HashResourcePath(const char* path, unsigned int hash = 2166136261u)
+{
+	return *path ? HashResourcePath(path + 1, (hash ^ (unsigned int)(unsigned char)*path) * 16777619u) : hash;
+}
+
+//Index into the table's array of one kind of resource, -1 when nothing was interned.
+struct TextureHandle
+{
+	int m_index = -1;
+	bool IsValid() const { return m_index >= 0; }
+	bool operator==(const TextureHandle& other) const { return m_index == other.m_index; }
+	bool operator!=(const TextureHandle& other) const { return m_index != other.m_index; }
+};
+
+struct ShaderHandle
+{
+	int m_index = -1;
+	bool IsValid() const { return m_index >= 0; }
+};
+
+struct FontHandle
+{
+	int m_index = -1;
+	bool IsValid() const { return m_index >= 0; }
+};
+
+struct StaticMeshHandle
+{
+	int m_index = -1;
+	bool IsValid() const { return m_index >= 0; }
+};
+
+//Geometry uploaded once and drawn as is, anything animated about it goes through the model matrix.
+struct StaticMesh
+{
+	VertexBuffer* m_vertexBuffer = nullptr;
+	int m_numVerts = 0;
+};
+
+//Interns resource paths once at load time and hands out handles, so render code reaches its textures, shaders and fonts
+//with an array index instead of a path lookup every frame. Interning the same path again returns the same handle.
+//Static meshes are interned by a name the caller picks, the verts are only read the first time.
+//Without a renderer every handle is still handed out with nothing behind it, so a headless game interns as usual.
+class RenderResourceTable
+{
+public:
+	~RenderResourceTable();
+
+	TextureHandle InternTexture(const char* path);
+	TextureHandle InternSkyboxTexture(const char* name, const char* front, const char* back, const char* left, const char* right, const char* top, const char* bottom);
+	ShaderHandle InternShader(const char* path);
+	FontHandle InternFont(const char* path);
+	StaticMeshHandle InternStaticMesh(const char* name, const std::vector<Vertex_PCU>& verts);
+
+	Texture* GetTexture(TextureHandle handle) const { return handle.m_index >= 0 ? m_textures[handle.m_index] : nullptr; }
+	Shader* GetShader(ShaderHandle handle) const { return handle.m_index >= 0 ? m_shaders[handle.m_index] : nullptr; }
+	BitmapFont* GetFont(FontHandle handle) const { return handle.m_index >= 0 ? m_fonts[handle.m_index] : nullptr; }
+	const StaticMesh& GetStaticMesh(StaticMeshHandle handle) const { return m_staticMeshes[handle.m_index]; }
+
+private:
+	std::unordered_map<unsigned int, int> m_textureIndices;		//path hash to index
+	std::unordered_map<unsigned int, int> m_shaderIndices;
+	std::unordered_map<unsigned int, int> m_fontIndices;
+	std::unordered_map<unsigned int, int> m_staticMeshIndices;
+	std::vector<Texture*> m_textures;
+	std::vector<Shader*> m_shaders;
+	std::vector<BitmapFont*> m_fonts;
+	std::vector<StaticMesh> m_staticMeshes;
+	std::vector<std::string> m_texturePaths;	//kept to catch two paths hashing the same
+	std::vector<std::string> m_shaderPaths;
+	std::vector<std::string> m_fontPaths;
+	std::vector<std::string> m_staticMeshNames;
+
+private:
+	int FindIndex(const std::unordered_map<unsigned int, int>& indices, unsigned int pathHash) const;
+	int FindInternedIndex(const std::unordered_map<unsigned int, int>& indices, const std::vector<std::string>& paths, const char* path) const;
+};
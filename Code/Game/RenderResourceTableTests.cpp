@@ -0,0 +1,91 @@
+#include <string>
+#include "Engine/Core/VertexUtils.hpp"
+#include "Engine/Math/AABB3.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/ParticleTestUtils.hpp"
+#include "Game/RenderResourceTable.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/RenderCommandQueue.hpp"
+
+extern RenderResourceTable* g_theRenderResources;
+
+static const char* RESOURCE_TEST_TEXTURE_PATH = "Data/Images/ResourceTest.png";
+
+GAME_TEST(RenderResources_PathsInternOnceIntoTheSameHandle)
+{
+	//a literal hashes at compile time to what the same path hashes to at load time
+	constexpr unsigned int compiledHash = HashResourcePath("Data/Fonts/MyFixedFont");
+	std::string loadedPath = "Data/Fonts/MyFixedFont";
+	GAME_TEST_CHECK(compiledHash == HashResourcePath(loadedPath.c_str()));
+	GAME_TEST_CHECK(compiledHash != HashResourcePath("Data/Fonts/MyFixedFont2"));
+
+	//interning again hands back the first handle, other paths get the next index of their own kind
+	RenderResourceTable table;
+	TextureHandle first = table.InternTexture("Data/Images/Pinky.png");
+	TextureHandle second = table.InternTexture("Data/Images/Miku.png");
+	TextureHandle again = table.InternTexture(std::string("Data/Images/Pinky.png").c_str());
+	GAME_TEST_CHECK(first.IsValid() && second.IsValid());
+	GAME_TEST_CHECK(first == again);
+	GAME_TEST_CHECK(first != second);
+	GAME_TEST_CHECK(first.m_index == 0 && second.m_index == 1);
+	ShaderHandle shader = table.InternShader("Data/Shaders/Skybox");
+	FontHandle font = table.InternFont(loadedPath.c_str());
+	GAME_TEST_CHECK(shader.m_index == 0 && font.m_index == 0);
+	GAME_TEST_CHECK(table.InternShader("Data/Shaders/Skybox").m_index == shader.m_index);
+
+	//without a renderer the handles still index, with nothing behind them
+	GAME_TEST_CHECK(table.GetTexture(first) == nullptr);
+	GAME_TEST_CHECK(table.GetTexture(TextureHandle()) == nullptr);
+	GAME_TEST_CHECK(!TextureHandle().IsValid());
+}
+
+GAME_TEST(RenderResources_EmittersInternTheirTextureTheFirstTimeTheyDraw)
+{
+	//still emitters draw their own static batch, so the effect binds the texture itself
+	std::vector<ParticleEmitterData> emitterData(1, MakeTestEmitterData(100, 50.f, 10.f, true));
+	emitterData[0].m_textureFilepath = RESOURCE_TEST_TEXTURE_PATH;
+	BatchedParticleEffect firstEffect(emitterData, 1);
+	BatchedParticleEffect secondEffect(emitterData, 1);
+	firstEffect.AddInstance(Mat44());
+	secondEffect.AddInstance(Mat44());
+	firstEffect.Update(0.5f);
+	secondEffect.Update(0.5f);
+
+	//baking leaves the path alone, so tools that never draw never load a texture
+	GAME_TEST_CHECK(!firstEffect.GetEmitter(0).m_texture.IsValid());
+	GAME_TEST_CHECK(firstEffect.GetEmitter(0).m_textureHash == HashResourcePath(RESOURCE_TEST_TEXTURE_PATH));
+
+	//drawing interns it once, and every effect drawing the same texture shares the handle
+	CountingRenderBackend backend;
+	firstEffect.DrawEmitterPasses(backend, 0, Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f));
+	secondEffect.DrawEmitterPasses(backend, 0, Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f));
+	TextureHandle handle = firstEffect.GetEmitter(0).m_texture;
+	GAME_TEST_CHECK(handle.IsValid());
+	GAME_TEST_CHECK(handle == secondEffect.GetEmitter(0).m_texture);
+	GAME_TEST_CHECK(handle == g_theRenderResources->InternTexture(RESOURCE_TEST_TEXTURE_PATH));
+}
+
+GAME_TEST(RenderResources_StaticMeshesAreBuiltOnceAndSharedByName)
+{
+	RenderResourceTable table;
+	std::vector<Vertex_PCU> sphereVerts;
+	AddVertsForSphere(sphereVerts, 16, 16, 1.f);
+	StaticMeshHandle sphere = table.InternStaticMesh("UnitSphere16x16", sphereVerts);
+	GAME_TEST_CHECK(sphere.IsValid());
+	GAME_TEST_CHECK(table.GetStaticMesh(sphere).m_numVerts == int(sphereVerts.size()));
+
+	//later users of the name get the first mesh, whatever verts they bring
+	std::vector<Vertex_PCU> otherVerts;
+	StaticMeshHandle again = table.InternStaticMesh("UnitSphere16x16", otherVerts);
+	GAME_TEST_CHECK(again.m_index == sphere.m_index);
+	GAME_TEST_CHECK(table.GetStaticMesh(again).m_numVerts == int(sphereVerts.size()));
+
+	std::vector<Vertex_PCU> cubeVerts;
+	AddVertsForAABB3D(cubeVerts, AABB3(Vec3(-1.f, -1.f, -1.f), Vec3(1.f, 1.f, 1.f)));
+	StaticMeshHandle cube = table.InternStaticMesh("SkyboxCube", cubeVerts);
+	GAME_TEST_CHECK(cube.m_index != sphere.m_index);
+	GAME_TEST_CHECK(table.GetStaticMesh(cube).m_numVerts == int(cubeVerts.size()));
+
+	//headless there is nothing to upload into, the vert count alone is kept
+	GAME_TEST_CHECK(table.GetStaticMesh(cube).m_vertexBuffer == nullptr);
+}
@@ -1,3 +1,4 @@
+#include <math.h>
 #include "Engine/Renderer/ParticlesManager.hpp"
 #include "Engine/Renderer/Renderer.hpp"
 #include "Engine/Renderer/ParticleSystem.hpp"
@@ -8,28 +9,76 @@
 #include "Engine/Audio/AudioSystem.hpp"
 #include "Game/Zoo.hpp"
 #include "Game/Game.hpp"
+#include "Game/ParticleSystemPool.hpp"
+#include "Game/ParticleSystemReclaimer.hpp"
+#include "Game/ParticleWorld.hpp"
+#include "Game/BatchedParticleEffect.hpp"
+#include "Game/ParticleOcclusionBuffer.hpp"
+#include "Game/RenderCommandQueue.hpp"
+#include "Game/RenderResourceTable.hpp"
 
 extern Renderer* g_theRenderer;
-extern ParticlesManager* g_theParticlesManager;
 extern AudioSystem* g_theAudio;
+extern RenderResourceTable* g_theRenderResources;
 
 const Vec3 PINKY_POS = Vec3(-10.f, 5.f, 1.5f);
 const Vec3 MATERIALIZE_PARTICLE_POS = Vec3(-10.f, 15.f, -0.1f);
 const Vec3 ATOMIZER_BASE_POS = Vec3(-20.f, 0.f, 13.f);
+const char* ATOMIZER_EFFECT_PATH = "Data/ParticleSystemData/Atomizer.xml";
+const char* ATOMIZER_STREAK_EFFECT_PATH = "Data/ParticleSystemData/AtomizerStreak.xml";
+constexpr int NUM_ATOMIZER_STREAKS = 50;
+constexpr int NUM_PREWARMED_ATOMIZER_BURSTS = 2;
 
 Zoo::Zoo(Game* game, GameMode zooMode)
 	:m_game(game), m_zooMode(zooMode)
 {
+	//without a gpu the atomizer bursts run on the cpu and the model, which only exists as a gpu mesh, is left out
+	if (m_game->IsHeadless())
+		m_isAtomizerOnGPU = false;
 	SpawnZooParticles();
-	LoadMikuModel();
+	if (!m_game->IsHeadless())
+		LoadMikuModel();
+	m_pinkyTexture = g_theRenderResources->InternTexture("Data/Images/Pinky.png");
+	std::vector<Vertex_PCU> sphereVerts;
+	AddVertsForSphere(sphereVerts, 16, 16, 1.f);
+	m_domeMesh = g_theRenderResources->InternStaticMesh("UnitSphere16x16", sphereVerts);
+
+	//the pinky quad hides whatever is behind it, so particles back there are not worth simulating or drawing
+	ParticleOcclusionBuffer* occlusionBuffer = m_game->GetParticleWorld()->GetOcclusionBuffer();
+	if (m_zooMode == GameMode::ZOO && occlusionBuffer)
+	{
+		Vec3 topLeft, botLeft, botRight, topRight;
+		GetPinkyCorners(topLeft, botLeft, botRight, topRight);
+		std::vector<Vec3> pinkyTriangles = { topLeft, botLeft, botRight, topLeft, botRight, topRight };
+		m_pinkyOccluderId = occlusionBuffer->AddOccluder(pinkyTriangles, Mat44::IDENTITY);
+	}
 }
 
 Zoo::~Zoo()
 {
-	g_theParticlesManager->KillAllParticleSystems();
+	//hand everything to the reclaimer so switching modes never waits on particle jobs still in flight
+	ParticleSystemReclaimer* reclaimer = m_game->GetParticleSystemReclaimer();
+	m_game->GetParticleSystemPool()->RetireAllPooledSystems();
+	for (int i = 0; i < m_systems.size(); i++)
+	{
+		reclaimer->Retire(m_systems[i]);
+	}
 	m_systems.clear();
+	delete m_atomizerStreakBatch;
+	m_atomizerStreakBatch = nullptr;
+	for (int i = 0; i < m_ambientEffects.size(); i++)
+	{
+		DestroyAmbientEffect(i);
+	}
+	m_ambientEffects.clear();
+	m_ambientSystems.clear();
 	delete m_miku;
 	m_miku = nullptr;
+	if (m_pinkyOccluderId != -1)
+	{
+		m_game->GetParticleWorld()->GetOcclusionBuffer()->RemoveOccluder(m_pinkyOccluderId);
+		m_pinkyOccluderId = -1;
+	}
 }
 
 void Zoo::Update(float deltaSeconds)
@@ -37,15 +86,39 @@ void Zoo::Update(float deltaSeconds)
 	if (m_zooMode == GameMode::ZOO)
 	{
 		UpdateParticlePos(deltaSeconds);
+		for (int i = 0; i < m_ambientEffects.size(); i++)
+		{
+			if (m_ambientEffects[i])
+				m_ambientEffects[i]->Update(deltaSeconds);
+		}
 	}
 	else if (m_zooMode == GameMode::COMBO_ZOO)
 	{
 		UpdateAtomizer(deltaSeconds);
+		m_atomizerStreakBatch->Update(deltaSeconds);
 	}
-	g_theParticlesManager->UpdateParticleSystems(deltaSeconds, m_game->GetWorldCamera());
+	m_game->GetParticleWorld()->UpdateParticleSystems(deltaSeconds, m_game->GetWorldCamera());
 }
 
 void Zoo::Render() const
+{
+	//engine systems draw straight to the gpu, batched effects go through the game's render backend
+	m_game->GetParticleWorld()->RenderEngineSystems(m_game->GetWorldCamera());
+
+	//every batched effect of the zoo goes through the world at once, so effects sharing an atlas page share their draws
+	std::vector<const BatchedParticleEffect*> batchedEffects;
+	if (m_atomizerStreakBatch)
+		batchedEffects.push_back(m_atomizerStreakBatch);
+	for (int i = 0; i < m_ambientEffects.size(); i++)
+	{
+		if (m_ambientEffects[i])
+			batchedEffects.push_back(m_ambientEffects[i]);
+	}
+	m_game->GetParticleWorld()->RenderBatchedEffects(batchedEffects, m_game->GetWorldCamera(), *m_game->GetRenderBackend());
+}
+
+//records into the game's render queue, the particles in Render() are drawn after it is submitted
+void Zoo::RenderGeometry() const
 {
 	if (m_zooMode == GameMode::ZOO)
 	{
@@ -56,16 +129,31 @@ void Zoo::Render() const
 	{
 		RenderSphereDome();
 	}
-	g_theParticlesManager->RenderParticleSystems(m_game->GetWorldCamera());
 }
 
 void Zoo::ChangeParticleSystemType()
 {
+	if (m_zooMode == GameMode::COMBO_ZOO)
+	{
+		//bursts already in flight finish on the old type, the next cycle fires on the new one
+		m_isAtomizerOnGPU = !m_isAtomizerOnGPU;
+		ParticleSystemPool* pool = m_game->GetParticleSystemPool();
+		if (!pool->IsPrewarmed(ATOMIZER_EFFECT_PATH, m_isAtomizerOnGPU))
+			pool->Prewarm(ATOMIZER_EFFECT_PATH, NUM_PREWARMED_ATOMIZER_BURSTS, m_isAtomizerOnGPU);
+	}
+
+	m_areAmbientEffectsOnGPU = !m_areAmbientEffectsOnGPU;
+	for (int i = 0; i < m_ambientEffects.size(); i++)
+	{
+		DestroyAmbientEffect(i);
+		CreateAmbientEffect(i);
+	}
+
 	std::vector<ParticleSystem*> copyOfSystems = m_systems;
 	m_systems.clear();
 	for (int i = 0; i < copyOfSystems.size(); i++)
 	{
-		ParticleSystem* changedSystem = g_theParticlesManager->ChangeParticleSystemType(copyOfSystems[i]);
+		ParticleSystem* changedSystem = m_game->GetParticleWorld()->ChangeEngineSystemType(copyOfSystems[i]);
 		m_systems.push_back(changedSystem);
 	}
 }
@@ -76,6 +164,10 @@ void Zoo::UpdateParticlePos(float deltaSeconds)
 	constexpr float duration = 15.f;
 	constexpr float speed = 100.f;
 	static float timer = 0.f;
+	//a world without a renderer spawns no engine systems
+	if (!m_materializeParticle_Hearts || !m_materializeParticle_Stars)
+		return;
+
 	timer += deltaSeconds;
 	m_materializeParticle_CurrAngle += speed * deltaSeconds;
 	m_materializeParticle_CurrHeight += deltaSeconds * 0.5f;
@@ -103,20 +195,22 @@ void Zoo::UpdateAtomizer(float deltaSeconds)
 	{
 		m_atomizerTimer = 0.f;
 
-		//clear old streaks
+		//old streaks stop emitting and let their trails fade out
 		for (int i = 0; i < m_atomizerStreaks.size(); i++)
 		{
-			g_theParticlesManager->KillParticleSystem(m_atomizerStreaks[i].m_system);
+			m_atomizerStreakBatch->RemoveInstance(m_atomizerStreaks[i].m_instanceIndex);
 		}
 		m_atomizerStreaks.clear();
 
 		//spawn new streaks
 		SpawnAtomizerStreaks();
+		SpawnAtomizerBurst();
 	}
 	for (int i = 0; i < m_atomizerStreaks.size(); i++)
 	{
-		Vec3 currPos = m_atomizerStreaks[i].m_system->GetPosition();
-		m_atomizerStreaks[i].m_system->SetPosition(currPos + (m_atomizerStreaks[i].m_moveDirection * m_atomizerStreaks[i].m_speed * deltaSeconds));
+		AtomizerStreakData& streak = m_atomizerStreaks[i];
+		streak.m_position += streak.m_moveDirection * streak.m_speed * deltaSeconds;
+		m_atomizerStreakBatch->SetInstanceTransform(streak.m_instanceIndex, GetAtomizerStreakTransform(streak));
 	}
 
 	m_domeYaw += 10.f * deltaSeconds;
@@ -128,20 +222,17 @@ void Zoo::SpawnZooParticles()
 {
 	if (m_zooMode == GameMode::ZOO)
 	{
-		ParticleSystem* campfire = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Campfire.xml", Vec3(-10.f, -15.f, 2.f), false);
-		m_systems.push_back(campfire);
-		ParticleSystem* rain = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Rain.xml", Vec3(-10.f, -5.f, 12.f), false);
-		m_systems.push_back(rain);
-		ParticleSystem* flame = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Flame.xml", PINKY_POS, false);
-		m_systems.push_back(flame);
-		m_materializeParticle_Hearts = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Hearts.xml", MATERIALIZE_PARTICLE_POS, false);
+		//looping ambient effects run batched so they go dormant while nobody is looking at them, or hidden behind the pinky
+		SpawnAmbientEffect("Data/ParticleSystemData/Campfire.xml", Vec3(-10.f, -15.f, 2.f));
+		SpawnAmbientEffect("Data/ParticleSystemData/Rain.xml", Vec3(-10.f, -5.f, 12.f));
+		SpawnAmbientEffect("Data/ParticleSystemData/Flame.xml", PINKY_POS);
+		m_materializeParticle_Hearts = m_game->GetParticleWorld()->CreateEngineSystem("Data/ParticleSystemData/Hearts.xml", MATERIALIZE_PARTICLE_POS, false);
 		m_systems.push_back(m_materializeParticle_Hearts);
-		m_materializeParticle_Stars = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Stars.xml", MATERIALIZE_PARTICLE_POS, false);
+		m_materializeParticle_Stars = m_game->GetParticleWorld()->CreateEngineSystem("Data/ParticleSystemData/Stars.xml", MATERIALIZE_PARTICLE_POS, false);
 		m_systems.push_back(m_materializeParticle_Stars);
-		ParticleSystem* starfield = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Starfield.xml", Vec3::ZERO, false);
-		m_systems.push_back(starfield);
-		ParticleSystem* blackhole = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Blackhole.xml", Vec3(5.f, 0.f, 3.f), false);
-		m_systems.push_back(blackhole);
+		SpawnAmbientEffect("Data/ParticleSystemData/Starfield.xml", Vec3::ZERO);
+		//the blackhole's alpha blended core and backdrop are sorted, so they merge into one back to front stream
+		SpawnAmbientEffect("Data/ParticleSystemData/Blackhole.xml", Vec3(5.f, 0.f, 3.f));
 	}
 	else if (m_zooMode == GameMode::CPU_PERF_ZOO)
 	{
@@ -149,7 +240,7 @@ void Zoo::SpawnZooParticles()
 		for (int i = 0; i < 5; i++)
 		{
 			Vec3 spawnPos = startPos + Vec3(i * 10.f, 0.f, 0.f);
-			ParticleSystem* blueParticles = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/TestBlue.xml", spawnPos, false);
+			ParticleSystem* blueParticles = m_game->GetParticleWorld()->CreateEngineSystem("Data/ParticleSystemData/TestBlue.xml", spawnPos, false);
 			m_systems.push_back(blueParticles);
 		}
 
@@ -157,61 +248,64 @@ void Zoo::SpawnZooParticles()
 		for (int i = 0; i < 5; i++)
 		{
 			Vec3 spawnPos = startPos + Vec3(i * 10.f, 0.f, 0.f);
-			ParticleSystem* blueParticles = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/TestBlue.xml", spawnPos, false);
+			ParticleSystem* blueParticles = m_game->GetParticleWorld()->CreateEngineSystem("Data/ParticleSystemData/TestBlue.xml", spawnPos, false);
 			m_systems.push_back(blueParticles);
 		}
 	}
 	else if (m_zooMode == GameMode::GPU_PERF_ZOO)
 	{
-		ParticleSystem* gpuParticle = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Tricolor.xml", Vec3(0.f, 0.f, 30.f), true);
+		ParticleSystem* gpuParticle = m_game->GetParticleWorld()->CreateEngineSystem("Data/ParticleSystemData/Tricolor.xml", Vec3(0.f, 0.f, 30.f), true);
 		m_systems.push_back(gpuParticle);
 	}
 	else if (m_zooMode == GameMode::COMBO_ZOO)
 	{
-		ParticleSystem* atomizer = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/Atomizer.xml", ATOMIZER_BASE_POS, true);
-		m_systems.push_back(atomizer);
+		//every cycle fires the atomizer burst as a pooled one-shot, so nothing is loaded or freed while the zoo runs
+		m_game->GetParticleSystemPool()->Prewarm(ATOMIZER_EFFECT_PATH, NUM_PREWARMED_ATOMIZER_BURSTS, m_isAtomizerOnGPU);
+		SpawnAtomizerBurst();
+		//old and new streaks overlap while the old trails fade out
+		m_atomizerStreakBatch = BatchedParticleEffect::CreateFromEffectFile(ATOMIZER_STREAK_EFFECT_PATH, NUM_ATOMIZER_STREAKS * 2, m_game->GetParticleWorld());
+		GUARANTEE_OR_DIE(m_atomizerStreakBatch, Stringf("Could not load the atomizer streaks from %s", ATOMIZER_STREAK_EFFECT_PATH));
 		SpawnAtomizerStreaks();
 	}
 }
 
 void Zoo::RenderPinky() const
 {
-	Camera worldCam = m_game->GetWorldCamera();
+	Vec3 topLeft, botLeft, botRight, topRight;
+	GetPinkyCorners(topLeft, botLeft, botRight, topRight);
+
+	std::vector<Vertex_PCU> verts;
+	AddVertsForQuad3D(verts, topLeft, botLeft, botRight, topRight);
+	RenderState state;
+	state.m_texture = g_theRenderResources->GetTexture(m_pinkyTexture);
+	m_game->GetRenderQueue()->DrawVertexArray(RenderLayer::TRANSLUCENT, state, int(verts.size()), verts.data());
+}
+
+void Zoo::GetPinkyCorners(Vec3& out_topLeft, Vec3& out_botLeft, Vec3& out_botRight, Vec3& out_topRight) const
+{
 	Vec3 pinkyPos = PINKY_POS;
 	Vec2 pinkySize = Vec2(2.f, 3.f);
 	//Vec3 forward = (worldCam.GetPosition() - pinkyPos).GetNormalized();
 	Vec3 forward = Vec3(1.f, 0.f, 0.f);
 	Vec3 up = Vec3(0.f, 0.f, 1.f);	//world up
 	Vec3 right = CrossProduct3D(up, forward);
-	
-	Vec3 topLeft = pinkyPos + up * pinkySize.y * 0.5f + (-right) * pinkySize.x * 0.5f;
-	Vec3 botLeft = pinkyPos + (-up) * pinkySize.y * 0.5f + (-right) * pinkySize.x * 0.5f;
-	Vec3 botRight = pinkyPos + (-up) * pinkySize.y * 0.5f + right * pinkySize.x * 0.5f;
-	Vec3 topRight = pinkyPos + up * pinkySize.y * 0.5f + right * pinkySize.x * 0.5f;
 
-	std::vector<Vertex_PCU> verts;
-	AddVertsForQuad3D(verts, topLeft, botLeft, botRight, topRight);
-	g_theRenderer->BindShaderByName("Default");
-	g_theRenderer->SetBlendMode(BlendMode::ALPHA);
-	g_theRenderer->SetModelMatrix(Mat44::IDENTITY);
-	g_theRenderer->SetModelColor(Rgba8::WHITE);
-	Texture* pinkyTex = g_theRenderer->CreateOrGetTextureFromFile("Data/Images/Pinky.png");
-	g_theRenderer->BindTexture(pinkyTex);
-	g_theRenderer->DrawVertexArray(int(verts.size()), verts.data());
+	out_topLeft = pinkyPos + up * pinkySize.y * 0.5f + (-right) * pinkySize.x * 0.5f;
+	out_botLeft = pinkyPos + (-up) * pinkySize.y * 0.5f + (-right) * pinkySize.x * 0.5f;
+	out_botRight = pinkyPos + (-up) * pinkySize.y * 0.5f + right * pinkySize.x * 0.5f;
+	out_topRight = pinkyPos + up * pinkySize.y * 0.5f + right * pinkySize.x * 0.5f;
 }
 
 void Zoo::RenderMiku() const
 {
-	Shader* litShader = g_theRenderer->CreateOrGetShader("Data/Shaders/SpriteLit");
-	g_theRenderer->BindShader(litShader);
-	g_theRenderer->BindVertexBuffer(m_miku->GetVertexBuffer());
-	g_theRenderer->BindIndexBuffer(m_miku->GetIndexBuffer());
-	g_theRenderer->SetModelMatrix(Mat44::IDENTITY);
-	g_theRenderer->SetModelColor(Rgba8::WHITE);
-	//g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-	Texture* mikuTex = g_theRenderer->CreateOrGetTextureFromFile("Data/Models/miku/miku_base.png");
-	g_theRenderer->BindTexture(mikuTex);
-	g_theRenderer->DrawIndexed(m_miku->GetElementCount());
+	if (!m_miku)
+		return;
+
+	RenderState state;
+	state.m_shader = g_theRenderResources->GetShader(m_mikuShader);
+	//state.m_blendMode = BlendMode::OPAQUE;
+	state.m_texture = g_theRenderResources->GetTexture(m_mikuTexture);
+	m_game->GetRenderQueue()->DrawIndexed(RenderLayer::WORLD, state, m_miku->GetVertexBuffer(), m_miku->GetIndexBuffer(), m_miku->GetElementCount());
 }
 
 void Zoo::LoadMikuModel()
@@ -227,47 +321,93 @@ void Zoo::LoadMikuModel()
 	builder.ImportFromOBJFile("Data/Models/miku/miku.obj", options);
 	m_miku = new Mesh(g_theRenderer);
 	m_miku->UpdateFromBuilder(builder);
+	m_mikuShader = g_theRenderResources->InternShader("Data/Shaders/SpriteLit");
+	m_mikuTexture = g_theRenderResources->InternTexture("Data/Models/miku/miku_base.png");
 }
 
 void Zoo::RenderSphereDome() const
 {
-	std::vector<Vertex_PCU> verts;
-	AddVertsForSphere(verts, 16, 16, m_domeRadius);
-	Mat44 transformMatrix = Mat44::CreateTranslation3D(ATOMIZER_BASE_POS);
-	transformMatrix.Append(Mat44::CreateZRotationDegrees(m_domeYaw));
-	TransformVertexArray3D(int(verts.size()), verts.data(), transformMatrix);
-	g_theRenderer->SetRasterizerState(CullMode::BACK, FillMode::WIREFRAME, WindingOrder::COUNTERCLOCKWISE);
-	g_theRenderer->SetBlendMode(BlendMode::ALPHA);
-	g_theRenderer->SetModelColor(Rgba8(0, 225, 255, m_domeAlpha));
-	g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->DrawVertexArray(int(verts.size()), verts.data());
-	g_theRenderer->SetRasterizerState(CullMode::BACK, FillMode::SOLID, WindingOrder::COUNTERCLOCKWISE);
+	//the unit sphere is uploaded once, the radius and yaw it animates with only change the model matrix
+	RenderState state;
+	state.m_fillMode = FillMode::WIREFRAME;
+	state.m_modelColor = Rgba8(0, 225, 255, m_domeAlpha);
+	state.m_modelMatrix = Mat44::CreateTranslation3D(ATOMIZER_BASE_POS);
+	state.m_modelMatrix.Append(Mat44::CreateZRotationDegrees(m_domeYaw));
+	state.m_modelMatrix.Append(Mat44::CreateUniformScale3D(m_domeRadius));
+	const StaticMesh& sphere = g_theRenderResources->GetStaticMesh(m_domeMesh);
+	m_game->GetRenderQueue()->DrawVertexBuffer(RenderLayer::TRANSLUCENT, state, sphere.m_vertexBuffer, sphere.m_numVerts);
 }
 
 void Zoo::SpawnAtomizerStreaks()
 {
 	RandomNumberGenerator rng;
-	constexpr int NUM_STREAKS = 50;
-	m_atomizerStreaks.reserve(NUM_STREAKS);
-	for (int i = 0; i < NUM_STREAKS; i++)
+	m_atomizerStreaks.reserve(NUM_ATOMIZER_STREAKS);
+	for (int i = 0; i < NUM_ATOMIZER_STREAKS; i++)
 	{
-		Vec3 randDirInSphere = rng.GetRandomDirectionInSphere();
-		Vec3 spawnPos = ATOMIZER_BASE_POS + ((randDirInSphere) * 10.f);
-		ParticleSystem* atomizerStreak = g_theParticlesManager->CreateParticleSystem("Data/ParticleSystemData/AtomizerStreak.xml", spawnPos, false);
-		m_systems.push_back(atomizerStreak);
-		std::vector<ParticleEmitterData> emitterData = atomizerStreak->GetEmitterDataForAllEmitters();
-		ConeEmitter* coneEmitter = dynamic_cast<ConeEmitter*>(emitterData[0].m_shape);
-		coneEmitter->m_coneForward = randDirInSphere;
-		atomizerStreak->UpdateEmitterData(emitterData);
-
+		Vec3 randDirInSphere = rng.GetRandomDirectionInSphere().GetNormalized();
 		AtomizerStreakData data;
-		data.m_system = atomizerStreak;
-		data.m_moveDirection = coneEmitter->m_coneForward;
+		data.m_position = ATOMIZER_BASE_POS + ((randDirInSphere) * 10.f);
+		data.m_moveDirection = randDirInSphere;
 		data.m_speed = rng.GetRandomFloatInRange(5.f, 8.f);
+		data.m_instanceIndex = m_atomizerStreakBatch->AddInstance(GetAtomizerStreakTransform(data));
 		m_atomizerStreaks.push_back(data);
 	}
 
 	//play sound
+	if (!g_theAudio)
+		return;
 	SoundID atomizerSound = g_theAudio->CreateOrGetSound("Data/Audio/Atomizer.wav");
 	g_theAudio->StartSound(atomizerSound);
 }
+
+void Zoo::SpawnAtomizerBurst()
+{
+	m_game->GetParticleSystemPool()->SpawnOneShot(ATOMIZER_EFFECT_PATH, &ATOMIZER_BASE_POS, 1, 0.f, m_isAtomizerOnGPU);
+}
+
+void Zoo::SpawnAmbientEffect(const char* effectPath, const Vec3& position)
+{
+	m_ambientEffectPaths.push_back(effectPath);
+	m_ambientEffectPositions.push_back(position);
+	m_ambientEffects.push_back(nullptr);
+	m_ambientSystems.push_back(nullptr);
+	CreateAmbientEffect(int(m_ambientEffects.size()) - 1);
+}
+
+void Zoo::CreateAmbientEffect(int ambientIndex)
+{
+	//batched effects simulate on the cpu, so on the gpu the effect goes back to being an engine system
+	if (m_areAmbientEffectsOnGPU)
+	{
+		m_ambientSystems[ambientIndex] = m_game->GetParticleWorld()->CreateEngineSystem(m_ambientEffectPaths[ambientIndex], m_ambientEffectPositions[ambientIndex], true);
+		return;
+	}
+
+	BatchedParticleEffect* effect = BatchedParticleEffect::CreateFromEffectFile(m_ambientEffectPaths[ambientIndex], 1, m_game->GetParticleWorld());
+	if (!effect)
+		return;
+
+	effect->AddInstance(Mat44::CreateTranslation3D(m_ambientEffectPositions[ambientIndex]));
+	m_ambientEffects[ambientIndex] = effect;
+}
+
+void Zoo::DestroyAmbientEffect(int ambientIndex)
+{
+	delete m_ambientEffects[ambientIndex];
+	m_ambientEffects[ambientIndex] = nullptr;
+	if (m_ambientSystems[ambientIndex])
+	{
+		m_game->GetParticleSystemReclaimer()->Retire(m_ambientSystems[ambientIndex]);
+		m_ambientSystems[ambientIndex] = nullptr;
+	}
+}
+
+Mat44 Zoo::GetAtomizerStreakTransform(const AtomizerStreakData& streak) const
+{
+	//the streak effect emits along its local +y, so that axis points where the streak is heading
+	Vec3 jBasis = streak.m_moveDirection;
+	Vec3 helper = fabsf(jBasis.z) < 0.99f ? Vec3(0.f, 0.f, 1.f) : Vec3(1.f, 0.f, 0.f);
+	Vec3 iBasis = CrossProduct3D(jBasis, helper).GetNormalized();
+	Vec3 kBasis = CrossProduct3D(iBasis, jBasis);
+	return Mat44(iBasis, jBasis, kBasis, streak.m_position);
+}
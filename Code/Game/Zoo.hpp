@@ -6,10 +6,12 @@ class Game;
 class ParticleSystem;
 class Prop;
 class Mesh;
+class BatchedParticleEffect;
 
 struct AtomizerStreakData
 {
-	ParticleSystem* m_system;
+	int m_instanceIndex = -1;
+	Vec3 m_position;
 	Vec3 m_moveDirection;
 	float m_speed = 0.f;
 };
@@ -21,6 +23,7 @@ public:
 	~Zoo();
 	void Update(float deltaSeconds);
 	void Render() const;
+	void RenderGeometry() const;
 	void ChangeParticleSystemType();
 
 private:
@@ -32,19 +35,37 @@ private:
 	float m_materializeParticle_CurrAngle = 0.f;
 	float m_materializeParticle_CurrHeight = 0.f;
 	Mesh* m_miku = nullptr;
+	TextureHandle m_mikuTexture;
+	ShaderHandle m_mikuShader;
+	TextureHandle m_pinkyTexture;
+	StaticMeshHandle m_domeMesh;
 	std::vector<AtomizerStreakData> m_atomizerStreaks;
+	BatchedParticleEffect* m_atomizerStreakBatch = nullptr;
+	std::vector<const char*> m_ambientEffectPaths;
+	std::vector<Vec3> m_ambientEffectPositions;
+	std::vector<BatchedParticleEffect*> m_ambientEffects;		//null while the effect runs on the gpu
+	std::vector<ParticleSystem*> m_ambientSystems;				//null while the effect runs batched
+	bool m_areAmbientEffectsOnGPU = false;
+	int m_pinkyOccluderId = -1;
 	float m_domeRadius = 0.f;
 	float m_domeYaw  = 0.f;
 	unsigned char m_domeAlpha = 255;
 	float m_atomizerTimer = 0.f;
+	bool m_isAtomizerOnGPU = true;
 
 private:
 	void UpdateParticlePos(float deltaSeconds);
 	void UpdateAtomizer(float deltaSeconds);
 	void SpawnZooParticles();
 	void RenderPinky() const;
+	void GetPinkyCorners(Vec3& out_topLeft, Vec3& out_botLeft, Vec3& out_botRight, Vec3& out_topRight) const;
 	void RenderMiku() const;
 	void LoadMikuModel();
 	void RenderSphereDome() const;
 	void SpawnAtomizerStreaks();
+	void SpawnAtomizerBurst();
+	void SpawnAmbientEffect(const char* effectPath, const Vec3& position);
+	void CreateAmbientEffect(int ambientIndex);
+	void DestroyAmbientEffect(int ambientIndex);
+	Mat44 GetAtomizerStreakTransform(const AtomizerStreakData& streak) const;
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+//Expands the compact particle instances written by the batched runtime into billboarded quads.
+//There is no vertex data, the instance and the corner both come from the vertex id.
+
+struct vs_input_t
+{
+    uint vertexID : SV_VertexID;
+};
+
+struct v2p_t
+{
+    float4 position : SV_Position;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+cbuffer CameraConstants : register(b2)
+{
+    float4x4 projectionMatrix;
+    float4x4 viewMatrix;
+}
+
+cbuffer ModelConstants : register(b3)
+{
+    float4x4 modelMatrix;
+    float4 modelColor;
+}
+
+cbuffer CompactParticleConstants : register(b11)
+{
+    float4 cameraLeft;
+    float4 cameraUp;
+    int isHorizontal;
+    int firstInstance;
+    int2 padding;
+}
+
+//20 bytes, laid out like CompactParticleInstance
+struct CompactParticle
+{
+    uint positionXY;            //half floats
+    uint positionZHalfWidth;    //half floats
+    uint halfHeightRotation;    //half floats
+    uint color;                 //rgba8
+    uint spriteFrameOrigin;     //16 bits each, the frame indexes particleFrameUVs
+};
+
+Texture2D diffuseTexture : register(t0);
+SamplerState diffuseSampler : register(s0);
+StructuredBuffer<CompactParticle> particleInstances : register(t1);
+StructuredBuffer<float4> particleOrigins : register(t2);
+StructuredBuffer<float4> particleFrameUVs : register(t3);    //mins in xy, maxs in zw
+
+static float2 corners[6] = { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f), float2(0.f, 0.f), float2(1.f, 1.f), float2(0.f, 1.f) };
+
+v2p_t VertexMain(vs_input_t input)
+{
+    CompactParticle particle = particleInstances[firstInstance + input.vertexID / 6];
+    uint originIndex = particle.spriteFrameOrigin >> 16;
+    float3 position = particleOrigins[originIndex].xyz + float3(f16tof32(particle.positionXY), f16tof32(particle.positionXY >> 16), f16tof32(particle.positionZHalfWidth));
+    float halfWidth = f16tof32(particle.positionZHalfWidth >> 16);
+    float halfHeight = f16tof32(particle.halfHeightRotation);
+    float rotationRadians = radians(f16tof32(particle.halfHeightRotation >> 16));
+
+    float3 right = -cameraLeft.xyz;
+    float3 up = cameraUp.xyz;
+    if (isHorizontal != 0)
+    {
+        right = float3(1.f, 0.f, 0.f);
+        up = float3(0.f, 1.f, 0.f);
+    }
+    float rotationCos = cos(rotationRadians);
+    float rotationSin = sin(rotationRadians);
+    float3 rotatedRight = right * rotationCos + up * rotationSin;
+    up = up * rotationCos - right * rotationSin;
+    right = rotatedRight;
+
+    float2 corner = corners[input.vertexID % 6];
+    float3 worldPosition = position + right * halfWidth * (corner.x * 2.f - 1.f) + up * halfHeight * (corner.y * 2.f - 1.f);
+
+    //the frame rects already account for the sprite sheet layout and the particle atlas
+    float4 frameUVs = particleFrameUVs[particle.spriteFrameOrigin & 0xffff];
+
+    float4 modelSpacePos = mul(modelMatrix, float4(worldPosition, 1.f));
+    float4 viewSpacePos = mul(viewMatrix, modelSpacePos);
+    v2p_t v2p;
+    v2p.position = mul(projectionMatrix, viewSpacePos);
+    v2p.color = float4(particle.color & 0xff, (particle.color >> 8) & 0xff, (particle.color >> 16) & 0xff, particle.color >> 24) / 255.f;
+    v2p.uv = lerp(frameUVs.xy, frameUVs.zw, corner);
+    return v2p;
+}
+
+float4 PixelMain(v2p_t input) : SV_Target0
+{
+    float4 tint = input.color * modelColor;
+    return diffuseTexture.Sample(diffuseSampler, input.uv) * tint;
+}
@@ -0,0 +1,121 @@
+//Plays back a loop clip. The clip's particles are uploaded once in instance space, and each frame only brings one segment per
+//visible instance and emitter: where the instance is and which particles its current frame shows.
+//Every segment owns the same number of quads, so the segment, the particle and the corner all come from the vertex id.
+
+struct vs_input_t
+{
+    uint vertexID : SV_VertexID;
+};
+
+struct v2p_t
+{
+    float4 position : SV_Position;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+cbuffer CameraConstants : register(b2)
+{
+    float4x4 projectionMatrix;
+    float4x4 viewMatrix;
+}
+
+cbuffer ModelConstants : register(b3)
+{
+    float4x4 modelMatrix;
+    float4 modelColor;
+}
+
+cbuffer LoopClipConstants : register(b12)
+{
+    float4 cameraLeft;
+    float4 cameraUp;
+    int isHorizontal;
+    int firstSegment;
+    int quadsPerSegment;
+    int padding;
+}
+
+//64 bytes, laid out like LoopClipParticleInstance
+struct ClipParticle
+{
+    float3 position;            //instance space
+    float halfWidth;
+    float halfHeight;
+    float rotationDegrees;
+    uint color;                 //rgba8
+    float padding;
+    float4 uvMinsMaxs;
+    float3 frameDelta;
+    float padding2;
+};
+
+//80 bytes, laid out like LoopClipSegment
+struct ClipSegment
+{
+    float4 iBasis;
+    float4 jBasis;
+    float4 kBasis;
+    float4 translation;
+    uint firstParticle;
+    uint numParticles;
+    float frameFraction;
+    float padding;
+};
+
+Texture2D diffuseTexture : register(t0);
+SamplerState diffuseSampler : register(s0);
+StructuredBuffer<ClipParticle> clipParticles : register(t1);
+StructuredBuffer<ClipSegment> clipSegments : register(t2);
+
+static float2 corners[6] = { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f), float2(0.f, 0.f), float2(1.f, 1.f), float2(0.f, 1.f) };
+
+v2p_t VertexMain(vs_input_t input)
+{
+    uint quadIndex = input.vertexID / 6;
+    ClipSegment segment = clipSegments[firstSegment + quadIndex / quadsPerSegment];
+    uint particleInSegment = quadIndex % quadsPerSegment;
+    v2p_t v2p;
+    if (particleInSegment >= segment.numParticles)
+    {
+        //past the end of this frame, collapsed to a point so nothing is rasterized
+        v2p.position = float4(0.f, 0.f, 0.f, 0.f);
+        v2p.color = float4(0.f, 0.f, 0.f, 0.f);
+        v2p.uv = float2(0.f, 0.f);
+        return v2p;
+    }
+
+    ClipParticle particle = clipParticles[segment.firstParticle + particleInSegment];
+    float2 corner = corners[input.vertexID % 6];
+
+    float3 localPosition = particle.position + particle.frameDelta * segment.frameFraction;
+    float3 center = segment.translation.xyz + segment.iBasis.xyz * localPosition.x + segment.jBasis.xyz * localPosition.y + segment.kBasis.xyz * localPosition.z;
+
+    float3 right = -cameraLeft.xyz;
+    float3 up = cameraUp.xyz;
+    if (isHorizontal != 0)
+    {
+        right = float3(1.f, 0.f, 0.f);
+        up = float3(0.f, 1.f, 0.f);
+    }
+    float rotationRadians = radians(particle.rotationDegrees);
+    float rotationCos = cos(rotationRadians);
+    float rotationSin = sin(rotationRadians);
+    float3 rotatedRight = right * rotationCos + up * rotationSin;
+    up = up * rotationCos - right * rotationSin;
+    right = rotatedRight;
+
+    float3 worldPosition = center + right * particle.halfWidth * (corner.x * 2.f - 1.f) + up * particle.halfHeight * (corner.y * 2.f - 1.f);
+    float4 modelSpacePos = mul(modelMatrix, float4(worldPosition, 1.f));
+    float4 viewSpacePos = mul(viewMatrix, modelSpacePos);
+    v2p.position = mul(projectionMatrix, viewSpacePos);
+    v2p.color = float4(particle.color & 0xff, (particle.color >> 8) & 0xff, (particle.color >> 16) & 0xff, particle.color >> 24) / 255.f;
+    v2p.uv = lerp(particle.uvMinsMaxs.xy, particle.uvMinsMaxs.zw, corner);
+    return v2p;
+}
+
+float4 PixelMain(v2p_t input) : SV_Target0
+{
+    float4 tint = input.color * modelColor;
+    return diffuseTexture.Sample(diffuseSampler, input.uv) * tint;
+}
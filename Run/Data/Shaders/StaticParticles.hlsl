@@ -0,0 +1,87 @@
+//Billboards the static particles of one batch, which are uploaded once when the batch changes.
+//There is no vertex data, the particle and the corner both come from the vertex id.
+
+struct vs_input_t
+{
+    uint vertexID : SV_VertexID;
+};
+
+struct v2p_t
+{
+    float4 position : SV_Position;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+cbuffer CameraConstants : register(b2)
+{
+    float4x4 projectionMatrix;
+    float4x4 viewMatrix;
+}
+
+cbuffer ModelConstants : register(b3)
+{
+    float4x4 modelMatrix;
+    float4 modelColor;
+}
+
+cbuffer StaticParticleConstants : register(b12)
+{
+    float4 cameraLeft;
+    float4 cameraUp;
+    float4 uvMinsMaxs;          //static emitters only ever show one frame
+    int isHorizontal;
+    int3 padding;
+}
+
+//32 bytes, laid out like StaticParticleInstance
+struct StaticParticle
+{
+    float3 position;            //world space
+    float halfWidth;
+    float halfHeight;
+    float rotationDegrees;
+    uint color;                 //rgba8
+    float padding;
+};
+
+Texture2D diffuseTexture : register(t0);
+SamplerState diffuseSampler : register(s0);
+StructuredBuffer<StaticParticle> staticParticles : register(t1);
+
+static float2 corners[6] = { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f), float2(0.f, 0.f), float2(1.f, 1.f), float2(0.f, 1.f) };
+
+v2p_t VertexMain(vs_input_t input)
+{
+    StaticParticle particle = staticParticles[input.vertexID / 6];
+    float2 corner = corners[input.vertexID % 6];
+
+    float3 right = -cameraLeft.xyz;
+    float3 up = cameraUp.xyz;
+    if (isHorizontal != 0)
+    {
+        right = float3(1.f, 0.f, 0.f);
+        up = float3(0.f, 1.f, 0.f);
+    }
+    float rotationRadians = radians(particle.rotationDegrees);
+    float rotationCos = cos(rotationRadians);
+    float rotationSin = sin(rotationRadians);
+    float3 rotatedRight = right * rotationCos + up * rotationSin;
+    up = up * rotationCos - right * rotationSin;
+    right = rotatedRight;
+
+    float3 worldPosition = particle.position + right * particle.halfWidth * (corner.x * 2.f - 1.f) + up * particle.halfHeight * (corner.y * 2.f - 1.f);
+    float4 modelSpacePos = mul(modelMatrix, float4(worldPosition, 1.f));
+    float4 viewSpacePos = mul(viewMatrix, modelSpacePos);
+    v2p_t v2p;
+    v2p.position = mul(projectionMatrix, viewSpacePos);
+    v2p.color = float4(particle.color & 0xff, (particle.color >> 8) & 0xff, (particle.color >> 16) & 0xff, particle.color >> 24) / 255.f;
+    v2p.uv = lerp(uvMinsMaxs.xy, uvMinsMaxs.zw, corner);
+    return v2p;
+}
+
+float4 PixelMain(v2p_t input) : SV_Target0
+{
+    float4 tint = input.color * modelColor;
+    return diffuseTexture.Sample(diffuseSampler, input.uv) * tint;
+}